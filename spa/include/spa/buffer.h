@@ -72,6 +72,8 @@ struct spa_chunk {
 /** Data for a buffer */
 struct spa_data {
 	uint32_t type;			/**< memory type */
+#define SPA_DATA_FLAG_MAP_TWICE	(1<<0)	/**< the memory is mapped twice, back to back, so that
+					 *   a ringbuffer in it can be accessed without wrapping */
 	uint32_t flags;			/**< data flags */
 	int fd;				/**< optional fd for data */
 	uint32_t mapoffset;		/**< offset to map fd at */
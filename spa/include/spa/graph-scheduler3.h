@@ -29,6 +29,7 @@ extern "C" {
 struct spa_graph_scheduler {
 	struct spa_graph *graph;
         struct spa_graph_node *node;
+	struct spa_list pending;	/* async nodes with outstanding work */
 };
 
 static inline void spa_graph_scheduler_init(struct spa_graph_scheduler *sched,
@@ -36,6 +37,65 @@ static inline void spa_graph_scheduler_init(struct spa_graph_scheduler *sched,
 {
 	sched->graph = graph;
 	sched->node = NULL;
+	spa_list_init(&sched->pending);
+}
+
+/* An async node that returned SPA_RESULT_OK from process_input has issued
+ * work that completes later. Its dependents are resumed from
+ * spa_graph_scheduler_complete(), the scheduler continues with the other
+ * nodes meanwhile. */
+static inline void spa_graph_scheduler_issued(struct spa_graph_scheduler *sched,
+					      struct spa_graph_node *node)
+{
+	struct spa_graph_port *p;
+
+	if (!(node->flags & SPA_GRAPH_NODE_FLAG_ASYNC) || node->state != SPA_RESULT_OK ||
+	    node->pending_link.next != NULL)
+		return;
+
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+		if (p->peer == NULL)
+			continue;
+		debug("node %p issued\n", node);
+		spa_list_insert(sched->pending.prev, &node->pending_link);
+		break;
+	}
+}
+
+/* Called when an async node signals completion. Returns false when the
+ * node missed the deadline, its result is then left for the next cycle
+ * and the dependents are not resumed. */
+static inline bool spa_graph_scheduler_complete(struct spa_graph_scheduler *sched,
+						struct spa_graph_node *node)
+{
+	if (node->pending_link.next) {
+		spa_list_remove(&node->pending_link);
+		node->pending_link.next = NULL;
+	} else if (node->late) {
+		debug("node %p completed late\n", node);
+		node->late = false;
+		return false;
+	}
+	return true;
+}
+
+/* Called at the deadline of the cycle. Nodes that did not complete are
+ * marked late and skipped until they complete. Returns the number of
+ * late nodes. */
+static inline uint32_t spa_graph_scheduler_deadline(struct spa_graph_scheduler *sched)
+{
+	struct spa_graph_node *n, *t;
+	uint32_t late = 0;
+
+	spa_list_for_each_safe(n, t, &sched->pending, pending_link) {
+		debug("node %p missed deadline\n", n);
+		spa_list_remove(&n->pending_link);
+		n->pending_link.next = NULL;
+		n->late = true;
+		n->xruns++;
+		late++;
+	}
+	return late;
 }
 
 static inline int spa_graph_node_scheduler_input(void *data)
@@ -113,9 +173,10 @@ static inline void spa_graph_scheduler_pull(struct spa_graph_scheduler *sched, s
 
 	debug("node %p %d %d\n", node, node->ready_in, node->required_in);
 
-	if (node->required_in > 0 && node->ready_in == node->required_in) {
+	if (!node->late && node->required_in > 0 && node->ready_in == node->required_in) {
 		node->state = node->callbacks->process_input(node->callbacks_data);
 		debug("node %p processed in %d\n", node, node->state);
+		spa_graph_scheduler_issued(sched, node);
 		if (node->state == SPA_RESULT_HAVE_BUFFER) {
 			spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
 				if (p->io->status == SPA_RESULT_HAVE_BUFFER)
@@ -141,8 +202,18 @@ static inline void spa_graph_scheduler_chain(struct spa_graph_scheduler *sched,
 
 
 	spa_list_for_each_safe(n, t, ready, ready_link) {
+		spa_list_remove(&n->ready_link);
+		n->ready_link.next = NULL;
+
+		if (n->late) {
+			debug("node %p is late, skip\n", n);
+			n->ready_in = 0;
+			continue;
+		}
+
 		n->state = n->callbacks->process_input(n->callbacks_data);
 		debug("node %p chain processed in %d\n", n, n->state);
+		spa_graph_scheduler_issued(sched, n);
 		if (n->state == SPA_RESULT_HAVE_BUFFER)
 			spa_graph_scheduler_push(sched, n);
 		else {
@@ -152,8 +223,6 @@ static inline void spa_graph_scheduler_chain(struct spa_graph_scheduler *sched,
 			                n->ready_in++;
 			}
 		}
-		spa_list_remove(&n->ready_link);
-		n->ready_link.next = NULL;
 	}
 }
 
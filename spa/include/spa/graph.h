@@ -73,6 +73,9 @@ struct spa_graph_node {
 	uint32_t max_in;
 	uint32_t required_in;
 	uint32_t ready_in;
+	struct spa_list pending_link;	/* link in the scheduler pending list */
+	bool late;			/* async node missed the deadline */
+	uint32_t xruns;			/* number of missed deadlines */
 	const struct spa_graph_node_callbacks *callbacks;
 	void *callbacks_data;
 };
@@ -101,6 +104,8 @@ spa_graph_node_init(struct spa_graph_node *node)
 	spa_list_init(&node->ports[SPA_DIRECTION_OUTPUT]);
 	node->flags = 0;
 	node->max_in = node->required_in = node->ready_in = 0;
+	node->late = false;
+	node->xruns = 0;
 	debug("node %p init\n", node);
 }
 
@@ -120,6 +125,7 @@ spa_graph_node_add(struct spa_graph *graph,
 	node->state = SPA_RESULT_NEED_BUFFER;
 	node->action = SPA_GRAPH_ACTION_OUT;
 	node->ready_link.next = NULL;
+	node->pending_link.next = NULL;
 	spa_list_insert(graph->nodes.prev, &node->link);
 	debug("node %p add\n", node);
 }
@@ -165,6 +171,10 @@ static inline void spa_graph_node_remove(struct spa_graph_node *node)
 	spa_list_remove(&node->link);
 	if (node->ready_link.next)
 		spa_list_remove(&node->ready_link);
+	if (node->pending_link.next) {
+		spa_list_remove(&node->pending_link);
+		node->pending_link.next = NULL;
+	}
 }
 
 static inline void spa_graph_port_remove(struct spa_graph_port *port)
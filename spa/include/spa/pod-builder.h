@@ -42,6 +42,10 @@ struct spa_pod_builder {
 			   uint32_t size);
 	bool in_array;
 	bool first;
+	/* called when \a size bytes don't fit in data. It should update data and
+	 * size and return 0, or < 0 to let the write fail. Pointers into data are
+	 * invalid after it returns, only refs stay valid. */
+	int (*overflow) (struct spa_pod_builder *builder, uint32_t size);
 };
 
 #define SPA_POD_BUILDER_INIT(buffer,size)  { buffer, size, }
@@ -56,6 +60,13 @@ static inline void spa_pod_builder_init(struct spa_pod_builder *builder, void *d
 	builder->stack = NULL;
 }
 
+static inline void
+spa_pod_builder_set_overflow(struct spa_pod_builder *builder,
+			     int (*overflow) (struct spa_pod_builder *builder, uint32_t size))
+{
+	builder->overflow = overflow;
+}
+
 static inline uint32_t
 spa_pod_builder_push(struct spa_pod_builder *builder,
 		     struct spa_pod_frame *frame,
@@ -81,7 +92,8 @@ spa_pod_builder_raw(struct spa_pod_builder *builder, const void *data, uint32_t
 		ref = builder->write(builder, -1, data, size);
 	} else {
 		ref = builder->offset;
-		if (ref + size > builder->size)
+		if (ref + size > builder->size &&
+		    (builder->overflow == NULL || builder->overflow(builder, ref + size) < 0))
 			ref = -1;
 		else
 			memcpy(builder->data + ref, data, size);
@@ -49,6 +49,10 @@ struct spa_props {
 #define SPA_TYPE_PROPS__volume		SPA_TYPE_PROPS_BASE "volume"
 #define SPA_TYPE_PROPS__mute		SPA_TYPE_PROPS_BASE "mute"
 #define SPA_TYPE_PROPS__patternType	SPA_TYPE_PROPS_BASE "patternType"
+#define SPA_TYPE_PROPS__threads		SPA_TYPE_PROPS_BASE "threads"
+#define SPA_TYPE_PROPS__threadType	SPA_TYPE_PROPS_BASE "threadType"
+#define SPA_TYPE_PROPS__rate		SPA_TYPE_PROPS_BASE "rate"
+#define SPA_TYPE_PROPS__quality		SPA_TYPE_PROPS_BASE "quality"
 
 static inline uint32_t
 spa_pod_builder_push_props(struct spa_pod_builder *builder,
@@ -0,0 +1,539 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <spa/pod-builder.h>
+#include <spa/pod-iter.h>
+
+#include "format-cache.h"
+#include "format.h"
+
+#define NAME "format-cache"
+
+#define CACHE_VERSION	1
+
+/** \cond */
+struct spa_format_cache {
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	char *filename;
+	char *stamp;
+	bool valid;
+
+	struct spa_pod_builder b;
+	uint32_t *offsets;
+	uint32_t n_formats;
+};
+
+typedef uint32_t (*remap_func_t) (void *data, uint32_t id);
+
+struct save_data {
+	struct spa_type_map *map;
+	uint32_t *ids;
+	uint32_t n_ids;
+};
+
+struct load_data {
+	uint32_t *ids;
+	uint32_t n_ids;
+};
+/** \endcond */
+
+static inline bool remap_id(uint32_t *id, remap_func_t func, void *data)
+{
+	uint32_t res;
+
+	if ((res = func(data, *id)) == SPA_ID_INVALID)
+		return false;
+	*id = res;
+	return true;
+}
+
+static bool remap_pod(struct spa_pod *pod, uint32_t maxsize, remap_func_t func, void *data);
+
+static bool
+remap_children(void *body, uint32_t offset, uint32_t size, remap_func_t func, void *data)
+{
+	while (offset < size) {
+		struct spa_pod *p = SPA_MEMBER(body, offset, struct spa_pod);
+
+		if (!remap_pod(p, size - offset, func, data))
+			return false;
+		offset += SPA_ROUND_UP_N(SPA_POD_SIZE(p), 8);
+	}
+	return true;
+}
+
+/* like pw_pod_remap_data() but checks the sizes of all pods against
+ * the available space because the data can come from a file */
+static bool remap_pod(struct spa_pod *pod, uint32_t maxsize, remap_func_t func, void *data)
+{
+	void *body = SPA_POD_BODY(pod);
+	uint32_t size, offset;
+
+	if (maxsize < sizeof(struct spa_pod) || SPA_POD_SIZE(pod) > maxsize)
+		return false;
+
+	size = pod->size;
+
+	switch (pod->type) {
+	case SPA_POD_TYPE_ID:
+		if (size < sizeof(uint32_t))
+			return false;
+		return remap_id(body, func, data);
+
+	case SPA_POD_TYPE_PROP:
+	{
+		struct spa_pod_prop_body *b = body;
+
+		if (size < sizeof(struct spa_pod_prop_body) || !remap_id(&b->key, func, data))
+			return false;
+
+		if (b->value.type != SPA_POD_TYPE_ID)
+			return true;
+		if (b->value.size != sizeof(uint32_t))
+			return false;
+
+		/* the default value and the alternatives */
+		for (offset = sizeof(struct spa_pod_prop_body);
+		     offset + sizeof(uint32_t) <= size; offset += sizeof(uint32_t))
+			if (!remap_id(SPA_MEMBER(b, offset, uint32_t), func, data))
+				return false;
+		return true;
+	}
+	case SPA_POD_TYPE_OBJECT:
+	{
+		struct spa_pod_object_body *b = body;
+
+		if (size < sizeof(struct spa_pod_object_body) || !remap_id(&b->type, func, data))
+			return false;
+
+		return remap_children(body, sizeof(struct spa_pod_object_body), size, func, data);
+	}
+	case SPA_POD_TYPE_STRUCT:
+		return remap_children(body, 0, size, func, data);
+
+	default:
+		return true;
+	}
+}
+
+/* map a local type id to an index in the table of type names */
+static uint32_t save_id(void *data, uint32_t id)
+{
+	struct save_data *d = data;
+	uint32_t i, *ids;
+
+	for (i = 0; i < d->n_ids; i++)
+		if (d->ids[i] == id)
+			return i;
+
+	if (spa_type_map_get_type(d->map, id) == NULL)
+		return SPA_ID_INVALID;
+
+	if ((ids = realloc(d->ids, (d->n_ids + 1) * sizeof(uint32_t))) == NULL)
+		return SPA_ID_INVALID;
+	d->ids = ids;
+	d->ids[d->n_ids] = id;
+
+	return d->n_ids++;
+}
+
+/* map an index in the table of type names to a local type id */
+static uint32_t load_id(void *data, uint32_t id)
+{
+	struct load_data *d = data;
+
+	if (id >= d->n_ids)
+		return SPA_ID_INVALID;
+
+	return d->ids[id];
+}
+
+static int cache_append(struct spa_format_cache *cache, const struct spa_pod *pod)
+{
+	uint32_t *offsets, ref;
+
+	offsets = realloc(cache->offsets, (cache->n_formats + 1) * sizeof(uint32_t));
+	if (offsets == NULL)
+		return SPA_RESULT_NO_MEMORY;
+	cache->offsets = offsets;
+
+	ref = spa_pod_builder_raw_padded(&cache->b, pod, SPA_POD_SIZE(pod));
+	if (ref == -1)
+		return SPA_RESULT_NO_MEMORY;
+
+	cache->offsets[cache->n_formats++] = ref;
+
+	return SPA_RESULT_OK;
+}
+
+static char *make_filename(const char *key)
+{
+	const char *dir, *home;
+	char *filename, *p, path[PATH_MAX];
+	int len, size;
+
+	if ((dir = getenv("SPA_FORMAT_CACHE_DIR")) != NULL)
+		len = snprintf(path, sizeof(path), "%s", dir);
+	else if ((dir = getenv("XDG_CACHE_HOME")) != NULL)
+		len = snprintf(path, sizeof(path), "%s/spa/formats", dir);
+	else if ((home = getenv("HOME")) != NULL)
+		len = snprintf(path, sizeof(path), "%s/.cache/spa/formats", home);
+	else
+		return NULL;
+
+	if (len < 0 || len >= sizeof(path))
+		return NULL;
+
+	size = len + strlen(key) + 2;
+	if ((filename = malloc(size)) == NULL)
+		return NULL;
+	snprintf(filename, size, "%s/%s", path, key);
+
+	/* the key is used as the file name, make it safe */
+	for (p = filename + len + 1; *p; p++) {
+		if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+		      (*p >= '0' && *p <= '9') || *p == '-' || *p == '.'))
+			*p = '_';
+	}
+	return filename;
+}
+
+static int make_dirs(char *filename)
+{
+	char *p;
+
+	for (p = strchr(filename + 1, '/'); p; p = strchr(p + 1, '/')) {
+		*p = '\0';
+		if (mkdir(filename, 0700) < 0 && errno != EEXIST) {
+			*p = '/';
+			return -errno;
+		}
+		*p = '/';
+	}
+	return 0;
+}
+
+static bool load_file(struct spa_format_cache *cache, struct spa_pod *pod, uint32_t size)
+{
+	struct spa_pod_iter it, names;
+	struct spa_pod *types, *formats, *p;
+	struct load_data data = { NULL, 0 };
+	const char *stamp;
+	int32_t version;
+	bool res = false;
+
+	if (!spa_pod_iter_struct(&it, pod, size) ||
+	    !spa_pod_iter_get(&it,
+			      SPA_POD_TYPE_INT, &version,
+			      SPA_POD_TYPE_POD, &p,
+			      SPA_POD_TYPE_POD, &types,
+			      SPA_POD_TYPE_POD, &formats, 0))
+		return false;
+
+	if (version != CACHE_VERSION || p->type != SPA_POD_TYPE_STRING || p->size == 0)
+		return false;
+
+	stamp = SPA_POD_CONTENTS(struct spa_pod_string, p);
+	if (stamp[p->size - 1] != '\0' || strcmp(stamp, cache->stamp) != 0) {
+		spa_log_debug(cache->log, NAME " %p: stamp changed, ignoring %s",
+			      cache, cache->filename);
+		return false;
+	}
+
+	if (!spa_pod_iter_pod(&names, types) || formats->type != SPA_POD_TYPE_STRUCT)
+		return false;
+
+	while (spa_pod_iter_has_next(&names)) {
+		uint32_t *ids;
+		const char *name;
+
+		p = spa_pod_iter_next(&names);
+		if (p->type != SPA_POD_TYPE_STRING || p->size == 0)
+			goto done;
+
+		name = SPA_POD_CONTENTS(struct spa_pod_string, p);
+		if (name[p->size - 1] != '\0')
+			goto done;
+
+		if ((ids = realloc(data.ids, (data.n_ids + 1) * sizeof(uint32_t))) == NULL)
+			goto done;
+		data.ids = ids;
+		data.ids[data.n_ids++] = spa_type_map_get_id(cache->map, name);
+	}
+
+	if (!remap_pod(formats, SPA_POD_SIZE(formats), load_id, &data))
+		goto done;
+
+	SPA_POD_CONTENTS_FOREACH(formats, sizeof(struct spa_pod_struct), p) {
+		if (p->type != SPA_POD_TYPE_OBJECT ||
+		    cache_append(cache, p) != SPA_RESULT_OK) {
+			spa_format_cache_reset(cache);
+			goto done;
+		}
+	}
+	res = true;
+
+      done:
+	free(data.ids);
+	return res;
+}
+
+static void load(struct spa_format_cache *cache)
+{
+	struct stat st;
+	void *data;
+	int fd;
+
+	if ((fd = open(cache->filename, O_RDONLY | O_CLOEXEC)) < 0)
+		return;
+
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(struct spa_pod) ||
+	    st.st_size > 1024 * 1024)
+		goto close;
+
+	if ((data = malloc(st.st_size)) == NULL)
+		goto close;
+
+	if (read(fd, data, st.st_size) == st.st_size &&
+	    load_file(cache, data, st.st_size)) {
+		spa_log_info(cache->log, NAME " %p: loaded %u formats from %s",
+			     cache, cache->n_formats, cache->filename);
+		cache->valid = true;
+	}
+	free(data);
+
+      close:
+	close(fd);
+}
+
+/** Make a new format cache
+ *
+ * \param map a type map
+ * \param log a log or NULL
+ * \param key a key that identifies the device
+ * \param stamp a string that changes when the formats of the device change
+ * \return a new format cache or NULL on error
+ *
+ * The formats are loaded from the cache file when it exists and has the
+ * same stamp. Check with spa_format_cache_is_valid().
+ */
+struct spa_format_cache *
+spa_format_cache_new(struct spa_type_map *map,
+		     struct spa_log *log,
+		     const char *key,
+		     const char *stamp)
+{
+	struct spa_format_cache *cache;
+
+	if (map == NULL || key == NULL || stamp == NULL)
+		return NULL;
+
+	cache = calloc(1, sizeof(struct spa_format_cache));
+	if (cache == NULL)
+		return NULL;
+
+	cache->map = map;
+	cache->log = log;
+	cache->filename = make_filename(key);
+	cache->stamp = strdup(stamp);
+	cache->b = (struct spa_pod_builder) { .overflow = spa_pod_builder_realloc };
+
+	if (cache->filename)
+		load(cache);
+
+	return cache;
+}
+
+/** Free a format cache
+ *
+ * \param cache a format cache
+ */
+void spa_format_cache_free(struct spa_format_cache *cache)
+{
+	free(cache->b.data);
+	free(cache->offsets);
+	free(cache->filename);
+	free(cache->stamp);
+	free(cache);
+}
+
+/** Check if a format cache has the complete list of formats
+ *
+ * \param cache a format cache
+ * \return true when the formats were loaded or saved
+ */
+bool spa_format_cache_is_valid(struct spa_format_cache *cache)
+{
+	return cache->valid;
+}
+
+/** Get a format from the cache
+ *
+ * \param cache a format cache
+ * \param index the index of the format
+ * \return the format at \a index or NULL when there are no more formats
+ */
+const struct spa_format *
+spa_format_cache_get(struct spa_format_cache *cache, uint32_t index)
+{
+	if (index >= cache->n_formats)
+		return NULL;
+
+	return SPA_MEMBER(cache->b.data, cache->offsets[index], struct spa_format);
+}
+
+/** Add a format to the cache
+ *
+ * \param cache a format cache
+ * \param format a format to add
+ * \return SPA_RESULT_OK on success
+ *
+ * Formats can only be added when the cache is not valid. Call
+ * spa_format_cache_save() after the last format was added.
+ */
+int spa_format_cache_add(struct spa_format_cache *cache, const struct spa_format *format)
+{
+	if (cache->valid)
+		return SPA_RESULT_ERROR;
+
+	return cache_append(cache, &format->pod);
+}
+
+/** Save the formats of the cache
+ *
+ * \param cache a format cache
+ * \return SPA_RESULT_OK on success
+ *
+ * Makes the cache valid and writes the formats to the cache file.
+ */
+int spa_format_cache_save(struct spa_format_cache *cache)
+{
+	struct spa_pod_builder b = { .overflow = spa_pod_builder_realloc };
+	struct spa_pod_frame f[2];
+	struct save_data data = { cache->map, NULL, 0 };
+	struct spa_pod *pod;
+	char *tmp = NULL;
+	uint32_t i;
+	int fd, res = SPA_RESULT_OK;
+
+	if (cache->valid)
+		return SPA_RESULT_OK;
+
+	cache->valid = true;
+
+	if (cache->filename == NULL)
+		return SPA_RESULT_OK;
+
+	/* the formats with their type ids replaced by an index in the names table */
+	spa_pod_builder_push_struct(&b, &f[0]);
+	for (i = 0; i < cache->n_formats; i++) {
+		uint32_t ref;
+
+		pod = (struct spa_pod *) spa_format_cache_get(cache, i);
+		ref = spa_pod_builder_raw_padded(&b, pod, SPA_POD_SIZE(pod));
+		if (ref == -1)
+			goto no_memory;
+
+		pod = SPA_POD_BUILDER_DEREF(&b, ref, struct spa_pod);
+		if (!remap_pod(pod, SPA_POD_SIZE(pod), save_id, &data)) {
+			spa_log_warn(cache->log, NAME " %p: can't map format types", cache);
+			res = SPA_RESULT_ERROR;
+			goto done;
+		}
+	}
+	spa_pod_builder_pop(&b, &f[0]);
+	pod = b.data;
+	b = (struct spa_pod_builder) { .overflow = spa_pod_builder_realloc };
+
+	spa_pod_builder_push_struct(&b, &f[0]);
+	spa_pod_builder_int(&b, CACHE_VERSION);
+	spa_pod_builder_string(&b, cache->stamp);
+	spa_pod_builder_push_struct(&b, &f[1]);
+	for (i = 0; i < data.n_ids; i++)
+		spa_pod_builder_string(&b, spa_type_map_get_type(cache->map, data.ids[i]));
+	spa_pod_builder_pop(&b, &f[1]);
+	spa_pod_builder_raw_padded(&b, pod, SPA_POD_SIZE(pod));
+	spa_pod_builder_pop(&b, &f[0]);
+	free(pod);
+
+	if (b.data == NULL || b.offset > b.size)
+		goto no_memory;
+
+	if (make_dirs(cache->filename) < 0)
+		goto write_failed;
+
+	if ((tmp = malloc(strlen(cache->filename) + 5)) == NULL)
+		goto no_memory;
+	sprintf(tmp, "%s.tmp", cache->filename);
+
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0)
+		goto write_failed;
+
+	if (write(fd, b.data, b.offset) != b.offset) {
+		close(fd);
+		unlink(tmp);
+		goto write_failed;
+	}
+	close(fd);
+
+	if (rename(tmp, cache->filename) < 0) {
+		unlink(tmp);
+		goto write_failed;
+	}
+	spa_log_info(cache->log, NAME " %p: saved %u formats to %s",
+		     cache, cache->n_formats, cache->filename);
+	goto done;
+
+      no_memory:
+	res = SPA_RESULT_NO_MEMORY;
+	goto done;
+      write_failed:
+	spa_log_warn(cache->log, NAME " %p: can't write %s: %s",
+		     cache, cache->filename, strerror(errno));
+	res = SPA_RESULT_ERROR;
+      done:
+	free(tmp);
+	free(data.ids);
+	free(b.data);
+	return res;
+}
+
+/** Remove all formats from the cache
+ *
+ * \param cache a format cache
+ *
+ * Makes the cache invalid, the formats need to be added again.
+ */
+void spa_format_cache_reset(struct spa_format_cache *cache)
+{
+	cache->b.offset = 0;
+	cache->n_formats = 0;
+	cache->valid = false;
+}
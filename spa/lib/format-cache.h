@@ -0,0 +1,71 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_LIBFORMAT_CACHE_H__
+#define __SPA_LIBFORMAT_CACHE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/defs.h>
+#include <spa/format.h>
+#include <spa/type-map.h>
+#include <spa/log.h>
+
+/** \class spa_format_cache
+ *
+ * Keeps the formats of a device in a file so that they don't need to be
+ * enumerated from the hardware again.
+ *
+ * A cache is identified by a key, usually the serial or bus path of the
+ * device, and validated with a stamp that changes when the device or
+ * driver changes. The file stores the formats together with the names
+ * of the types they use so that they can be loaded with a different
+ * type map.
+ *
+ * The cache file is placed in $SPA_FORMAT_CACHE_DIR or
+ * $XDG_CACHE_HOME/spa/formats (~/.cache/spa/formats).
+ */
+struct spa_format_cache;
+
+struct spa_format_cache *
+spa_format_cache_new(struct spa_type_map *map,
+		     struct spa_log *log,
+		     const char *key,
+		     const char *stamp);
+
+void spa_format_cache_free(struct spa_format_cache *cache);
+
+bool spa_format_cache_is_valid(struct spa_format_cache *cache);
+
+const struct spa_format *
+spa_format_cache_get(struct spa_format_cache *cache, uint32_t index);
+
+int spa_format_cache_add(struct spa_format_cache *cache, const struct spa_format *format);
+
+int spa_format_cache_save(struct spa_format_cache *cache);
+
+void spa_format_cache_reset(struct spa_format_cache *cache);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __SPA_LIBFORMAT_CACHE_H__ */
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <spa/format-builder.h>
@@ -27,6 +28,22 @@
 
 #include <lib/props.h>
 
+/* overflow handler for builders with heap data, the data is grown with
+ * realloc and should be freed with free() */
+int
+spa_pod_builder_realloc(struct spa_pod_builder *builder, uint32_t size)
+{
+	uint32_t s = SPA_ROUND_UP_N(size, 4096);
+	void *d;
+
+	if ((d = realloc(builder->data, s)) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	builder->data = d;
+	builder->size = s;
+	return SPA_RESULT_OK;
+}
+
 int
 spa_format_filter(const struct spa_format *format,
 		  const struct spa_format *filter,
@@ -33,6 +33,8 @@ int spa_format_filter(const struct spa_format *format,
 int spa_format_compare(const struct spa_format *format1,
 		       const struct spa_format *format2);
 
+int spa_pod_builder_realloc(struct spa_pod_builder *builder, uint32_t size);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
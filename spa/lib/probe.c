@@ -0,0 +1,240 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <spa/list.h>
+#include <spa/pod-utils.h>
+
+#include "probe.h"
+
+#define NAME "probe"
+
+/** \cond */
+struct result {
+	struct spa_list link;
+	/* followed by the result pod */
+};
+
+struct spa_probe {
+	struct spa_loop *main_loop;
+	struct spa_log *log;
+
+	spa_probe_work_func_t work;
+	spa_probe_result_func_t result;
+	void *data;
+
+	pthread_mutex_t lock;
+	struct spa_list results;
+	bool stopping;
+
+	struct spa_source source;
+
+	uint32_t n_threads;
+	pthread_t threads[0];
+};
+/** \endcond */
+
+static void on_results(struct spa_source *source)
+{
+	struct spa_probe *probe = source->data;
+	struct result *r;
+	uint64_t count;
+
+	if (read(probe->source.fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+		spa_log_warn(probe->log, NAME " %p: failed to read fd: %s",
+			     probe, strerror(errno));
+
+	while (true) {
+		pthread_mutex_lock(&probe->lock);
+		if (spa_list_is_empty(&probe->results))
+			r = NULL;
+		else {
+			r = spa_list_first(&probe->results, struct result, link);
+			spa_list_remove(&r->link);
+		}
+		pthread_mutex_unlock(&probe->lock);
+
+		if (r == NULL)
+			break;
+
+		probe->result(probe->data, SPA_MEMBER(r, sizeof(struct result), struct spa_pod));
+		free(r);
+	}
+}
+
+static void *probe_thread(void *data)
+{
+	struct spa_probe *probe = data;
+
+	probe->work(probe, probe->data);
+
+	return NULL;
+}
+
+/** Make a new probe pool and start the worker threads
+ *
+ * \param main_loop the loop to deliver the results on
+ * \param log a log or NULL
+ * \param n_threads the number of worker threads
+ * \param work the function to run in each worker thread
+ * \param result the function to call with each result
+ * \param data user data for \a work and \a result
+ * \return a new probe pool or NULL when no thread could be started
+ */
+struct spa_probe *
+spa_probe_new(struct spa_loop *main_loop,
+	      struct spa_log *log,
+	      uint32_t n_threads,
+	      spa_probe_work_func_t work,
+	      spa_probe_result_func_t result,
+	      void *data)
+{
+	struct spa_probe *probe;
+	uint32_t i;
+	int err;
+
+	if (n_threads == 0)
+		return NULL;
+
+	probe = calloc(1, sizeof(struct spa_probe) + n_threads * sizeof(pthread_t));
+	if (probe == NULL)
+		return NULL;
+
+	probe->main_loop = main_loop;
+	probe->log = log;
+	probe->work = work;
+	probe->result = result;
+	probe->data = data;
+
+	pthread_mutex_init(&probe->lock, NULL);
+	spa_list_init(&probe->results);
+
+	probe->source.func = on_results;
+	probe->source.data = probe;
+	probe->source.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	probe->source.mask = SPA_IO_IN | SPA_IO_ERR;
+	if (probe->source.fd == -1)
+		goto no_fd;
+
+	spa_loop_add_source(main_loop, &probe->source);
+
+	for (i = 0; i < n_threads; i++) {
+		if ((err = pthread_create(&probe->threads[i], NULL, probe_thread, probe)) != 0) {
+			spa_log_warn(log, NAME " %p: can't create thread: %s", probe, strerror(err));
+			break;
+		}
+	}
+	probe->n_threads = i;
+	if (probe->n_threads == 0)
+		goto no_threads;
+
+	spa_log_debug(log, NAME " %p: started %u threads", probe, probe->n_threads);
+
+	return probe;
+
+      no_threads:
+	spa_loop_remove_source(main_loop, &probe->source);
+	close(probe->source.fd);
+      no_fd:
+	pthread_mutex_destroy(&probe->lock);
+	free(probe);
+	return NULL;
+}
+
+/** Post a result to the main loop
+ *
+ * \param probe a probe pool
+ * \param result a result pod, a copy is made
+ * \return SPA_RESULT_OK on success
+ *
+ * This function can be called from any thread.
+ */
+int spa_probe_post(struct spa_probe *probe, const struct spa_pod *result)
+{
+	struct result *r;
+	uint64_t count = 1;
+	size_t size = SPA_POD_SIZE(result);
+
+	r = malloc(sizeof(struct result) + size);
+	if (r == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	memcpy(SPA_MEMBER(r, sizeof(struct result), void), result, size);
+
+	pthread_mutex_lock(&probe->lock);
+	spa_list_insert(probe->results.prev, &r->link);
+	pthread_mutex_unlock(&probe->lock);
+
+	if (write(probe->source.fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+		spa_log_warn(probe->log, NAME " %p: failed to write fd: %s",
+			     probe, strerror(errno));
+
+	return SPA_RESULT_OK;
+}
+
+/** Check if the probe pool is being destroyed
+ *
+ * \param probe a probe pool
+ * \return true when the work functions should return
+ */
+bool spa_probe_is_stopping(struct spa_probe *probe)
+{
+	bool stopping;
+
+	pthread_mutex_lock(&probe->lock);
+	stopping = probe->stopping;
+	pthread_mutex_unlock(&probe->lock);
+
+	return stopping;
+}
+
+/** Destroy a probe pool
+ *
+ * \param probe a probe pool
+ *
+ * Waits for the worker threads to finish. Results that were not yet
+ * delivered are dropped.
+ */
+void spa_probe_destroy(struct spa_probe *probe)
+{
+	struct result *r, *t;
+	uint32_t i;
+
+	pthread_mutex_lock(&probe->lock);
+	probe->stopping = true;
+	pthread_mutex_unlock(&probe->lock);
+
+	for (i = 0; i < probe->n_threads; i++)
+		pthread_join(probe->threads[i], NULL);
+
+	spa_loop_remove_source(probe->main_loop, &probe->source);
+	close(probe->source.fd);
+
+	spa_list_for_each_safe(r, t, &probe->results, link)
+		free(r);
+
+	pthread_mutex_destroy(&probe->lock);
+	free(probe);
+}
@@ -0,0 +1,69 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_LIBPROBE_H__
+#define __SPA_LIBPROBE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/defs.h>
+#include <spa/pod.h>
+#include <spa/loop.h>
+#include <spa/log.h>
+
+/** \class spa_probe
+ *
+ * A pool of worker threads that probe devices in the background and
+ * post the results back to the main loop.
+ *
+ * Each worker thread runs the work function once. The work function
+ * typically takes devices from a shared list until the list is empty
+ * or spa_probe_is_stopping() returns true, and posts a result pod with
+ * spa_probe_post() for each probed device. The result function is
+ * called from the main loop with a copy of each posted result.
+ */
+struct spa_probe;
+
+/** Called in each worker thread */
+typedef void (*spa_probe_work_func_t) (struct spa_probe *probe, void *data);
+
+/** Called from the main loop for each posted result */
+typedef void (*spa_probe_result_func_t) (void *data, const struct spa_pod *result);
+
+struct spa_probe *
+spa_probe_new(struct spa_loop *main_loop,
+	      struct spa_log *log,
+	      uint32_t n_threads,
+	      spa_probe_work_func_t work,
+	      spa_probe_result_func_t result,
+	      void *data);
+
+int spa_probe_post(struct spa_probe *probe, const struct spa_pod *result);
+
+bool spa_probe_is_stopping(struct spa_probe *probe);
+
+void spa_probe_destroy(struct spa_probe *probe);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __SPA_LIBPROBE_H__ */
@@ -129,6 +129,9 @@ static inline struct spa_pod_prop *find_prop(const struct spa_pod *pod, uint32_t
 	return NULL;
 }
 
+/* the builder can grow while filtering, never keep a pointer into it */
+#define PROP_FLAGS(b,f)	(SPA_POD_BUILDER_DEREF(b, (f)->ref, struct spa_pod_prop)->body.flags)
+
 int
 spa_props_filter(struct spa_pod_builder *b,
 		 const struct spa_pod *props,
@@ -141,7 +144,7 @@ spa_props_filter(struct spa_pod_builder *b,
 
 	SPA_POD_FOREACH(props, props_size, pr) {
 		struct spa_pod_frame f;
-		struct spa_pod_prop *p1, *p2, *np;
+		struct spa_pod_prop *p1, *p2;
 		int nalt1, nalt2;
 		void *alt1, *alt2, *a1, *a2;
 		uint32_t rt1, rt2;
@@ -165,8 +168,7 @@ spa_props_filter(struct spa_pod_builder *b,
 		rt2 = p2->body.flags & SPA_POD_PROP_RANGE_MASK;
 
 		/* else we filter. start with copying the property */
-		spa_pod_builder_push_prop(b, &f, p1->body.key, 0),
-		    np = SPA_POD_BUILDER_DEREF(b, f.ref, struct spa_pod_prop);
+		spa_pod_builder_push_prop(b, &f, p1->body.key, 0);
 
 		/* default value */
 		spa_pod_builder_raw(b, &p1->body.value,
@@ -209,7 +211,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			}
 			if (n_copied == 0)
 				return SPA_RESULT_INCOMPATIBLE_PROPS;
-			np->body.flags |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
+			PROP_FLAGS(b, &f) |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
 		}
 
 		if ((rt1 == SPA_POD_PROP_RANGE_NONE && rt2 == SPA_POD_PROP_RANGE_MIN_MAX) ||
@@ -227,7 +229,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			}
 			if (n_copied == 0)
 				return SPA_RESULT_INCOMPATIBLE_PROPS;
-			np->body.flags |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
+			PROP_FLAGS(b, &f) |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
 		}
 
 		if ((rt1 == SPA_POD_PROP_RANGE_NONE && rt2 == SPA_POD_PROP_RANGE_STEP) ||
@@ -250,7 +252,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			}
 			if (n_copied == 0)
 				return SPA_RESULT_INCOMPATIBLE_PROPS;
-			np->body.flags |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
+			PROP_FLAGS(b, &f) |= SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET;
 		}
 
 		if (rt1 == SPA_POD_PROP_RANGE_MIN_MAX && rt2 == SPA_POD_PROP_RANGE_MIN_MAX) {
@@ -267,7 +269,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			else
 				spa_pod_builder_raw(b, alt2, p2->body.value.size);
 
-			np->body.flags |= SPA_POD_PROP_RANGE_MIN_MAX | SPA_POD_PROP_FLAG_UNSET;
+			PROP_FLAGS(b, &f) |= SPA_POD_PROP_RANGE_MIN_MAX | SPA_POD_PROP_FLAG_UNSET;
 		}
 
 		if (rt1 == SPA_POD_PROP_RANGE_NONE && rt2 == SPA_POD_PROP_RANGE_FLAGS)
@@ -306,7 +308,7 @@ spa_props_filter(struct spa_pod_builder *b,
 			return SPA_RESULT_NOT_IMPLEMENTED;
 
 		spa_pod_builder_pop(b, &f);
-		fix_default(np);
+		fix_default(SPA_POD_BUILDER_DEREF(b, f.ref, struct spa_pod_prop));
 	}
 	return SPA_RESULT_OK;
 }
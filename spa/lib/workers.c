@@ -0,0 +1,235 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "workers.h"
+
+#define NAME "workers"
+
+/** \cond */
+struct worker {
+	struct spa_workers *workers;
+	pthread_t thread;
+	bool quit;
+};
+
+struct spa_workers {
+	struct spa_log *log;
+
+	spa_workers_func_t func;
+	void *data;
+
+	/* the jobs of the current run, taken in order by the workers and
+	 * the calling thread */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_cond_t done;
+	uint32_t n_jobs;
+	uint32_t next_job;
+	uint32_t n_done;
+
+	uint32_t n_workers;
+	uint32_t max_workers;
+	struct worker worker[0];
+};
+/** \endcond */
+
+/* take the next job and run it, called with the lock held */
+static void run_job(struct spa_workers *workers)
+{
+	uint32_t job = workers->next_job++;
+
+	pthread_mutex_unlock(&workers->lock);
+	workers->func(workers->data, job);
+	pthread_mutex_lock(&workers->lock);
+
+	if (++workers->n_done == workers->n_jobs)
+		pthread_cond_signal(&workers->done);
+}
+
+static void *worker_thread(void *data)
+{
+	struct worker *w = data;
+	struct spa_workers *workers = w->workers;
+
+	pthread_mutex_lock(&workers->lock);
+	while (true) {
+		while (!w->quit && workers->next_job >= workers->n_jobs)
+			pthread_cond_wait(&workers->cond, &workers->lock);
+		if (w->quit)
+			break;
+		run_job(workers);
+	}
+	pthread_mutex_unlock(&workers->lock);
+
+	return NULL;
+}
+
+/** Make a new pool of worker threads
+ *
+ * \param log a log or NULL
+ * \param max_threads the maximum number of threads, including the caller
+ * \param n_threads the number of threads to start with, including the caller
+ * \param func the function to run for each job
+ * \param data user data for \a func
+ * \return a new pool or NULL when out of memory
+ */
+struct spa_workers *
+spa_workers_new(struct spa_log *log,
+		uint32_t max_threads,
+		uint32_t n_threads,
+		spa_workers_func_t func,
+		void *data)
+{
+	struct spa_workers *workers;
+	uint32_t max_workers = max_threads > 1 ? max_threads - 1 : 0;
+
+	workers = calloc(1, sizeof(struct spa_workers) + max_workers * sizeof(struct worker));
+	if (workers == NULL)
+		return NULL;
+
+	workers->log = log;
+	workers->func = func;
+	workers->data = data;
+	workers->max_workers = max_workers;
+
+	pthread_mutex_init(&workers->lock, NULL);
+	pthread_cond_init(&workers->cond, NULL);
+	pthread_cond_init(&workers->done, NULL);
+
+	spa_workers_set_threads(workers, n_threads);
+
+	return workers;
+}
+
+/** Change the number of threads
+ *
+ * \param workers a worker pool
+ * \param n_threads the new number of threads, including the caller
+ * \return SPA_RESULT_OK on success
+ *
+ * This can be called while another thread is in spa_workers_run(). The
+ * workers that are stopped finish their current job first and the jobs
+ * they leave are taken by the remaining threads.
+ */
+int spa_workers_set_threads(struct spa_workers *workers, uint32_t n_threads)
+{
+	uint32_t i, n_workers, old;
+	int err;
+
+	n_workers = n_threads > 1 ? SPA_MIN(n_threads - 1, workers->max_workers) : 0;
+	old = workers->n_workers;
+
+	if (n_workers < old) {
+		pthread_mutex_lock(&workers->lock);
+		__atomic_store_n(&workers->n_workers, n_workers, __ATOMIC_RELAXED);
+		for (i = n_workers; i < old; i++)
+			workers->worker[i].quit = true;
+		pthread_cond_broadcast(&workers->cond);
+		pthread_mutex_unlock(&workers->lock);
+
+		for (i = n_workers; i < old; i++)
+			pthread_join(workers->worker[i].thread, NULL);
+	}
+
+	for (i = old; i < n_workers; i++) {
+		struct worker *w = &workers->worker[i];
+
+		w->workers = workers;
+		w->quit = false;
+		if ((err = pthread_create(&w->thread, NULL, worker_thread, w)) != 0) {
+			spa_log_warn(workers->log, NAME " %p: can't create thread: %s",
+				     workers, strerror(err));
+			break;
+		}
+		pthread_mutex_lock(&workers->lock);
+		__atomic_store_n(&workers->n_workers, i + 1, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&workers->lock);
+	}
+
+	spa_log_info(workers->log, NAME " %p: using %u threads", workers,
+		     workers->n_workers + 1);
+
+	return SPA_RESULT_OK;
+}
+
+/** Get the number of threads
+ *
+ * \param workers a worker pool
+ * \return the number of threads, including the caller
+ *
+ * The result is a hint for splitting the work in jobs, the pool can be
+ * resized before the jobs run.
+ */
+uint32_t spa_workers_get_threads(struct spa_workers *workers)
+{
+	return __atomic_load_n(&workers->n_workers, __ATOMIC_RELAXED) + 1;
+}
+
+/** Run jobs on the pool
+ *
+ * \param workers a worker pool
+ * \param n_jobs the number of jobs
+ *
+ * Calls the job function for each job from 0 to \a n_jobs - 1 and returns
+ * when all jobs are done. The calling thread runs jobs as well. Only one
+ * thread can run jobs at a time.
+ */
+void spa_workers_run(struct spa_workers *workers, uint32_t n_jobs)
+{
+	if (n_jobs == 0)
+		return;
+
+	if (n_jobs == 1) {
+		workers->func(workers->data, 0);
+		return;
+	}
+
+	pthread_mutex_lock(&workers->lock);
+	workers->n_jobs = n_jobs;
+	workers->next_job = 0;
+	workers->n_done = 0;
+	pthread_cond_broadcast(&workers->cond);
+
+	while (workers->next_job < workers->n_jobs)
+		run_job(workers);
+	while (workers->n_done < workers->n_jobs)
+		pthread_cond_wait(&workers->done, &workers->lock);
+
+	workers->n_jobs = 0;
+	workers->next_job = 0;
+	pthread_mutex_unlock(&workers->lock);
+}
+
+/** Stop all threads and free the pool
+ *
+ * \param workers a worker pool
+ */
+void spa_workers_destroy(struct spa_workers *workers)
+{
+	spa_workers_set_threads(workers, 1);
+
+	pthread_cond_destroy(&workers->done);
+	pthread_cond_destroy(&workers->cond);
+	pthread_mutex_destroy(&workers->lock);
+	free(workers);
+}
@@ -0,0 +1,63 @@
+/* Simple Plugin API
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __SPA_LIBWORKERS_H__
+#define __SPA_LIBWORKERS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/defs.h>
+#include <spa/log.h>
+
+/** \class spa_workers
+ *
+ * A pool of threads that helps the calling thread run a number of jobs.
+ *
+ * spa_workers_run() runs the job function once for each job index and
+ * returns when all jobs are done. The calling thread takes jobs too, so
+ * all jobs complete even when the pool is resized while it runs.
+ */
+struct spa_workers;
+
+/** Called in a worker or the calling thread for each job */
+typedef void (*spa_workers_func_t) (void *data, uint32_t job);
+
+struct spa_workers *
+spa_workers_new(struct spa_log *log,
+		uint32_t max_threads,
+		uint32_t n_threads,
+		spa_workers_func_t func,
+		void *data);
+
+int spa_workers_set_threads(struct spa_workers *workers, uint32_t n_threads);
+
+uint32_t spa_workers_get_threads(struct spa_workers *workers);
+
+void spa_workers_run(struct spa_workers *workers, uint32_t n_jobs);
+
+void spa_workers_destroy(struct spa_workers *workers);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* __SPA_LIBWORKERS_H__ */
@@ -23,6 +23,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 
 #include <libudev.h>
 #include <asoundlib.h>
@@ -32,6 +33,7 @@
 #include <spa/loop.h>
 #include <spa/monitor.h>
 #include <lib/debug.h>
+#include <lib/probe.h>
 
 #define NAME  "alsa-monitor"
 
@@ -49,6 +51,16 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	spa_type_monitor_map(map, &type->monitor);
 }
 
+struct card {
+	snd_ctl_t *ctl_hndl;
+	char card_name[16];
+	int dev_idx;
+	int stream_idx;
+
+	uint8_t item_buffer[4096];
+	struct spa_monitor_item *item;
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_monitor monitor;
@@ -67,17 +79,19 @@ struct impl {
 	uint32_t index;
 	struct udev_list_entry *devices;
 
-	uint8_t item_buffer[4096];
-	struct spa_monitor_item *item;
-
-	snd_ctl_t *ctl_hndl;
+	struct card card;
 	struct udev_device *dev;
-	char card_name[16];
-	int dev_idx;
-	int stream_idx;
 
 	int fd;
 	struct spa_source source;
+
+	uint32_t probe_threads;
+	struct spa_probe *probe;
+	pthread_mutex_t probe_lock;
+	bool probe_scanned;
+	char **probe_devices;
+	uint32_t n_probe_devices;
+	uint32_t probe_index;
 };
 
 static int impl_udev_open(struct impl *this)
@@ -107,10 +121,11 @@ static const char *path_get_card_id(const char *path)
 }
 
 static int
-fill_item(struct impl *this, snd_ctl_card_info_t *card_info, snd_pcm_info_t *dev_info, struct udev_device *dev)
+fill_item(struct impl *this, struct card *card,
+	  snd_ctl_card_info_t *card_info, snd_pcm_info_t *dev_info, struct udev_device *dev)
 {
 	const char *str, *name, *klass = NULL;
-	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(this->item_buffer, sizeof(this->item_buffer));
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(card->item_buffer, sizeof(card->item_buffer));
 	const struct spa_handle_factory *factory = NULL;
 	struct spa_pod_frame f[3];
 	char card_name[64];
@@ -138,7 +153,7 @@ fill_item(struct impl *this, snd_ctl_card_info_t *card_info, snd_pcm_info_t *dev
 	if (!(name && *name))
 		name = "Unknown";
 
-	snprintf(card_name, 64, "%s,%d", this->card_name, snd_pcm_info_get_device(dev_info));
+	snprintf(card_name, 64, "%s,%d", card->card_name, snd_pcm_info_get_device(dev_info));
 
 	spa_pod_builder_add(&b,
 		SPA_POD_TYPE_OBJECT, &f[0], 0, this->type.monitor.MonitorItem,
@@ -225,24 +240,24 @@ fill_item(struct impl *this, snd_ctl_card_info_t *card_info, snd_pcm_info_t *dev
 			-SPA_POD_TYPE_PROP, &f[1],
 			-SPA_POD_TYPE_OBJECT, &f[0], 0);
 
-	this->item = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_monitor_item);
+	card->item = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_monitor_item);
 
 	return 0;
 }
 
-static void close_card(struct impl *this)
+static void close_card(struct card *card)
 {
-	if (this->ctl_hndl)
-		snd_ctl_close(this->ctl_hndl);
-	this->ctl_hndl = NULL;
+	if (card->ctl_hndl)
+		snd_ctl_close(card->ctl_hndl);
+	card->ctl_hndl = NULL;
 }
 
-static int open_card(struct impl *this, struct udev_device *dev)
+static int open_card(struct impl *this, struct card *card, struct udev_device *dev)
 {
 	int err;
 	const char *str;
 
-	if (this->ctl_hndl)
+	if (card->ctl_hndl)
 		return 0;
 
 	if (udev_device_get_property_value(dev, "PULSE_IGNORE"))
@@ -254,42 +269,42 @@ static int open_card(struct impl *this, struct udev_device *dev)
 	if ((str = path_get_card_id(udev_device_get_property_value(dev, "DEVPATH"))) == NULL)
 		return -1;
 
-	snprintf(this->card_name, 16, "hw:%s", str);
+	snprintf(card->card_name, 16, "hw:%s", str);
 
-	if ((err = snd_ctl_open(&this->ctl_hndl, this->card_name, 0)) < 0) {
-		spa_log_error(this->log, "can't open control for card %s: %s", this->card_name, snd_strerror(err));
+	if ((err = snd_ctl_open(&card->ctl_hndl, card->card_name, 0)) < 0) {
+		spa_log_error(this->log, "can't open control for card %s: %s", card->card_name, snd_strerror(err));
 		return err;
 	}
-	this->dev_idx = -1;
-	this->stream_idx = -1;
+	card->dev_idx = -1;
+	card->stream_idx = -1;
 
 	return 0;
 }
 
-static int get_next_device(struct impl *this, struct udev_device *dev)
+static int get_next_device(struct impl *this, struct card *card, struct udev_device *dev)
 {
 	int err;
 	snd_pcm_info_t *dev_info;
 	snd_ctl_card_info_t *card_info;
 
-	if (this->stream_idx == -1) {
+	if (card->stream_idx == -1) {
 	      next_device:
-		if ((err = snd_ctl_pcm_next_device(this->ctl_hndl, &this->dev_idx)) < 0) {
+		if ((err = snd_ctl_pcm_next_device(card->ctl_hndl, &card->dev_idx)) < 0) {
 			spa_log_error(this->log, "error iterating devices: %s", snd_strerror(err));
 			return err;
 		}
-		if (this->dev_idx < 0)
+		if (card->dev_idx < 0)
 			return -1;
 
-		this->stream_idx = 0;
+		card->stream_idx = 0;
 	}
 
 	snd_pcm_info_alloca(&dev_info);
-	snd_pcm_info_set_device(dev_info, this->dev_idx);
+	snd_pcm_info_set_device(dev_info, card->dev_idx);
 	snd_pcm_info_set_subdevice(dev_info, 0);
 
       again:
-	switch (this->stream_idx++) {
+	switch (card->stream_idx++) {
 	case 0:
 		snd_pcm_info_set_stream(dev_info, SND_PCM_STREAM_PLAYBACK);
 		break;
@@ -302,19 +317,31 @@ static int get_next_device(struct impl *this, struct udev_device *dev)
 
 	snd_ctl_card_info_alloca(&card_info);
 
-	if ((err = snd_ctl_card_info(this->ctl_hndl, card_info)) < 0) {
+	if ((err = snd_ctl_card_info(card->ctl_hndl, card_info)) < 0) {
 		spa_log_error(this->log, "can't get card info for device: %s", snd_strerror(err));
 		return err;
 	}
 
-	if ((err = snd_ctl_pcm_info(this->ctl_hndl, dev_info)) < 0)
+	if ((err = snd_ctl_pcm_info(card->ctl_hndl, dev_info)) < 0)
 		goto again;
 
-	fill_item(this, card_info, dev_info, dev);
+	fill_item(this, card, card_info, dev_info, dev);
 
 	return 0;
 }
 
+static void emit_item(struct impl *this, uint32_t type, struct spa_monitor_item *item)
+{
+	uint8_t buffer[4096];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod_frame f[1];
+	struct spa_event *event;
+
+	spa_pod_builder_object(&b, &f[0], 0, type, SPA_POD_TYPE_POD, item);
+	event = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_event);
+	this->callbacks->event(this->callbacks_data, event);
+}
+
 static void impl_on_fd_events(struct spa_source *source)
 {
 	struct impl *this = source->data;
@@ -336,23 +363,166 @@ static void impl_on_fd_events(struct spa_source *source)
 	} else
 		return;
 
-	if (open_card(this, dev) < 0)
+	if (open_card(this, &this->card, dev) < 0)
+		return;
+
+	while (get_next_device(this, &this->card, dev) >= 0)
+		emit_item(this, type, this->card.item);
+
+	close_card(&this->card);
+}
+
+static int enum_items(struct impl *this, struct spa_monitor_item **item, uint32_t index)
+{
+	int res;
+
+	if ((res = impl_udev_open(this)) < 0)
+		return res;
+
+	if (index == 0 || this->index > index) {
+		if (this->enumerate)
+			udev_enumerate_unref(this->enumerate);
+		this->enumerate = udev_enumerate_new(this->udev);
+
+		udev_enumerate_add_match_subsystem(this->enumerate, "sound");
+		udev_enumerate_scan_devices(this->enumerate);
+
+		this->devices = udev_enumerate_get_list_entry(this->enumerate);
+		this->index = 0;
+	}
+	while (index > this->index && this->devices) {
+		this->devices = udev_list_entry_get_next(this->devices);
+		this->index++;
+	}
+      again:
+	if (this->devices == NULL)
+		return SPA_RESULT_ENUM_END;
+
+	if (this->dev == NULL) {
+		this->dev = udev_device_new_from_syspath(this->udev, udev_list_entry_get_name(this->devices));
+
+		if (open_card(this, &this->card, this->dev) < 0) {
+			udev_device_unref(this->dev);
+		      next:
+			this->dev = NULL;
+			this->devices = udev_list_entry_get_next(this->devices);
+			goto again;
+		}
+	}
+	if (get_next_device(this, &this->card, this->dev) < 0) {
+		close_card(&this->card);
+		goto next;
+	}
+
+	this->index++;
+
+	*item = this->card.item;
+
+	return SPA_RESULT_OK;
+}
+
+/* called from the probe threads, the first thread scans the devices and
+ * all threads then take devices from the list until it is empty */
+static char *probe_next_device(struct impl *this, struct udev *udev)
+{
+	char *syspath = NULL;
+
+	pthread_mutex_lock(&this->probe_lock);
+	if (!this->probe_scanned) {
+		struct udev_enumerate *enumerate;
+		struct udev_list_entry *devices;
+
+		enumerate = udev_enumerate_new(udev);
+		udev_enumerate_add_match_subsystem(enumerate, "sound");
+		udev_enumerate_scan_devices(enumerate);
+
+		udev_list_entry_foreach(devices, udev_enumerate_get_list_entry(enumerate)) {
+			this->probe_devices = realloc(this->probe_devices,
+					(this->n_probe_devices + 1) * sizeof(char *));
+			this->probe_devices[this->n_probe_devices++] =
+					strdup(udev_list_entry_get_name(devices));
+		}
+		udev_enumerate_unref(enumerate);
+
+		this->probe_scanned = true;
+	}
+	if (this->probe_index < this->n_probe_devices)
+		syspath = this->probe_devices[this->probe_index++];
+	pthread_mutex_unlock(&this->probe_lock);
+
+	return syspath;
+}
+
+static void probe_work(struct spa_probe *probe, void *data)
+{
+	struct impl *this = data;
+	struct card *card;
+	struct udev *udev;
+	char *syspath;
+
+	/* udev contexts and card state can't be shared between threads */
+	if ((udev = udev_new()) == NULL)
 		return;
 
-	while (true) {
-		uint8_t buffer[4096];
-		struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
-		struct spa_pod_frame f[1];
-		struct spa_event *event;
+	card = calloc(1, sizeof(struct card));
+
+	while (card && !spa_probe_is_stopping(probe) &&
+	       (syspath = probe_next_device(this, udev)) != NULL) {
+		struct udev_device *dev;
 
-		if (get_next_device(this, dev) < 0)
-			break;
+		if ((dev = udev_device_new_from_syspath(udev, syspath)) == NULL)
+			continue;
 
-		spa_pod_builder_object(&b, &f[0], 0, type, SPA_POD_TYPE_POD, this->item);
-		event = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_event);
-		this->callbacks->event(this->callbacks_data, event);
+		if (open_card(this, card, dev) == 0) {
+			while (get_next_device(this, card, dev) >= 0)
+				spa_probe_post(probe, &card->item->object.pod);
+			close_card(card);
+		}
+		udev_device_unref(dev);
 	}
-	close_card(this);
+	free(card);
+	udev_unref(udev);
+}
+
+static void probe_result(void *data, const struct spa_pod *result)
+{
+	struct impl *this = data;
+
+	emit_item(this, this->type.monitor.Added, (struct spa_monitor_item *) result);
+}
+
+static void probe_stop(struct impl *this)
+{
+	uint32_t i;
+
+	if (this->probe == NULL)
+		return;
+
+	spa_probe_destroy(this->probe);
+	this->probe = NULL;
+
+	for (i = 0; i < this->n_probe_devices; i++)
+		free(this->probe_devices[i]);
+	free(this->probe_devices);
+	this->probe_devices = NULL;
+	this->n_probe_devices = 0;
+	this->probe_index = 0;
+	this->probe_scanned = false;
+}
+
+static void probe_start(struct impl *this)
+{
+	struct spa_monitor_item *item;
+	uint32_t index;
+
+	this->probe = spa_probe_new(this->main_loop, this->log, this->probe_threads,
+				    probe_work, probe_result, this);
+	if (this->probe != NULL)
+		return;
+
+	spa_log_warn(this->log, NAME " %p: can't start probe threads, probing now", this);
+	for (index = 0; enum_items(this, &item, index) == SPA_RESULT_OK; index++)
+		emit_item(this, this->type.monitor.Added, item);
 }
 
 static int
@@ -388,7 +558,11 @@ impl_monitor_set_callbacks(struct spa_monitor *monitor,
 		this->source.mask = SPA_IO_IN | SPA_IO_ERR;
 
 		spa_loop_add_source(this->main_loop, &this->source);
+
+		if (this->probe_threads > 0)
+			probe_start(this);
 	} else {
+		probe_stop(this);
 		spa_loop_remove_source(this->main_loop, &this->source);
 	}
 
@@ -399,7 +573,6 @@ static int impl_monitor_enum_items(struct spa_monitor *monitor,
 				   struct spa_monitor_item **item,
 				   uint32_t index)
 {
-	int res;
 	struct impl *this;
 
 	spa_return_val_if_fail(monitor != NULL, SPA_RESULT_INVALID_ARGUMENTS);
@@ -407,49 +580,12 @@ static int impl_monitor_enum_items(struct spa_monitor *monitor,
 
 	this = SPA_CONTAINER_OF(monitor, struct impl, monitor);
 
-	if ((res = impl_udev_open(this)) < 0)
-		return res;
-
-	if (index == 0 || this->index > index) {
-		if (this->enumerate)
-			udev_enumerate_unref(this->enumerate);
-		this->enumerate = udev_enumerate_new(this->udev);
-
-		udev_enumerate_add_match_subsystem(this->enumerate, "sound");
-		udev_enumerate_scan_devices(this->enumerate);
-
-		this->devices = udev_enumerate_get_list_entry(this->enumerate);
-		this->index = 0;
-	}
-	while (index > this->index && this->devices) {
-		this->devices = udev_list_entry_get_next(this->devices);
-		this->index++;
-	}
-      again:
-	if (this->devices == NULL)
+	/* with probe threads, the items are added asynchronously after
+	 * the callbacks are set */
+	if (this->probe_threads > 0)
 		return SPA_RESULT_ENUM_END;
 
-	if (this->dev == NULL) {
-		this->dev = udev_device_new_from_syspath(this->udev, udev_list_entry_get_name(this->devices));
-
-		if (open_card(this, this->dev) < 0) {
-			udev_device_unref(this->dev);
-		      next:
-			this->dev = NULL;
-			this->devices = udev_list_entry_get_next(this->devices);
-			goto again;
-		}
-	}
-	if (get_next_device(this, this->dev) < 0) {
-		close_card(this);
-		goto next;
-	}
-
-	this->index++;
-
-	*item = this->item;
-
-	return SPA_RESULT_OK;
+	return enum_items(this, item, index);
 }
 
 static const struct spa_monitor impl_monitor = {
@@ -478,6 +614,15 @@ static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id,
 
 static int impl_clear(struct spa_handle *handle)
 {
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = (struct impl *) handle;
+
+	probe_stop(this);
+	pthread_mutex_destroy(&this->probe_lock);
+
 	return SPA_RESULT_OK;
 }
 
@@ -518,6 +663,14 @@ impl_init(const struct spa_handle_factory *factory,
 
 	this->monitor = impl_monitor;
 
+	if (info) {
+		const char *str;
+
+		if ((str = spa_dict_lookup(info, "monitor.probe-threads")))
+			this->probe_threads = atoi(str);
+	}
+	pthread_mutex_init(&this->probe_lock, NULL);
+
 	return SPA_RESULT_OK;
 }
 
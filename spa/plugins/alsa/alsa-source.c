@@ -85,6 +85,7 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 				this->type.prop_device, -SPA_POD_TYPE_STRING,
 					this->props.device, sizeof(this->props.device),
 				this->type.prop_min_latency, SPA_POD_TYPE_INT, &this->props.min_latency, 0);
+		spa_alsa_update_latency(this);
 	}
 
 	return SPA_RESULT_OK;
@@ -667,6 +668,15 @@ static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id,
 
 static int impl_clear(struct spa_handle *handle)
 {
+	struct state *this;
+
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = (struct state *) handle;
+
+	if (this->format_cache)
+		spa_format_cache_free(this->format_cache);
+
 	return SPA_RESULT_OK;
 }
 
@@ -725,6 +735,7 @@ impl_init(const struct spa_handle_factory *factory,
 			snprintf(this->props.device, 63, "%s", info->items[i].value);
 		}
 	}
+	spa_alsa_init_format_cache(this, info);
 	return SPA_RESULT_OK;
 }
 
@@ -107,6 +107,35 @@ static snd_pcm_format_t spa_alsa_format_to_alsa(struct type *map, uint32_t forma
 	return SND_PCM_FORMAT_UNKNOWN;
 }
 
+/* the formats are cached per pcm device and stream and are validated with
+ * the card info that the monitor collected */
+void spa_alsa_init_format_cache(struct state *state, const struct spa_dict *info)
+{
+	const char *id, *pcm, *driver, *longname, *components, *pcm_id;
+
+	if (info == NULL)
+		return;
+
+	if (!(id = spa_dict_lookup(info, "device.serial")) &&
+	    !(id = spa_dict_lookup(info, "device.bus_path")))
+		return;
+
+	if ((pcm = strrchr(state->props.device, ',')) == NULL)
+		return;
+
+	snprintf(state->cache_key, sizeof(state->cache_key), "alsa-%s-%s-%s", id, pcm + 1,
+		 state->stream == SND_PCM_STREAM_PLAYBACK ? "playback" : "capture");
+
+	driver = spa_dict_lookup(info, "alsa.card.driver");
+	longname = spa_dict_lookup(info, "alsa.card.longname");
+	components = spa_dict_lookup(info, "alsa.card.components");
+	pcm_id = spa_dict_lookup(info, "alsa.pcm.id");
+
+	snprintf(state->cache_stamp, sizeof(state->cache_stamp), "%s:%s:%s:%s",
+		 driver ? driver : "", longname ? longname : "",
+		 components ? components : "", pcm_id ? pcm_id : "");
+}
+
 int
 spa_alsa_enum_format(struct state *state, struct spa_format **format, const struct spa_format *filter, uint32_t index)
 {
@@ -126,6 +155,16 @@ spa_alsa_enum_format(struct state *state, struct spa_format **format, const stru
 	if (index == 1)
 		return SPA_RESULT_ENUM_END;
 
+	if (state->format_cache == NULL && state->cache_key[0] != '\0')
+		state->format_cache = spa_format_cache_new(state->map, state->log,
+							   state->cache_key, state->cache_stamp);
+
+	if (state->format_cache && spa_format_cache_is_valid(state->format_cache)) {
+		fmt = (struct spa_format *) spa_format_cache_get(state->format_cache, 0);
+		if (fmt != NULL)
+			goto have_format;
+	}
+
 	opened = state->opened;
 	if ((err = spa_alsa_open(state)) < 0)
 		return SPA_RESULT_ERROR;
@@ -188,13 +227,20 @@ spa_alsa_enum_format(struct state *state, struct spa_format **format, const stru
 
 	fmt = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
 
+	if (!opened)
+		spa_alsa_close(state);
+
+	if (state->format_cache) {
+		spa_format_cache_add(state->format_cache, fmt);
+		spa_format_cache_save(state->format_cache);
+	}
+
+      have_format:
 	spa_pod_builder_init(&b, state->format_buffer, sizeof(state->format_buffer));
 	if ((res = spa_format_filter(fmt, filter, &b)) < 0)
 		return res;
 
 	*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
-	if (!opened)
-		spa_alsa_close(state);
 
 	return SPA_RESULT_OK;
 }
@@ -351,7 +397,11 @@ pull_frames(struct state *state,
 			n_bytes = SPA_MIN(avail, to_write * state->frame_size);
 			n_frames = SPA_MIN(to_write, n_bytes / state->frame_size);
 
-			spa_ringbuffer_read_data(ringbuffer, d[0].data, index & ringbuffer->mask, dst, n_bytes);
+			if (d[0].flags & SPA_DATA_FLAG_MAP_TWICE)
+				memcpy(dst, SPA_MEMBER(d[0].data, index & ringbuffer->mask, void), n_bytes);
+			else
+				spa_ringbuffer_read_data(ringbuffer, d[0].data,
+							 index & ringbuffer->mask, dst, n_bytes);
 
 			spa_ringbuffer_read_update(ringbuffer, index + n_bytes);
 			reuse = avail == n_bytes;
@@ -670,6 +720,37 @@ int spa_alsa_start(struct state *state, bool xrun_recover)
 	return SPA_RESULT_OK;
 }
 
+static int
+do_update_latency(struct spa_loop *loop,
+		  bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct state *state = user_data;
+	uint32_t latency = *(const uint32_t *) data;
+
+	state->threshold = SPA_MIN(latency, state->buffer_frames);
+	spa_log_debug(state->log, "alsa %p: threshold %d", state, state->threshold);
+
+	return SPA_RESULT_OK;
+}
+
+/* apply a changed min-latency to a running device without restarting it,
+ * the new threshold is used from the next timeout on */
+int spa_alsa_update_latency(struct state *state)
+{
+	uint32_t latency = state->props.min_latency;
+
+	if (!state->started)
+		return SPA_RESULT_OK;
+
+	return spa_loop_invoke(state->data_loop,
+			       do_update_latency,
+			       0,
+			       sizeof(latency),
+			       &latency,
+			       false,
+			       state);
+}
+
 int spa_alsa_pause(struct state *state, bool xrun_recover)
 {
 	int err;
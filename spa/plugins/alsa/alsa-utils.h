@@ -39,6 +39,8 @@ extern "C" {
 #include <spa/audio/format-utils.h>
 #include <spa/format-builder.h>
 
+#include <lib/format-cache.h>
+
 struct props {
 	char device[64];
 	char device_name[128];
@@ -131,6 +133,10 @@ struct state {
 	struct spa_audio_info current_format;
 	uint8_t format_buffer[1024];
 
+	char cache_key[256];
+	char cache_stamp[512];
+	struct spa_format_cache *format_cache;
+
 	snd_pcm_uframes_t buffer_frames;
 	snd_pcm_uframes_t period_frames;
 	snd_pcm_format_t format;
@@ -174,6 +180,8 @@ struct state {
 	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
 			SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
 
+void spa_alsa_init_format_cache(struct state *state, const struct spa_dict *info);
+
 int
 spa_alsa_enum_format(struct state *state,
 		     struct spa_format **format, const struct spa_format *filter, uint32_t index);
@@ -182,6 +190,7 @@ int spa_alsa_set_format(struct state *state, struct spa_audio_info *info, uint32
 
 int spa_alsa_start(struct state *state, bool xrun_recover);
 int spa_alsa_pause(struct state *state, bool xrun_recover);
+int spa_alsa_update_latency(struct state *state);
 int spa_alsa_close(struct state *state);
 
 #ifdef __cplusplus
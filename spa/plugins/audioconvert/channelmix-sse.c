@@ -0,0 +1,60 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <xmmintrin.h>
+
+#include "channelmix.h"
+
+void
+channelmix_matrix_sse(struct channelmix *mix, float **dst, const float **src, uint32_t n_samples)
+{
+	uint32_t i, j, n, unrolled = n_samples & ~3;
+
+	for (i = 0; i < mix->dst_chan; i++) {
+		float *d = dst[i];
+		bool first = true;
+
+		for (j = 0; j < mix->src_chan; j++) {
+			const float *s = src[j];
+			float g = mix->matrix[i][j];
+			__m128 gain = _mm_set1_ps(g);
+
+			if (g == 0.0f)
+				continue;
+
+			if (first) {
+				for (n = 0; n < unrolled; n += 4)
+					_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_loadu_ps(&s[n]), gain));
+				for (; n < n_samples; n++)
+					d[n] = s[n] * g;
+				first = false;
+			} else {
+				for (n = 0; n < unrolled; n += 4)
+					_mm_storeu_ps(&d[n], _mm_add_ps(_mm_loadu_ps(&d[n]),
+							_mm_mul_ps(_mm_loadu_ps(&s[n]), gain)));
+				for (; n < n_samples; n++)
+					d[n] += s[n] * g;
+			}
+		}
+		if (first)
+			memset(d, 0, n_samples * sizeof(float));
+	}
+}
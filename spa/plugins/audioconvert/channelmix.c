@@ -0,0 +1,276 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include "fmt-ops.h"
+#include "channelmix.h"
+
+#define GAIN_3DB	0.7071068f	/* -3dB */
+
+#if defined(HAVE_SSE2)
+void channelmix_matrix_sse(struct channelmix *mix, float **dst,
+			   const float **src, uint32_t n_samples);
+#endif
+
+static void
+channelmix_copy(struct channelmix *mix, float **dst, const float **src, uint32_t n_samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < mix->dst_chan; i++)
+		memcpy(dst[i], src[i], n_samples * sizeof(float));
+}
+
+static void
+channelmix_matrix(struct channelmix *mix, float **dst, const float **src, uint32_t n_samples)
+{
+	uint32_t i, j, n;
+
+	for (i = 0; i < mix->dst_chan; i++) {
+		float *d = dst[i];
+		bool first = true;
+
+		for (j = 0; j < mix->src_chan; j++) {
+			const float *s = src[j];
+			float g = mix->matrix[i][j];
+
+			if (g == 0.0f)
+				continue;
+
+			if (first) {
+				for (n = 0; n < n_samples; n++)
+					d[n] = s[n] * g;
+				first = false;
+			} else {
+				for (n = 0; n < n_samples; n++)
+					d[n] += s[n] * g;
+			}
+		}
+		if (first)
+			memset(d, 0, n_samples * sizeof(float));
+	}
+}
+
+static uint32_t default_mask(uint32_t channels)
+{
+	switch (channels) {
+	case 1:
+		return CHANNEL_FC;
+	case 2:
+		return CHANNEL_FL | CHANNEL_FR;
+	case 3:
+		return CHANNEL_FL | CHANNEL_FR | CHANNEL_FC;
+	case 4:
+		return CHANNEL_FL | CHANNEL_FR | CHANNEL_BL | CHANNEL_BR;
+	case 5:
+		return CHANNEL_FL | CHANNEL_FR | CHANNEL_FC | CHANNEL_BL | CHANNEL_BR;
+	case 6:
+		return CHANNEL_FL | CHANNEL_FR | CHANNEL_FC | CHANNEL_LFE |
+		       CHANNEL_BL | CHANNEL_BR;
+	case 7:
+		return CHANNEL_FL | CHANNEL_FR | CHANNEL_FC | CHANNEL_LFE |
+		       CHANNEL_BC | CHANNEL_SL | CHANNEL_SR;
+	case 8:
+		return CHANNEL_FL | CHANNEL_FR | CHANNEL_FC | CHANNEL_LFE |
+		       CHANNEL_BL | CHANNEL_BR | CHANNEL_SL | CHANNEL_SR;
+	default:
+		return 0;
+	}
+}
+
+/* channels are stored in the order of their bit in the mask */
+static int channel_index(uint32_t mask, uint32_t channel)
+{
+	if ((mask & channel) == 0)
+		return -1;
+	return __builtin_popcount(mask & (channel - 1));
+}
+
+struct mix_ctx {
+	struct channelmix *mix;
+	uint32_t dst_mask;
+	int src;
+};
+
+static void mix_to(struct mix_ctx *ctx, uint32_t channel, float gain)
+{
+	int d = channel_index(ctx->dst_mask, channel);
+	if (d >= 0)
+		ctx->mix->matrix[d][ctx->src] += gain;
+}
+
+static bool has(struct mix_ctx *ctx, uint32_t channels)
+{
+	return (ctx->dst_mask & channels) == channels;
+}
+
+/* distribute a source channel that has no matching destination channel
+ * over its nearest neighbours */
+static void downmix_channel(struct mix_ctx *ctx, uint32_t channel)
+{
+	switch (channel) {
+	case CHANNEL_FL:
+	case CHANNEL_FR:
+		mix_to(ctx, CHANNEL_FC, GAIN_3DB);
+		break;
+	case CHANNEL_FC:
+		if (has(ctx, CHANNEL_FL | CHANNEL_FR)) {
+			mix_to(ctx, CHANNEL_FL, GAIN_3DB);
+			mix_to(ctx, CHANNEL_FR, GAIN_3DB);
+		}
+		break;
+	case CHANNEL_FLC:
+	case CHANNEL_FRC:
+		if (has(ctx, CHANNEL_FL | CHANNEL_FR))
+			mix_to(ctx, channel == CHANNEL_FLC ? CHANNEL_FL : CHANNEL_FR, 1.0f);
+		else
+			mix_to(ctx, CHANNEL_FC, GAIN_3DB);
+		break;
+	case CHANNEL_BL:
+	case CHANNEL_BR:
+	case CHANNEL_SL:
+	case CHANNEL_SR:
+	{
+		bool left = channel == CHANNEL_BL || channel == CHANNEL_SL;
+		if (has(ctx, CHANNEL_BL | CHANNEL_BR))
+			mix_to(ctx, left ? CHANNEL_BL : CHANNEL_BR, 1.0f);
+		else if (has(ctx, CHANNEL_SL | CHANNEL_SR))
+			mix_to(ctx, left ? CHANNEL_SL : CHANNEL_SR, 1.0f);
+		else if (has(ctx, CHANNEL_FL | CHANNEL_FR))
+			mix_to(ctx, left ? CHANNEL_FL : CHANNEL_FR, GAIN_3DB);
+		else
+			mix_to(ctx, CHANNEL_FC, GAIN_3DB);
+		break;
+	}
+	case CHANNEL_BC:
+		if (has(ctx, CHANNEL_BL | CHANNEL_BR)) {
+			mix_to(ctx, CHANNEL_BL, GAIN_3DB);
+			mix_to(ctx, CHANNEL_BR, GAIN_3DB);
+		} else if (has(ctx, CHANNEL_SL | CHANNEL_SR)) {
+			mix_to(ctx, CHANNEL_SL, GAIN_3DB);
+			mix_to(ctx, CHANNEL_SR, GAIN_3DB);
+		} else if (has(ctx, CHANNEL_FL | CHANNEL_FR)) {
+			mix_to(ctx, CHANNEL_FL, 0.5f);
+			mix_to(ctx, CHANNEL_FR, 0.5f);
+		} else
+			mix_to(ctx, CHANNEL_FC, 0.5f);
+		break;
+	case CHANNEL_LFE:
+	default:
+		/* dropped */
+		break;
+	}
+}
+
+static void build_matrix(struct channelmix *mix)
+{
+	struct mix_ctx ctx = { mix, mix->dst_mask, 0 };
+	uint32_t i, j, bit;
+	int fc, fl, fr;
+
+	for (bit = 0; bit < 32; bit++) {
+		uint32_t channel = 1u << bit;
+		int d;
+
+		if ((mix->src_mask & channel) == 0)
+			continue;
+
+		if ((d = channel_index(mix->dst_mask, channel)) >= 0)
+			mix->matrix[d][ctx.src] = 1.0f;
+		else
+			downmix_channel(&ctx, channel);
+
+		ctx.src++;
+	}
+
+	/* a mono source goes to both front channels when there is no center */
+	fc = channel_index(mix->src_mask, CHANNEL_FC);
+	fl = channel_index(mix->dst_mask, CHANNEL_FL);
+	fr = channel_index(mix->dst_mask, CHANNEL_FR);
+	if (mix->src_chan == 1 && fc == 0 && fl >= 0 && fr >= 0 &&
+	    channel_index(mix->dst_mask, CHANNEL_FC) < 0) {
+		mix->matrix[fl][0] = 1.0f;
+		mix->matrix[fr][0] = 1.0f;
+	}
+
+	/* scale down the rows that would clip a full scale signal */
+	for (i = 0; i < mix->dst_chan; i++) {
+		float sum = 0.0f;
+
+		for (j = 0; j < mix->src_chan; j++)
+			sum += mix->matrix[i][j];
+		if (sum > 1.0f) {
+			for (j = 0; j < mix->src_chan; j++)
+				mix->matrix[i][j] /= sum;
+		}
+	}
+}
+
+int channelmix_init(struct channelmix *mix,
+		    uint32_t src_chan, uint32_t src_mask,
+		    uint32_t dst_chan, uint32_t dst_mask,
+		    uint32_t features)
+{
+	uint32_t i, j;
+
+	if (src_chan == 0 || src_chan > CHANNELMIX_MAX_CHANNELS ||
+	    dst_chan == 0 || dst_chan > CHANNELMIX_MAX_CHANNELS)
+		return -EINVAL;
+
+	if (__builtin_popcount(src_mask) != src_chan)
+		src_mask = default_mask(src_chan);
+	if (__builtin_popcount(dst_mask) != dst_chan)
+		dst_mask = default_mask(dst_chan);
+
+	memset(mix, 0, sizeof(struct channelmix));
+	mix->src_chan = src_chan;
+	mix->dst_chan = dst_chan;
+	mix->src_mask = src_mask;
+	mix->dst_mask = dst_mask;
+
+	if (src_mask == 0 || dst_mask == 0) {
+		/* unknown layout, map the channels in order */
+		for (i = 0; i < SPA_MIN(src_chan, dst_chan); i++)
+			mix->matrix[i][i] = 1.0f;
+	} else
+		build_matrix(mix);
+
+	mix->identity = src_chan == dst_chan;
+	for (i = 0; i < dst_chan && mix->identity; i++) {
+		for (j = 0; j < src_chan; j++) {
+			if (mix->matrix[i][j] != (i == j ? 1.0f : 0.0f)) {
+				mix->identity = false;
+				break;
+			}
+		}
+	}
+
+	if (mix->identity)
+		mix->process = channelmix_copy;
+#if defined(HAVE_SSE2)
+	else if (features & FEATURE_SSE2)
+		mix->process = channelmix_matrix_sse;
+#endif
+	else
+		mix->process = channelmix_matrix;
+
+	return 0;
+}
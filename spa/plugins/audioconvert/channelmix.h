@@ -0,0 +1,64 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <spa/defs.h>
+
+#define CHANNELMIX_MAX_CHANNELS	8
+
+/* channel positions, the bits used in the channel_mask of a raw audio
+ * format */
+#define CHANNEL_FL	(1 << 0)
+#define CHANNEL_FR	(1 << 1)
+#define CHANNEL_FC	(1 << 2)
+#define CHANNEL_LFE	(1 << 3)
+#define CHANNEL_BL	(1 << 4)
+#define CHANNEL_BR	(1 << 5)
+#define CHANNEL_FLC	(1 << 6)
+#define CHANNEL_FRC	(1 << 7)
+#define CHANNEL_BC	(1 << 8)
+#define CHANNEL_SL	(1 << 9)
+#define CHANNEL_SR	(1 << 10)
+
+struct channelmix;
+
+typedef void (*channelmix_func_t) (struct channelmix *mix, float **dst,
+				   const float **src, uint32_t n_samples);
+
+struct channelmix {
+	uint32_t src_chan;
+	uint32_t dst_chan;
+	uint32_t src_mask;
+	uint32_t dst_mask;
+	bool identity;		/**< dst is a copy of src, no mixing needed */
+
+	/** gain of each source channel in each destination channel */
+	float matrix[CHANNELMIX_MAX_CHANNELS][CHANNELMIX_MAX_CHANNELS];
+
+	channelmix_func_t process;
+};
+
+int channelmix_init(struct channelmix *mix,
+		    uint32_t src_chan, uint32_t src_mask,
+		    uint32_t dst_chan, uint32_t dst_mask,
+		    uint32_t features);
+
+#define channelmix_process(mix,...)	(mix)->process(mix, __VA_ARGS__)
@@ -0,0 +1,171 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+
+#include <emmintrin.h>
+
+#include "fmt-ops.h"
+
+/* SSE2 versions of the most common conversions. Unaligned loads and
+ * stores are used for the interleaved side, the tail of each block is
+ * handled with scalar code. */
+
+void
+conv_s16_to_f32d_2_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples)
+{
+	const int16_t *s = src[0];
+	float *d0 = dst[0], *d1 = dst[1];
+	const __m128 factor = _mm_set1_ps(1.0f / 32767.0f);
+	uint32_t n, unrolled = n_samples & ~3;
+	__m128i in, lo, hi;
+	__m128 l, r;
+
+	for (n = 0; n < unrolled; n += 4) {
+		/* L0 R0 L1 R1 L2 R2 L3 R3 */
+		in = _mm_loadu_si128((const __m128i *) &s[2 * n]);
+		/* sign extend the left and right samples to 32 bits */
+		lo = _mm_srai_epi32(_mm_slli_epi32(in, 16), 16);
+		hi = _mm_srai_epi32(in, 16);
+		l = _mm_mul_ps(_mm_cvtepi32_ps(lo), factor);
+		r = _mm_mul_ps(_mm_cvtepi32_ps(hi), factor);
+		_mm_storeu_ps(&d0[n], l);
+		_mm_storeu_ps(&d1[n], r);
+	}
+	for (; n < n_samples; n++) {
+		d0[n] = s[2 * n] * (1.0f / 32767.0f);
+		d1[n] = s[2 * n + 1] * (1.0f / 32767.0f);
+	}
+}
+
+void
+conv_s16d_to_f32d_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples)
+{
+	const __m128 factor = _mm_set1_ps(1.0f / 32767.0f);
+	uint32_t i, n, unrolled = n_samples & ~3;
+
+	for (i = 0; i < n_channels; i++) {
+		const int16_t *s = src[i];
+		float *d = dst[i];
+		__m128i in;
+
+		for (n = 0; n < unrolled; n += 4) {
+			in = _mm_loadl_epi64((const __m128i *) &s[n]);
+			in = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+			_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_cvtepi32_ps(in), factor));
+		}
+		for (; n < n_samples; n++)
+			d[n] = s[n] * (1.0f / 32767.0f);
+	}
+}
+
+static inline int16_t
+f32_to_s16(float v)
+{
+	return (int16_t) lrintf(SPA_CLAMP(v, -1.0f, 1.0f) * 32767.0f);
+}
+
+void
+conv_f32d_to_s16_2_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1];
+	int16_t *d = dst[0];
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128 max = _mm_set1_ps(1.0f), min = _mm_set1_ps(-1.0f);
+	uint32_t n, unrolled = n_samples & ~3;
+	__m128 l, r;
+	__m128i li, ri, out;
+
+	for (n = 0; n < unrolled; n += 4) {
+		l = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&s0[n]), min), max), scale);
+		r = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&s1[n]), min), max), scale);
+		li = _mm_cvtps_epi32(l);
+		ri = _mm_cvtps_epi32(r);
+		/* interleave to L0 R0 L1 R1 ... as 32 bits and pack to 16 bits */
+		out = _mm_packs_epi32(_mm_unpacklo_epi32(li, ri), _mm_unpackhi_epi32(li, ri));
+		_mm_storeu_si128((__m128i *) &d[2 * n], out);
+	}
+	for (; n < n_samples; n++) {
+		d[2 * n] = f32_to_s16(s0[n]);
+		d[2 * n + 1] = f32_to_s16(s1[n]);
+	}
+}
+
+void
+conv_f32d_to_s16d_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples)
+{
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128 max = _mm_set1_ps(1.0f), min = _mm_set1_ps(-1.0f);
+	uint32_t i, n, unrolled = n_samples & ~7;
+
+	for (i = 0; i < n_channels; i++) {
+		const float *s = src[i];
+		int16_t *d = dst[i];
+		__m128 a, b;
+
+		for (n = 0; n < unrolled; n += 8) {
+			a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&s[n]), min), max), scale);
+			b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&s[n + 4]), min), max), scale);
+			_mm_storeu_si128((__m128i *) &d[n],
+					 _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+		}
+		for (; n < n_samples; n++)
+			d[n] = f32_to_s16(s[n]);
+	}
+}
+
+void
+conv_f32_to_f32d_2_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src[0];
+	float *d0 = dst[0], *d1 = dst[1];
+	uint32_t n, unrolled = n_samples & ~3;
+	__m128 a, b;
+
+	for (n = 0; n < unrolled; n += 4) {
+		a = _mm_loadu_ps(&s[2 * n]);		/* L0 R0 L1 R1 */
+		b = _mm_loadu_ps(&s[2 * n + 4]);	/* L2 R2 L3 R3 */
+		_mm_storeu_ps(&d0[n], _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(&d1[n], _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	for (; n < n_samples; n++) {
+		d0[n] = s[2 * n];
+		d1[n] = s[2 * n + 1];
+	}
+}
+
+void
+conv_f32d_to_f32_2_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1];
+	float *d = dst[0];
+	uint32_t n, unrolled = n_samples & ~3;
+	__m128 l, r;
+
+	for (n = 0; n < unrolled; n += 4) {
+		l = _mm_loadu_ps(&s0[n]);
+		r = _mm_loadu_ps(&s1[n]);
+		_mm_storeu_ps(&d[2 * n], _mm_unpacklo_ps(l, r));
+		_mm_storeu_ps(&d[2 * n + 4], _mm_unpackhi_ps(l, r));
+	}
+	for (; n < n_samples; n++) {
+		d[2 * n] = s0[n];
+		d[2 * n + 1] = s1[n];
+	}
+}
@@ -0,0 +1,246 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <endian.h>
+#include <math.h>
+
+#include "fmt-ops.h"
+
+#define S16_SCALE	32767.0f
+#define S24_SCALE	8388607.0f
+#define S32_SCALE	2147483520.0f	/* largest float below 2^31 */
+
+static inline int32_t read_s24(const uint8_t *p)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	return ((int32_t) p[2] << 24 | p[1] << 16 | p[0] << 8) >> 8;
+#else
+	return ((int32_t) p[0] << 24 | p[1] << 16 | p[2] << 8) >> 8;
+#endif
+}
+
+static inline void write_s24(uint8_t *p, int32_t v)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+#else
+	p[0] = v >> 16;
+	p[1] = v >> 8;
+	p[2] = v;
+#endif
+}
+
+#define READ_S16(p)	(*(const int16_t *)(p) * (1.0f / S16_SCALE))
+#define READ_S24(p)	(read_s24(p) * (1.0f / S24_SCALE))
+#define READ_S24_32(p)	(((*(const int32_t *)(p)) << 8 >> 8) * (1.0f / S24_SCALE))
+#define READ_S32(p)	(*(const int32_t *)(p) * (1.0f / S32_SCALE))
+
+#define CLAMP1(v)	SPA_CLAMP(v, -1.0f, 1.0f)
+
+#define WRITE_S16(p,v)		*(int16_t *)(p) = (int16_t) lrintf(CLAMP1(v) * S16_SCALE)
+#define WRITE_S24(p,v)		write_s24(p, (int32_t) lrintf(CLAMP1(v) * S24_SCALE))
+#define WRITE_S24_32(p,v)	*(int32_t *)(p) = (int32_t) lrintf(CLAMP1(v) * S24_SCALE)
+#define WRITE_S32(p,v)		*(int32_t *)(p) = (int32_t) lrintf(CLAMP1(v) * S32_SCALE)
+
+#define DEFINE_CONV(fmt,size,READ,WRITE)					\
+static void									\
+conv_##fmt##_to_f32d(void **dst, const void **src,				\
+		     uint32_t n_channels, uint32_t n_samples)			\
+{										\
+	const uint8_t *s = src[0];						\
+	float **d = (float **) dst;						\
+	uint32_t i, j;								\
+										\
+	for (j = 0; j < n_samples; j++) {					\
+		for (i = 0; i < n_channels; i++, s += size)			\
+			d[i][j] = READ(s);					\
+	}									\
+}										\
+										\
+static void									\
+conv_##fmt##d_to_f32d(void **dst, const void **src,				\
+		      uint32_t n_channels, uint32_t n_samples)			\
+{										\
+	uint32_t i, j;								\
+										\
+	for (i = 0; i < n_channels; i++) {					\
+		const uint8_t *s = src[i];					\
+		float *d = dst[i];						\
+										\
+		for (j = 0; j < n_samples; j++, s += size)			\
+			d[j] = READ(s);						\
+	}									\
+}										\
+										\
+static void									\
+conv_f32d_to_##fmt(void **dst, const void **src,				\
+		   uint32_t n_channels, uint32_t n_samples)			\
+{										\
+	const float **s = (const float **) src;					\
+	uint8_t *d = dst[0];							\
+	uint32_t i, j;								\
+										\
+	for (j = 0; j < n_samples; j++) {					\
+		for (i = 0; i < n_channels; i++, d += size)			\
+			WRITE(d, s[i][j]);					\
+	}									\
+}										\
+										\
+static void									\
+conv_f32d_to_##fmt##d(void **dst, const void **src,				\
+		      uint32_t n_channels, uint32_t n_samples)			\
+{										\
+	uint32_t i, j;								\
+										\
+	for (i = 0; i < n_channels; i++) {					\
+		const float *s = src[i];					\
+		uint8_t *d = dst[i];						\
+										\
+		for (j = 0; j < n_samples; j++, d += size)			\
+			WRITE(d, s[j]);						\
+	}									\
+}
+
+DEFINE_CONV(s16, 2, READ_S16, WRITE_S16)
+DEFINE_CONV(s24, 3, READ_S24, WRITE_S24)
+DEFINE_CONV(s24_32, 4, READ_S24_32, WRITE_S24_32)
+DEFINE_CONV(s32, 4, READ_S32, WRITE_S32)
+
+static void
+conv_f32_to_f32d(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src[0];
+	float **d = (float **) dst;
+	uint32_t i, j;
+
+	for (j = 0; j < n_samples; j++) {
+		for (i = 0; i < n_channels; i++)
+			d[i][j] = *s++;
+	}
+}
+
+static void
+conv_f32d_to_f32d(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_channels; i++)
+		memcpy(dst[i], src[i], n_samples * sizeof(float));
+}
+
+static void
+conv_f32d_to_f32(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples)
+{
+	const float **s = (const float **) src;
+	float *d = dst[0];
+	uint32_t i, j;
+
+	for (j = 0; j < n_samples; j++) {
+		for (i = 0; i < n_channels; i++)
+			*d++ = s[i][j];
+	}
+}
+
+#if defined(HAVE_SSE2)
+void conv_s16_to_f32d_2_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples);
+void conv_f32d_to_s16_2_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples);
+void conv_f32_to_f32d_2_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples);
+void conv_f32d_to_f32_2_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples);
+void conv_s16d_to_f32d_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples);
+void conv_f32d_to_s16d_sse(void **dst, const void **src, uint32_t n_channels, uint32_t n_samples);
+#endif
+
+#define TO_F32D(fmt,planar,channels,features,func)				\
+	{ fmt, planar, FMT_F32, true, channels, features, func }
+#define FROM_F32D(fmt,planar,channels,features,func)				\
+	{ FMT_F32, true, fmt, planar, channels, features, func }
+
+/* the first match wins, specialized versions go first */
+static const struct conv_info conv_table[] =
+{
+#if defined(HAVE_SSE2)
+	TO_F32D(FMT_S16, false, 2, FEATURE_SSE2, conv_s16_to_f32d_2_sse),
+	TO_F32D(FMT_S16, true, 0, FEATURE_SSE2, conv_s16d_to_f32d_sse),
+	TO_F32D(FMT_F32, false, 2, FEATURE_SSE2, conv_f32_to_f32d_2_sse),
+	FROM_F32D(FMT_S16, false, 2, FEATURE_SSE2, conv_f32d_to_s16_2_sse),
+	FROM_F32D(FMT_S16, true, 0, FEATURE_SSE2, conv_f32d_to_s16d_sse),
+	FROM_F32D(FMT_F32, false, 2, FEATURE_SSE2, conv_f32d_to_f32_2_sse),
+#endif
+	TO_F32D(FMT_S16, false, 0, 0, conv_s16_to_f32d),
+	TO_F32D(FMT_S16, true, 0, 0, conv_s16d_to_f32d),
+	TO_F32D(FMT_S24, false, 0, 0, conv_s24_to_f32d),
+	TO_F32D(FMT_S24, true, 0, 0, conv_s24d_to_f32d),
+	TO_F32D(FMT_S24_32, false, 0, 0, conv_s24_32_to_f32d),
+	TO_F32D(FMT_S24_32, true, 0, 0, conv_s24_32d_to_f32d),
+	TO_F32D(FMT_S32, false, 0, 0, conv_s32_to_f32d),
+	TO_F32D(FMT_S32, true, 0, 0, conv_s32d_to_f32d),
+	TO_F32D(FMT_F32, false, 0, 0, conv_f32_to_f32d),
+	TO_F32D(FMT_F32, true, 0, 0, conv_f32d_to_f32d),
+
+	FROM_F32D(FMT_S16, false, 0, 0, conv_f32d_to_s16),
+	FROM_F32D(FMT_S16, true, 0, 0, conv_f32d_to_s16d),
+	FROM_F32D(FMT_S24, false, 0, 0, conv_f32d_to_s24),
+	FROM_F32D(FMT_S24, true, 0, 0, conv_f32d_to_s24d),
+	FROM_F32D(FMT_S24_32, false, 0, 0, conv_f32d_to_s24_32),
+	FROM_F32D(FMT_S24_32, true, 0, 0, conv_f32d_to_s24_32d),
+	FROM_F32D(FMT_S32, false, 0, 0, conv_f32d_to_s32),
+	FROM_F32D(FMT_S32, true, 0, 0, conv_f32d_to_s32d),
+	FROM_F32D(FMT_F32, false, 0, 0, conv_f32d_to_f32),
+	FROM_F32D(FMT_F32, true, 0, 0, conv_f32d_to_f32d),
+};
+
+#undef TO_F32D
+#undef FROM_F32D
+
+const struct conv_info *
+find_conv_info(uint32_t src_fmt, bool src_planar,
+	       uint32_t dst_fmt, bool dst_planar,
+	       uint32_t n_channels, uint32_t features)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(conv_table); i++) {
+		const struct conv_info *c = &conv_table[i];
+
+		if (c->src_fmt == src_fmt && c->src_planar == src_planar &&
+		    c->dst_fmt == dst_fmt && c->dst_planar == dst_planar &&
+		    (c->n_channels == 0 || c->n_channels == n_channels) &&
+		    (c->features & features) == c->features)
+			return c;
+	}
+	return NULL;
+}
+
+uint32_t fmt_sample_size(uint32_t fmt)
+{
+	switch (fmt) {
+	case FMT_S16:
+		return 2;
+	case FMT_S24:
+		return 3;
+	case FMT_S24_32:
+	case FMT_S32:
+	case FMT_F32:
+		return 4;
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,59 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <spa/defs.h>
+
+#define FEATURE_SSE2	(1 << 0)
+
+/* sample formats the converter can read and write, F32 planar is the
+ * intermediate format the channel mixer works on */
+enum {
+	FMT_S16,
+	FMT_S24,
+	FMT_S24_32,
+	FMT_S32,
+	FMT_F32,
+	FMT_MAX,
+};
+
+/* Convert n_samples frames. Interleaved data uses only src[0] or dst[0],
+ * planar data has one pointer per channel. */
+typedef void (*convert_func_t) (void **dst, const void **src,
+				uint32_t n_channels, uint32_t n_samples);
+
+struct conv_info {
+	uint32_t src_fmt;
+	bool src_planar;
+	uint32_t dst_fmt;
+	bool dst_planar;
+	uint32_t n_channels;	/**< 0 for any number of channels */
+	uint32_t features;	/**< required cpu features */
+	convert_func_t func;
+};
+
+const struct conv_info *
+find_conv_info(uint32_t src_fmt, bool src_planar,
+	       uint32_t dst_fmt, bool dst_planar,
+	       uint32_t n_channels, uint32_t features);
+
+uint32_t fmt_sample_size(uint32_t fmt);
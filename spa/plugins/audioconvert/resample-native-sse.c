@@ -0,0 +1,63 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <xmmintrin.h>
+
+#include "resample-native.h"
+
+static inline float hsum(__m128 sum)
+{
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+	return _mm_cvtss_f32(sum);
+}
+
+/* n_taps is a multiple of 8 and the filter rows are aligned, only the
+ * history needs unaligned loads */
+static inline float
+inner_product_sse(const float *s, const float *taps, uint32_t n_taps)
+{
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(s + i), _mm_load_ps(taps + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(s + i + 4), _mm_load_ps(taps + i + 4)));
+	}
+	return hsum(_mm_add_ps(sum0, sum1));
+}
+
+static inline float
+inner_product_ip_sse(const float *s, const float *t0, const float *t1, float x, uint32_t n_taps)
+{
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(), in;
+	float s0, s1;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i += 4) {
+		in = _mm_loadu_ps(s + i);
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(in, _mm_load_ps(t0 + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(in, _mm_load_ps(t1 + i)));
+	}
+	s0 = hsum(sum0);
+	s1 = hsum(sum1);
+	return s0 + (s1 - s0) * x;
+}
+
+DEFINE_RESAMPLER(sse)
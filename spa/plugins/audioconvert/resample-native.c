@@ -0,0 +1,289 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <spa/defs.h>
+
+#include "fmt-ops.h"
+#include "resample.h"
+#include "resample-native.h"
+
+#define MIN_PHASES	256
+#define MAX_PHASES	1024
+#define MAX_TAPS	2048
+#define BLOCK_SIZE	4096	/* input frames that are buffered in one call */
+
+struct quality {
+	uint32_t n_taps;
+	double cutoff;		/* fraction of the nyquist frequency */
+};
+
+static const struct quality qualities[] = {
+	{ 8, 0.53, },
+	{ 16, 0.67, },
+	{ 32, 0.80, },
+	{ 48, 0.85, },
+	{ 64, 0.88, },
+	{ 128, 0.93, },
+	{ 256, 0.97, },
+};
+
+static inline float
+inner_product_c(const float *s, const float *taps, uint32_t n_taps)
+{
+	float sum = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i++)
+		sum += s[i] * taps[i];
+	return sum;
+}
+
+static inline float
+inner_product_ip_c(const float *s, const float *t0, const float *t1, float x, uint32_t n_taps)
+{
+	float sum0 = 0.0f, sum1 = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i++) {
+		sum0 += s[i] * t0[i];
+		sum1 += s[i] * t1[i];
+	}
+	return sum0 + (sum1 - sum0) * x;
+}
+
+DEFINE_RESAMPLER(c)
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b != 0) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static inline double sinc(double x)
+{
+	if (x == 0.0)
+		return 1.0;
+	x *= M_PI;
+	return sin(x) / x;
+}
+
+/* blackman-harris window, x in [-1.0, 1.0] */
+static inline double window(double x)
+{
+	x *= M_PI;
+	return 0.35875 + 0.48829 * cos(x) + 0.14128 * cos(2.0 * x) + 0.01168 * cos(3.0 * x);
+}
+
+/* Row p of the filter bank is the windowed sinc shifted by p / n_phases
+ * of an input sample. Tap t of a row is applied to the input sample at
+ * t - n_taps / 2 + 1 relative to the output position. */
+static void build_filter(float *filter, uint32_t n_taps, uint32_t n_phases, double cutoff)
+{
+	uint32_t p, t, half = n_taps / 2;
+
+	for (p = 0; p <= n_phases; p++) {
+		float *row = &filter[p * n_taps];
+		double frac = (double) p / n_phases, sum = 0.0;
+
+		for (t = 0; t < n_taps; t++) {
+			double d = (double) t - half + 1 - frac;
+			double v = cutoff * sinc(cutoff * d) * window(d / half);
+			row[t] = v;
+			sum += v;
+		}
+		/* unity gain for DC */
+		for (t = 0; t < n_taps; t++)
+			row[t] /= sum;
+	}
+}
+
+static void impl_native_free(struct resample *r)
+{
+	free(r->data);
+	r->data = NULL;
+}
+
+static void impl_native_update_rate(struct resample *r, double rate)
+{
+	struct native_data *d = r->data;
+	resample_func_t func;
+
+	r->rate = rate;
+	d->inc = (double) d->n_phases * d->in_rate * rate / d->out_rate;
+
+	if (rate == 1.0 && d->n_phases == d->out_rate)
+		func = d->func_full;
+	else
+		func = d->func_inter;
+
+	if (func == d->func)
+		return;
+
+	/* carry the position over to the other phase representation */
+	if (func == d->func_inter) {
+		d->fphase = d->phase;
+	} else {
+		d->phase = (uint32_t) (d->fphase + 0.5);
+		if (d->phase >= d->n_phases) {
+			d->phase -= d->n_phases;
+			d->index++;
+		}
+	}
+	d->func = func;
+}
+
+static void impl_native_process(struct resample *r,
+				const void **src, uint32_t *in_len,
+				void **dst, uint32_t *out_len)
+{
+	struct native_data *d = r->data;
+	uint32_t c, in, avail, out, consumed, need;
+
+	/* only take the input that is needed for *out_len frames so that the
+	 * caller keeps the rest and no latency is added */
+	need = d->index + d->n_taps + (uint32_t) ceil(*out_len * d->inc / d->n_phases);
+	need = SPA_MIN(need, d->hist_cap);
+	in = need > d->hist_len ? SPA_MIN(*in_len, need - d->hist_len) : 0;
+	for (c = 0; c < r->channels; c++)
+		memcpy(&d->history[c][d->hist_len], src[c], in * sizeof(float));
+	avail = d->hist_len + in;
+
+	out = d->func(d, (float **) dst, r->channels, avail, *out_len);
+
+	/* drop the samples that no output needs anymore */
+	consumed = SPA_MIN(d->index, avail);
+	if (consumed > 0) {
+		for (c = 0; c < r->channels; c++)
+			memmove(d->history[c], &d->history[c][consumed],
+				(avail - consumed) * sizeof(float));
+		d->index -= consumed;
+	}
+	d->hist_len = avail - consumed;
+
+	*in_len = in;
+	*out_len = out;
+}
+
+static void impl_native_reset(struct resample *r)
+{
+	struct native_data *d = r->data;
+	uint32_t c;
+
+	/* prefill so that the first output is centered on the first input */
+	for (c = 0; c < r->channels; c++)
+		memset(d->history[c], 0, d->hist_cap * sizeof(float));
+	d->hist_len = d->n_taps / 2 - 1;
+	d->index = 0;
+	d->phase = 0;
+	d->fphase = 0.0;
+}
+
+static uint32_t impl_native_delay(struct resample *r)
+{
+	struct native_data *d = r->data;
+	return d->n_taps / 2;
+}
+
+int resample_native_init(struct resample *r)
+{
+	struct native_data *d;
+	const struct quality *q;
+	uint32_t c, g, in_rate, out_rate, n_taps, n_phases, hist_cap;
+	double scale;
+	size_t filter_size, history_size;
+
+	if (r->channels == 0 || r->i_rate == 0 || r->o_rate == 0)
+		return -EINVAL;
+
+	q = &qualities[SPA_MIN(r->quality, RESAMPLE_QUALITY_MAX)];
+
+	g = gcd(r->i_rate, r->o_rate);
+	in_rate = r->i_rate / g;
+	out_rate = r->o_rate / g;
+
+	/* when downsampling, the cutoff is lowered to the output nyquist
+	 * frequency and the filter is made longer to keep the transition
+	 * band as steep */
+	scale = SPA_MIN(1.0, (double) r->o_rate / r->i_rate);
+	n_taps = ceil(q->n_taps / scale);
+	n_taps = SPA_MIN((n_taps + 7) & ~7, MAX_TAPS);
+
+	/* small ratios like 1:1 have few filters, multiply them so that the
+	 * interpolated mode has enough resolution when the rate is adjusted */
+	if (out_rate < MIN_PHASES) {
+		uint32_t mult = (MIN_PHASES + out_rate - 1) / out_rate;
+		in_rate *= mult;
+		out_rate *= mult;
+	}
+	n_phases = SPA_MIN(out_rate, MAX_PHASES);
+	hist_cap = n_taps + BLOCK_SIZE;
+
+	filter_size = (n_phases + 1) * n_taps * sizeof(float);
+	history_size = r->channels * hist_cap * sizeof(float);
+
+	d = calloc(1, sizeof(struct native_data) + filter_size +
+		   r->channels * sizeof(float *) + history_size + 16);
+	if (d == NULL)
+		return -ENOMEM;
+
+	d->n_taps = n_taps;
+	d->n_phases = n_phases;
+	d->in_rate = in_rate;
+	d->out_rate = out_rate;
+	d->hist_cap = hist_cap;
+	/* aligned for the SIMD loads of the taps */
+	d->filter = (float *) (((uintptr_t) (d + 1) + 15) & ~(uintptr_t) 15);
+	d->history = SPA_MEMBER(d->filter, filter_size, float *);
+	for (c = 0; c < r->channels; c++)
+		d->history[c] = SPA_MEMBER(d->history, r->channels * sizeof(float *) +
+					   c * hist_cap * sizeof(float), float);
+
+	build_filter(d->filter, n_taps, n_phases, q->cutoff * scale);
+
+	d->func_full = resample_full_c;
+	d->func_inter = resample_inter_c;
+#if defined(HAVE_SSE2)
+	if (r->cpu_flags & FEATURE_SSE2) {
+		d->func_full = resample_full_sse;
+		d->func_inter = resample_inter_sse;
+	}
+#endif
+	d->func = d->func_inter;
+
+	r->free = impl_native_free;
+	r->update_rate = impl_native_update_rate;
+	r->process = impl_native_process;
+	r->reset = impl_native_reset;
+	r->delay = impl_native_delay;
+	r->data = d;
+
+	impl_native_reset(r);
+	impl_native_update_rate(r, r->rate == 0.0 ? 1.0 : r->rate);
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdint.h>
+
+struct native_data;
+
+typedef uint32_t (*resample_func_t) (struct native_data *d, float **dst,
+				     uint32_t channels, uint32_t avail, uint32_t out_len);
+
+struct native_data {
+	uint32_t n_taps;	/* filter length, a multiple of 8 */
+	uint32_t n_phases;	/* number of filters in the bank */
+	uint32_t in_rate;	/* rates divided by their gcd, multiplied to
+				 * get at least MIN_PHASES filters */
+	uint32_t out_rate;
+
+	uint32_t index;		/* history position of the first tap */
+	uint32_t phase;		/* filter of the next output, exact mode */
+	double fphase;		/* filter of the next output, interpolated mode */
+	double inc;		/* phase increment per output, interpolated mode */
+
+	uint32_t hist_len;
+	uint32_t hist_cap;
+	float **history;
+
+	resample_func_t func;
+	resample_func_t func_full;
+	resample_func_t func_inter;
+
+	float *filter;		/* n_phases + 1 rows of n_taps coefficients */
+};
+
+/* Generate the filter loops for an architecture. The full version is used
+ * when the ratio is exact and each output uses one of the n_phases
+ * filters, the interpolated version is used for arbitrary ratios and
+ * blends between two neighbouring filters. */
+#define DEFINE_RESAMPLER(arch)							\
+uint32_t									\
+resample_full_##arch(struct native_data *d, float **dst,			\
+		     uint32_t channels, uint32_t avail, uint32_t out_len)	\
+{										\
+	uint32_t c, o, n_taps = d->n_taps, index = d->index, phase = d->phase;	\
+										\
+	for (o = 0; o < out_len && index + n_taps <= avail; o++) {		\
+		const float *taps = &d->filter[phase * n_taps];			\
+										\
+		for (c = 0; c < channels; c++)					\
+			dst[c][o] = inner_product_##arch(&d->history[c][index],	\
+							 taps, n_taps);		\
+										\
+		phase += d->in_rate;						\
+		index += phase / d->out_rate;					\
+		phase %= d->out_rate;						\
+	}									\
+	d->index = index;							\
+	d->phase = phase;							\
+	return o;								\
+}										\
+										\
+uint32_t									\
+resample_inter_##arch(struct native_data *d, float **dst,			\
+		      uint32_t channels, uint32_t avail, uint32_t out_len)	\
+{										\
+	uint32_t c, o, n_taps = d->n_taps, index = d->index;			\
+	double fphase = d->fphase;						\
+										\
+	for (o = 0; o < out_len && index + n_taps <= avail; o++) {		\
+		uint32_t phase = (uint32_t) fphase;				\
+		float x = fphase - phase;					\
+		const float *t0 = &d->filter[phase * n_taps];			\
+		const float *t1 = t0 + n_taps;					\
+										\
+		for (c = 0; c < channels; c++)					\
+			dst[c][o] = inner_product_ip_##arch(&d->history[c][index],\
+							 t0, t1, x, n_taps);	\
+										\
+		fphase += d->inc;						\
+		while (fphase >= d->n_phases) {					\
+			fphase -= d->n_phases;					\
+			index++;						\
+		}								\
+	}									\
+	d->index = index;							\
+	d->fphase = fphase;							\
+	return o;								\
+}
+
+uint32_t resample_full_c(struct native_data *d, float **dst,
+			 uint32_t channels, uint32_t avail, uint32_t out_len);
+uint32_t resample_inter_c(struct native_data *d, float **dst,
+			  uint32_t channels, uint32_t avail, uint32_t out_len);
+uint32_t resample_full_sse(struct native_data *d, float **dst,
+			   uint32_t channels, uint32_t avail, uint32_t out_len);
+uint32_t resample_inter_sse(struct native_data *d, float **dst,
+			    uint32_t channels, uint32_t avail, uint32_t out_len);
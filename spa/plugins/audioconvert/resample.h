@@ -0,0 +1,68 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_RESAMPLE_H__
+#define __SPA_RESAMPLE_H__
+
+#include <stdint.h>
+
+#define RESAMPLE_QUALITY_MIN		0
+#define RESAMPLE_QUALITY_MAX		6
+#define RESAMPLE_QUALITY_DEFAULT	3
+
+/* Resampler for float planar samples.
+ *
+ * quality selects the filter length and cutoff. Higher qualities have a
+ * steeper filter but need more input samples before output is produced,
+ * see resample_delay().
+ *
+ * rate is an adjustment of the conversion ratio: with a rate > 1.0 more
+ * input samples are consumed for each output sample. It can be changed
+ * while processing to compensate the drift between two clocks. */
+struct resample {
+	uint32_t channels;
+	uint32_t i_rate;
+	uint32_t o_rate;
+	double rate;
+	uint32_t quality;
+	uint32_t cpu_flags;
+
+	void (*free) (struct resample *r);
+	void (*update_rate) (struct resample *r, double rate);
+	/* consume at most *in_len input frames and produce at most *out_len
+	 * output frames, both are updated with the number of frames used */
+	void (*process) (struct resample *r,
+			 const void **src, uint32_t *in_len,
+			 void **dst, uint32_t *out_len);
+	void (*reset) (struct resample *r);
+	/* number of input frames needed before the first output */
+	uint32_t (*delay) (struct resample *r);
+
+	void *data;
+};
+
+#define resample_free(r)		(r)->free(r)
+#define resample_update_rate(r,...)	(r)->update_rate(r,__VA_ARGS__)
+#define resample_process(r,...)		(r)->process(r,__VA_ARGS__)
+#define resample_reset(r)		(r)->reset(r)
+#define resample_delay(r)		(r)->delay(r)
+
+int resample_native_init(struct resample *r);
+
+#endif /* __SPA_RESAMPLE_H__ */
@@ -52,6 +52,8 @@ struct type {
 	uint32_t prop_volume;
 	uint32_t wave_sine;
 	uint32_t wave_square;
+	uint32_t wave_noise;
+	uint32_t wave_silence;
 	struct spa_type_meta meta;
 	struct spa_type_data data;
 	struct spa_type_media_type media_type;
@@ -76,6 +78,8 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
 	type->wave_sine = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":sine");
 	type->wave_square = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":square");
+	type->wave_noise = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":noise");
+	type->wave_silence = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType ":silence");
 	spa_type_meta_map(map, &type->meta);
 	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
@@ -97,6 +101,7 @@ struct props {
 
 #define MAX_BUFFERS 16
 #define MAX_PORTS 1
+#define OSC_LANES 4
 
 struct buffer {
 	struct spa_buffer *outbuf;
@@ -139,6 +144,7 @@ struct impl {
 	size_t bpf;
 	render_func_t render_func;
 	double accumulator;
+	uint32_t noise_state[OSC_LANES];
 
 	struct buffer buffers[MAX_BUFFERS];
 	uint32_t n_buffers;
@@ -195,10 +201,12 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 	spa_pod_builder_props(&b, &f[0], this->type.props,
 		PROP(&f[1], this->type.prop_live, SPA_POD_TYPE_BOOL,
 			this->props.live),
-		PROP_EN(&f[1], this->type.prop_wave, SPA_POD_TYPE_ID, 3,
+		PROP_EN(&f[1], this->type.prop_wave, SPA_POD_TYPE_ID, 5,
 			this->props.wave,
 			this->type.wave_sine,
-			this->type.wave_square),
+			this->type.wave_square,
+			this->type.wave_noise,
+			this->type.wave_silence),
 		PROP_MM(&f[1], this->type.prop_freq, SPA_POD_TYPE_DOUBLE,
 			this->props.freq,
 			0.0, 50000000.0),
@@ -309,7 +317,8 @@ static int make_buffer(struct impl *this)
 
 		offset = index & b->rb->ringbuffer.mask;
 
-		if (offset + n_bytes > b->rb->ringbuffer.size) {
+		if (offset + n_bytes > b->rb->ringbuffer.size &&
+		    !(b->outbuf->datas[0].flags & SPA_DATA_FLAG_MAP_TWICE)) {
 			uint32_t l0 = b->rb->ringbuffer.size - offset;
 			this->render_func(this, SPA_MEMBER(b->outbuf->datas[0].data, offset, void),
 					  l0 / this->bpf);
@@ -591,7 +600,7 @@ impl_node_port_set_format(struct spa_node *node,
 		this->bpf = sizes[idx] * info.info.raw.channels;
 		this->current_format = info;
 		this->have_format = true;
-		this->render_func = sine_funcs[idx];
+		this->render_func = render_funcs[idx];
 	}
 
 	if (this->have_format) {
@@ -1013,6 +1022,7 @@ impl_init(const struct spa_handle_factory *factory,
 	this->node = impl_node;
 	this->clock = impl_clock;
 	reset_props(this, &this->props);
+	init_noise(this);
 
 	spa_list_init(&this->empty);
 
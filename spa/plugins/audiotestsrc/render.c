@@ -17,40 +17,156 @@
  * Boston, MA 02110-1301, USA.
  */
 
+
+#include <string.h>
 #include <math.h>
 
 #define M_PI_M2 ( M_PI + M_PI )
 
-#define DEFINE_SINE(type,scale)								\
+/* samples are generated in mono float blocks of this size and then
+ * converted and interleaved into the output format */
+#define BLOCK_SIZE	256
+
+typedef void (*wave_func_t) (struct impl *this, float *dst, int n_samples);
+
+/* Sine with a recursive oscillator. OSC_LANES phasors, one sample apart,
+ * are each rotated by OSC_LANES * step so the inner loop has no
+ * dependency between lanes and vectorizes. The phasors are reseeded from
+ * the accumulator for every block so that rounding errors can't build up. */
+static void wave_sine(struct impl *this, float *dst, int n_samples)
+{
+	double step, amp, rc, rs, c[OSC_LANES], s[OSC_LANES];
+	int i, k;
+
+	step = M_PI_M2 * this->props.freq / this->current_format.info.raw.rate;
+	amp = this->props.volume;
+
+	for (k = 0; k < OSC_LANES; k++) {
+		double phase = this->accumulator + (k + 1) * step;
+		c[k] = cos(phase) * amp;
+		s[k] = sin(phase) * amp;
+	}
+	rc = cos(OSC_LANES * step);
+	rs = sin(OSC_LANES * step);
+
+	/* dst has room for n_samples rounded up to OSC_LANES */
+	for (i = 0; i < n_samples; i += OSC_LANES) {
+		for (k = 0; k < OSC_LANES; k++) {
+			double t = c[k] * rc - s[k] * rs;
+			dst[i + k] = s[k];
+			s[k] = c[k] * rs + s[k] * rc;
+			c[k] = t;
+		}
+	}
+	this->accumulator = fmod(this->accumulator + n_samples * step, M_PI_M2);
+}
+
+static void wave_square(struct impl *this, float *dst, int n_samples)
+{
+	double step, acc;
+	float amp;
+	int i;
+
+	step = M_PI_M2 * this->props.freq / this->current_format.info.raw.rate;
+	amp = this->props.volume;
+	acc = this->accumulator;
+
+	for (i = 0; i < n_samples; i++) {
+		acc += step;
+		if (acc >= M_PI_M2)
+			acc -= M_PI_M2;
+		dst[i] = acc < M_PI ? amp : -amp;
+	}
+	this->accumulator = acc;
+}
+
+/* white noise from OSC_LANES interleaved xorshift32 generators */
+static void wave_noise(struct impl *this, float *dst, int n_samples)
+{
+	uint32_t *st = this->noise_state;
+	float amp = this->props.volume / 2147483648.0f;
+	int i, k;
+
+	for (i = 0; i < n_samples; i += OSC_LANES) {
+		for (k = 0; k < OSC_LANES; k++) {
+			uint32_t x = st[k];
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			st[k] = x;
+			dst[i + k] = (int32_t) x * amp;
+		}
+	}
+}
+
+static wave_func_t get_wave_func(struct impl *this)
+{
+	if (this->props.wave == this->type.wave_square)
+		return wave_square;
+	if (this->props.wave == this->type.wave_noise)
+		return wave_noise;
+	return wave_sine;
+}
+
+static void init_noise(struct impl *this)
+{
+	int k;
+	for (k = 0; k < OSC_LANES; k++)
+		this->noise_state[k] = 0x9e3779b9u * (k + 1);
+}
+
+#define DEFINE_RENDER(sample_t,scale,min,max)						\
 static void										\
-audio_test_src_create_sine_##type (struct impl *this, type *samples, size_t n_samples)	\
+audio_test_src_render_##sample_t (struct impl *this, sample_t *samples, size_t n_samples)	\
 {											\
-	int i, c, channels;								\
-	double step, amp;								\
+	float tmp[BLOCK_SIZE] __attribute__ ((aligned (16)));				\
+	wave_func_t wave;								\
+	int i, c, n, channels;								\
 											\
 	channels = this->current_format.info.raw.channels;				\
-	step = M_PI_M2 * this->props.freq / this->current_format.info.raw.rate;		\
-	amp = this->props.volume * scale;						\
 											\
-	for (i = 0; i < n_samples; i++) {						\
-		type val;								\
-		this->accumulator += step;						\
-		if (this->accumulator >= M_PI_M2)					\
-			this->accumulator -= M_PI_M2;					\
-		val = (type) (sin (this->accumulator) * amp);				\
-		for (c = 0; c < channels; ++c)						\
-			*samples++ = val;						\
+	if (this->props.wave == this->type.wave_silence) {				\
+		memset(samples, 0, n_samples * channels * sizeof(sample_t));		\
+		return;									\
+	}										\
+	wave = get_wave_func(this);							\
+	/* noise is independent per channel, generate it as one mono stream */		\
+	if (wave == wave_noise) {							\
+		n_samples *= channels;							\
+		channels = 1;								\
+	}										\
+											\
+	for (; n_samples > 0; n_samples -= n) {						\
+		n = SPA_MIN(n_samples, BLOCK_SIZE);					\
+		wave(this, tmp, n);							\
+		if (channels == 1) {							\
+			for (i = 0; i < n; i++)						\
+				samples[i] = (sample_t) (SPA_CLAMP(tmp[i], min, max) * scale); \
+		} else if (channels == 2) {						\
+			for (i = 0; i < n; i++) {					\
+				sample_t v = (sample_t) (SPA_CLAMP(tmp[i], min, max) * scale);	\
+				samples[2 * i] = v;					\
+				samples[2 * i + 1] = v;					\
+			}								\
+		} else {								\
+			for (i = 0; i < n; i++) {					\
+				sample_t v = (sample_t) (SPA_CLAMP(tmp[i], min, max) * scale);	\
+				for (c = 0; c < channels; c++)				\
+					samples[i * channels + c] = v;			\
+			}								\
+		}									\
+		samples += n * channels;						\
 	}										\
 }
 
-DEFINE_SINE(int16_t, 32767.0);
-DEFINE_SINE(int32_t, 2147483647.0);
-DEFINE_SINE(float, 1.0);
-DEFINE_SINE(double, 1.0);
+DEFINE_RENDER(int16_t, 32767.0f, -1.0f, 1.0f);
+DEFINE_RENDER(int32_t, 2147483520.0f, -1.0f, 1.0f);
+DEFINE_RENDER(float, 1.0f, -10.0f, 10.0f);
+DEFINE_RENDER(double, 1.0, -10.0f, 10.0f);
 
-static const render_func_t sine_funcs[] = {
-	(render_func_t) audio_test_src_create_sine_int16_t,
-	(render_func_t) audio_test_src_create_sine_int32_t,
-	(render_func_t) audio_test_src_create_sine_float,
-	(render_func_t) audio_test_src_create_sine_double
+static const render_func_t render_funcs[] = {
+	(render_func_t) audio_test_src_render_int16_t,
+	(render_func_t) audio_test_src_render_int32_t,
+	(render_func_t) audio_test_src_render_float,
+	(render_func_t) audio_test_src_render_double
 };
@@ -17,52 +17,107 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
 #include <stddef.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
+#include <pthread.h>
 
 #include <spa/type-map.h>
 #include <spa/log.h>
+#include <spa/list.h>
 #include <spa/node.h>
+#include <spa/format-builder.h>
+#include <spa/param-alloc.h>
 #include <spa/video/format-utils.h>
 #include <lib/props.h>
+#include <lib/format.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+
+#include "ffmpeg.h"
+
+#define NAME "ffmpeg-dec"
 
 #define IS_VALID_PORT(this,d,id) ((id) == 0)
 #define MAX_BUFFERS    32
 
+/* extra bytes after the last plane, some codecs overread with SIMD */
+#define FRAME_PADDING  64
+
+struct props {
+	int threads;
+	uint32_t thread_type;
+};
+
+/* An output buffer is free when it is neither queued downstream
+ * (outstanding) nor used as a frame by the codec (referenced). The codec
+ * takes and releases buffers from its own threads when frame threading
+ * is enabled so the flags and the free list are protected by impl.lock. */
 struct buffer {
+	struct impl *impl;
 	struct spa_buffer *outbuf;
 	bool outstanding;
-	struct buffer *next;
+	bool referenced;
+	struct spa_meta_header *h;
+	struct spa_list link;
 };
 
 struct port {
 	bool have_format;
 	struct spa_video_info current_format;
-	bool have_buffers;
-	struct buffer buffers[MAX_BUFFERS];
+
 	struct spa_port_info info;
+	uint8_t params_buffer[1024];
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
 	struct spa_port_io *io;
+
+	struct spa_list empty;
 };
 
 struct type {
 	uint32_t node;
+	uint32_t format;
+	uint32_t props;
+	struct spa_ffmpeg_type_thread thread;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
 	struct spa_type_media_type media_type;
 	struct spa_type_media_subtype media_subtype;
+	struct spa_type_media_subtype_video media_subtype_video;
 	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
 	struct spa_type_command_node command_node;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
+	struct spa_type_param_alloc_meta_enable param_alloc_meta_enable;
 };
 
 static inline void init_type(struct type *type, struct spa_type_map *map)
 {
 	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	spa_ffmpeg_type_thread_map(map, &type->thread);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
 	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_media_subtype_video_map(map, &type->media_subtype_video);
 	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
 	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
+	spa_type_param_alloc_meta_enable_map(map, &type->param_alloc_meta_enable);
 }
 
+/* how a frame is laid out in the memory of an output buffer */
+struct layout {
+	int linesize[4];
+	size_t offset[4];
+	size_t size;
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_node node;
@@ -71,23 +126,97 @@ struct impl {
 	struct spa_type_map *map;
 	struct spa_log *log;
 
+	uint8_t props_buffer[512];
+	struct props props;
+
 	const struct spa_node_callbacks *callbacks;
 	void *user_data;
 
+	uint8_t format_buffer[1024];
+
 	struct port in_ports[1];
 	struct port out_ports[1];
 
+	const AVCodec *codec;
+	AVCodecContext *context;
+	AVFrame *frame;
+	uint32_t media_subtype;
+
+	pthread_mutex_t lock;
+	enum AVPixelFormat pix_fmt;
+	struct layout layout;
+	bool direct;
+
+	uint32_t seq;
+
 	bool started;
 };
 
+#define DEFAULT_THREADS		0
+
+static void reset_props(struct impl *this, struct props *props)
+{
+	props->threads = DEFAULT_THREADS;
+	props->thread_type = this->type.thread.type_auto;
+}
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_MM(f,key,type,...)							\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+
 static int spa_ffmpeg_dec_node_get_props(struct spa_node *node, struct spa_props **props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	if (node == NULL || props == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_pod_builder_init(&b, this->props_buffer, sizeof(this->props_buffer));
+	spa_pod_builder_props(&b, &f[0], this->type.props,
+		PROP_MM(&f[1], this->type.thread.threads, SPA_POD_TYPE_INT,
+			this->props.threads,
+			0, 64),
+		PROP_EN(&f[1], this->type.thread.thread_type, SPA_POD_TYPE_ID, 4,
+			this->props.thread_type,
+			this->type.thread.type_auto,
+			this->type.thread.type_frame,
+			this->type.thread.type_slice));
+
+	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return SPA_RESULT_OK;
 }
 
+/* the threading of a codec can only be configured before it is opened,
+ * changes are applied when the input format is set the next time */
 static int spa_ffmpeg_dec_node_set_props(struct spa_node *node, const struct spa_props *props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (props == NULL) {
+		reset_props(this, &this->props);
+	} else {
+		spa_props_query(props,
+				this->type.thread.threads, SPA_POD_TYPE_INT, &this->props.threads,
+				this->type.thread.thread_type, SPA_POD_TYPE_ID, &this->props.thread_type,
+				0);
+	}
+	return SPA_RESULT_OK;
 }
 
 static int spa_ffmpeg_dec_node_send_command(struct spa_node *node, const struct spa_command *command)
@@ -182,6 +311,81 @@ spa_ffmpeg_dec_node_remove_port(struct spa_node *node,
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
 
+static void build_input_format(struct impl *this, struct spa_pod_builder *b)
+{
+	struct spa_pod_frame f[2];
+
+	spa_pod_builder_format(b, &f[0], this->type.format,
+		this->type.media_type.video,
+		this->media_subtype,
+		PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+			320, 240,
+			1, 1,
+			INT32_MAX, INT32_MAX),
+		PROP_U_MM(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+			25, 1,
+			0, 1,
+			INT32_MAX, 1));
+}
+
+/* the raw formats the codec can produce, the size and framerate follow
+ * the input */
+static void build_output_format(struct impl *this, struct spa_pod_builder *b)
+{
+	struct spa_pod_frame f[2];
+	struct port *in_port = &this->in_ports[0];
+	struct spa_video_info_mjpg *info = &in_port->current_format.info.mjpg;
+	const enum AVPixelFormat *pix_fmts = this->codec->pix_fmts;
+	static const enum AVPixelFormat default_pix_fmts[] = {
+		AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_NONE
+	};
+	struct spa_pod_prop *prop;
+	uint32_t n_formats = 0;
+
+	if (pix_fmts == NULL)
+		pix_fmts = default_pix_fmts;
+
+	spa_pod_builder_push_format(b, &f[0], this->type.format,
+				    this->type.media_type.video,
+				    this->type.media_subtype.raw);
+
+	spa_pod_builder_push_prop(b, &f[1], this->type.format_video.format,
+				  SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET);
+	prop = SPA_POD_BUILDER_DEREF(b, f[1].ref, struct spa_pod_prop);
+	for (; *pix_fmts != AV_PIX_FMT_NONE; pix_fmts++) {
+		uint32_t format = spa_ffmpeg_video_format(&this->type.video_format, *pix_fmts);
+
+		if (format == this->type.video_format.UNKNOWN)
+			continue;
+		if (n_formats == 0)
+			spa_pod_builder_id(b, format);
+		spa_pod_builder_id(b, format);
+		n_formats++;
+	}
+	if (n_formats <= 1)
+		prop->body.flags &= ~(SPA_POD_PROP_RANGE_MASK | SPA_POD_PROP_FLAG_UNSET);
+	spa_pod_builder_pop(b, &f[1]);
+
+	if (in_port->have_format) {
+		spa_pod_builder_add(b,
+			PROP(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+				info->size.width, info->size.height),
+			PROP(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+				info->framerate.num, info->framerate.denom), 0);
+	} else {
+		spa_pod_builder_add(b,
+			PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+				320, 240,
+				1, 1,
+				INT32_MAX, INT32_MAX),
+			PROP_U_MM(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+				25, 1,
+				0, 1,
+				INT32_MAX, 1), 0);
+	}
+	spa_pod_builder_pop(b, &f[0]);
+}
+
 static int
 spa_ffmpeg_dec_node_port_enum_formats(struct spa_node *node,
 				      enum spa_direction direction,
@@ -190,27 +394,205 @@ spa_ffmpeg_dec_node_port_enum_formats(struct spa_node *node,
 				      const struct spa_format *filter,
 				      uint32_t index)
 {
-	//struct impl *this;
+	struct impl *this;
+	int res;
+	struct spa_format *fmt;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = { NULL, };
+	uint32_t count, match;
 
 	if (node == NULL || format == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	//this = SPA_CONTAINER_OF (node, struct impl, node);
+	this = SPA_CONTAINER_OF(node, struct impl, node);
 
 	if (!IS_VALID_PORT(this, direction, port_id))
 		return SPA_RESULT_INVALID_PORT;
 
-	switch (index) {
+	if (this->media_subtype == SPA_ID_INVALID)
+		return SPA_RESULT_ENUM_END;
+
+	count = match = filter ? 0 : index;
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (count++) {
 	case 0:
+		if (direction == SPA_DIRECTION_INPUT)
+			build_input_format(this, &b);
+		else
+			build_output_format(this, &b);
 		break;
 	default:
 		return SPA_RESULT_ENUM_END;
 	}
-	*format = NULL;
+	fmt = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+
+	if ((res = spa_format_filter(fmt, filter, &b)) != SPA_RESULT_OK || match++ != index)
+		goto next;
+
+	*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
 
 	return SPA_RESULT_OK;
 }
 
+static void close_codec(struct impl *this)
+{
+	if (this->context)
+		avcodec_free_context(&this->context);
+}
+
+static void release_frame_buffer(void *opaque, uint8_t *data)
+{
+	struct buffer *b = opaque;
+	struct impl *this = b->impl;
+
+	pthread_mutex_lock(&this->lock);
+	b->referenced = false;
+	if (!b->outstanding)
+		spa_list_insert(this->out_ports[0].empty.prev, &b->link);
+	pthread_mutex_unlock(&this->lock);
+}
+
+/* Let the codec decode directly into the memory of a free output buffer.
+ * Frames that do not match the negotiated output, or that arrive when
+ * no buffer is free, come from the default ffmpeg pool and are copied
+ * when they are output. */
+static int get_buffer2(AVCodecContext *context, AVFrame *frame, int flags)
+{
+	struct impl *this = context->opaque;
+	struct port *port = &this->out_ports[0];
+	struct spa_video_info_raw *info = &port->current_format.info.raw;
+	struct buffer *b = NULL;
+	uint8_t *data;
+	int i;
+
+	if (!this->direct ||
+	    frame->format != this->pix_fmt ||
+	    frame->width != info->size.width ||
+	    frame->height != info->size.height)
+		return avcodec_default_get_buffer2(context, frame, flags);
+
+	pthread_mutex_lock(&this->lock);
+	if (!spa_list_is_empty(&port->empty)) {
+		b = spa_list_first(&port->empty, struct buffer, link);
+		spa_list_remove(&b->link);
+		b->referenced = true;
+	}
+	pthread_mutex_unlock(&this->lock);
+
+	if (b == NULL)
+		return avcodec_default_get_buffer2(context, frame, flags);
+
+	data = b->outbuf->datas[0].data;
+
+	frame->buf[0] = av_buffer_create(data, this->layout.size, release_frame_buffer, b, 0);
+	if (frame->buf[0] == NULL) {
+		release_frame_buffer(b, data);
+		return AVERROR(ENOMEM);
+	}
+	for (i = 0; i < 4; i++) {
+		frame->data[i] = this->layout.linesize[i] ? data + this->layout.offset[i] : NULL;
+		frame->linesize[i] = this->layout.linesize[i];
+	}
+	frame->extended_data = frame->data;
+
+	return 0;
+}
+
+static int open_codec(struct impl *this, const struct spa_video_info *info)
+{
+	AVCodecContext *c;
+	int res;
+
+	close_codec(this);
+
+	if ((c = avcodec_alloc_context3(this->codec)) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	c->width = info->info.mjpg.size.width;
+	c->height = info->info.mjpg.size.height;
+	c->framerate = (AVRational) { info->info.mjpg.framerate.num,
+				      info->info.mjpg.framerate.denom };
+	c->opaque = this;
+	spa_ffmpeg_setup_threads(c, &this->type.thread, this->props.threads,
+				 this->props.thread_type);
+
+	if (this->codec->capabilities & AV_CODEC_CAP_DR1) {
+		c->get_buffer2 = get_buffer2;
+		c->thread_safe_callbacks = 1;
+	}
+
+	if ((res = avcodec_open2(c, this->codec, NULL)) < 0) {
+		spa_log_error(this->log, NAME " %p: can't open codec %s: %s", this,
+			      this->codec->name, av_err2str(res));
+		avcodec_free_context(&c);
+		return SPA_RESULT_ERROR;
+	}
+	spa_log_info(this->log, NAME " %p: opened %s with %d threads, type %d", this,
+		     this->codec->name, c->thread_count, c->active_thread_type);
+
+	this->context = c;
+
+	return SPA_RESULT_OK;
+}
+
+/* compute the plane layout the way the default ffmpeg allocator would,
+ * with the width padded until all strides have the alignment the codec
+ * needs */
+static int compute_layout(struct impl *this, struct layout *layout)
+{
+	struct spa_video_info_raw *info = &this->out_ports[0].current_format.info.raw;
+	enum AVPixelFormat pix_fmt = this->context->pix_fmt;
+	int w, h, i, res, unaligned;
+	int align[AV_NUM_DATA_POINTERS];
+	uint8_t *data[4];
+
+	w = info->size.width;
+	h = info->size.height;
+
+	this->context->pix_fmt = this->pix_fmt;
+	avcodec_align_dimensions2(this->context, &w, &h, align);
+	this->context->pix_fmt = pix_fmt;
+
+	do {
+		if ((res = av_image_fill_linesizes(layout->linesize, this->pix_fmt, w)) < 0)
+			return res;
+		w += w & ~(w - 1);
+
+		unaligned = 0;
+		for (i = 0; i < 4; i++)
+			unaligned |= layout->linesize[i] % align[i];
+	} while (unaligned);
+
+	if ((res = av_image_fill_pointers(data, this->pix_fmt, h, NULL, layout->linesize)) < 0)
+		return res;
+
+	for (i = 0; i < 4; i++)
+		layout->offset[i] = data[i] ? data[i] - data[0] : 0;
+	layout->size = res + FRAME_PADDING;
+
+	return 0;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers", this);
+		/* make the codec drop the frames it keeps in the buffers */
+		if (port == &this->out_ports[0] && this->context)
+			avcodec_flush_buffers(this->context);
+		pthread_mutex_lock(&this->lock);
+		this->direct = false;
+		port->n_buffers = 0;
+		spa_list_init(&port->empty);
+		pthread_mutex_unlock(&this->lock);
+	}
+	return SPA_RESULT_OK;
+}
+
 static int
 spa_ffmpeg_dec_node_port_set_format(struct spa_node *node,
 				    enum spa_direction direction,
@@ -220,8 +602,9 @@ spa_ffmpeg_dec_node_port_set_format(struct spa_node *node,
 {
 	struct impl *this;
 	struct port *port;
+	int res;
 
-	if (node == NULL || format == NULL)
+	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
 	this = SPA_CONTAINER_OF(node, struct impl, node);
@@ -234,21 +617,56 @@ spa_ffmpeg_dec_node_port_set_format(struct spa_node *node,
 
 	if (format == NULL) {
 		port->have_format = false;
-		return SPA_RESULT_OK;
+		clear_buffers(this, port);
+		if (direction == SPA_DIRECTION_INPUT)
+			close_codec(this);
+	} else if (direction == SPA_DIRECTION_INPUT) {
+		struct spa_video_info info = { SPA_FORMAT_MEDIA_TYPE(format),
+			SPA_FORMAT_MEDIA_SUBTYPE(format),
+		};
+
+		if (info.media_type != this->type.media_type.video ||
+		    info.media_subtype != this->media_subtype)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		/* the h264 info starts with the same fields as mjpg */
+		if (!spa_format_video_mjpg_parse(format, &info.info.mjpg, &this->type.format_video))
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (!(flags & SPA_PORT_FORMAT_FLAG_TEST_ONLY)) {
+			if ((res = open_codec(this, &info)) < 0)
+				return res;
+			port->current_format = info;
+			port->have_format = true;
+
+			/* the stride alignment depends on the codec */
+			if (this->out_ports[0].have_format &&
+			    compute_layout(this, &this->layout) < 0)
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
+		}
 	} else {
 		struct spa_video_info info = { SPA_FORMAT_MEDIA_TYPE(format),
 			SPA_FORMAT_MEDIA_SUBTYPE(format),
 		};
+		enum AVPixelFormat pix_fmt;
 
-		if (info.media_type != this->type.media_type.video &&
+		if (info.media_type != this->type.media_type.video ||
 		    info.media_subtype != this->type.media_subtype.raw)
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
 		if (!spa_format_video_raw_parse(format, &info.info.raw, &this->type.format_video))
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
+		pix_fmt = spa_ffmpeg_pix_fmt(&this->type.video_format, info.info.raw.format);
+		if (pix_fmt == AV_PIX_FMT_NONE)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
 		if (!(flags & SPA_PORT_FORMAT_FLAG_TEST_ONLY)) {
+			clear_buffers(this, port);
 			port->current_format = info;
+			this->pix_fmt = pix_fmt;
+			if (this->context && compute_layout(this, &this->layout) < 0)
+				return SPA_RESULT_INVALID_MEDIA_TYPE;
 			port->have_format = true;
 		}
 	}
@@ -314,7 +732,74 @@ spa_ffmpeg_dec_node_port_enum_params(struct spa_node *node,
 				     uint32_t index,
 				     struct spa_param **param)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct impl *this;
+	struct port *port;
+
+	if (node == NULL || param == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (!IS_VALID_PORT(this, direction, port_id))
+		return SPA_RESULT_INVALID_PORT;
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format || this->context == NULL)
+		return SPA_RESULT_NO_FORMAT;
+
+	spa_pod_builder_init(&b, port->params_buffer, sizeof(port->params_buffer));
+
+	switch (index) {
+	case 0:
+		if (direction == SPA_DIRECTION_INPUT) {
+			struct spa_video_info_mjpg *info = &port->current_format.info.mjpg;
+
+			spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+				PROP(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
+					info->size.width * info->size.height * 2),
+				PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT,
+					0),
+				PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+					MAX_BUFFERS,
+					2, MAX_BUFFERS),
+				PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT,
+					16));
+		} else {
+			/* enough buffers for the frames the codec keeps as
+			 * references and the frames in flight in its threads */
+			spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+				PROP(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
+					this->layout.size),
+				PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT,
+					this->layout.linesize[0]),
+				PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+					MAX_BUFFERS,
+					SPA_MIN(this->context->thread_count + 18, MAX_BUFFERS),
+					MAX_BUFFERS),
+				PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT,
+					64));
+		}
+		break;
+
+	case 1:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.Header),
+			PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				sizeof(struct spa_meta_header)));
+		break;
+
+	default:
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -333,13 +818,73 @@ spa_ffmpeg_dec_node_port_use_buffers(struct spa_node *node,
 				     struct spa_buffer **buffers,
 				     uint32_t n_buffers)
 {
+	struct impl *this;
+	struct port *port;
+	bool direct;
+	uint32_t i;
+
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	if (!IS_VALID_PORT(node, direction, port_id))
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (!IS_VALID_PORT(this, direction, port_id))
 		return SPA_RESULT_INVALID_PORT;
 
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format || this->context == NULL)
+		return SPA_RESULT_NO_FORMAT;
+
+	if (n_buffers > MAX_BUFFERS)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	clear_buffers(this, port);
+
+	direct = true;
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b;
+		struct spa_data *d = buffers[i]->datas;
+
+		b = &port->buffers[i];
+		b->impl = this;
+		b->outbuf = buffers[i];
+		b->outstanding = direction == SPA_DIRECTION_INPUT;
+		b->referenced = false;
+		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
+
+		if (!((d[0].type == this->type.data.MemPtr ||
+		       d[0].type == this->type.data.MemFd ||
+		       d[0].type == this->type.data.DmaBuf) && d[0].data != NULL)) {
+			spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
+				      buffers[i]);
+			return SPA_RESULT_ERROR;
+		}
+		if (direction == SPA_DIRECTION_OUTPUT) {
+			if (d[0].maxsize < this->layout.size) {
+				spa_log_error(this->log, NAME " %p: buffer %p too small %u < %zd",
+					      this, buffers[i], d[0].maxsize, this->layout.size);
+				return SPA_RESULT_ERROR;
+			}
+			/* decoding into the buffer needs aligned planes */
+			if (((uintptr_t) d[0].data & 63) != 0)
+				direct = false;
+			spa_list_insert(port->empty.prev, &b->link);
+		}
+	}
+	port->n_buffers = n_buffers;
+
+	if (direction == SPA_DIRECTION_OUTPUT) {
+		pthread_mutex_lock(&this->lock);
+		this->direct = direct && n_buffers > 0 &&
+			(this->codec->capabilities & AV_CODEC_CAP_DR1);
+		pthread_mutex_unlock(&this->lock);
+		spa_log_info(this->log, NAME " %p: %s decoding into %d buffers", this,
+			     this->direct ? "direct" : "copy", n_buffers);
+	}
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -378,46 +923,287 @@ spa_ffmpeg_dec_node_port_set_io(struct spa_node *node,
 	return SPA_RESULT_OK;
 }
 
-static int spa_ffmpeg_dec_node_process_input(struct spa_node *node)
+static void recycle_buffer(struct impl *this, uint32_t id)
+{
+	struct port *port = &this->out_ports[0];
+	struct buffer *b = &port->buffers[id];
+
+	pthread_mutex_lock(&this->lock);
+	if (!b->outstanding) {
+		pthread_mutex_unlock(&this->lock);
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+	b->outstanding = false;
+	if (!b->referenced)
+		spa_list_insert(port->empty.prev, &b->link);
+	pthread_mutex_unlock(&this->lock);
+
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
+
+static struct buffer *find_frame_buffer(struct impl *this, AVFrame *frame)
 {
-	return SPA_RESULT_INVALID_PORT;
+	struct port *port = &this->out_ports[0];
+	uint32_t i;
+
+	if (frame->buf[0] == NULL)
+		return NULL;
+
+	for (i = 0; i < port->n_buffers; i++) {
+		struct buffer *b = &port->buffers[i];
+
+		if (b->outbuf->datas[0].data == frame->buf[0]->data &&
+		    av_buffer_get_opaque(frame->buf[0]) == b)
+			return b;
+	}
+	return NULL;
 }
 
-static int spa_ffmpeg_dec_node_process_output(struct spa_node *node)
+static struct buffer *find_free_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b = NULL;
+
+	pthread_mutex_lock(&this->lock);
+	if (!spa_list_is_empty(&port->empty)) {
+		b = spa_list_first(&port->empty, struct buffer, link);
+		spa_list_remove(&b->link);
+		b->outstanding = true;
+	}
+	pthread_mutex_unlock(&this->lock);
+
+	return b;
+}
+
+static void copy_frame(struct impl *this, struct buffer *b, AVFrame *frame)
+{
+	uint8_t *dst[4];
+	uint8_t *data = b->outbuf->datas[0].data;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		dst[i] = this->layout.linesize[i] ? data + this->layout.offset[i] : NULL;
+
+	av_image_copy(dst, this->layout.linesize,
+		      (const uint8_t **) frame->data, frame->linesize,
+		      frame->format, frame->width, frame->height);
+}
+
+static int output_frame(struct impl *this, AVFrame *frame)
+{
+	struct port *port = &this->out_ports[0];
+	struct spa_video_info_raw *info = &port->current_format.info.raw;
+	struct spa_port_io *output = port->io;
+	struct buffer *b;
+	struct spa_data *d;
+	bool direct = false;
+
+	if (frame->format != this->pix_fmt ||
+	    frame->width != info->size.width ||
+	    frame->height != info->size.height) {
+		spa_log_warn(this->log, NAME " %p: dropping frame %dx%d, format %d", this,
+			     frame->width, frame->height, frame->format);
+		av_frame_unref(frame);
+		return SPA_RESULT_NEED_BUFFER;
+	}
+
+	if ((b = find_frame_buffer(this, frame))) {
+		/* the same frame can be output again, copy it in that case */
+		pthread_mutex_lock(&this->lock);
+		if (!b->outstanding) {
+			b->outstanding = true;
+			direct = true;
+		}
+		pthread_mutex_unlock(&this->lock);
+	}
+	if (!direct) {
+		if ((b = find_free_buffer(this, port)) == NULL) {
+			spa_log_trace(this->log, NAME " %p: out of buffers", this);
+			av_frame_unref(frame);
+			return SPA_RESULT_OUT_OF_BUFFERS;
+		}
+		copy_frame(this, b, frame);
+	}
+
+	d = &b->outbuf->datas[0];
+	d->chunk->offset = 0;
+	d->chunk->size = this->layout.size - FRAME_PADDING;
+	d->chunk->stride = this->layout.linesize[0];
+
+	if (b->h) {
+		b->h->seq = this->seq;
+		b->h->pts = av_frame_get_best_effort_timestamp(frame);
+		b->h->dts_offset = 0;
+	}
+	this->seq++;
+
+	av_frame_unref(frame);
+
+	output->buffer_id = b->outbuf->id;
+	output->status = SPA_RESULT_HAVE_BUFFER;
+
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static int send_packet(struct impl *this, struct spa_port_io *input)
+{
+	struct port *port = &this->in_ports[0];
+	struct buffer *b;
+	struct spa_data *d;
+	AVPacket packet;
+	int res;
+
+	if (input->buffer_id >= port->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	b = &port->buffers[input->buffer_id];
+	d = &b->outbuf->datas[0];
+
+	av_init_packet(&packet);
+	packet.data = SPA_MEMBER(d->data, d->chunk->offset, uint8_t);
+	packet.size = d->chunk->size;
+	if (b->h)
+		packet.pts = b->h->pts;
+
+	/* the packet is not refcounted so the codec copies what it needs
+	 * and the input buffer can be reused right away */
+	res = avcodec_send_packet(this->context, &packet);
+	if (res == AVERROR(EAGAIN))
+		return SPA_RESULT_HAVE_BUFFER;
+
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	if (res < 0) {
+		spa_log_warn(this->log, NAME " %p: decode error: %s", this, av_err2str(res));
+		return SPA_RESULT_ERROR;
+	}
+	return SPA_RESULT_OK;
+}
+
+static int receive_frame(struct impl *this)
+{
+	int res;
+
+	res = avcodec_receive_frame(this->context, this->frame);
+	if (res == AVERROR(EAGAIN))
+		return SPA_RESULT_NEED_BUFFER;
+	else if (res < 0) {
+		spa_log_error(this->log, NAME " %p: decode error: %s", this, av_err2str(res));
+		return SPA_RESULT_ERROR;
+	}
+	return output_frame(this, this->frame);
+}
+
+static int decode(struct impl *this)
+{
+	struct spa_port_io *input = this->in_ports[0].io;
+	int res;
+
+	if (this->context == NULL || !this->out_ports[0].have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	/* decoded frames need a free buffer, unless they were decoded into
+	 * one, keep the data in the codec until there is one */
+	if (!this->direct && spa_list_is_empty(&this->out_ports[0].empty))
+		return SPA_RESULT_OUT_OF_BUFFERS;
+
+	/* with frame threading a frame is only ready after the threads are
+	 * filled, try to get one first so that the codec can take the next
+	 * packet */
+	if ((res = receive_frame(this)) != SPA_RESULT_NEED_BUFFER)
+		return res;
+
+	if (input->status != SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_NEED_BUFFER;
+
+	if ((res = send_packet(this, input)) < 0)
+		return res;
+
+	return receive_frame(this);
+}
+
+static int spa_ffmpeg_dec_node_process_input(struct spa_node *node)
 {
 	struct impl *this;
-	struct port *port;
-	struct spa_port_io *output;
+	struct spa_port_io *input, *output;
 
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
 	this = SPA_CONTAINER_OF(node, struct impl, node);
 
-	port = &this->out_ports[0];
+	if ((output = this->out_ports[0].io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
 
-	if ((output = port->io) == NULL)
+	if ((input = this->in_ports[0].io) == NULL)
 		return SPA_RESULT_ERROR;
 
-	if (!port->have_format) {
-		output->status = SPA_RESULT_NO_FORMAT;
+	return decode(this);
+}
+
+static int spa_ffmpeg_dec_node_process_output(struct spa_node *node)
+{
+	struct impl *this;
+	struct spa_port_io *input, *output;
+	int res;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if ((output = this->out_ports[0].io) == NULL)
 		return SPA_RESULT_ERROR;
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	/* recycle */
+	if (output->buffer_id != SPA_ID_INVALID) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
 	}
-	output->status = SPA_RESULT_OK;
 
-	return SPA_RESULT_OK;
+	if ((input = this->in_ports[0].io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	if ((res = decode(this)) != SPA_RESULT_NEED_BUFFER)
+		return res;
+
+	input->range = output->range;
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	return SPA_RESULT_NEED_BUFFER;
 }
 
 static int
 spa_ffmpeg_dec_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
 {
+	struct impl *this;
+	struct port *port;
+
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
 	if (port_id != 0)
 		return SPA_RESULT_INVALID_PORT;
 
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	port = &this->out_ports[port_id];
+
+	if (port->n_buffers == 0)
+		return SPA_RESULT_NO_BUFFERS;
+
+	if (buffer_id >= port->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	recycle_buffer(this, buffer_id);
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -474,8 +1260,31 @@ spa_ffmpeg_dec_get_interface(struct spa_handle *handle, uint32_t interface_id, v
 	return SPA_RESULT_OK;
 }
 
+static int spa_ffmpeg_dec_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	if (handle == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = (struct impl *) handle;
+
+	/* frees the codec threads and drops the references on the buffers */
+	close_codec(this);
+	av_frame_free(&this->frame);
+	pthread_mutex_destroy(&this->lock);
+
+	return SPA_RESULT_OK;
+}
+
+size_t spa_ffmpeg_dec_get_size(void)
+{
+	return sizeof(struct impl);
+}
+
 int
 spa_ffmpeg_dec_init(struct spa_handle *handle,
+		    const AVCodec *codec,
 		    const struct spa_dict *info,
 		    const struct spa_support *support,
 		    uint32_t n_support)
@@ -484,6 +1293,7 @@ spa_ffmpeg_dec_init(struct spa_handle *handle,
 	uint32_t i;
 
 	handle->get_interface = spa_ffmpeg_dec_get_interface;
+	handle->clear = spa_ffmpeg_dec_clear;
 
 	this = (struct impl *) handle;
 
@@ -500,9 +1310,20 @@ spa_ffmpeg_dec_init(struct spa_handle *handle,
 	init_type(&this->type, this->map);
 
 	this->node = ffmpeg_dec_node;
+	this->codec = codec;
+	this->media_subtype = spa_ffmpeg_media_subtype(&this->type.media_subtype_video, codec->id);
+	reset_props(this, &this->props);
+
+	if ((this->frame = av_frame_alloc()) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	pthread_mutex_init(&this->lock, NULL);
+
+	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->in_ports[0].empty);
 
-	this->in_ports[0].info.flags = 0;
-	this->out_ports[0].info.flags = 0;
+	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->out_ports[0].empty);
 
 	return SPA_RESULT_OK;
 }
@@ -17,54 +17,88 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
 #include <stddef.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 
 #include <spa/log.h>
 #include <spa/type-map.h>
+#include <spa/list.h>
 #include <spa/node.h>
+#include <spa/format-builder.h>
+#include <spa/param-alloc.h>
 #include <spa/video/format-utils.h>
 #include <lib/props.h>
+#include <lib/format.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+
+#include "ffmpeg.h"
+
+#define NAME "ffmpeg-enc"
 
 #define IS_VALID_PORT(this,d,id) ((id) == 0)
 #define MAX_BUFFERS    32
 
+struct props {
+	int threads;
+	uint32_t thread_type;
+};
+
 struct buffer {
-	struct spa_buffer buffer;
-	struct spa_meta metas[1];
-	struct spa_meta_header header;
-	struct spa_data datas[1];
-	struct spa_buffer *imported;
+	struct spa_buffer *outbuf;
 	bool outstanding;
-	struct buffer *next;
+	struct spa_meta_header *h;
+	struct spa_list link;
 };
 
 struct port {
 	bool have_format;
 	struct spa_video_info current_format;
-	bool have_buffers;
-	struct buffer buffers[MAX_BUFFERS];
+
 	struct spa_port_info info;
+	uint8_t params_buffer[1024];
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
 	struct spa_port_io *io;
+
+	struct spa_list empty;
 };
 
 struct type {
 	uint32_t node;
+	uint32_t format;
+	uint32_t props;
+	struct spa_ffmpeg_type_thread thread;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
 	struct spa_type_media_type media_type;
 	struct spa_type_media_subtype media_subtype;
+	struct spa_type_media_subtype_video media_subtype_video;
 	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
 	struct spa_type_command_node command_node;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
+	struct spa_type_param_alloc_meta_enable param_alloc_meta_enable;
 };
 
 static inline void init_type(struct type *type, struct spa_type_map *map)
 {
 	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	spa_ffmpeg_type_thread_map(map, &type->thread);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
 	spa_type_media_type_map(map, &type->media_type);
 	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_media_subtype_video_map(map, &type->media_subtype_video);
 	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
 	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
+	spa_type_param_alloc_meta_enable_map(map, &type->param_alloc_meta_enable);
 }
 
 struct impl {
@@ -75,23 +109,94 @@ struct impl {
 	struct spa_type_map *map;
 	struct spa_log *log;
 
+	uint8_t props_buffer[512];
+	struct props props;
+
 	const struct spa_node_callbacks *callbacks;
 	void *user_data;
 
+	uint8_t format_buffer[1024];
+
 	struct port in_ports[1];
 	struct port out_ports[1];
 
+	const AVCodec *codec;
+	AVCodecContext *context;
+	AVFrame *frame;
+	AVPacket packet;
+	uint32_t media_subtype;
+	enum AVPixelFormat pix_fmt;
+
+	uint32_t seq;
+
 	bool started;
 };
 
+#define DEFAULT_THREADS		0
+
+static void reset_props(struct impl *this, struct props *props)
+{
+	props->threads = DEFAULT_THREADS;
+	props->thread_type = this->type.thread.type_auto;
+}
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_MM(f,key,type,...)							\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_EN(f,key,type,n,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_ENUM,type,n,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+
 static int spa_ffmpeg_enc_node_get_props(struct spa_node *node, struct spa_props **props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	if (node == NULL || props == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_pod_builder_init(&b, this->props_buffer, sizeof(this->props_buffer));
+	spa_pod_builder_props(&b, &f[0], this->type.props,
+		PROP_MM(&f[1], this->type.thread.threads, SPA_POD_TYPE_INT,
+			this->props.threads,
+			0, 64),
+		PROP_EN(&f[1], this->type.thread.thread_type, SPA_POD_TYPE_ID, 4,
+			this->props.thread_type,
+			this->type.thread.type_auto,
+			this->type.thread.type_frame,
+			this->type.thread.type_slice));
+
+	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return SPA_RESULT_OK;
 }
 
+/* the threading of a codec can only be configured before it is opened,
+ * changes are applied when the input format is set the next time */
 static int spa_ffmpeg_enc_node_set_props(struct spa_node *node, const struct spa_props *props)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct impl *this;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (props == NULL) {
+		reset_props(this, &this->props);
+	} else {
+		spa_props_query(props,
+				this->type.thread.threads, SPA_POD_TYPE_INT, &this->props.threads,
+				this->type.thread.thread_type, SPA_POD_TYPE_ID, &this->props.thread_type,
+				0);
+	}
+	return SPA_RESULT_OK;
 }
 
 static int spa_ffmpeg_enc_node_send_command(struct spa_node *node, const struct spa_command *command)
@@ -185,6 +290,83 @@ spa_ffmpeg_enc_node_remove_port(struct spa_node *node,
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
 
+/* the raw formats the codec can take */
+static void build_input_format(struct impl *this, struct spa_pod_builder *b)
+{
+	struct spa_pod_frame f[2];
+	const enum AVPixelFormat *pix_fmts = this->codec->pix_fmts;
+	static const enum AVPixelFormat default_pix_fmts[] = {
+		AV_PIX_FMT_YUV420P, AV_PIX_FMT_NONE
+	};
+	struct spa_pod_prop *prop;
+	uint32_t n_formats = 0;
+
+	if (pix_fmts == NULL)
+		pix_fmts = default_pix_fmts;
+
+	spa_pod_builder_push_format(b, &f[0], this->type.format,
+				    this->type.media_type.video,
+				    this->type.media_subtype.raw);
+
+	spa_pod_builder_push_prop(b, &f[1], this->type.format_video.format,
+				  SPA_POD_PROP_RANGE_ENUM | SPA_POD_PROP_FLAG_UNSET);
+	prop = SPA_POD_BUILDER_DEREF(b, f[1].ref, struct spa_pod_prop);
+	for (; *pix_fmts != AV_PIX_FMT_NONE; pix_fmts++) {
+		uint32_t format = spa_ffmpeg_video_format(&this->type.video_format, *pix_fmts);
+
+		if (format == this->type.video_format.UNKNOWN)
+			continue;
+		if (n_formats == 0)
+			spa_pod_builder_id(b, format);
+		spa_pod_builder_id(b, format);
+		n_formats++;
+	}
+	if (n_formats <= 1)
+		prop->body.flags &= ~(SPA_POD_PROP_RANGE_MASK | SPA_POD_PROP_FLAG_UNSET);
+	spa_pod_builder_pop(b, &f[1]);
+
+	spa_pod_builder_add(b,
+		PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+			320, 240,
+			1, 1,
+			INT32_MAX, INT32_MAX),
+		PROP_U_MM(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+			25, 1,
+			1, 1,
+			INT32_MAX, 1), 0);
+	spa_pod_builder_pop(b, &f[0]);
+}
+
+/* the encoded format, the size and framerate follow the input */
+static void build_output_format(struct impl *this, struct spa_pod_builder *b)
+{
+	struct spa_pod_frame f[2];
+	struct port *in_port = &this->in_ports[0];
+	struct spa_video_info_raw *info = &in_port->current_format.info.raw;
+
+	if (in_port->have_format) {
+		spa_pod_builder_format(b, &f[0], this->type.format,
+			this->type.media_type.video,
+			this->media_subtype,
+			PROP(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+				info->size.width, info->size.height),
+			PROP(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+				info->framerate.num, info->framerate.denom));
+	} else {
+		spa_pod_builder_format(b, &f[0], this->type.format,
+			this->type.media_type.video,
+			this->media_subtype,
+			PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+				320, 240,
+				1, 1,
+				INT32_MAX, INT32_MAX),
+			PROP_U_MM(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+				25, 1,
+				1, 1,
+				INT32_MAX, 1));
+	}
+}
+
 static int
 spa_ffmpeg_enc_node_port_enum_formats(struct spa_node *node,
 				      enum spa_direction direction,
@@ -192,30 +374,101 @@ spa_ffmpeg_enc_node_port_enum_formats(struct spa_node *node,
 				      struct spa_format **format,
 				      const struct spa_format *filter, uint32_t index)
 {
-	//struct impl *this;
-	//struct port *port;
+	struct impl *this;
+	int res;
+	struct spa_format *fmt;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = { NULL, };
+	uint32_t count, match;
 
 	if (node == NULL || format == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	//this = SPA_CONTAINER_OF (node, struct impl, node);
+	this = SPA_CONTAINER_OF(node, struct impl, node);
 
 	if (!IS_VALID_PORT(this, direction, port_id))
 		return SPA_RESULT_INVALID_PORT;
 
-	//port = direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+	if (this->media_subtype == SPA_ID_INVALID)
+		return SPA_RESULT_ENUM_END;
 
-	switch (index) {
+	count = match = filter ? 0 : index;
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (count++) {
 	case 0:
+		if (direction == SPA_DIRECTION_INPUT)
+			build_input_format(this, &b);
+		else
+			build_output_format(this, &b);
 		break;
 	default:
 		return SPA_RESULT_ENUM_END;
 	}
-	*format = NULL;
+	fmt = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+
+	if ((res = spa_format_filter(fmt, filter, &b)) != SPA_RESULT_OK || match++ != index)
+		goto next;
+
+	*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
 
 	return SPA_RESULT_OK;
 }
 
+static void close_codec(struct impl *this)
+{
+	if (this->context)
+		avcodec_free_context(&this->context);
+}
+
+static int open_codec(struct impl *this, const struct spa_video_info *info,
+		      enum AVPixelFormat pix_fmt)
+{
+	const struct spa_video_info_raw *raw = &info->info.raw;
+	AVCodecContext *c;
+	int res;
+
+	close_codec(this);
+
+	if ((c = avcodec_alloc_context3(this->codec)) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	c->width = raw->size.width;
+	c->height = raw->size.height;
+	c->pix_fmt = pix_fmt;
+	c->framerate = (AVRational) { raw->framerate.num, raw->framerate.denom };
+	c->time_base = (AVRational) { raw->framerate.denom, raw->framerate.num };
+	spa_ffmpeg_setup_threads(c, &this->type.thread, this->props.threads,
+				 this->props.thread_type);
+
+	if ((res = avcodec_open2(c, this->codec, NULL)) < 0) {
+		spa_log_error(this->log, NAME " %p: can't open codec %s: %s", this,
+			      this->codec->name, av_err2str(res));
+		avcodec_free_context(&c);
+		return SPA_RESULT_ERROR;
+	}
+	spa_log_info(this->log, NAME " %p: opened %s with %d threads, type %d", this,
+		     this->codec->name, c->thread_count, c->active_thread_type);
+
+	this->context = c;
+	this->pix_fmt = pix_fmt;
+
+	return SPA_RESULT_OK;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers", this);
+		port->n_buffers = 0;
+		spa_list_init(&port->empty);
+	}
+	return SPA_RESULT_OK;
+}
+
 static int
 spa_ffmpeg_enc_node_port_set_format(struct spa_node *node,
 				    enum spa_direction direction,
@@ -224,8 +477,9 @@ spa_ffmpeg_enc_node_port_set_format(struct spa_node *node,
 {
 	struct impl *this;
 	struct port *port;
+	int res;
 
-	if (node == NULL || format == NULL)
+	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
 	this = SPA_CONTAINER_OF(node, struct impl, node);
@@ -238,20 +492,46 @@ spa_ffmpeg_enc_node_port_set_format(struct spa_node *node,
 
 	if (format == NULL) {
 		port->have_format = false;
-		return SPA_RESULT_OK;
-	} else {
+		clear_buffers(this, port);
+		if (direction == SPA_DIRECTION_INPUT)
+			close_codec(this);
+	} else if (direction == SPA_DIRECTION_INPUT) {
 		struct spa_video_info info = { SPA_FORMAT_MEDIA_TYPE(format),
 			SPA_FORMAT_MEDIA_SUBTYPE(format),
 		};
+		enum AVPixelFormat pix_fmt;
 
-		if (info.media_type != this->type.media_type.video &&
+		if (info.media_type != this->type.media_type.video ||
 		    info.media_subtype != this->type.media_subtype.raw)
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
 		if (!spa_format_video_raw_parse(format, &info.info.raw, &this->type.format_video))
 			return SPA_RESULT_INVALID_MEDIA_TYPE;
 
+		pix_fmt = spa_ffmpeg_pix_fmt(&this->type.video_format, info.info.raw.format);
+		if (pix_fmt == AV_PIX_FMT_NONE || info.info.raw.framerate.num == 0)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
 		if (!(flags & SPA_PORT_FORMAT_FLAG_TEST_ONLY)) {
+			if ((res = open_codec(this, &info, pix_fmt)) < 0)
+				return res;
+			port->current_format = info;
+			port->have_format = true;
+		}
+	} else {
+		struct spa_video_info info = { SPA_FORMAT_MEDIA_TYPE(format),
+			SPA_FORMAT_MEDIA_SUBTYPE(format),
+		};
+
+		if (info.media_type != this->type.media_type.video ||
+		    info.media_subtype != this->media_subtype)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (!spa_format_video_mjpg_parse(format, &info.info.mjpg, &this->type.format_video))
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (!(flags & SPA_PORT_FORMAT_FLAG_TEST_ONLY)) {
+			clear_buffers(this, port);
 			port->current_format = info;
 			port->have_format = true;
 		}
@@ -312,9 +592,74 @@ spa_ffmpeg_enc_node_port_get_info(struct spa_node *node,
 static int
 spa_ffmpeg_enc_node_port_enum_params(struct spa_node *node,
 				     enum spa_direction direction,
-				     uint32_t port_id, uint32_t index, struct spa_param **param)
+				     uint32_t port_id,
+				     uint32_t index,
+				     struct spa_param **param)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct impl *this;
+	struct port *port;
+	struct spa_video_info_raw *info;
+	int size, stride;
+
+	if (node == NULL || param == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (!IS_VALID_PORT(this, direction, port_id))
+		return SPA_RESULT_INVALID_PORT;
+
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format || this->context == NULL)
+		return SPA_RESULT_NO_FORMAT;
+
+	info = &this->in_ports[0].current_format.info.raw;
+
+	if (direction == SPA_DIRECTION_INPUT) {
+		size = av_image_get_buffer_size(this->pix_fmt,
+						info->size.width, info->size.height, 16);
+		stride = av_image_get_linesize(this->pix_fmt, info->size.width, 0);
+	} else {
+		/* a compressed frame is rarely larger than a raw one */
+		size = info->size.width * info->size.height * 2;
+		stride = 0;
+	}
+
+	spa_pod_builder_init(&b, port->params_buffer, sizeof(port->params_buffer));
+
+	switch (index) {
+	case 0:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+			PROP(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
+				size),
+			PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT,
+				stride),
+			PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+				MAX_BUFFERS,
+				2, MAX_BUFFERS),
+			PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT,
+				16));
+		break;
+
+	case 1:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.Header),
+			PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				sizeof(struct spa_meta_header)));
+		break;
+
+	default:
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -331,13 +676,51 @@ spa_ffmpeg_enc_node_port_use_buffers(struct spa_node *node,
 				     uint32_t port_id,
 				     struct spa_buffer **buffers, uint32_t n_buffers)
 {
+	struct impl *this;
+	struct port *port;
+	uint32_t i;
+
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	if (!IS_VALID_PORT(node, direction, port_id))
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (!IS_VALID_PORT(this, direction, port_id))
 		return SPA_RESULT_INVALID_PORT;
 
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	port =
+	    direction == SPA_DIRECTION_INPUT ? &this->in_ports[port_id] : &this->out_ports[port_id];
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	if (n_buffers > MAX_BUFFERS)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b;
+		struct spa_data *d = buffers[i]->datas;
+
+		b = &port->buffers[i];
+		b->outbuf = buffers[i];
+		b->outstanding = direction == SPA_DIRECTION_INPUT;
+		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
+
+		if (!((d[0].type == this->type.data.MemPtr ||
+		       d[0].type == this->type.data.MemFd ||
+		       d[0].type == this->type.data.DmaBuf) && d[0].data != NULL)) {
+			spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
+				      buffers[i]);
+			return SPA_RESULT_ERROR;
+		}
+		if (direction == SPA_DIRECTION_OUTPUT)
+			spa_list_insert(port->empty.prev, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return SPA_RESULT_OK;
 }
 
 static int
@@ -346,8 +729,7 @@ spa_ffmpeg_enc_node_port_alloc_buffers(struct spa_node *node,
 				       uint32_t port_id,
 				       struct spa_param **params,
 				       uint32_t n_params,
-				       struct spa_buffer **buffers,
-				       uint32_t *n_buffers)
+				       struct spa_buffer **buffers, uint32_t *n_buffers)
 {
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
@@ -375,36 +757,187 @@ spa_ffmpeg_enc_node_port_set_io(struct spa_node *node,
 	return SPA_RESULT_OK;
 }
 
-static int
-spa_ffmpeg_enc_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+static void recycle_buffer(struct impl *this, uint32_t id)
 {
-	if (node == NULL)
-		return SPA_RESULT_INVALID_ARGUMENTS;
+	struct port *port = &this->out_ports[0];
+	struct buffer *b = &port->buffers[id];
 
-	if (port_id != 0)
-		return SPA_RESULT_INVALID_PORT;
+	if (!b->outstanding) {
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
 
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	spa_list_insert(port->empty.prev, &b->link);
+	b->outstanding = false;
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
 }
 
-static int
-spa_ffmpeg_enc_node_port_send_command(struct spa_node *node,
-				      enum spa_direction direction,
-				      uint32_t port_id, const struct spa_command *command)
+static struct buffer *find_free_buffer(struct impl *this, struct port *port)
 {
-	return SPA_RESULT_NOT_IMPLEMENTED;
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->empty))
+		return NULL;
+
+	b = spa_list_first(&port->empty, struct buffer, link);
+	spa_list_remove(&b->link);
+	b->outstanding = true;
+
+	return b;
+}
+
+/* Wrap the input buffer in a frame without copying. The frame is not
+ * refcounted so the codec makes its own copy only when it needs to keep
+ * the picture around, for lookahead or frame threading. */
+static int send_frame(struct impl *this, struct spa_port_io *input)
+{
+	struct port *port = &this->in_ports[0];
+	struct spa_video_info_raw *info = &port->current_format.info.raw;
+	AVFrame *frame = this->frame;
+	struct buffer *b;
+	struct spa_data *d;
+	int res;
+
+	if (input->buffer_id >= port->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	b = &port->buffers[input->buffer_id];
+	d = &b->outbuf->datas[0];
+
+	frame->format = this->pix_fmt;
+	frame->width = info->size.width;
+	frame->height = info->size.height;
+	frame->pts = b->h ? b->h->pts : AV_NOPTS_VALUE;
+
+	if ((res = av_image_fill_arrays(frame->data, frame->linesize,
+					SPA_MEMBER(d->data, d->chunk->offset, uint8_t),
+					this->pix_fmt, frame->width, frame->height, 1)) < 0)
+		return SPA_RESULT_ERROR;
+
+	if (d->chunk->stride > 0 && d->chunk->stride != frame->linesize[0]) {
+		/* the strides of the other planes scale with the first */
+		int i, stride0 = frame->linesize[0];
+		for (i = 0; i < 4 && frame->linesize[i]; i++) {
+			size_t offset = frame->data[i] - frame->data[0];
+			frame->linesize[i] = frame->linesize[i] * d->chunk->stride / stride0;
+			frame->data[i] = frame->data[0] + offset * d->chunk->stride / stride0;
+		}
+	}
+
+	res = avcodec_send_frame(this->context, frame);
+	if (res == AVERROR(EAGAIN))
+		return SPA_RESULT_HAVE_BUFFER;
+
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	if (res < 0) {
+		spa_log_warn(this->log, NAME " %p: encode error: %s", this, av_err2str(res));
+		return SPA_RESULT_ERROR;
+	}
+	return SPA_RESULT_OK;
+}
+
+static int receive_packet(struct impl *this)
+{
+	struct port *port = &this->out_ports[0];
+	struct spa_port_io *output = port->io;
+	AVPacket *packet = &this->packet;
+	struct buffer *b;
+	struct spa_data *d;
+	int res;
+
+	res = avcodec_receive_packet(this->context, packet);
+	if (res == AVERROR(EAGAIN))
+		return SPA_RESULT_NEED_BUFFER;
+	else if (res < 0) {
+		spa_log_error(this->log, NAME " %p: encode error: %s", this, av_err2str(res));
+		return SPA_RESULT_ERROR;
+	}
+
+	b = find_free_buffer(this, port);
+	d = &b->outbuf->datas[0];
+
+	if (packet->size > d->maxsize) {
+		spa_log_warn(this->log, NAME " %p: packet of %d bytes does not fit in %u",
+			     this, packet->size, d->maxsize);
+		recycle_buffer(this, b->outbuf->id);
+		av_packet_unref(packet);
+		return SPA_RESULT_NEED_BUFFER;
+	}
+
+	memcpy(d->data, packet->data, packet->size);
+	d->chunk->offset = 0;
+	d->chunk->size = packet->size;
+	d->chunk->stride = 0;
+
+	if (b->h) {
+		b->h->flags = 0;
+		if (!(packet->flags & AV_PKT_FLAG_KEY))
+			b->h->flags |= SPA_META_HEADER_FLAG_DELTA_UNIT;
+		b->h->seq = this->seq;
+		b->h->pts = packet->pts;
+		b->h->dts_offset = packet->pts - packet->dts;
+	}
+	this->seq++;
+
+	av_packet_unref(packet);
+
+	output->buffer_id = b->outbuf->id;
+	output->status = SPA_RESULT_HAVE_BUFFER;
+
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static int encode(struct impl *this)
+{
+	struct spa_port_io *input = this->in_ports[0].io;
+	int res;
+
+	if (this->context == NULL || !this->out_ports[0].have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	if (spa_list_is_empty(&this->out_ports[0].empty))
+		return SPA_RESULT_OUT_OF_BUFFERS;
+
+	if ((res = receive_packet(this)) != SPA_RESULT_NEED_BUFFER)
+		return res;
+
+	if (input->status != SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_NEED_BUFFER;
+
+	if ((res = send_frame(this, input)) < 0)
+		return res;
+
+	return receive_packet(this);
 }
 
 static int spa_ffmpeg_enc_node_process_input(struct spa_node *node)
 {
-	return SPA_RESULT_INVALID_PORT;
+	struct impl *this;
+	struct spa_port_io *input, *output;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if ((output = this->out_ports[0].io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	if ((input = this->in_ports[0].io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	return encode(this);
 }
 
 static int spa_ffmpeg_enc_node_process_output(struct spa_node *node)
 {
 	struct impl *this;
-	struct port *port;
-	struct spa_port_io *output;
+	struct spa_port_io *input, *output;
+	int res;
 
 	if (node == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
@@ -412,19 +945,64 @@ static int spa_ffmpeg_enc_node_process_output(struct spa_node *node)
 	this = SPA_CONTAINER_OF(node, struct impl, node);
 
 	if ((output = this->out_ports[0].io) == NULL)
-		return SPA_RESULT_OK;
+		return SPA_RESULT_ERROR;
 
-	port = &this->out_ports[0];
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
 
-	if (!port->have_format) {
-		output->status = SPA_RESULT_NO_FORMAT;
-		return SPA_RESULT_ERROR;
+	/* recycle */
+	if (output->buffer_id != SPA_ID_INVALID) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
 	}
-	output->status = SPA_RESULT_OK;
+
+	if ((input = this->in_ports[0].io) == NULL)
+		return SPA_RESULT_ERROR;
+
+	if ((res = encode(this)) != SPA_RESULT_NEED_BUFFER)
+		return res;
+
+	input->range = output->range;
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	return SPA_RESULT_NEED_BUFFER;
+}
+
+static int
+spa_ffmpeg_enc_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this;
+	struct port *port;
+
+	if (node == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (port_id != 0)
+		return SPA_RESULT_INVALID_PORT;
+
+	port = &this->out_ports[port_id];
+
+	if (port->n_buffers == 0)
+		return SPA_RESULT_NO_BUFFERS;
+
+	if (buffer_id >= port->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	recycle_buffer(this, buffer_id);
 
 	return SPA_RESULT_OK;
 }
 
+static int
+spa_ffmpeg_enc_node_port_send_command(struct spa_node *node,
+				      enum spa_direction direction,
+				      uint32_t port_id, const struct spa_command *command)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
 static const struct spa_node ffmpeg_enc_node = {
 	SPA_VERSION_NODE,
 	NULL,
@@ -469,8 +1047,29 @@ spa_ffmpeg_enc_get_interface(struct spa_handle *handle, uint32_t interface_id, v
 	return SPA_RESULT_OK;
 }
 
+static int spa_ffmpeg_enc_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	if (handle == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	this = (struct impl *) handle;
+
+	close_codec(this);
+	av_frame_free(&this->frame);
+
+	return SPA_RESULT_OK;
+}
+
+size_t spa_ffmpeg_enc_get_size(void)
+{
+	return sizeof(struct impl);
+}
+
 int
 spa_ffmpeg_enc_init(struct spa_handle *handle,
+		    const AVCodec *codec,
 		    const struct spa_dict *info,
 		    const struct spa_support *support, uint32_t n_support)
 {
@@ -478,6 +1077,7 @@ spa_ffmpeg_enc_init(struct spa_handle *handle,
 	uint32_t i;
 
 	handle->get_interface = spa_ffmpeg_enc_get_interface;
+	handle->clear = spa_ffmpeg_enc_clear;
 
 	this = (struct impl *) handle;
 
@@ -491,11 +1091,23 @@ spa_ffmpeg_enc_init(struct spa_handle *handle,
 		spa_log_error(this->log, "a type-map is needed");
 		return SPA_RESULT_ERROR;
 	}
+	init_type(&this->type, this->map);
 
 	this->node = ffmpeg_enc_node;
+	this->codec = codec;
+	this->media_subtype = spa_ffmpeg_media_subtype(&this->type.media_subtype_video, codec->id);
+	reset_props(this, &this->props);
+
+	if ((this->frame = av_frame_alloc()) == NULL)
+		return SPA_RESULT_NO_MEMORY;
+	av_init_packet(&this->packet);
+
+	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
+	    SPA_PORT_INFO_FLAG_NO_REF;
+	spa_list_init(&this->in_ports[0].empty);
 
-	this->in_ports[0].info.flags = 0;
-	this->out_ports[0].info.flags = 0;
+	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->out_ports[0].empty);
 
 	return SPA_RESULT_OK;
 }
@@ -18,6 +18,9 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include <spa/plugin.h>
 #include <spa/node.h>
@@ -25,10 +28,19 @@
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 
-int spa_ffmpeg_dec_init(struct spa_handle *handle, const struct spa_dict *info,
-			const struct spa_support *support, uint32_t n_support);
-int spa_ffmpeg_enc_init(struct spa_handle *handle, const struct spa_dict *info,
-			const struct spa_support *support, uint32_t n_support);
+#include "ffmpeg.h"
+
+struct factory {
+	struct spa_handle_factory factory;
+	const AVCodec *codec;
+	char name[128];
+};
+
+/* factories are handed out by pointer and can be kept around by the
+ * caller, they live as long as the plugin */
+static struct factory *factories;
+static uint32_t n_factories;
+static pthread_once_t factories_once = PTHREAD_ONCE_INIT;
 
 static int
 ffmpeg_dec_init(const struct spa_handle_factory *factory,
@@ -37,10 +49,14 @@ ffmpeg_dec_init(const struct spa_handle_factory *factory,
 		const struct spa_support *support,
 		uint32_t n_support)
 {
+	struct factory *f;
+
 	if (factory == NULL || handle == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	return spa_ffmpeg_dec_init(handle, info, support, n_support);
+	f = SPA_CONTAINER_OF(factory, struct factory, factory);
+
+	return spa_ffmpeg_dec_init(handle, f->codec, info, support, n_support);
 }
 
 static int
@@ -50,10 +66,14 @@ ffmpeg_enc_init(const struct spa_handle_factory *factory,
 		const struct spa_support *support,
 		uint32_t n_support)
 {
+	struct factory *f;
+
 	if (factory == NULL || handle == NULL)
 		return SPA_RESULT_INVALID_ARGUMENTS;
 
-	return spa_ffmpeg_enc_init(handle, info, support, n_support);
+	f = SPA_CONTAINER_OF(factory, struct factory, factory);
+
+	return spa_ffmpeg_enc_init(handle, f->codec, info, support, n_support);
 }
 
 static const struct spa_interface_info ffmpeg_interfaces[] = {
@@ -76,38 +96,56 @@ ffmpeg_enum_interface_info(const struct spa_handle_factory *factory,
 	return SPA_RESULT_OK;
 }
 
-int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t index)
+static void init_factory(struct factory *f, const AVCodec *codec)
+{
+	bool encoder = av_codec_is_encoder(codec);
+	const struct spa_handle_factory factory = {
+		SPA_VERSION_HANDLE_FACTORY,
+		f->name,
+		NULL,
+		encoder ? spa_ffmpeg_enc_get_size() : spa_ffmpeg_dec_get_size(),
+		encoder ? ffmpeg_enc_init : ffmpeg_dec_init,
+		ffmpeg_enum_interface_info,
+	};
+
+	f->codec = codec;
+	snprintf(f->name, sizeof(f->name), "%s_%s", encoder ? "ffenc" : "ffdec", codec->name);
+	memcpy(&f->factory, &factory, sizeof(factory));
+}
+
+static void init_factories(void)
 {
-	static const AVCodec *c = NULL;
-	static int ci = 0;
-	static struct spa_handle_factory f;
-	static char name[128];
+	const AVCodec *c = NULL;
+	uint32_t n = 0;
 
 	av_register_all();
 
-	if (index == 0) {
-		c = av_codec_next(NULL);
-		ci = 0;
-	}
-	while (index > ci && c) {
-		c = av_codec_next(c);
-		ci++;
-	}
-	if (c == NULL)
-		return SPA_RESULT_ENUM_END;
+	/* the nodes only handle video for now */
+	while ((c = av_codec_next(c)))
+		if (c->type == AVMEDIA_TYPE_VIDEO)
+			n++;
+
+	factories = calloc(n, sizeof(struct factory));
+	if (factories == NULL)
+		return;
 
-	if (av_codec_is_encoder(c)) {
-		snprintf(name, 128, "ffenc_%s", c->name);
-		f.init = ffmpeg_enc_init;
-	} else {
-		snprintf(name, 128, "ffdec_%s", c->name);
-		f.init = ffmpeg_dec_init;
+	while ((c = av_codec_next(c))) {
+		if (c->type == AVMEDIA_TYPE_VIDEO)
+			init_factory(&factories[n_factories++], c);
 	}
-	f.name = name;
-	f.info = NULL;
-	f.enum_interface_info = ffmpeg_enum_interface_info;
+}
+
+int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t index)
+{
+	if (factory == NULL)
+		return SPA_RESULT_INVALID_ARGUMENTS;
+
+	pthread_once(&factories_once, init_factories);
+
+	if (index >= n_factories)
+		return SPA_RESULT_ENUM_END;
 
-	*factory = &f;
+	*factory = &factories[index].factory;
 
 	return SPA_RESULT_OK;
 }
@@ -0,0 +1,171 @@
+/* Spa FFMpeg support
+ * Copyright (C) 2016 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_FFMPEG_H__
+#define __SPA_FFMPEG_H__
+
+#include <stddef.h>
+
+#include <spa/plugin.h>
+#include <spa/props.h>
+#include <spa/format-utils.h>
+#include <spa/video/format-utils.h>
+
+#include <libavcodec/avcodec.h>
+
+size_t spa_ffmpeg_dec_get_size(void);
+int spa_ffmpeg_dec_init(struct spa_handle *handle, const AVCodec *codec,
+			const struct spa_dict *info,
+			const struct spa_support *support, uint32_t n_support);
+
+size_t spa_ffmpeg_enc_get_size(void);
+int spa_ffmpeg_enc_init(struct spa_handle *handle, const AVCodec *codec,
+			const struct spa_dict *info,
+			const struct spa_support *support, uint32_t n_support);
+
+#define SPA_FFMPEG_THREAD_TYPE_AUTO	SPA_TYPE_PROPS__threadType ":auto"
+#define SPA_FFMPEG_THREAD_TYPE_FRAME	SPA_TYPE_PROPS__threadType ":frame"
+#define SPA_FFMPEG_THREAD_TYPE_SLICE	SPA_TYPE_PROPS__threadType ":slice"
+
+struct spa_ffmpeg_type_thread {
+	uint32_t threads;
+	uint32_t thread_type;
+	uint32_t type_auto;
+	uint32_t type_frame;
+	uint32_t type_slice;
+};
+
+static inline void
+spa_ffmpeg_type_thread_map(struct spa_type_map *map, struct spa_ffmpeg_type_thread *type)
+{
+	type->threads = spa_type_map_get_id(map, SPA_TYPE_PROPS__threads);
+	type->thread_type = spa_type_map_get_id(map, SPA_TYPE_PROPS__threadType);
+	type->type_auto = spa_type_map_get_id(map, SPA_FFMPEG_THREAD_TYPE_AUTO);
+	type->type_frame = spa_type_map_get_id(map, SPA_FFMPEG_THREAD_TYPE_FRAME);
+	type->type_slice = spa_type_map_get_id(map, SPA_FFMPEG_THREAD_TYPE_SLICE);
+}
+
+/* configure the threading of a codec context before it is opened. Frame
+ * threading adds threads - 1 frames of latency, slice threading needs
+ * support from the bitstream; auto lets the codec pick what it can do. */
+static inline void
+spa_ffmpeg_setup_threads(AVCodecContext *context, const struct spa_ffmpeg_type_thread *type,
+			 int threads, uint32_t thread_type)
+{
+	context->thread_count = threads;
+
+	if (thread_type == type->type_frame)
+		context->thread_type = FF_THREAD_FRAME;
+	else if (thread_type == type->type_slice)
+		context->thread_type = FF_THREAD_SLICE;
+	else
+		context->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+}
+
+#define VIDEO_FORMAT(n)		offsetof(struct spa_type_video_format, n)
+
+static const struct {
+	size_t format;
+	enum AVPixelFormat pix_fmt;
+} spa_ffmpeg_format_map[] = {
+	{ VIDEO_FORMAT(I420), AV_PIX_FMT_YUV420P },
+	{ VIDEO_FORMAT(Y42B), AV_PIX_FMT_YUV422P },
+	{ VIDEO_FORMAT(Y444), AV_PIX_FMT_YUV444P },
+	{ VIDEO_FORMAT(Y41B), AV_PIX_FMT_YUV411P },
+	{ VIDEO_FORMAT(YUY2), AV_PIX_FMT_YUYV422 },
+	{ VIDEO_FORMAT(UYVY), AV_PIX_FMT_UYVY422 },
+	{ VIDEO_FORMAT(NV12), AV_PIX_FMT_NV12 },
+	{ VIDEO_FORMAT(NV21), AV_PIX_FMT_NV21 },
+	{ VIDEO_FORMAT(RGB), AV_PIX_FMT_RGB24 },
+	{ VIDEO_FORMAT(BGR), AV_PIX_FMT_BGR24 },
+	{ VIDEO_FORMAT(RGBx), AV_PIX_FMT_RGB0 },
+	{ VIDEO_FORMAT(BGRx), AV_PIX_FMT_BGR0 },
+	{ VIDEO_FORMAT(xRGB), AV_PIX_FMT_0RGB },
+	{ VIDEO_FORMAT(xBGR), AV_PIX_FMT_0BGR },
+	{ VIDEO_FORMAT(RGBA), AV_PIX_FMT_RGBA },
+	{ VIDEO_FORMAT(BGRA), AV_PIX_FMT_BGRA },
+	{ VIDEO_FORMAT(ARGB), AV_PIX_FMT_ARGB },
+	{ VIDEO_FORMAT(ABGR), AV_PIX_FMT_ABGR },
+	{ VIDEO_FORMAT(GRAY8), AV_PIX_FMT_GRAY8 },
+};
+
+#undef VIDEO_FORMAT
+
+static inline enum AVPixelFormat
+spa_ffmpeg_pix_fmt(struct spa_type_video_format *type, uint32_t format)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(spa_ffmpeg_format_map); i++) {
+		if (*SPA_MEMBER(type, spa_ffmpeg_format_map[i].format, uint32_t) == format)
+			return spa_ffmpeg_format_map[i].pix_fmt;
+	}
+	return AV_PIX_FMT_NONE;
+}
+
+static inline uint32_t
+spa_ffmpeg_video_format(struct spa_type_video_format *type, enum AVPixelFormat pix_fmt)
+{
+	uint32_t i;
+
+	/* the full range variants only differ in the color range */
+	if (pix_fmt == AV_PIX_FMT_YUVJ420P)
+		pix_fmt = AV_PIX_FMT_YUV420P;
+	else if (pix_fmt == AV_PIX_FMT_YUVJ422P)
+		pix_fmt = AV_PIX_FMT_YUV422P;
+	else if (pix_fmt == AV_PIX_FMT_YUVJ444P)
+		pix_fmt = AV_PIX_FMT_YUV444P;
+
+	for (i = 0; i < SPA_N_ELEMENTS(spa_ffmpeg_format_map); i++) {
+		if (spa_ffmpeg_format_map[i].pix_fmt == pix_fmt)
+			return *SPA_MEMBER(type, spa_ffmpeg_format_map[i].format, uint32_t);
+	}
+	return type->UNKNOWN;
+}
+
+static inline uint32_t
+spa_ffmpeg_media_subtype(struct spa_type_media_subtype_video *type, enum AVCodecID codec_id)
+{
+	switch (codec_id) {
+	case AV_CODEC_ID_H264:
+		return type->h264;
+	case AV_CODEC_ID_MJPEG:
+		return type->mjpg;
+	case AV_CODEC_ID_DVVIDEO:
+		return type->dv;
+	case AV_CODEC_ID_H263:
+		return type->h263;
+	case AV_CODEC_ID_MPEG1VIDEO:
+		return type->mpeg1;
+	case AV_CODEC_ID_MPEG2VIDEO:
+		return type->mpeg2;
+	case AV_CODEC_ID_MPEG4:
+		return type->mpeg4;
+	case AV_CODEC_ID_VC1:
+		return type->vc1;
+	case AV_CODEC_ID_VP8:
+		return type->vp8;
+	case AV_CODEC_ID_VP9:
+		return type->vp9;
+	default:
+		return SPA_ID_INVALID;
+	}
+}
+
+#endif /* __SPA_FFMPEG_H__ */
@@ -18,10 +18,16 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
 #include <sys/eventfd.h>
 
 #include <spa/type-map.h>
@@ -40,6 +46,14 @@
 
 #define TRACE_BUFFER (16*1024)
 
+/* binary mode: every thread that logs gets its own ring to which it only
+ * copies the format pointer and the raw arguments */
+#define MAX_THREADS	16
+#define THREAD_BUFFER	(32*1024)
+#define MAX_RECORD	1024
+#define MAX_ARGS	32
+#define MAX_STRING	128
+
 struct type {
 	uint32_t log;
 };
@@ -61,8 +75,415 @@ struct impl {
 
 	bool have_source;
 	struct spa_source source;
+
+	bool binary;
+	uint32_t n_rings;
+	struct ring {
+		struct spa_ringbuffer rb;
+		uint32_t dropped;
+		uint8_t data[THREAD_BUFFER];
+	} rings[MAX_THREADS];
+	/* set by the reader when it found all rings empty and waits for
+	 * a wakeup, the first writer after that signals event_fd */
+	uint32_t sleeping;
+
+	bool have_thread;
+	bool running;
+	int event_fd;
+	pthread_t thread;
+};
+
+/* a deferred message, followed by n_args arguments and the copied strings */
+struct record {
+	uint32_t size;
+	uint32_t level;
+	uint32_t line;
+	uint32_t n_args;
+	uint64_t time;
+	const char *file;
+	const char *func;
+	const char *fmt;
+};
+
+union arg {
+	int64_t i;
+	double d;
+	const void *p;
+	uint32_t str;		/* offset of the string in the record */
 };
 
+enum arg_type {
+	ARG_NONE,
+	ARG_INT,
+	ARG_DOUBLE,
+	ARG_LONG_DOUBLE,
+	ARG_STRING,
+	ARG_POINTER,
+};
+
+struct spec {
+	char text[32];		/* the conversion specification, '*' resolved */
+	int len;
+	int n_star;		/* number of '*' width and precision arguments */
+	char length;		/* 'H' for hh, 'h', 'l', 'q' for ll, 'z', 'j', 't', 'L' or 0 */
+	enum arg_type type;
+};
+
+/* parse the conversion specification after the '%' at *fmt */
+static bool parse_spec(const char **fmt, struct spec *spec)
+{
+	const char *f = *fmt + 1;
+
+	spec->n_star = 0;
+	spec->length = 0;
+
+	while (*f && strchr("-+ #0'", *f))
+		f++;
+	if (*f == '*') {
+		spec->n_star++;
+		f++;
+	} else {
+		while (*f >= '0' && *f <= '9')
+			f++;
+	}
+	if (*f == '.') {
+		f++;
+		if (*f == '*') {
+			spec->n_star++;
+			f++;
+		} else {
+			while (*f >= '0' && *f <= '9')
+				f++;
+		}
+	}
+	switch (*f) {
+	case 'h':
+		spec->length = f[1] == 'h' ? 'H' : 'h';
+		f += f[1] == 'h' ? 2 : 1;
+		break;
+	case 'l':
+		spec->length = f[1] == 'l' ? 'q' : 'l';
+		f += f[1] == 'l' ? 2 : 1;
+		break;
+	case 'q': case 'z': case 'j': case 't': case 'L':
+		spec->length = *f == 'q' ? 'q' : *f;
+		f++;
+		break;
+	}
+	switch (*f) {
+	case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+		spec->type = ARG_INT;
+		break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		spec->type = spec->length == 'L' ? ARG_LONG_DOUBLE : ARG_DOUBLE;
+		break;
+	case 's':
+		spec->type = ARG_STRING;
+		break;
+	case 'p':
+		spec->type = ARG_POINTER;
+		break;
+	case '%':
+		spec->type = ARG_NONE;
+		break;
+	default:
+		return false;
+	}
+	f++;
+
+	spec->len = f - *fmt;
+	if (spec->len >= (int) sizeof(spec->text))
+		return false;
+	memcpy(spec->text, *fmt, spec->len);
+	spec->text[spec->len] = '\0';
+	*fmt = f;
+	return true;
+}
+
+static int64_t get_int_arg(char length, va_list *args)
+{
+	switch (length) {
+	case 'l':
+		return va_arg(*args, long);
+	case 'q':
+		return va_arg(*args, long long);
+	case 'z':
+		return va_arg(*args, size_t);
+	case 'j':
+		return va_arg(*args, intmax_t);
+	case 't':
+		return va_arg(*args, ptrdiff_t);
+	default:
+		return va_arg(*args, int);
+	}
+}
+
+static int print_int_arg(char *buf, size_t size, const char *spec, char length, int64_t v)
+{
+	switch (length) {
+	case 'l':
+		return snprintf(buf, size, spec, (long) v);
+	case 'q':
+		return snprintf(buf, size, spec, (long long) v);
+	case 'z':
+		return snprintf(buf, size, spec, (size_t) v);
+	case 'j':
+		return snprintf(buf, size, spec, (intmax_t) v);
+	case 't':
+		return snprintf(buf, size, spec, (ptrdiff_t) v);
+	default:
+		return snprintf(buf, size, spec, (int) v);
+	}
+}
+
+static struct ring *get_ring(struct impl *impl)
+{
+	static __thread struct impl *thread_impl;
+	static __thread struct ring *thread_ring;
+	uint32_t index;
+
+	if (SPA_LIKELY(thread_impl == impl))
+		return thread_ring;
+
+	index = __atomic_fetch_add(&impl->n_rings, 1, __ATOMIC_SEQ_CST);
+	thread_impl = impl;
+	thread_ring = index < MAX_THREADS ? &impl->rings[index] : NULL;
+
+	return thread_ring;
+}
+
+/* Copy the message into the ring of the calling thread without formatting
+ * it. Only the arguments of %s are copied, all other arguments are stored
+ * as they are. Returns false when the message could not be deferred. */
+static bool
+log_binary(struct impl *impl,
+	   enum spa_log_level level,
+	   const char *file,
+	   int line,
+	   const char *func,
+	   const char *fmt,
+	   va_list va)
+{
+	uint8_t buffer[MAX_RECORD] __attribute__ ((aligned (8)));
+	struct record *rec = (struct record *) buffer;
+	union arg *args = SPA_MEMBER(rec, sizeof(struct record), union arg);
+	struct ring *ring;
+	struct timespec ts;
+	struct spec spec;
+	const char *f;
+	uint32_t n_args = 0, str_offs, index;
+	int32_t filled;
+	va_list ap;
+
+	if ((ring = get_ring(impl)) == NULL)
+		return false;
+
+	va_copy(ap, va);
+
+	/* count the arguments to know where the strings start */
+	for (f = fmt; (f = strchr(f, '%')); ) {
+		if (!parse_spec(&f, &spec))
+			goto fallback;
+		n_args += spec.n_star + (spec.type != ARG_NONE ? 1 : 0);
+	}
+	if (n_args > MAX_ARGS)
+		goto fallback;
+
+	str_offs = sizeof(struct record) + n_args * sizeof(union arg);
+	n_args = 0;
+
+	for (f = fmt; (f = strchr(f, '%')); ) {
+		int i;
+
+		parse_spec(&f, &spec);
+		for (i = 0; i < spec.n_star; i++)
+			args[n_args++].i = va_arg(ap, int);
+
+		switch (spec.type) {
+		case ARG_NONE:
+			break;
+		case ARG_INT:
+			args[n_args++].i = get_int_arg(spec.length, &ap);
+			break;
+		case ARG_DOUBLE:
+			args[n_args++].d = va_arg(ap, double);
+			break;
+		case ARG_LONG_DOUBLE:
+			args[n_args++].d = va_arg(ap, long double);
+			break;
+		case ARG_POINTER:
+			args[n_args++].p = va_arg(ap, void *);
+			break;
+		case ARG_STRING:
+		{
+			const char *str = va_arg(ap, const char *);
+			size_t len;
+
+			if (str == NULL)
+				str = "(null)";
+			len = strnlen(str, MAX_STRING - 1);
+			if (str_offs + len + 1 > sizeof(buffer))
+				goto fallback;
+			memcpy(buffer + str_offs, str, len);
+			buffer[str_offs + len] = '\0';
+			args[n_args++].str = str_offs;
+			str_offs += len + 1;
+			break;
+		}
+		}
+	}
+	va_end(ap);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	rec->size = SPA_ROUND_UP_N(str_offs, 8);
+	rec->level = level;
+	rec->line = line;
+	rec->n_args = n_args;
+	rec->time = ts.tv_sec * SPA_NSEC_PER_SEC + ts.tv_nsec;
+	rec->file = file;
+	rec->func = func;
+	rec->fmt = fmt;
+
+	filled = spa_ringbuffer_get_write_index(&ring->rb, &index);
+	if (filled + rec->size > ring->rb.size) {
+		__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+		return true;
+	}
+	spa_ringbuffer_write_data(&ring->rb, ring->data, index & ring->rb.mask, rec, rec->size);
+	spa_ringbuffer_write_update(&ring->rb, index + rec->size);
+
+	/* the reader drains all rings on a wakeup, only wake it when it
+	 * went to sleep. The fence orders the write index before the flag,
+	 * the reader does the opposite so one of both sees the other. */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_exchange_n(&impl->sleeping, 0, __ATOMIC_SEQ_CST)) {
+		uint64_t count = 1;
+		if (write(impl->event_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+			fprintf(stderr, "error signaling eventfd: %s\n", strerror(errno));
+	}
+	return true;
+
+      fallback:
+	va_end(ap);
+	return false;
+}
+
+static void print_record(struct impl *impl, struct record *rec)
+{
+	static const char *levels[] = { "-", "E", "W", "I", "D", "T", "*T*" };
+	union arg *args = SPA_MEMBER(rec, sizeof(struct record), union arg);
+	char text[512], spec_text[64];
+	const char *f = rec->fmt, *p;
+	struct spec spec;
+	uint32_t n_args = 0;
+	size_t len = 0;
+
+	while ((p = strchr(f, '%')) && len < sizeof(text) - 1) {
+		int i, n, star[2] = { 0, 0 };
+		char *s, *d;
+
+		n = SPA_MIN((size_t) (p - f), sizeof(text) - 1 - len);
+		memcpy(text + len, f, n);
+		len += n;
+
+		f = p;
+		if (!parse_spec(&f, &spec))
+			break;
+
+		/* print the '*' values into the specification */
+		for (i = 0; i < spec.n_star && n_args < rec->n_args; i++)
+			star[i] = args[n_args++].i;
+		for (i = 0, s = spec.text, d = spec_text; *s; s++) {
+			if (*s == '*' && i < spec.n_star)
+				d += sprintf(d, "%d", star[i++]);
+			else if (*s != 'L' || spec.type != ARG_LONG_DOUBLE)
+				*d++ = *s;
+		}
+		*d = '\0';
+
+		if (spec.type != ARG_NONE && n_args >= rec->n_args)
+			break;
+
+		switch (spec.type) {
+		case ARG_NONE:
+			n = snprintf(text + len, sizeof(text) - len, "%%");
+			break;
+		case ARG_INT:
+			n = print_int_arg(text + len, sizeof(text) - len,
+					  spec_text, spec.length, args[n_args++].i);
+			break;
+		case ARG_DOUBLE:
+		case ARG_LONG_DOUBLE:
+			n = snprintf(text + len, sizeof(text) - len, spec_text, args[n_args++].d);
+			break;
+		case ARG_POINTER:
+			n = snprintf(text + len, sizeof(text) - len, spec_text, args[n_args++].p);
+			break;
+		case ARG_STRING:
+			n = snprintf(text + len, sizeof(text) - len, spec_text,
+				     SPA_MEMBER(rec, args[n_args++].str, const char));
+			break;
+		}
+		len = SPA_MIN(len + SPA_MAX(n, 0), sizeof(text) - 1);
+	}
+	if (len < sizeof(text) - 1)
+		len += snprintf(text + len, sizeof(text) - len, "%s", f);
+	text[SPA_MIN(len, sizeof(text) - 1)] = '\0';
+
+	fprintf(stderr, "[%s][%" PRIu64 ".%06" PRIu64 "][%s:%i %s()] %s\n",
+		levels[SPA_MIN(rec->level + 1, SPA_N_ELEMENTS(levels) - 1)],
+		(uint64_t) (rec->time / SPA_NSEC_PER_SEC),
+		(uint64_t) ((rec->time % SPA_NSEC_PER_SEC) / 1000),
+		strrchr(rec->file, '/') ? strrchr(rec->file, '/') + 1 : rec->file,
+		rec->line, rec->func, text);
+}
+
+static bool rings_empty(struct impl *impl)
+{
+	uint32_t i, index, n_rings = SPA_MIN(__atomic_load_n(&impl->n_rings, __ATOMIC_SEQ_CST), MAX_THREADS);
+
+	for (i = 0; i < n_rings; i++) {
+		if (spa_ringbuffer_get_read_index(&impl->rings[i].rb, &index) > 0)
+			return false;
+	}
+	return true;
+}
+
+static void drain_rings(struct impl *impl)
+{
+	uint32_t i, n_rings = SPA_MIN(__atomic_load_n(&impl->n_rings, __ATOMIC_SEQ_CST), MAX_THREADS);
+
+	for (i = 0; i < n_rings; i++) {
+		struct ring *ring = &impl->rings[i];
+		uint8_t buffer[MAX_RECORD] __attribute__ ((aligned (8)));
+		struct record *rec = (struct record *) buffer;
+		uint32_t index, dropped;
+		int32_t avail;
+
+		while ((avail = spa_ringbuffer_get_read_index(&ring->rb, &index)) > 0) {
+			spa_ringbuffer_read_data(&ring->rb, ring->data, index & ring->rb.mask,
+						 rec, sizeof(struct record));
+			spa_ringbuffer_read_data(&ring->rb, ring->data, index & ring->rb.mask,
+						 rec, SPA_MIN(rec->size, sizeof(buffer)));
+			print_record(impl, rec);
+			spa_ringbuffer_read_update(&ring->rb, index + rec->size);
+		}
+		if ((dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED)) > 0)
+			fprintf(stderr, "[W][logger] %u messages dropped\n", dropped);
+	}
+}
+
+/* drain the rings until they are empty after telling the writers to
+ * wake us up, a record written in between is never left behind */
+static void flush_rings(struct impl *impl)
+{
+	do {
+		drain_rings(impl);
+		__atomic_store_n(&impl->sleeping, 1, __ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	} while (!rings_empty(impl) && __atomic_exchange_n(&impl->sleeping, 0, __ATOMIC_SEQ_CST));
+}
+
 static void
 impl_log_logv(struct spa_log *log,
 	      enum spa_log_level level,
@@ -78,6 +499,10 @@ impl_log_logv(struct spa_log *log,
 	int size;
 	bool do_trace;
 
+	if (level == SPA_LOG_LEVEL_TRACE && impl->binary &&
+	    log_binary(impl, level, file, line, func, fmt, args))
+		return;
+
 	if ((do_trace = (level == SPA_LOG_LEVEL_TRACE && impl->have_source)))
 		level++;
 
@@ -125,6 +550,9 @@ static void on_trace_event(struct spa_source *source)
 	if (read(source->fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
 		fprintf(stderr, "failed to read event fd: %s", strerror(errno));
 
+	if (impl->binary)
+		flush_rings(impl);
+
 	while ((avail = spa_ringbuffer_get_read_index(&impl->trace_rb, &index)) > 0) {
 		uint32_t offset, first;
 
@@ -143,6 +571,24 @@ static void on_trace_event(struct spa_source *source)
         }
 }
 
+/* without a main loop the rings are written out from a thread of their own */
+static void *flush_thread(void *data)
+{
+	struct impl *impl = data;
+	struct pollfd pfd = { impl->event_fd, POLLIN, 0 };
+	uint64_t count;
+
+	while (impl->running) {
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+			break;
+		if (read(impl->event_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t) &&
+		    errno != EAGAIN)
+			fprintf(stderr, "failed to read event fd: %s", strerror(errno));
+		flush_rings(impl);
+	}
+	return NULL;
+}
+
 static const struct spa_log impl_log = {
 	SPA_VERSION_LOG,
 	NULL,
@@ -176,6 +622,16 @@ static int impl_clear(struct spa_handle *handle)
 
 	this = (struct impl *) handle;
 
+	if (this->have_thread) {
+		uint64_t count = 1;
+
+		this->running = false;
+		if (write(this->event_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+			fprintf(stderr, "error signaling eventfd: %s\n", strerror(errno));
+		pthread_join(this->thread, NULL);
+		close(this->event_fd);
+		this->have_thread = false;
+	}
 	if (this->have_source) {
 		spa_loop_remove_source(this->source.loop, &this->source);
 		close(this->source.fd);
@@ -194,6 +650,7 @@ impl_init(const struct spa_handle_factory *factory,
 	struct impl *this;
 	uint32_t i;
 	struct spa_loop *loop = NULL;
+	const char *str;
 
 	spa_return_val_if_fail(factory != NULL, SPA_RESULT_INVALID_ARGUMENTS);
 	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
@@ -217,6 +674,9 @@ impl_init(const struct spa_handle_factory *factory,
 	}
 	init_type(&this->type, this->map);
 
+	if (info && (str = spa_dict_lookup(info, "log.binary")))
+		this->binary = (strcmp(str, "true") == 0 || atoi(str) == 1);
+
 	if (loop) {
 		this->source.func = on_trace_event;
 		this->source.data = this;
@@ -225,10 +685,28 @@ impl_init(const struct spa_handle_factory *factory,
 		this->source.rmask = 0;
 		spa_loop_add_source(loop, &this->source);
 		this->have_source = true;
+		this->event_fd = this->source.fd;
 	}
 
 	spa_ringbuffer_init(&this->trace_rb, TRACE_BUFFER);
 
+	if (this->binary) {
+		for (i = 0; i < MAX_THREADS; i++)
+			spa_ringbuffer_init(&this->rings[i].rb, THREAD_BUFFER);
+		this->sleeping = 1;
+
+		if (!this->have_source) {
+			this->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+			this->running = true;
+			if (pthread_create(&this->thread, NULL, flush_thread, this) == 0) {
+				this->have_thread = true;
+			} else {
+				close(this->event_fd);
+				this->binary = false;
+			}
+		}
+	}
+
 	spa_log_info(&this->log, NAME " %p: initialized", this);
 
 	return SPA_RESULT_OK;
@@ -39,6 +39,8 @@
 
 #define DATAS_SIZE (4096 * 8)
 
+#define TIMERS_EXTEND	16
+
 /** \cond */
 
 struct invoke_item {
@@ -89,6 +91,14 @@ struct impl {
 
 	struct spa_ringbuffer buffer;
 	uint8_t buffer_data[DATAS_SIZE];
+
+	/* all timer sources share one timerfd, armed with the earliest
+	 * expiration found in a binary min-heap of the armed timers */
+	struct spa_source *timer;
+	struct source_impl **timers;
+	uint32_t n_timers;
+	uint32_t max_timers;
+	uint64_t timer_next;
 };
 
 struct source_impl {
@@ -107,6 +117,10 @@ struct source_impl {
 	} func;
 	int signal_number;
 	bool enabled;
+
+	uint64_t expire;
+	uint64_t interval;
+	uint32_t heap_index;
 };
 /** \endcond */
 
@@ -496,16 +510,146 @@ static void loop_signal_event(struct spa_source *source)
 				source, source->fd, strerror(errno));
 }
 
-static void source_timer_func(struct spa_source *source)
+static inline uint64_t get_monotonic_time(void)
 {
-	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
-	uint64_t expires;
+	struct timespec now;
 
-	if (read(source->fd, &expires, sizeof(uint64_t)) != sizeof(uint64_t))
-		spa_log_warn(impl->impl->log, NAME " %p: failed to read timer fd %d: %s",
-				source, source->fd, strerror(errno));
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
+
+static inline void timers_set(struct impl *impl, uint32_t index, struct source_impl *s)
+{
+	impl->timers[index] = s;
+	s->heap_index = index;
+}
+
+static void timers_sift_up(struct impl *impl, uint32_t index)
+{
+	struct source_impl *s = impl->timers[index];
+
+	while (index > 0) {
+		uint32_t parent = (index - 1) / 2;
+		if (impl->timers[parent]->expire <= s->expire)
+			break;
+		timers_set(impl, index, impl->timers[parent]);
+		index = parent;
+	}
+	timers_set(impl, index, s);
+}
+
+static void timers_sift_down(struct impl *impl, uint32_t index)
+{
+	struct source_impl *s = impl->timers[index];
+
+	while (true) {
+		uint32_t child = index * 2 + 1;
+
+		if (child >= impl->n_timers)
+			break;
+		if (child + 1 < impl->n_timers &&
+		    impl->timers[child + 1]->expire < impl->timers[child]->expire)
+			child++;
+		if (s->expire <= impl->timers[child]->expire)
+			break;
+		timers_set(impl, index, impl->timers[child]);
+		index = child;
+	}
+	timers_set(impl, index, s);
+}
+
+static int timers_insert(struct impl *impl, struct source_impl *s)
+{
+	if (impl->n_timers == impl->max_timers) {
+		uint32_t max = impl->max_timers + TIMERS_EXTEND;
+		struct source_impl **timers;
+
+		timers = realloc(impl->timers, max * sizeof(struct source_impl *));
+		if (timers == NULL)
+			return SPA_RESULT_NO_MEMORY;
+		impl->timers = timers;
+		impl->max_timers = max;
+	}
+	timers_set(impl, impl->n_timers++, s);
+	timers_sift_up(impl, s->heap_index);
+	return SPA_RESULT_OK;
+}
+
+static bool timers_remove(struct impl *impl, struct source_impl *s)
+{
+	uint32_t index = s->heap_index;
+	struct source_impl *last;
+
+	if (index >= impl->n_timers || impl->timers[index] != s)
+		return false;
+
+	s->heap_index = SPA_ID_INVALID;
+	last = impl->timers[--impl->n_timers];
+	if (last == s)
+		return true;
+
+	timers_set(impl, index, last);
+	if (index > 0 && impl->timers[(index - 1) / 2]->expire > last->expire)
+		timers_sift_up(impl, index);
+	else
+		timers_sift_down(impl, index);
 
-	impl->func.timer(&impl->impl->utils, source, source->data);
+	return true;
+}
+
+/* program the shared timerfd with the earliest expiration, only touching
+ * the fd when the head of the heap changed */
+static int timers_rearm(struct impl *impl)
+{
+	struct itimerspec its;
+	uint64_t next;
+
+	next = impl->n_timers > 0 ? impl->timers[0]->expire : 0;
+	if (next == impl->timer_next)
+		return SPA_RESULT_OK;
+
+	spa_zero(its);
+	its.it_value.tv_sec = next / SPA_NSEC_PER_SEC;
+	its.it_value.tv_nsec = next % SPA_NSEC_PER_SEC;
+
+	if (timerfd_settime(impl->timer->fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+		return SPA_RESULT_ERRNO;
+
+	impl->timer_next = next;
+	return SPA_RESULT_OK;
+}
+
+static void timers_dispatch(struct spa_loop_utils *utils, struct spa_source *source,
+			    int fd, enum spa_io mask, void *data)
+{
+	struct impl *impl = data;
+	uint64_t expires, now;
+
+	if (read(fd, &expires, sizeof(uint64_t)) != sizeof(uint64_t) && errno != EAGAIN)
+		spa_log_warn(impl->log, NAME " %p: failed to read timer fd %d: %s",
+				impl, fd, strerror(errno));
+
+	/* the timerfd is disarmed now */
+	impl->timer_next = 0;
+	now = get_monotonic_time();
+
+	/* callbacks can update or destroy any timer, including the one being
+	 * dispatched, so always restart from the head of the heap */
+	while (impl->n_timers > 0 && impl->timers[0]->expire <= now) {
+		struct source_impl *s = impl->timers[0];
+
+		if (s->interval > 0) {
+			/* skip missed periods, like the timerfd would */
+			s->expire += s->interval;
+			if (s->expire <= now)
+				s->expire = now + s->interval - (now - s->expire) % s->interval;
+			timers_sift_down(impl, 0);
+		} else {
+			timers_remove(impl, s);
+		}
+		s->func.timer(&impl->utils, &s->source, s->source.data);
+	}
+	timers_rearm(impl);
 }
 
 static struct spa_source *loop_add_timer(struct spa_loop_utils *utils,
@@ -519,15 +663,13 @@ static struct spa_source *loop_add_timer(struct spa_loop_utils *utils,
 		return NULL;
 
 	source->source.loop = &impl->loop;
-	source->source.func = source_timer_func;
+	source->source.func = NULL;
 	source->source.data = data;
-	source->source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-	source->source.mask = SPA_IO_IN;
+	source->source.fd = -1;
 	source->impl = impl;
-	source->close = true;
+	source->close = false;
 	source->func.timer = func;
-
-	spa_loop_add_source(&impl->loop, &source->source);
+	source->heap_index = SPA_ID_INVALID;
 
 	spa_list_insert(&impl->source_list, &source->link);
 
@@ -538,25 +680,32 @@ static int
 loop_update_timer(struct spa_source *source,
 		  struct timespec *value, struct timespec *interval, bool absolute)
 {
-	struct itimerspec its;
-	int flags = 0;
+	struct source_impl *s = SPA_CONTAINER_OF(source, struct source_impl, source);
+	struct impl *impl = s->impl;
+	uint64_t expire = 0;
+	int res;
 
-	spa_zero(its);
 	if (value) {
-		its.it_value = *value;
+		expire = SPA_TIMESPEC_TO_TIME(value);
 	} else if (interval) {
-		its.it_value = *interval;
+		expire = SPA_TIMESPEC_TO_TIME(interval);
 		absolute = true;
 	}
-	if (interval)
-		its.it_interval = *interval;
-	if (absolute)
-		flags |= TFD_TIMER_ABSTIME;
+	s->interval = interval ? SPA_TIMESPEC_TO_TIME(interval) : 0;
 
-	if (timerfd_settime(source->fd, flags, &its, NULL) < 0)
-		return SPA_RESULT_ERRNO;
+	timers_remove(impl, s);
 
-	return SPA_RESULT_OK;
+	/* a zero value disarms the timer */
+	if (expire > 0) {
+		if (!absolute)
+			expire += get_monotonic_time();
+		/* 0 is reserved for a disarmed timerfd */
+		s->expire = SPA_MAX(expire, 1);
+
+		if ((res = timers_insert(impl, s)) < 0)
+			return res;
+	}
+	return timers_rearm(impl);
 }
 
 static void source_signal_func(struct spa_source *source)
@@ -610,6 +759,9 @@ static void loop_destroy_source(struct spa_source *source)
 
 	spa_list_remove(&impl->link);
 
+	if (timers_remove(loop_impl, impl))
+		timers_rearm(loop_impl);
+
 	spa_loop_remove_source(source->loop, source);
 
 	if (source->fd != -1 && impl->close) {
@@ -681,11 +833,14 @@ static int impl_clear(struct spa_handle *handle)
 
 	impl = (struct impl *) handle;
 
+	impl->n_timers = 0;
 	spa_list_for_each_safe(source, tmp, &impl->source_list, link)
 	    loop_destroy_source(&source->source);
 	spa_list_for_each_safe(source, tmp, &impl->destroy_list, link)
 	    free(source);
 
+	free(impl->timers);
+
 	close(impl->ack_fd);
 	close(impl->epoll_fd);
 
@@ -738,6 +893,11 @@ impl_init(const struct spa_handle_factory *factory,
 	impl->wakeup = spa_loop_utils_add_event(&impl->utils, wakeup_func, impl);
 	impl->ack_fd = eventfd(0, EFD_CLOEXEC);
 
+	impl->timer = spa_loop_utils_add_io(&impl->utils,
+					    timerfd_create(CLOCK_MONOTONIC,
+							   TFD_CLOEXEC | TFD_NONBLOCK),
+					    SPA_IO_IN, true, timers_dispatch, impl);
+
 	spa_log_info(impl->log, NAME " %p: initialized", impl);
 
 	return SPA_RESULT_OK;
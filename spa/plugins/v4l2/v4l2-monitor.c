@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 #include <libudev.h>
 
@@ -30,6 +31,7 @@
 #include <spa/loop.h>
 #include <spa/monitor.h>
 #include <lib/debug.h>
+#include <lib/probe.h>
 
 #define NAME "v4l2-monitor"
 
@@ -38,6 +40,7 @@ extern const struct spa_handle_factory spa_v4l2_source_factory;
 struct item {
 	struct spa_monitor_item *item;
 	struct udev_device *udevice;
+	uint8_t item_buffer[4096];
 };
 
 struct type {
@@ -68,11 +71,18 @@ struct impl {
 	struct udev_enumerate *enumerate;
 	uint32_t index;
 	struct udev_list_entry *devices;
-	uint8_t item_buffer[4096];
 
 	struct item uitem;
 
 	struct spa_source source;
+
+	uint32_t probe_threads;
+	struct spa_probe *probe;
+	pthread_mutex_t probe_lock;
+	bool probe_scanned;
+	char **probe_devices;
+	uint32_t n_probe_devices;
+	uint32_t probe_index;
 };
 
 static int impl_udev_open(struct impl *this)
@@ -110,7 +120,7 @@ static void fill_item(struct impl *this, struct item *item, struct udev_device *
 	if (!(name && *name))
 		name = "Unknown";
 
-	spa_pod_builder_init(&b, this->item_buffer, sizeof(this->item_buffer));
+	spa_pod_builder_init(&b, item->item_buffer, sizeof(item->item_buffer));
 
 	spa_pod_builder_push_object(&b, &f[0], 0, this->type.monitor.MonitorItem);
 
@@ -199,16 +209,26 @@ static void fill_item(struct impl *this, struct item *item, struct udev_device *
 	item->item = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_monitor_item);
 }
 
+static void emit_item(struct impl *this, uint32_t type, struct spa_monitor_item *item)
+{
+	struct spa_event *event;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[1];
+	uint8_t buffer[4096];
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_pod_builder_object(&b, &f[0], 0, type, SPA_POD_TYPE_POD, item);
+
+	event = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_event);
+	this->callbacks->event(this->callbacks_data, event);
+}
+
 static void impl_on_fd_events(struct spa_source *source)
 {
 	struct impl *this = source->data;
 	struct udev_device *dev;
-	struct spa_event *event;
 	const char *action;
 	uint32_t type;
-	struct spa_pod_builder b = { NULL, };
-	struct spa_pod_frame f[1];
-	uint8_t buffer[4096];
 
 	dev = udev_monitor_receive_device(this->umonitor);
 	fill_item(this, &this->uitem, dev);
@@ -227,11 +247,112 @@ static void impl_on_fd_events(struct spa_source *source)
 	} else
 		return;
 
-	spa_pod_builder_init(&b, buffer, sizeof(buffer));
-	spa_pod_builder_object(&b, &f[0], 0, type, SPA_POD_TYPE_POD, this->uitem.item);
+	emit_item(this, type, this->uitem.item);
+}
 
-	event = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_event);
-	this->callbacks->event(this->callbacks_data, event);
+/* called from the probe threads, the first thread scans the devices and
+ * all threads then take devices from the list until it is empty */
+static char *probe_next_device(struct impl *this, struct udev *udev)
+{
+	char *syspath = NULL;
+
+	pthread_mutex_lock(&this->probe_lock);
+	if (!this->probe_scanned) {
+		struct udev_enumerate *enumerate;
+		struct udev_list_entry *devices;
+
+		enumerate = udev_enumerate_new(udev);
+		udev_enumerate_add_match_subsystem(enumerate, "video4linux");
+		udev_enumerate_scan_devices(enumerate);
+
+		udev_list_entry_foreach(devices, udev_enumerate_get_list_entry(enumerate)) {
+			this->probe_devices = realloc(this->probe_devices,
+					(this->n_probe_devices + 1) * sizeof(char *));
+			this->probe_devices[this->n_probe_devices++] =
+					strdup(udev_list_entry_get_name(devices));
+		}
+		udev_enumerate_unref(enumerate);
+
+		this->probe_scanned = true;
+	}
+	if (this->probe_index < this->n_probe_devices)
+		syspath = this->probe_devices[this->probe_index++];
+	pthread_mutex_unlock(&this->probe_lock);
+
+	return syspath;
+}
+
+static void probe_work(struct spa_probe *probe, void *data)
+{
+	struct impl *this = data;
+	struct item *item;
+	struct udev *udev;
+	char *syspath;
+
+	/* udev contexts can't be shared between threads */
+	if ((udev = udev_new()) == NULL)
+		return;
+
+	item = calloc(1, sizeof(struct item));
+
+	while (item && !spa_probe_is_stopping(probe) &&
+	       (syspath = probe_next_device(this, udev)) != NULL) {
+		struct udev_device *dev;
+
+		if ((dev = udev_device_new_from_syspath(udev, syspath)) == NULL)
+			continue;
+
+		fill_item(this, item, dev);
+		spa_probe_post(probe, &item->item->object.pod);
+	}
+	if (item) {
+		fill_item(this, item, NULL);
+		free(item);
+	}
+	udev_unref(udev);
+}
+
+static void probe_result(void *data, const struct spa_pod *result)
+{
+	struct impl *this = data;
+
+	emit_item(this, this->type.monitor.Added, (struct spa_monitor_item *) result);
+}
+
+static void probe_stop(struct impl *this)
+{
+	uint32_t i;
+
+	if (this->probe == NULL)
+		return;
+
+	spa_probe_destroy(this->probe);
+	this->probe = NULL;
+
+	for (i = 0; i < this->n_probe_devices; i++)
+		free(this->probe_devices[i]);
+	free(this->probe_devices);
+	this->probe_devices = NULL;
+	this->n_probe_devices = 0;
+	this->probe_index = 0;
+	this->probe_scanned = false;
+}
+
+static int enum_items(struct impl *this, struct spa_monitor_item **item, uint32_t index);
+
+static void probe_start(struct impl *this)
+{
+	struct spa_monitor_item *item;
+	uint32_t index;
+
+	this->probe = spa_probe_new(this->main_loop, this->log, this->probe_threads,
+				    probe_work, probe_result, this);
+	if (this->probe != NULL)
+		return;
+
+	spa_log_warn(this->log, NAME " %p: can't start probe threads, probing now", this);
+	for (index = 0; enum_items(this, &item, index) == SPA_RESULT_OK; index++)
+		emit_item(this, this->type.monitor.Added, item);
 }
 
 static int
@@ -266,25 +387,22 @@ impl_monitor_set_callbacks(struct spa_monitor *monitor,
 		this->source.mask = SPA_IO_IN | SPA_IO_ERR;
 
 		spa_loop_add_source(this->main_loop, &this->source);
+
+		if (this->probe_threads > 0)
+			probe_start(this);
 	} else {
+		probe_stop(this);
 		spa_loop_remove_source(this->main_loop, &this->source);
 	}
 
 	return SPA_RESULT_OK;
 }
 
-static int
-impl_monitor_enum_items(struct spa_monitor *monitor, struct spa_monitor_item **item, uint32_t index)
+static int enum_items(struct impl *this, struct spa_monitor_item **item, uint32_t index)
 {
 	int res;
-	struct impl *this;
 	struct udev_device *dev;
 
-	spa_return_val_if_fail(monitor != NULL, SPA_RESULT_INVALID_ARGUMENTS);
-	spa_return_val_if_fail(item != NULL, SPA_RESULT_INVALID_ARGUMENTS);
-
-	this = SPA_CONTAINER_OF(monitor, struct impl, monitor);
-
 	if ((res = impl_udev_open(this)) < 0)
 		return res;
 
@@ -322,6 +440,24 @@ impl_monitor_enum_items(struct spa_monitor *monitor, struct spa_monitor_item **i
 	return SPA_RESULT_OK;
 }
 
+static int
+impl_monitor_enum_items(struct spa_monitor *monitor, struct spa_monitor_item **item, uint32_t index)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(monitor != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(item != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(monitor, struct impl, monitor);
+
+	/* with probe threads, the items are added asynchronously after
+	 * the callbacks are set */
+	if (this->probe_threads > 0)
+		return SPA_RESULT_ENUM_END;
+
+	return enum_items(this, item, index);
+}
+
 static const struct spa_monitor impl_monitor = {
 	SPA_VERSION_MONITOR,
 	NULL,
@@ -348,6 +484,16 @@ static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id,
 
 static int impl_clear(struct spa_handle *handle)
 {
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = (struct impl *) handle;
+
+	probe_stop(this);
+	fill_item(this, &this->uitem, NULL);
+	pthread_mutex_destroy(&this->probe_lock);
+
 	return SPA_RESULT_OK;
 }
 
@@ -387,6 +533,14 @@ impl_init(const struct spa_handle_factory *factory,
 
 	this->monitor = impl_monitor;
 
+	if (info) {
+		const char *str;
+
+		if ((str = spa_dict_lookup(info, "monitor.probe-threads")))
+			this->probe_threads = atoi(str);
+	}
+	pthread_mutex_init(&this->probe_lock, NULL);
+
 	return SPA_RESULT_OK;
 }
 
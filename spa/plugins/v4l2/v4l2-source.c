@@ -35,6 +35,8 @@
 #include <spa/format-builder.h>
 #include <lib/debug.h>
 #include <lib/props.h>
+#include <lib/format.h>
+#include <lib/format-cache.h>
 
 #define NAME "v4l2-source"
 
@@ -118,6 +120,10 @@ struct port {
 	struct v4l2_frmsizeenum frmsize;
 	struct v4l2_frmivalenum frmival;
 
+	struct spa_format_cache *format_cache;
+	bool cache_fill;
+	uint32_t cache_index;
+
 	bool have_format;
 	struct spa_video_info current_format;
 	uint8_t format_buffer[1024];
@@ -156,6 +162,7 @@ struct impl {
 
 	uint8_t props_buffer[512];
 	struct props props;
+	char cache_key[256];
 
 	const struct spa_node_callbacks *callbacks;
 	void *callbacks_data;
@@ -912,6 +919,15 @@ static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id,
 
 static int impl_clear(struct spa_handle *handle)
 {
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = (struct impl *) handle;
+
+	if (this->out_ports[0].format_cache)
+		spa_format_cache_free(this->out_ports[0].format_cache);
+
 	return SPA_RESULT_OK;
 }
 
@@ -969,6 +985,12 @@ impl_init(const struct spa_handle_factory *factory,
 	if (info && (str = spa_dict_lookup(info, "device.path"))) {
 		strncpy(this->props.device, str, 63);
 	}
+	if (info && ((str = spa_dict_lookup(info, "device.serial")) ||
+		     (str = spa_dict_lookup(info, "device.bus_path")))) {
+		const char *base = strrchr(this->props.device, '/');
+		snprintf(this->cache_key, sizeof(this->cache_key), "v4l2-%s-%s",
+			 str, base ? base + 1 : this->props.device);
+	}
 
 	return SPA_RESULT_OK;
 }
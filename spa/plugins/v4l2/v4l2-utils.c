@@ -521,10 +521,10 @@ filter_framerate(struct v4l2_frmivalenum *frmival,
 #define FOURCC_ARGS(f) (f)&0x7f,((f)>>8)&0x7f,((f)>>16)&0x7f,((f)>>24)&0x7f
 
 static int
-spa_v4l2_enum_format(struct impl *this,
-		     struct spa_format **format,
-		     const struct spa_format *filter,
-		     uint32_t index)
+enum_device_format(struct impl *this,
+		   struct spa_format **format,
+		   const struct spa_format *filter,
+		   uint32_t index)
 {
 	struct port *state = &this->out_ports[0];
 	int res, n_fractions;
@@ -788,6 +788,91 @@ spa_v4l2_enum_format(struct impl *this,
 	return SPA_RESULT_OK;
 }
 
+static int
+enum_cached_format(struct impl *this,
+		   struct spa_format **format,
+		   const struct spa_format *filter,
+		   uint32_t index)
+{
+	struct port *state = &this->out_ports[0];
+	const struct spa_format *cached;
+	struct spa_pod_builder b = { NULL, };
+
+	if (index == 0)
+		state->cache_index = 0;
+
+	while ((cached = spa_format_cache_get(state->format_cache, state->cache_index++))) {
+		spa_pod_builder_init(&b, state->format_buffer, sizeof(state->format_buffer));
+		if (spa_format_filter(cached, filter, &b) == SPA_RESULT_OK) {
+			*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
+			return SPA_RESULT_OK;
+		}
+	}
+	return SPA_RESULT_ENUM_END;
+}
+
+static struct spa_format_cache *make_format_cache(struct impl *this)
+{
+	struct port *state = &this->out_ports[0];
+	char stamp[256];
+
+	if (this->cache_key[0] == '\0')
+		return NULL;
+
+	/* the formats only change with the driver or the device */
+	snprintf(stamp, sizeof(stamp), "%s:%s:%s:%08x:%08x:%08x",
+		 state->cap.driver, state->cap.card, state->cap.bus_info,
+		 state->cap.version, state->cap.capabilities, state->cap.device_caps);
+
+	return spa_format_cache_new(this->map, this->log, this->cache_key, stamp);
+}
+
+static int
+spa_v4l2_enum_format(struct impl *this,
+		     struct spa_format **format,
+		     const struct spa_format *filter,
+		     uint32_t index)
+{
+	struct port *state = &this->out_ports[0];
+	int res;
+
+	if (spa_v4l2_open(this) < 0)
+		return SPA_RESULT_ERROR;
+
+	if (state->format_cache == NULL)
+		state->format_cache = make_format_cache(this);
+
+	if (state->format_cache == NULL)
+		return enum_device_format(this, format, filter, index);
+
+	if (spa_format_cache_is_valid(state->format_cache))
+		return enum_cached_format(this, format, filter, index);
+
+	/* fill the cache when all formats are enumerated in order without
+	 * a filter */
+	if (index == 0) {
+		spa_format_cache_reset(state->format_cache);
+		state->cache_fill = filter == NULL;
+		state->cache_index = 0;
+	} else if (filter != NULL || index != state->cache_index) {
+		state->cache_fill = false;
+	}
+
+	res = enum_device_format(this, format, filter, index);
+
+	if (state->cache_fill) {
+		if (res == SPA_RESULT_OK) {
+			spa_format_cache_add(state->format_cache, *format);
+			state->cache_index++;
+		} else {
+			if (res == SPA_RESULT_ENUM_END)
+				spa_format_cache_save(state->format_cache);
+			state->cache_fill = false;
+		}
+	}
+	return res;
+}
+
 static int spa_v4l2_set_format(struct impl *this, struct spa_video_info *format, bool try_only)
 {
 	struct port *state = &this->out_ports[0];
@@ -0,0 +1,104 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <math.h>
+
+#include <emmintrin.h>
+
+#include "video-ops.h"
+
+/* SSE2 versions of the per line kernels. Lines are not guaranteed to be
+ * aligned so unaligned loads and stores are used, the tail of each line
+ * is handled with the C version. */
+
+void matrix_line_sse(uint8_t *dst, const uint8_t *src, const float *m, uint32_t width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i amask = _mm_set1_epi32(0xff);
+	__m128 m0[4], m1[4], m2[4];
+	uint32_t x, i, unrolled = width & ~3;
+
+	for (i = 0; i < 4; i++) {
+		m0[i] = _mm_set1_ps(m[i]);
+		m1[i] = _mm_set1_ps(m[4 + i]);
+		m2[i] = _mm_set1_ps(m[8 + i]);
+	}
+
+	for (x = 0; x < unrolled; x += 4, src += 16, dst += 16) {
+		__m128i in, r0, r1, r2;
+		__m128 c0, c1, c2, v0, v1, v2;
+
+		/* 4 pixels of A C0 C1 C2, one pixel per 32 bit lane */
+		in = _mm_loadu_si128((const __m128i *) src);
+		c0 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(in, 8), amask));
+		c1 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(in, 16), amask));
+		c2 = _mm_cvtepi32_ps(_mm_srli_epi32(in, 24));
+
+		v0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0[0], c0), _mm_mul_ps(m0[1], c1)),
+				_mm_add_ps(_mm_mul_ps(m0[2], c2), m0[3]));
+		v1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1[0], c0), _mm_mul_ps(m1[1], c1)),
+				_mm_add_ps(_mm_mul_ps(m1[2], c2), m1[3]));
+		v2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2[0], c0), _mm_mul_ps(m2[1], c1)),
+				_mm_add_ps(_mm_mul_ps(m2[2], c2), m2[3]));
+
+		/* round, saturate to 0..255 with the 16 bit packs */
+		r0 = _mm_cvtps_epi32(v0);
+		r1 = _mm_cvtps_epi32(v1);
+		r2 = _mm_cvtps_epi32(v2);
+		r0 = _mm_packus_epi16(_mm_packs_epi32(r0, r0), zero);
+		r1 = _mm_packus_epi16(_mm_packs_epi32(r1, r1), zero);
+		r2 = _mm_packus_epi16(_mm_packs_epi32(r2, r2), zero);
+		/* back to one pixel per 32 bit lane */
+		r0 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(zero, r0), _mm_unpacklo_epi8(r1, r2));
+		r0 = _mm_or_si128(r0, _mm_and_si128(in, amask));
+		_mm_storeu_si128((__m128i *) dst, r0);
+	}
+	if (x < width)
+		matrix_line_c(dst, src, m, width - x);
+}
+
+void vblend_line_sse(uint8_t *dst, const uint8_t *src0, const uint8_t *src1,
+		     uint32_t weight, uint32_t n_bytes)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i w1 = _mm_set1_epi16(weight);
+	const __m128i w0 = _mm_set1_epi16(256 - weight);
+	const __m128i round = _mm_set1_epi16(128);
+	uint32_t i, unrolled = n_bytes & ~15;
+
+	for (i = 0; i < unrolled; i += 16) {
+		__m128i a, b, lo, hi;
+
+		a = _mm_loadu_si128((const __m128i *) &src0[i]);
+		b = _mm_loadu_si128((const __m128i *) &src1[i]);
+
+		/* (a * (256 - w) + b * w + 128) >> 8, the sum is at most
+		 * 255 * 256 + 128 and fits in an unsigned 16 bit lane */
+		lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0),
+				   _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1));
+		hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0),
+				   _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1));
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+
+		_mm_storeu_si128((__m128i *) &dst[i], _mm_packus_epi16(lo, hi));
+	}
+	if (i < n_bytes)
+		vblend_line_c(&dst[i], &src0[i], &src1[i], weight, n_bytes - i);
+}
@@ -0,0 +1,365 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "video-ops.h"
+
+static inline bool is_chroma(const struct format_info *info, int k)
+{
+	return info->yuv && k >= 2;
+}
+
+/* planar, semi-planar and packed formats without horizontally shared
+ * samples */
+static void
+unpack_generic(const struct format_info *info, const struct frame *f, uint32_t y, uint8_t *dst)
+{
+	uint32_t x, width = f->width;
+	int k;
+
+	for (k = 0; k < 4; k++) {
+		int p = info->plane[k];
+		const uint8_t *s;
+		uint32_t step, hsub;
+
+		if (p < 0) {
+			uint8_t v = (k == COMP_A) ? 0xff : is_chroma(info, k) ? 0x80 : 0x00;
+			for (x = 0; x < width; x++)
+				dst[4 * x + k] = v;
+			continue;
+		}
+
+		hsub = is_chroma(info, k) ? info->hsub : 0;
+		s = f->data[p] + (is_chroma(info, k) ? y >> info->vsub : y) * f->stride[p] +
+		    info->offset[k];
+		step = info->pstride[p];
+
+		if (hsub == 0) {
+			for (x = 0; x < width; x++, s += step)
+				dst[4 * x + k] = *s;
+		} else {
+			for (x = 0; x < width; x++)
+				dst[4 * x + k] = s[(x >> hsub) * step];
+		}
+	}
+}
+
+static void
+pack_generic(const struct format_info *info, struct frame *f, uint32_t y, const uint8_t *src)
+{
+	uint32_t x, width = f->width;
+	int k;
+
+	for (k = 0; k < 4; k++) {
+		int p = info->plane[k];
+		uint8_t *d;
+		uint32_t step;
+
+		if (p < 0)
+			continue;
+
+		step = info->pstride[p];
+
+		if (!is_chroma(info, k) || (info->hsub == 0 && info->vsub == 0)) {
+			d = f->data[p] + y * f->stride[p] + info->offset[k];
+			for (x = 0; x < width; x++, d += step)
+				*d = src[4 * x + k];
+		} else if ((y & ((1 << info->vsub) - 1)) == 0) {
+			/* average the pixels that share a chroma sample, the
+			 * rows in between are skipped */
+			uint32_t n = 1 << info->hsub;
+
+			d = f->data[p] + (y >> info->vsub) * f->stride[p] + info->offset[k];
+			for (x = 0; x < width; x += n, d += step) {
+				uint32_t i, sum = 0, cnt = SPA_MIN(n, width - x);
+				for (i = 0; i < cnt; i++)
+					sum += src[4 * (x + i) + k];
+				*d = (sum + cnt / 2) / cnt;
+			}
+		}
+	}
+}
+
+/* packed 4:2:2, two pixels in 4 bytes with the Y samples 2 bytes apart */
+static void
+unpack_422(const struct format_info *info, const struct frame *f, uint32_t y, uint8_t *dst)
+{
+	const uint8_t *s = f->data[0] + y * f->stride[0];
+	int oy = info->offset[1], ou = info->offset[2], ov = info->offset[3];
+	uint32_t x, width = f->width;
+
+	for (x = 0; x < width; x++, dst += 4) {
+		const uint8_t *m = s + (x >> 1) * 4;
+		dst[0] = 0xff;
+		dst[1] = m[oy + (x & 1) * 2];
+		dst[2] = m[ou];
+		dst[3] = m[ov];
+	}
+}
+
+static void
+pack_422(const struct format_info *info, struct frame *f, uint32_t y, const uint8_t *src)
+{
+	uint8_t *d = f->data[0] + y * f->stride[0];
+	int oy = info->offset[1], ou = info->offset[2], ov = info->offset[3];
+	uint32_t x, width = f->width;
+
+	for (x = 0; x + 1 < width; x += 2, d += 4, src += 8) {
+		d[oy] = src[1];
+		d[oy + 2] = src[5];
+		d[ou] = (src[2] + src[6] + 1) >> 1;
+		d[ov] = (src[3] + src[7] + 1) >> 1;
+	}
+	if (x < width) {
+		d[oy] = d[oy + 2] = src[1];
+		d[ou] = src[2];
+		d[ov] = src[3];
+	}
+}
+
+#define VIDEO_FORMAT(n)		offsetof(struct spa_type_video_format, n)
+
+#define PLANAR(fmt,hs,vs,pu,pv)							\
+	{ VIDEO_FORMAT(fmt), true, 3, { 1, 1, 1 }, hs, vs,			\
+	  { -1, 0, pu, pv }, { 0, 0, 0, 0 }, unpack_generic, pack_generic }
+#define SEMI_PLANAR(fmt,ou,ov)							\
+	{ VIDEO_FORMAT(fmt), true, 2, { 1, 2, 0 }, 1, 1,			\
+	  { -1, 0, 1, 1 }, { 0, 0, ou, ov }, unpack_generic, pack_generic }
+#define PACKED_422(fmt,oy,ou,ov)						\
+	{ VIDEO_FORMAT(fmt), true, 1, { 2, 0, 0 }, 1, 0,			\
+	  { -1, 0, 0, 0 }, { 0, oy, ou, ov }, unpack_422, pack_422 }
+#define PACKED(fmt,yuv,ps,pa,oa,o1,o2,o3)					\
+	{ VIDEO_FORMAT(fmt), yuv, 1, { ps, 0, 0 }, 0, 0,			\
+	  { pa, 0, 0, 0 }, { oa, o1, o2, o3 }, unpack_generic, pack_generic }
+
+static const struct format_info format_infos[] = {
+	PLANAR(I420, 1, 1, 1, 2),
+	PLANAR(YV12, 1, 1, 2, 1),
+	PLANAR(Y42B, 1, 0, 1, 2),
+	PLANAR(Y444, 0, 0, 1, 2),
+	PLANAR(Y41B, 2, 0, 1, 2),
+	SEMI_PLANAR(NV12, 0, 1),
+	SEMI_PLANAR(NV21, 1, 0),
+	PACKED_422(YUY2, 0, 1, 3),
+	PACKED_422(UYVY, 1, 0, 2),
+	PACKED_422(YVYU, 0, 3, 1),
+	PACKED(AYUV, true, 4, 0, 0, 1, 2, 3),
+	PACKED(RGB, false, 3, -1, 0, 0, 1, 2),
+	PACKED(BGR, false, 3, -1, 0, 2, 1, 0),
+	PACKED(RGBx, false, 4, -1, 0, 0, 1, 2),
+	PACKED(BGRx, false, 4, -1, 0, 2, 1, 0),
+	PACKED(xRGB, false, 4, -1, 0, 1, 2, 3),
+	PACKED(xBGR, false, 4, -1, 0, 3, 2, 1),
+	PACKED(RGBA, false, 4, 0, 3, 0, 1, 2),
+	PACKED(BGRA, false, 4, 0, 3, 2, 1, 0),
+	PACKED(ARGB, false, 4, 0, 0, 1, 2, 3),
+	PACKED(ABGR, false, 4, 0, 0, 3, 2, 1),
+	{ VIDEO_FORMAT(GRAY8), true, 1, { 1, 0, 0 }, 0, 0,
+	  { -1, 0, -1, -1 }, { 0, 0, 0, 0 }, unpack_generic, pack_generic },
+};
+
+#undef PLANAR
+#undef SEMI_PLANAR
+#undef PACKED_422
+#undef PACKED
+#undef VIDEO_FORMAT
+
+const struct format_info *
+find_format_info(struct spa_type_video_format *type, uint32_t format)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(format_infos); i++) {
+		if (*SPA_MEMBER(type, format_infos[i].format, uint32_t) == format)
+			return &format_infos[i];
+	}
+	return NULL;
+}
+
+uint32_t format_info_get_id(struct spa_type_video_format *type, uint32_t index)
+{
+	if (index >= SPA_N_ELEMENTS(format_infos))
+		return SPA_ID_INVALID;
+	return *SPA_MEMBER(type, format_infos[index].format, uint32_t);
+}
+
+uint32_t format_info_layout(const struct format_info *info,
+			    uint32_t width, uint32_t height, uint32_t stride0,
+			    uint32_t stride[MAX_PLANES], uint32_t offset[MAX_PLANES])
+{
+	uint32_t p, size = 0;
+
+	/* chroma planes have stride0 >> hsub bytes per line, the way v4l2
+	 * lays out planar formats */
+	if (stride0 == 0)
+		stride0 = SPA_ROUND_UP_N(width * info->pstride[0], 4 << info->hsub);
+
+	for (p = 0; p < MAX_PLANES; p++) {
+		uint32_t rows;
+
+		if (p >= info->n_planes) {
+			stride[p] = offset[p] = 0;
+			continue;
+		}
+		if (p == 0) {
+			stride[p] = stride0;
+			rows = height;
+		} else {
+			stride[p] = (stride0 * info->pstride[p] / info->pstride[0]) >> info->hsub;
+			rows = (height + (1 << info->vsub) - 1) >> info->vsub;
+		}
+		offset[p] = size;
+		size += stride[p] * rows;
+	}
+	return size;
+}
+
+void matrix_line_c(uint8_t *dst, const uint8_t *src, const float *m, uint32_t width)
+{
+	uint32_t x;
+
+	for (x = 0; x < width; x++, src += 4, dst += 4) {
+		float c0 = src[1], c1 = src[2], c2 = src[3];
+		int v0 = lrintf(m[0] * c0 + m[1] * c1 + m[2] * c2 + m[3]);
+		int v1 = lrintf(m[4] * c0 + m[5] * c1 + m[6] * c2 + m[7]);
+		int v2 = lrintf(m[8] * c0 + m[9] * c1 + m[10] * c2 + m[11]);
+
+		dst[0] = src[0];
+		dst[1] = SPA_CLAMP(v0, 0, 255);
+		dst[2] = SPA_CLAMP(v1, 0, 255);
+		dst[3] = SPA_CLAMP(v2, 0, 255);
+	}
+}
+
+void vblend_line_c(uint8_t *dst, const uint8_t *src0, const uint8_t *src1,
+		   uint32_t weight, uint32_t n_bytes)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_bytes; i++)
+		dst[i] = (src0[i] * (256 - weight) + src1[i] * weight + 128) >> 8;
+}
+
+void hscale_line(uint8_t *dst, const uint8_t *src, uint32_t dst_width,
+		 const uint32_t *offset, const uint16_t *weight)
+{
+	uint32_t x, k;
+
+	for (x = 0; x < dst_width; x++, dst += 4) {
+		const uint8_t *s = src + offset[x] * 4;
+		uint32_t w = weight[x];
+
+		for (k = 0; k < 4; k++)
+			dst[k] = (s[k] * (256 - w) + s[k + 4] * w + 128) >> 8;
+	}
+}
+
+static void mat_mul(double r[3][3], const double a[3][3], const double b[3][3])
+{
+	int i, j, k;
+
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			r[i][j] = 0.0;
+			for (k = 0; k < 3; k++)
+				r[i][j] += a[i][k] * b[k][j];
+		}
+	}
+}
+
+/* Build the matrix between 8 bit YUV and 8 bit full range RGB. */
+void color_matrix_init(float m[12], bool to_rgb,
+		       enum spa_video_color_matrix matrix,
+		       enum spa_video_color_range range)
+{
+	double kr, kb, kg, ys, yo, cs;
+	double yuv_to_rgb[3][3], rgb_to_yuv[3][3], scale[3][3] = { { 0.0 } }, r[3][3];
+	double offs[3];
+	int i, j;
+
+	switch (matrix) {
+	case SPA_VIDEO_COLOR_MATRIX_BT709:
+		kr = 0.2126, kb = 0.0722;
+		break;
+	case SPA_VIDEO_COLOR_MATRIX_BT2020:
+		kr = 0.2627, kb = 0.0593;
+		break;
+	case SPA_VIDEO_COLOR_MATRIX_SMPTE240M:
+		kr = 0.212, kb = 0.087;
+		break;
+	case SPA_VIDEO_COLOR_MATRIX_FCC:
+		kr = 0.30, kb = 0.11;
+		break;
+	case SPA_VIDEO_COLOR_MATRIX_BT601:
+	default:
+		kr = 0.299, kb = 0.114;
+		break;
+	}
+	kg = 1.0 - kr - kb;
+
+	if (range == SPA_VIDEO_COLOR_RANGE_0_255) {
+		ys = 255.0, yo = 0.0, cs = 255.0;
+	} else {
+		ys = 219.0, yo = 16.0, cs = 224.0;
+	}
+
+	/* normalized Y in [0, 1] and Cb, Cr in [-0.5, 0.5] */
+	yuv_to_rgb[0][0] = 1.0, yuv_to_rgb[0][1] = 0.0, yuv_to_rgb[0][2] = 2.0 * (1.0 - kr);
+	yuv_to_rgb[1][0] = 1.0;
+	yuv_to_rgb[1][1] = -2.0 * kb * (1.0 - kb) / kg;
+	yuv_to_rgb[1][2] = -2.0 * kr * (1.0 - kr) / kg;
+	yuv_to_rgb[2][0] = 1.0, yuv_to_rgb[2][1] = 2.0 * (1.0 - kb), yuv_to_rgb[2][2] = 0.0;
+
+	rgb_to_yuv[0][0] = kr, rgb_to_yuv[0][1] = kg, rgb_to_yuv[0][2] = kb;
+	rgb_to_yuv[1][0] = -0.5 * kr / (1.0 - kb);
+	rgb_to_yuv[1][1] = -0.5 * kg / (1.0 - kb);
+	rgb_to_yuv[1][2] = 0.5;
+	rgb_to_yuv[2][0] = 0.5;
+	rgb_to_yuv[2][1] = -0.5 * kg / (1.0 - kr);
+	rgb_to_yuv[2][2] = -0.5 * kb / (1.0 - kr);
+
+	if (to_rgb) {
+		/* rgb = 255 * M * (S * yuv - o) */
+		scale[0][0] = 1.0 / ys, scale[1][1] = 1.0 / cs, scale[2][2] = 1.0 / cs;
+		for (i = 0; i < 3; i++)
+			for (j = 0; j < 3; j++)
+				yuv_to_rgb[i][j] *= 255.0;
+		mat_mul(r, yuv_to_rgb, scale);
+		offs[0] = yo, offs[1] = 128.0, offs[2] = 128.0;
+		for (i = 0; i < 3; i++) {
+			m[i * 4 + 3] = 0.0;
+			for (j = 0; j < 3; j++) {
+				m[i * 4 + j] = r[i][j];
+				m[i * 4 + 3] -= r[i][j] * offs[j];
+			}
+		}
+	} else {
+		/* yuv = S * M * rgb / 255 + o */
+		scale[0][0] = ys / 255.0, scale[1][1] = cs / 255.0, scale[2][2] = cs / 255.0;
+		mat_mul(r, scale, rgb_to_yuv);
+		offs[0] = yo, offs[1] = 128.0, offs[2] = 128.0;
+		for (i = 0; i < 3; i++) {
+			for (j = 0; j < 3; j++)
+				m[i * 4 + j] = r[i][j];
+			m[i * 4 + 3] = offs[i];
+		}
+	}
+}
@@ -0,0 +1,103 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_VIDEO_OPS_H__
+#define __SPA_VIDEO_OPS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <spa/defs.h>
+#include <spa/video/raw-utils.h>
+#include <spa/video/color.h>
+
+#define FEATURE_SSE2	(1 << 0)
+
+#define MAX_PLANES	3
+
+/* Rows are converted through an intermediate line of 4 bytes per pixel,
+ * A followed by Y U V for YUV formats or R G B for RGB formats. */
+#define COMP_A		0
+
+struct frame {
+	uint32_t width;
+	uint32_t height;
+	uint8_t *data[MAX_PLANES];
+	uint32_t stride[MAX_PLANES];
+};
+
+struct format_info;
+
+typedef void (*unpack_func_t) (const struct format_info *info, const struct frame *f,
+			       uint32_t y, uint8_t *dst);
+typedef void (*pack_func_t) (const struct format_info *info, struct frame *f,
+			     uint32_t y, const uint8_t *src);
+
+struct format_info {
+	size_t format;			/**< offset in struct spa_type_video_format */
+	bool yuv;
+	uint32_t n_planes;
+	uint32_t pstride[MAX_PLANES];	/**< bytes per pixel in each plane */
+	uint32_t hsub;			/**< chroma subsampling, as a shift */
+	uint32_t vsub;
+	int8_t plane[4];		/**< plane of each component, -1 when absent */
+	int8_t offset[4];		/**< byte offset of each component in a pixel */
+	unpack_func_t unpack;
+	pack_func_t pack;
+};
+
+const struct format_info *
+find_format_info(struct spa_type_video_format *type, uint32_t format);
+
+uint32_t format_info_get_id(struct spa_type_video_format *type, uint32_t index);
+
+/* fill in the plane strides and offsets of a frame stored in one block
+ * of memory, a stride0 of 0 selects a default stride. Returns the size of
+ * the frame. */
+uint32_t format_info_layout(const struct format_info *info,
+			    uint32_t width, uint32_t height, uint32_t stride0,
+			    uint32_t stride[MAX_PLANES], uint32_t offset[MAX_PLANES]);
+
+/* 3x4 matrix applied to the three color components of a line */
+typedef void (*matrix_func_t) (uint8_t *dst, const uint8_t *src,
+			       const float *m, uint32_t width);
+/* dst = (src0 * (256 - weight) + src1 * weight) / 256 */
+typedef void (*vblend_func_t) (uint8_t *dst, const uint8_t *src0, const uint8_t *src1,
+			       uint32_t weight, uint32_t n_bytes);
+
+void matrix_line_c(uint8_t *dst, const uint8_t *src, const float *m, uint32_t width);
+void vblend_line_c(uint8_t *dst, const uint8_t *src0, const uint8_t *src1,
+		   uint32_t weight, uint32_t n_bytes);
+#if defined(HAVE_SSE2)
+void matrix_line_sse(uint8_t *dst, const uint8_t *src, const float *m, uint32_t width);
+void vblend_line_sse(uint8_t *dst, const uint8_t *src0, const uint8_t *src1,
+		     uint32_t weight, uint32_t n_bytes);
+#endif
+
+/* bilinear horizontal scaling with precomputed source positions and
+ * weights in 1/256, src needs one extra pixel at the end */
+void hscale_line(uint8_t *dst, const uint8_t *src, uint32_t dst_width,
+		 const uint32_t *offset, const uint16_t *weight);
+
+void color_matrix_init(float m[12], bool to_rgb,
+		       enum spa_video_color_matrix matrix,
+		       enum spa_video_color_range range);
+
+#endif /* __SPA_VIDEO_OPS_H__ */
@@ -0,0 +1,1236 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <spa/log.h>
+#include <spa/type-map.h>
+#include <spa/node.h>
+#include <spa/list.h>
+#include <spa/video/format-utils.h>
+#include <spa/format-builder.h>
+#include <spa/param-alloc.h>
+#include <lib/props.h>
+#include <lib/format.h>
+#include <lib/workers.h>
+
+#include "video-ops.h"
+
+#define NAME "videoconvert"
+
+#define MAX_BUFFERS	16
+#define MAX_THREADS	8
+
+struct props {
+	int threads;
+};
+
+static int default_threads(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return SPA_CLAMP(n, 1, 4);
+}
+
+static void reset_props(struct props *props)
+{
+	props->threads = default_threads();
+}
+
+struct buffer {
+	struct spa_buffer *outbuf;
+	bool outstanding;
+	struct spa_meta_header *h;
+	struct spa_list link;
+};
+
+struct port {
+	bool have_format;
+	struct spa_video_info_raw format;
+	const struct format_info *info;
+	/* layout when all planes are in one data block */
+	uint32_t stride[MAX_PLANES];
+	uint32_t offset[MAX_PLANES];
+	uint32_t size;
+
+	struct spa_port_info info_port;
+	uint8_t params_buffer[1024];
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct spa_port_io *io;
+
+	struct spa_list empty;
+};
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	uint32_t props;
+	uint32_t prop_threads;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_video format_video;
+	struct spa_type_video_format video_format;
+	struct spa_type_command_node command_node;
+	struct spa_type_param_alloc_buffers param_alloc_buffers;
+	struct spa_type_param_alloc_meta_enable param_alloc_meta_enable;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
+	type->prop_threads = spa_type_map_get_id(map, SPA_TYPE_PROPS__threads);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_video_map(map, &type->format_video);
+	spa_type_video_format_map(map, &type->video_format);
+	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_alloc_buffers_map(map, &type->param_alloc_buffers);
+	spa_type_param_alloc_meta_enable_map(map, &type->param_alloc_meta_enable);
+}
+
+/* scratch lines of one band of rows */
+struct band {
+	uint8_t *unpacked;	/**< source line, one extra pixel for the scaler */
+	uint8_t *scaled[2];	/**< cached horizontally scaled source lines */
+	int32_t scaled_row[2];
+	uint8_t *line;		/**< output line */
+};
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct type type;
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	const struct spa_node_callbacks *callbacks;
+	void *callbacks_data;
+
+	uint8_t props_buffer[512];
+	struct props props;
+
+	uint8_t format_buffer[1024];
+
+	struct port in_ports[1];
+	struct port out_ports[1];
+
+	uint32_t cpu_flags;
+	matrix_func_t matrix;
+	vblend_func_t vblend;
+
+	bool have_convert;
+	bool passthrough;	/**< same format and size, planes are copied */
+	bool scale;
+	bool color;		/**< a color matrix is applied */
+	float color_matrix[12];
+
+	uint32_t *hoffset;
+	uint16_t *hweight;
+	uint8_t *memory;
+	struct band bands[MAX_THREADS];
+
+	/* the current frames, set up before the workers are woken up */
+	struct frame src;
+	struct frame dst;
+	uint32_t n_bands;
+	uint32_t band_rows;
+
+	/* the bands are converted by the calling thread and the workers */
+	struct spa_workers *workers;
+
+	bool started;
+};
+
+#define CHECK_PORT(this,d,p)	((p) == 0)
+#define GET_IN_PORT(this,p)	(&this->in_ports[p])
+#define GET_OUT_PORT(this,p)	(&this->out_ports[p])
+#define GET_PORT(this,d,p)	(d == SPA_DIRECTION_INPUT ? GET_IN_PORT(this,p) : GET_OUT_PORT(this,p))
+#define GET_OTHER_PORT(this,d,p) (d == SPA_DIRECTION_INPUT ? GET_OUT_PORT(this,p) : GET_IN_PORT(this,p))
+
+#define PROP(f,key,type,...)							\
+	SPA_POD_PROP (f,key,0,type,1,__VA_ARGS__)
+#define PROP_MM(f,key,type,...)							\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+#define PROP_U_MM(f,key,type,...)						\
+	SPA_POD_PROP (f,key,SPA_POD_PROP_FLAG_UNSET |				\
+			SPA_POD_PROP_RANGE_MIN_MAX,type,3,__VA_ARGS__)
+
+static void convert_band(struct impl *this, uint32_t band);
+
+static void do_convert_band(void *data, uint32_t job)
+{
+	convert_band(data, job);
+}
+
+static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
+{
+	struct impl *this;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(props != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_pod_builder_init(&b, this->props_buffer, sizeof(this->props_buffer));
+	spa_pod_builder_props(&b, &f[0], this->type.props,
+		PROP_MM(&f[1], this->type.prop_threads, SPA_POD_TYPE_INT,
+			this->props.threads,
+			1, MAX_THREADS));
+
+	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_node_set_props(struct spa_node *node, const struct spa_props *props)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (props == NULL) {
+		reset_props(&this->props);
+	} else {
+		spa_props_query(props,
+				this->type.prop_threads, SPA_POD_TYPE_INT, &this->props.threads, 0);
+	}
+	this->props.threads = SPA_CLAMP(this->props.threads, 1, MAX_THREADS);
+
+	/* the pool can be resized while a frame is converted */
+	if (this->props.threads != spa_workers_get_threads(this->workers))
+		spa_workers_set_threads(this->workers, this->props.threads);
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_node_send_command(struct spa_node *node, const struct spa_command *command)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(command != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (SPA_COMMAND_TYPE(command) == this->type.command_node.Start) {
+		this->started = true;
+	} else if (SPA_COMMAND_TYPE(command) == this->type.command_node.Pause) {
+		this->started = false;
+	} else
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_set_callbacks(struct spa_node *node,
+			const struct spa_node_callbacks *callbacks,
+			void *data)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	this->callbacks = callbacks;
+	this->callbacks_data = data;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_get_n_ports(struct spa_node *node,
+		      uint32_t *n_input_ports,
+		      uint32_t *max_input_ports,
+		      uint32_t *n_output_ports,
+		      uint32_t *max_output_ports)
+{
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	if (n_input_ports)
+		*n_input_ports = 1;
+	if (max_input_ports)
+		*max_input_ports = 1;
+	if (n_output_ports)
+		*n_output_ports = 1;
+	if (max_output_ports)
+		*max_output_ports = 1;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_get_port_ids(struct spa_node *node,
+		       uint32_t n_input_ports,
+		       uint32_t *input_ids,
+		       uint32_t n_output_ports,
+		       uint32_t *output_ids)
+{
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	if (n_input_ports > 0 && input_ids)
+		input_ids[0] = 0;
+	if (n_output_ports > 0 && output_ids)
+		output_ids[0] = 0;
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_node_add_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_remove_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_port_enum_formats(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    struct spa_format **format,
+			    const struct spa_format *filter,
+			    uint32_t index)
+{
+	struct impl *this;
+	struct port *other;
+	int res;
+	struct spa_format *fmt;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+	uint32_t count, match, video_format;
+	struct spa_rectangle size;
+	struct spa_fraction rate, rate_min, rate_max;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(format != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	/* prefer the size of the other side, we don't change the framerate */
+	other = GET_OTHER_PORT(this, direction, 0);
+	if (other->have_format) {
+		size = other->format.size;
+		rate = rate_min = rate_max = other->format.framerate;
+	} else {
+		size = (struct spa_rectangle) { 320, 240 };
+		rate = (struct spa_fraction) { 25, 1 };
+		rate_min = (struct spa_fraction) { 0, 1 };
+		rate_max = (struct spa_fraction) { INT32_MAX, 1 };
+	}
+
+	count = match = filter ? 0 : index;
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	/* the format of the other side first, then all the formats we can
+	 * convert between */
+	if (count == 0) {
+		if (!other->have_format) {
+			count++;
+			goto next;
+		}
+		video_format = other->format.format;
+	} else {
+		video_format = format_info_get_id(&this->type.video_format, count - 1);
+		if (video_format == SPA_ID_INVALID)
+			return SPA_RESULT_ENUM_END;
+		if (other->have_format && video_format == other->format.format) {
+			count++;
+			goto next;
+		}
+	}
+	count++;
+
+	spa_pod_builder_format(&b, &f[0], this->type.format,
+		this->type.media_type.video,
+		this->type.media_subtype.raw,
+		PROP(&f[1], this->type.format_video.format, SPA_POD_TYPE_ID,
+			video_format),
+		PROP_U_MM(&f[1], this->type.format_video.size, SPA_POD_TYPE_RECTANGLE,
+			size.width, size.height,
+			1, 1,
+			INT32_MAX, INT32_MAX),
+		PROP_U_MM(&f[1], this->type.format_video.framerate, SPA_POD_TYPE_FRACTION,
+			rate.num, rate.denom,
+			rate_min.num, rate_min.denom,
+			rate_max.num, rate_max.denom));
+
+	fmt = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+
+	if ((res = spa_format_filter(fmt, filter, &b)) != SPA_RESULT_OK || match++ != index)
+		goto next;
+
+	*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
+
+	return SPA_RESULT_OK;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers", this);
+		port->n_buffers = 0;
+		spa_list_init(&port->empty);
+	}
+	return SPA_RESULT_OK;
+}
+
+static void free_convert(struct impl *this)
+{
+	free(this->memory);
+	this->memory = NULL;
+	this->have_convert = false;
+}
+
+/* pick the line functions and allocate the scratch memory once both sides
+ * are known */
+static int setup_convert(struct impl *this)
+{
+	struct port *in = GET_IN_PORT(this, 0), *out = GET_OUT_PORT(this, 0);
+	uint32_t i, in_width = in->format.size.width, out_width = out->format.size.width;
+	uint32_t in_height = in->format.size.height, out_height = out->format.size.height;
+	uint32_t line_size, n_lines;
+	uint8_t *p;
+
+	free_convert(this);
+
+	this->passthrough = in->info == out->info &&
+	    in_width == out_width && in_height == out_height;
+	this->scale = in_width != out_width || in_height != out_height;
+	this->color = in->info->yuv != out->info->yuv;
+
+	if (this->color) {
+		const struct spa_video_info_raw *yuv = in->info->yuv ? &in->format : &out->format;
+		enum spa_video_color_matrix matrix = yuv->color_matrix;
+		enum spa_video_color_range range = yuv->color_range;
+
+		/* guess the way the other side would when it's not given */
+		if (matrix == SPA_VIDEO_COLOR_MATRIX_UNKNOWN ||
+		    matrix == SPA_VIDEO_COLOR_MATRIX_RGB)
+			matrix = yuv->size.height >= 720 ?
+			    SPA_VIDEO_COLOR_MATRIX_BT709 : SPA_VIDEO_COLOR_MATRIX_BT601;
+		if (range == SPA_VIDEO_COLOR_RANGE_UNKNOWN)
+			range = SPA_VIDEO_COLOR_RANGE_16_235;
+
+		color_matrix_init(this->color_matrix, in->info->yuv, matrix, range);
+	}
+
+	this->matrix = matrix_line_c;
+	this->vblend = vblend_line_c;
+#if defined(HAVE_SSE2)
+	if (this->cpu_flags & FEATURE_SSE2) {
+		this->matrix = matrix_line_sse;
+		this->vblend = vblend_line_sse;
+	}
+#endif
+
+	/* per band: one unpacked source line, two scaled lines and the
+	 * output line */
+	line_size = SPA_ROUND_UP_N((SPA_MAX(in_width, out_width) + 1) * 4, 16);
+	n_lines = MAX_THREADS * 4;
+
+	this->memory = malloc(n_lines * line_size + 16 +
+			      out_width * (sizeof(uint32_t) + sizeof(uint16_t)));
+	if (this->memory == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	p = (uint8_t *) SPA_ROUND_UP_N((uintptr_t) this->memory, 16);
+	for (i = 0; i < MAX_THREADS; i++) {
+		struct band *b = &this->bands[i];
+
+		b->unpacked = p;
+		b->scaled[0] = p + line_size;
+		b->scaled[1] = p + 2 * line_size;
+		b->line = p + 3 * line_size;
+		p += 4 * line_size;
+	}
+	this->hoffset = (uint32_t *) p;
+	this->hweight = (uint16_t *) (this->hoffset + out_width);
+
+	/* source position of the center of each output pixel in 1/256,
+	 * the last pixel is blended with the duplicate after the line */
+	for (i = 0; i < out_width; i++) {
+		int64_t sx = ((int64_t) (2 * i + 1) * in_width * 256) / (2 * out_width) - 128;
+		sx = SPA_CLAMP(sx, 0, (in_width - 1) * 256);
+		this->hoffset[i] = sx >> 8;
+		this->hweight[i] = sx & 0xff;
+	}
+
+	this->have_convert = true;
+
+	spa_log_info(this->log, NAME " %p: %dx%d -> %dx%d%s%s%s", this,
+		     in_width, in_height, out_width, out_height,
+		     this->passthrough ? " copy" : "",
+		     this->scale ? " scale" : "",
+		     this->color ? (in->info->yuv ? " yuv->rgb" : " rgb->yuv") : "");
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_set_format(struct spa_node *node,
+			  enum spa_direction direction,
+			  uint32_t port_id,
+			  uint32_t flags,
+			  const struct spa_format *format)
+{
+	struct impl *this;
+	struct port *port, *other;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+	other = GET_OTHER_PORT(this, direction, 0);
+
+	if (format == NULL) {
+		port->have_format = false;
+		clear_buffers(this, port);
+		free_convert(this);
+	} else {
+		struct spa_video_info info = { SPA_FORMAT_MEDIA_TYPE(format),
+			SPA_FORMAT_MEDIA_SUBTYPE(format),
+		};
+		const struct format_info *finfo;
+
+		if (info.media_type != this->type.media_type.video ||
+		    info.media_subtype != this->type.media_subtype.raw)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (!spa_format_video_raw_parse(format, &info.info.raw, &this->type.format_video))
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if ((finfo = find_format_info(&this->type.video_format,
+					      info.info.raw.format)) == NULL)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (info.info.raw.size.width == 0 || info.info.raw.size.height == 0)
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		if (other->have_format &&
+		    (other->format.framerate.num != info.info.raw.framerate.num ||
+		     other->format.framerate.denom != info.info.raw.framerate.denom))
+			return SPA_RESULT_INVALID_MEDIA_TYPE;
+
+		port->format = info.info.raw;
+		port->info = finfo;
+		port->size = format_info_layout(finfo,
+						info.info.raw.size.width, info.info.raw.size.height,
+						0, port->stride, port->offset);
+		port->have_format = true;
+
+		if (other->have_format) {
+			int res;
+			if ((res = setup_convert(this)) != SPA_RESULT_OK) {
+				port->have_format = false;
+				return res;
+			}
+		}
+	}
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_get_format(struct spa_node *node,
+			  enum spa_direction direction,
+			  uint32_t port_id,
+			  const struct spa_format **format)
+{
+	struct impl *this;
+	struct port *port;
+	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_frame f[2];
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(format != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+	spa_pod_builder_format(&b, &f[0], this->type.format,
+		this->type.media_type.video,
+		this->type.media_subtype.raw,
+		PROP(&f[1], this->type.format_video.format, SPA_POD_TYPE_ID,
+			port->format.format),
+		PROP(&f[1], this->type.format_video.size, -SPA_POD_TYPE_RECTANGLE,
+			&port->format.size),
+		PROP(&f[1], this->type.format_video.framerate, -SPA_POD_TYPE_FRACTION,
+			&port->format.framerate));
+	*format = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_format);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_get_info(struct spa_node *node,
+			enum spa_direction direction,
+			uint32_t port_id,
+			const struct spa_port_info **info)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(info != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+	*info = &port->info_port;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_enum_params(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   uint32_t index,
+			   struct spa_param **param)
+{
+	struct spa_pod_builder b = { NULL };
+	struct spa_pod_frame f[2];
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(param != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	spa_pod_builder_init(&b, port->params_buffer, sizeof(port->params_buffer));
+
+	switch (index) {
+	case 0:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_buffers.Buffers,
+			PROP(&f[1], this->type.param_alloc_buffers.size, SPA_POD_TYPE_INT,
+				port->size),
+			PROP(&f[1], this->type.param_alloc_buffers.stride, SPA_POD_TYPE_INT,
+				port->stride[0]),
+			PROP_U_MM(&f[1], this->type.param_alloc_buffers.buffers, SPA_POD_TYPE_INT,
+				MAX_BUFFERS,
+				2, MAX_BUFFERS),
+			PROP(&f[1], this->type.param_alloc_buffers.align, SPA_POD_TYPE_INT,
+				16));
+		break;
+
+	case 1:
+		spa_pod_builder_object(&b, &f[0], 0, this->type.param_alloc_meta_enable.MetaEnable,
+			PROP(&f[1], this->type.param_alloc_meta_enable.type, SPA_POD_TYPE_ID,
+				this->type.meta.Header),
+			PROP(&f[1], this->type.param_alloc_meta_enable.size, SPA_POD_TYPE_INT,
+				sizeof(struct spa_meta_header)));
+		break;
+
+	default:
+		return SPA_RESULT_NOT_IMPLEMENTED;
+	}
+
+	*param = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_param);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_set_param(struct spa_node *node,
+			 enum spa_direction direction,
+			 uint32_t port_id,
+			 const struct spa_param *param)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_port_use_buffers(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   struct spa_buffer **buffers,
+			   uint32_t n_buffers)
+{
+	struct impl *this;
+	struct port *port;
+	uint32_t i, j, n_datas;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return SPA_RESULT_NO_FORMAT;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b;
+		struct spa_data *d = buffers[i]->datas;
+
+		b = &port->buffers[i];
+		b->outbuf = buffers[i];
+		b->outstanding = direction == SPA_DIRECTION_INPUT;
+		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
+
+		/* one data block per plane or all planes in the first one */
+		n_datas = buffers[i]->n_datas >= port->info->n_planes ? port->info->n_planes : 1;
+
+		if (buffers[i]->n_datas < 1) {
+			spa_log_error(this->log, NAME " %p: no datas on buffer %p", this,
+				      buffers[i]);
+			return SPA_RESULT_ERROR;
+		}
+		for (j = 0; j < n_datas; j++) {
+			if ((d[j].type != this->type.data.MemPtr &&
+			     d[j].type != this->type.data.MemFd &&
+			     d[j].type != this->type.data.DmaBuf) || d[j].data == NULL) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p",
+					      this, buffers[i]);
+				return SPA_RESULT_ERROR;
+			}
+		}
+		if (n_datas == 1 && d[0].maxsize < port->size) {
+			spa_log_error(this->log, NAME " %p: buffer %p too small", this,
+				      buffers[i]);
+			return SPA_RESULT_ERROR;
+		}
+		if (direction == SPA_DIRECTION_OUTPUT)
+			spa_list_insert(port->empty.prev, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_alloc_buffers(struct spa_node *node,
+			     enum spa_direction direction,
+			     uint32_t port_id,
+			     struct spa_param **params,
+			     uint32_t n_params,
+			     struct spa_buffer **buffers,
+			     uint32_t *n_buffers)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int
+impl_node_port_set_io(struct spa_node *node,
+		      enum spa_direction direction,
+		      uint32_t port_id,
+		      struct spa_port_io *io)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), SPA_RESULT_INVALID_PORT);
+
+	port = GET_PORT(this, direction, port_id);
+	port->io = io;
+
+	return SPA_RESULT_OK;
+}
+
+static void recycle_buffer(struct impl *this, uint32_t id)
+{
+	struct port *port = GET_OUT_PORT(this, 0);
+	struct buffer *b = &port->buffers[id];
+
+	if (!b->outstanding) {
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+
+	spa_list_insert(port->empty.prev, &b->link);
+	b->outstanding = false;
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
+
+static int impl_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, SPA_DIRECTION_OUTPUT, port_id),
+			       SPA_RESULT_INVALID_PORT);
+
+	port = GET_OUT_PORT(this, port_id);
+
+	if (port->n_buffers == 0)
+		return SPA_RESULT_NO_BUFFERS;
+
+	if (buffer_id >= port->n_buffers)
+		return SPA_RESULT_INVALID_BUFFER_ID;
+
+	recycle_buffer(this, buffer_id);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_node_port_send_command(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    const struct spa_command *command)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->empty))
+		return NULL;
+
+	b = spa_list_first(&port->empty, struct buffer, link);
+	spa_list_remove(&b->link);
+	b->outstanding = true;
+
+	return b->outbuf;
+}
+
+/* map the planes of a buffer, an input buffer can have a different stride
+ * than the one we suggested */
+static void map_frame(struct port *port, struct spa_buffer *buf, struct frame *f, bool input)
+{
+	struct spa_data *d = buf->datas;
+	const struct format_info *info = port->info;
+	uint32_t p, stride[MAX_PLANES], offset[MAX_PLANES];
+
+	f->width = port->format.size.width;
+	f->height = port->format.size.height;
+
+	if (buf->n_datas >= info->n_planes) {
+		for (p = 0; p < info->n_planes; p++) {
+			uint32_t s = input ? d[p].chunk->stride : 0;
+
+			f->data[p] = SPA_MEMBER(d[p].data, input ? d[p].chunk->offset : 0, uint8_t);
+			f->stride[p] = s ? s : port->stride[p];
+		}
+	} else {
+		uint32_t s = input ? d[0].chunk->stride : 0;
+
+		if (s == 0 || s == port->stride[0]) {
+			memcpy(stride, port->stride, sizeof(stride));
+			memcpy(offset, port->offset, sizeof(offset));
+		} else
+			format_info_layout(info, f->width, f->height, s, stride, offset);
+
+		for (p = 0; p < info->n_planes; p++) {
+			f->data[p] = SPA_MEMBER(d[0].data,
+						(input ? d[0].chunk->offset : 0) + offset[p], uint8_t);
+			f->stride[p] = stride[p];
+		}
+	}
+}
+
+static uint8_t *get_scaled_line(struct impl *this, struct band *b, uint32_t row)
+{
+	const struct format_info *info = GET_IN_PORT(this, 0)->info;
+	uint32_t slot, width = this->src.width;
+
+	if (b->scaled_row[0] == row)
+		return b->scaled[0];
+	if (b->scaled_row[1] == row)
+		return b->scaled[1];
+
+	/* rows are requested in increasing order, replace the lowest one */
+	slot = b->scaled_row[0] < b->scaled_row[1] ? 0 : 1;
+
+	if (width == this->dst.width) {
+		info->unpack(info, &this->src, row, b->scaled[slot]);
+	} else {
+		info->unpack(info, &this->src, row, b->unpacked);
+		memcpy(&b->unpacked[width * 4], &b->unpacked[(width - 1) * 4], 4);
+		hscale_line(b->scaled[slot], b->unpacked, this->dst.width,
+			    this->hoffset, this->hweight);
+	}
+	b->scaled_row[slot] = row;
+
+	return b->scaled[slot];
+}
+
+static void convert_band(struct impl *this, uint32_t band)
+{
+	const struct format_info *out_info = GET_OUT_PORT(this, 0)->info;
+	const struct format_info *in_info = GET_IN_PORT(this, 0)->info;
+	struct band *b = &this->bands[band];
+	uint32_t y, y0, y1, src_h = this->src.height, dst_h = this->dst.height;
+
+	y0 = band * this->band_rows;
+	y1 = SPA_MIN(y0 + this->band_rows, dst_h);
+
+	b->scaled_row[0] = b->scaled_row[1] = -1;
+
+	for (y = y0; y < y1; y++) {
+		uint8_t *line;
+
+		if (!this->scale) {
+			in_info->unpack(in_info, &this->src, y, b->line);
+			line = b->line;
+		} else {
+			int64_t sy = ((int64_t) (2 * y + 1) * src_h * 256) / (2 * dst_h) - 128;
+			uint32_t row, weight;
+
+			sy = SPA_CLAMP(sy, 0, (int64_t) (src_h - 1) * 256);
+			row = sy >> 8;
+			weight = sy & 0xff;
+
+			line = get_scaled_line(this, b, row);
+			if (weight != 0) {
+				this->vblend(b->line, line, get_scaled_line(this, b, row + 1),
+					     weight, this->dst.width * 4);
+				line = b->line;
+			}
+		}
+		if (this->color) {
+			this->matrix(b->line, line, this->color_matrix, this->dst.width);
+			line = b->line;
+		}
+		out_info->pack(out_info, &this->dst, y, line);
+	}
+}
+
+static void copy_planes(struct impl *this)
+{
+	const struct format_info *info = GET_IN_PORT(this, 0)->info;
+	uint32_t p, y;
+
+	for (p = 0; p < info->n_planes; p++) {
+		uint32_t rows = p == 0 ? this->dst.height :
+		    (this->dst.height + (1 << info->vsub) - 1) >> info->vsub;
+		uint32_t n_bytes = SPA_MIN(this->src.stride[p], this->dst.stride[p]);
+
+		if (this->src.stride[p] == this->dst.stride[p]) {
+			memcpy(this->dst.data[p], this->src.data[p], rows * n_bytes);
+			continue;
+		}
+		for (y = 0; y < rows; y++)
+			memcpy(this->dst.data[p] + y * this->dst.stride[p],
+			       this->src.data[p] + y * this->src.stride[p], n_bytes);
+	}
+}
+
+static void convert(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
+{
+	struct port *in = GET_IN_PORT(this, 0), *out = GET_OUT_PORT(this, 0);
+	struct spa_data *dd = dbuf->datas;
+	uint32_t i, n_bands, n_datas;
+
+	map_frame(in, sbuf, &this->src, true);
+	map_frame(out, dbuf, &this->dst, false);
+
+	if (this->passthrough) {
+		copy_planes(this);
+		goto done;
+	}
+
+	/* split the output in bands of an even number of rows so that
+	 * vertically subsampled chroma rows are written by one thread */
+	n_bands = SPA_MIN(spa_workers_get_threads(this->workers), (this->dst.height + 1) / 2);
+	n_bands = SPA_MAX(n_bands, 1);
+	this->band_rows = SPA_ROUND_UP_N((this->dst.height + n_bands - 1) / n_bands, 2);
+	this->n_bands = n_bands;
+
+	spa_workers_run(this->workers, n_bands);
+
+      done:
+	n_datas = dbuf->n_datas >= out->info->n_planes ? out->info->n_planes : 1;
+	for (i = 0; i < n_datas; i++) {
+		dd[i].chunk->offset = 0;
+		dd[i].chunk->stride = this->dst.stride[i];
+		dd[i].chunk->size = n_datas == 1 ? out->size :
+		    this->dst.stride[i] * (i == 0 ? this->dst.height :
+			(this->dst.height + (1 << out->info->vsub) - 1) >> out->info->vsub);
+	}
+}
+
+static int impl_node_process_input(struct spa_node *node)
+{
+	struct impl *this;
+	struct spa_port_io *input;
+	struct spa_port_io *output;
+	struct port *in_port, *out_port;
+	struct spa_buffer *dbuf, *sbuf;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, SPA_RESULT_ERROR);
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, SPA_RESULT_ERROR);
+
+	if (input->status != SPA_RESULT_HAVE_BUFFER || input->buffer_id >= in_port->n_buffers)
+		return SPA_RESULT_NEED_BUFFER;
+
+	if (!this->have_convert)
+		return SPA_RESULT_NO_FORMAT;
+
+	if ((dbuf = find_free_buffer(this, out_port)) == NULL)
+		return SPA_RESULT_OUT_OF_BUFFERS;
+
+	sbuf = in_port->buffers[input->buffer_id].outbuf;
+
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	convert(this, dbuf, sbuf);
+
+	output->buffer_id = dbuf->id;
+	output->status = SPA_RESULT_HAVE_BUFFER;
+
+	return SPA_RESULT_HAVE_BUFFER;
+}
+
+static int impl_node_process_output(struct spa_node *node)
+{
+	struct impl *this;
+	struct port *in_port, *out_port;
+	struct spa_port_io *input, *output;
+
+	spa_return_val_if_fail(node != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, SPA_RESULT_ERROR);
+
+	if (output->status == SPA_RESULT_HAVE_BUFFER)
+		return SPA_RESULT_HAVE_BUFFER;
+
+	/* recycle */
+	if (output->buffer_id != SPA_ID_INVALID) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, SPA_RESULT_ERROR);
+
+	input->range = output->range;
+	input->status = SPA_RESULT_NEED_BUFFER;
+
+	return SPA_RESULT_NEED_BUFFER;
+}
+
+static const struct spa_node impl_node = {
+	SPA_VERSION_NODE,
+	NULL,
+	impl_node_get_props,
+	impl_node_set_props,
+	impl_node_send_command,
+	impl_node_set_callbacks,
+	impl_node_get_n_ports,
+	impl_node_get_port_ids,
+	impl_node_add_port,
+	impl_node_remove_port,
+	impl_node_port_enum_formats,
+	impl_node_port_set_format,
+	impl_node_port_get_format,
+	impl_node_port_get_info,
+	impl_node_port_enum_params,
+	impl_node_port_set_param,
+	impl_node_port_use_buffers,
+	impl_node_port_alloc_buffers,
+	impl_node_port_set_io,
+	impl_node_port_reuse_buffer,
+	impl_node_port_send_command,
+	impl_node_process_input,
+	impl_node_process_output,
+};
+
+static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id, void **interface)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(interface != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = (struct impl *) handle;
+
+	if (interface_id == this->type.node)
+		*interface = &this->node;
+	else
+		return SPA_RESULT_UNKNOWN_INTERFACE;
+
+	return SPA_RESULT_OK;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = (struct impl *) handle;
+
+	spa_workers_destroy(this->workers);
+	free_convert(this);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *this;
+	uint32_t i;
+
+	spa_return_val_if_fail(factory != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(handle != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this = (struct impl *) handle;
+
+	for (i = 0; i < n_support; i++) {
+		if (strcmp(support[i].type, SPA_TYPE__TypeMap) == 0)
+			this->map = support[i].data;
+		else if (strcmp(support[i].type, SPA_TYPE__Log) == 0)
+			this->log = support[i].data;
+	}
+	if (this->map == NULL) {
+		spa_log_error(this->log, "a type-map is needed");
+		return SPA_RESULT_ERROR;
+	}
+	init_type(&this->type, this->map);
+
+	this->node = impl_node;
+
+#if defined(HAVE_SSE2)
+	if (__builtin_cpu_supports("sse2"))
+		this->cpu_flags |= FEATURE_SSE2;
+#endif
+
+	reset_props(&this->props);
+
+	this->in_ports[0].info_port.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->in_ports[0].empty);
+
+	this->out_ports[0].info_port.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
+	    SPA_PORT_INFO_FLAG_NO_REF;
+	spa_list_init(&this->out_ports[0].empty);
+
+	this->workers = spa_workers_new(this->log, MAX_THREADS, this->props.threads,
+					do_convert_band, this);
+	if (this->workers == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
+	return SPA_RESULT_OK;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE__Node,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t index)
+{
+	spa_return_val_if_fail(factory != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+	spa_return_val_if_fail(info != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	switch (index) {
+	case 0:
+		*info = &impl_interfaces[index];
+		break;
+	default:
+		return SPA_RESULT_ENUM_END;
+	}
+	return SPA_RESULT_OK;
+}
+
+const struct spa_handle_factory spa_videoconvert_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	NAME,
+	NULL,
+	sizeof(struct impl),
+	impl_init,
+	impl_enum_interface_info,
+};
@@ -65,16 +65,24 @@ static Pixel colors[N_COLORS] = {
 
 typedef struct _DrawingData DrawingData;
 
-typedef void (*DrawPixelFunc) (DrawingData * dd, int x, Pixel * pixel);
-
 struct _DrawingData {
-	char *line;
+	uint8_t *data;
 	int width;
 	int height;
 	int stride;
-	DrawPixelFunc draw_pixel;
+	bool uyvy;
+};
+
+/* four independent xorshift generators, the compiler can keep the lanes
+ * in one vector register */
+typedef struct _Rand Rand;
+
+struct _Rand {
+	uint32_t s[4];
 };
 
+static uint8_t gray_y[256];
+
 static inline void update_yuv(Pixel * pixel)
 {
 	uint16_t y, u, v;
@@ -106,29 +114,44 @@ static void init_colors(void)
 	for (i = 0; i < N_COLORS; i++) {
 		update_yuv(&colors[i]);
 	}
+	/* gray has U and V of 128, only Y needs a lookup */
+	for (i = 0; i < 256; i++) {
+		Pixel p = { i, i, i, };
+		update_yuv(&p);
+		gray_y[i] = p.Y;
+	}
 }
 
-static void draw_pixel_rgb(DrawingData * dd, int x, Pixel * color)
+static void rand_init(Rand * r, uint32_t seed)
 {
-	dd->line[3 * x + 0] = color->R;
-	dd->line[3 * x + 1] = color->G;
-	dd->line[3 * x + 2] = color->B;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		/* xorshift gets stuck on 0 */
+		r->s[i] = (seed + i) * 0x9e3779b9 + 0x7f4a7c15;
+		if (r->s[i] == 0)
+			r->s[i] = 1;
+	}
 }
 
-static void draw_pixel_uyvy(DrawingData * dd, int x, Pixel * color)
+static inline void rand_fill(Rand * r, uint8_t * dst, int n)
 {
-	if (x & 1) {
-		/* odd pixel */
-		dd->line[2 * (x - 1) + 3] = color->Y;
-	} else {
-		/* even pixel */
-		dd->line[2 * x + 0] = color->U;
-		dd->line[2 * x + 1] = color->Y;
-		dd->line[2 * x + 2] = color->V;
+	uint32_t v[4];
+	int i, j;
+
+	for (i = 0; i < n; i += sizeof(v)) {
+		for (j = 0; j < 4; j++) {
+			uint32_t x = r->s[j];
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			r->s[j] = v[j] = x;
+		}
+		memcpy(&dst[i], v, SPA_MIN(n - i, (int) sizeof(v)));
 	}
 }
 
-static int drawing_data_init(DrawingData * dd, struct impl *this, char *data)
+static int drawing_data_init(DrawingData * dd, struct impl *this, uint8_t *data)
 {
 	struct spa_video_info *format = &this->current_format;
 	struct spa_rectangle *size = &format->info.raw.size;
@@ -138,13 +161,13 @@ static int drawing_data_init(DrawingData * dd, struct impl *this, char *data)
 		return SPA_RESULT_NOT_IMPLEMENTED;
 
 	if (format->info.raw.format == this->type.video_format.RGB) {
-		dd->draw_pixel = draw_pixel_rgb;
+		dd->uyvy = false;
 	} else if (format->info.raw.format == this->type.video_format.UYVY) {
-		dd->draw_pixel = draw_pixel_uyvy;
+		dd->uyvy = true;
 	} else
 		return SPA_RESULT_NOT_IMPLEMENTED;
 
-	dd->line = data;
+	dd->data = data;
 	dd->width = size->width;
 	dd->height = size->height;
 	dd->stride = this->stride;
@@ -152,127 +175,182 @@ static int drawing_data_init(DrawingData * dd, struct impl *this, char *data)
 	return SPA_RESULT_OK;
 }
 
-static inline void draw_pixels(DrawingData * dd, int offset, Color color, int length)
+static inline uint8_t *get_line(DrawingData * dd, int y)
+{
+	return dd->data + y * dd->stride;
+}
+
+/* bytes that hold pixels 0 to x - 1, for UYVY this includes the pair of
+ * pixel x - 1 */
+static inline int line_bytes(DrawingData * dd, int x)
 {
+	return dd->uyvy ? ((x + 1) / 2) * 4 : x * 3;
+}
+
+static void draw_pixels(DrawingData * dd, uint8_t * line, int offset, Color color, int length)
+{
+	const Pixel *c = &colors[color];
 	int x;
 
-	for (x = offset; x < offset + length; x++) {
-		dd->draw_pixel(dd, x, &colors[color]);
+	if (dd->uyvy) {
+		for (x = offset; x < offset + length; x++) {
+			if (x & 1) {
+				/* odd pixel */
+				line[2 * (x - 1) + 3] = c->Y;
+			} else {
+				/* even pixel */
+				line[2 * x + 0] = c->U;
+				line[2 * x + 1] = c->Y;
+				line[2 * x + 2] = c->V;
+			}
+		}
+	} else {
+		for (x = offset; x < offset + length; x++) {
+			line[3 * x + 0] = c->R;
+			line[3 * x + 1] = c->G;
+			line[3 * x + 2] = c->B;
+		}
 	}
 }
 
-static inline void next_line(DrawingData * dd)
+/* the first line of a band was drawn, copy it to the others */
+static void copy_lines(DrawingData * dd, int y0, int y1, int n_bytes)
 {
-	dd->line += dd->stride;
+	const uint8_t *src = get_line(dd, y0);
+	int y;
+
+	for (y = y0 + 1; y < y1; y++)
+		memcpy(get_line(dd, y), src, n_bytes);
 }
 
-static void draw_smpte_snow(DrawingData * dd)
+static void draw_snow_line(DrawingData * dd, Rand * r, uint8_t * line, int offset, int length)
+{
+	uint8_t noise[256];
+	int x, i, n;
+
+	for (x = offset; x < offset + length; x += n) {
+		n = SPA_MIN(offset + length - x, (int) sizeof(noise));
+		rand_fill(r, noise, n);
+
+		if (dd->uyvy) {
+			for (i = 0; i < n; i++) {
+				int px = x + i;
+				if (px & 1) {
+					line[2 * (px - 1) + 3] = gray_y[noise[i]];
+				} else {
+					line[2 * px + 0] = 128;
+					line[2 * px + 1] = gray_y[noise[i]];
+					line[2 * px + 2] = 128;
+				}
+			}
+		} else {
+			uint8_t *d = &line[3 * x];
+			for (i = 0; i < n; i++, d += 3)
+				d[0] = d[1] = d[2] = noise[i];
+		}
+	}
+}
+
+static void draw_smpte_snow(DrawingData * dd, Rand * r, int y0, int y1)
 {
 	int h, w;
-	int y1, y2;
-	int i, j;
+	int h1, h2;
+	int i, j, a, b, x;
+	uint8_t *line;
 
 	w = dd->width;
 	h = dd->height;
-	y1 = 2 * h / 3;
-	y2 = 3 * h / 4;
+	h1 = 2 * h / 3;
+	h2 = 3 * h / 4;
 
-	for (i = 0; i < y1; i++) {
+	/* color bars */
+	a = y0;
+	b = SPA_MIN(y1, h1);
+	if (a < b) {
 		for (j = 0; j < 7; j++) {
 			int x1 = j * w / 7;
 			int x2 = (j + 1) * w / 7;
-			draw_pixels(dd, x1, j, x2 - x1);
+			draw_pixels(dd, get_line(dd, a), x1, j, x2 - x1);
 		}
-		next_line(dd);
+		copy_lines(dd, a, b, line_bytes(dd, w));
 	}
 
-	for (i = y1; i < y2; i++) {
+	a = SPA_MAX(y0, h1);
+	b = SPA_MIN(y1, h2);
+	if (a < b) {
 		for (j = 0; j < 7; j++) {
 			int x1 = j * w / 7;
 			int x2 = (j + 1) * w / 7;
 			Color c = (j & 1) ? BLACK : BLUE - j;
 
-			draw_pixels(dd, x1, c, x2 - x1);
+			draw_pixels(dd, get_line(dd, a), x1, c, x2 - x1);
 		}
-		next_line(dd);
+		copy_lines(dd, a, b, line_bytes(dd, w));
 	}
 
-	for (i = y2; i < h; i++) {
-		int x = 0;
-
-		/* negative I */
-		draw_pixels(dd, x, NEG_I, w / 6);
-		x += w / 6;
-
-		/* white */
-		draw_pixels(dd, x, WHITE, w / 6);
-		x += w / 6;
-
-		/* positive Q */
-		draw_pixels(dd, x, POS_Q, w / 6);
-		x += w / 6;
-
-		/* pluge */
-		draw_pixels(dd, x, DARK_BLACK, w / 12);
-		x += w / 12;
-		draw_pixels(dd, x, BLACK, w / 12);
-		x += w / 12;
-		draw_pixels(dd, x, LIGHT_BLACK, w / 12);
-		x += w / 12;
-
-		/* war of the ants (a.k.a. snow) */
-		for (j = x; j < w; j++) {
-			Pixel p;
-			unsigned char r = rand();
-
-			p.R = r;
-			p.G = r;
-			p.B = r;
-			update_yuv(&p);
-			dd->draw_pixel(dd, j, &p);
-		}
+	a = SPA_MAX(y0, h2);
+	b = y1;
+	if (a >= b)
+		return;
 
-		next_line(dd);
-	}
+	x = 0;
+	line = get_line(dd, a);
+
+	/* negative I */
+	draw_pixels(dd, line, x, NEG_I, w / 6);
+	x += w / 6;
+
+	/* white */
+	draw_pixels(dd, line, x, WHITE, w / 6);
+	x += w / 6;
+
+	/* positive Q */
+	draw_pixels(dd, line, x, POS_Q, w / 6);
+	x += w / 6;
+
+	/* pluge */
+	draw_pixels(dd, line, x, DARK_BLACK, w / 12);
+	x += w / 12;
+	draw_pixels(dd, line, x, BLACK, w / 12);
+	x += w / 12;
+	draw_pixels(dd, line, x, LIGHT_BLACK, w / 12);
+	x += w / 12;
+
+	copy_lines(dd, a, b, line_bytes(dd, x));
+
+	/* war of the ants (a.k.a. snow) */
+	for (i = a; i < b; i++)
+		draw_snow_line(dd, r, get_line(dd, i), x, w - x);
 }
 
-static void draw_snow(DrawingData * dd)
+static void draw_snow(DrawingData * dd, Rand * r, int y0, int y1)
 {
-	int x, y;
-
-	for (y = 0; y < dd->height; y++) {
-		for (x = 0; x < dd->width; x++) {
-			Pixel p;
-			unsigned char r = rand();
-
-			p.R = r;
-			p.G = r;
-			p.B = r;
-			update_yuv(&p);
-			dd->draw_pixel(dd, x, &p);
-		}
+	int y;
 
-		next_line(dd);
-	}
+	for (y = y0; y < y1; y++)
+		draw_snow_line(dd, r, get_line(dd, y), 0, dd->width);
 }
 
-static int draw(struct impl *this, char *data)
+/* draw lines y0 to y1 of the frame */
+static int draw_lines(struct impl *this, uint8_t *data, int y0, int y1, uint32_t seed)
 {
 	DrawingData dd;
+	Rand r;
 	int res;
 	uint32_t pattern;
 
-	init_colors();
-
 	res = drawing_data_init(&dd, this, data);
 	if (res != SPA_RESULT_OK)
 		return res;
 
+	y1 = SPA_MIN(y1, dd.height);
+	rand_init(&r, seed);
+
 	pattern = this->props.pattern;
 	if (pattern == this->type.pattern_smpte_snow)
-		draw_smpte_snow(&dd);
+		draw_smpte_snow(&dd, &r, y0, y1);
 	else if (pattern == this->type.pattern_snow)
-		draw_snow(&dd);
+		draw_snow(&dd, &r, y0, y1);
 	else
 		return SPA_RESULT_NOT_IMPLEMENTED;
 
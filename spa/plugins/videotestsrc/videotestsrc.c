@@ -36,6 +36,7 @@
 
 #include <lib/format.h>
 #include <lib/props.h>
+#include <lib/workers.h>
 
 #define NAME "videotestsrc"
 
@@ -49,6 +50,7 @@ struct type {
 	uint32_t props;
 	uint32_t prop_live;
 	uint32_t prop_pattern;
+	uint32_t prop_threads;
 	uint32_t pattern_smpte_snow;
 	uint32_t pattern_snow;
 	struct spa_type_meta meta;
@@ -71,6 +73,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
 	type->prop_live = spa_type_map_get_id(map, SPA_TYPE_PROPS__live);
 	type->prop_pattern = spa_type_map_get_id(map, SPA_TYPE_PROPS__patternType);
+	type->prop_threads = spa_type_map_get_id(map, SPA_TYPE_PROPS__threads);
 	type->pattern_smpte_snow = spa_type_map_get_id(map, SPA_TYPE_PROPS__patternType ":smpte-snow");
 	type->pattern_snow = spa_type_map_get_id(map, SPA_TYPE_PROPS__patternType ":snow");
 	spa_type_meta_map(map, &type->meta);
@@ -88,10 +91,12 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 struct props {
 	bool live;
 	uint32_t pattern;
+	int threads;
 };
 
 #define MAX_BUFFERS 16
 #define MAX_PORTS 1
+#define MAX_THREADS 16
 
 struct buffer {
 	struct spa_buffer *outbuf;
@@ -138,6 +143,11 @@ struct impl {
 
 	uint64_t frame_count;
 	struct spa_list empty;
+
+	/* the frame is drawn in bands by the data thread and the workers */
+	uint8_t *frame;
+	int band_lines;
+	struct spa_workers *workers;
 };
 
 #define CHECK_PORT_NUM(this,d,p)  ((d) == SPA_DIRECTION_OUTPUT && (p) < MAX_PORTS)
@@ -145,11 +155,13 @@ struct impl {
 
 #define DEFAULT_LIVE true
 #define DEFAULT_PATTERN pattern_smpte_snow
+#define DEFAULT_THREADS 1
 
 static void reset_props(struct impl *this, struct props *props)
 {
 	props->live = DEFAULT_LIVE;
 	props->pattern = this->type.DEFAULT_PATTERN;
+	props->threads = DEFAULT_THREADS;
 }
 
 #define PROP(f,key,type,...)							\
@@ -183,7 +195,10 @@ static int impl_node_get_props(struct spa_node *node, struct spa_props **props)
 		PROP_EN(&f[1], this->type.prop_pattern, SPA_POD_TYPE_ID, 3,
 			this->props.pattern,
 			this->type.pattern_smpte_snow,
-			this->type.pattern_snow));
+			this->type.pattern_snow),
+		PROP_MM(&f[1], this->type.prop_threads, SPA_POD_TYPE_INT,
+			this->props.threads,
+			1, MAX_THREADS));
 
 	*props = SPA_POD_BUILDER_DEREF(&b, f[0].ref, struct spa_props);
 
@@ -204,8 +219,14 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 		spa_props_query(props,
 				this->type.prop_live, SPA_POD_TYPE_BOOL, &this->props.live,
 				this->type.prop_pattern, SPA_POD_TYPE_ID, &this->props.pattern,
+				this->type.prop_threads, SPA_POD_TYPE_INT, &this->props.threads,
 				0);
 	}
+	this->props.threads = SPA_CLAMP(this->props.threads, 1, MAX_THREADS);
+
+	/* the pool can be resized while a frame is drawn */
+	if (this->props.threads != spa_workers_get_threads(this->workers))
+		spa_workers_set_threads(this->workers, this->props.threads);
 
 	if (this->props.live)
 		this->info.flags |= SPA_PORT_INFO_FLAG_LIVE;
@@ -217,9 +238,35 @@ static int impl_node_set_props(struct spa_node *node, const struct spa_props *pr
 
 #include "draw.c"
 
+static void draw_band(struct impl *this, uint32_t band)
+{
+	int y0 = band * this->band_lines;
+
+	draw_lines(this, this->frame, y0, y0 + this->band_lines,
+		   this->frame_count * MAX_THREADS + band);
+}
+
+static void do_draw_band(void *data, uint32_t job)
+{
+	draw_band(data, job);
+}
+
 static int fill_buffer(struct impl *this, struct buffer *b)
 {
-	return draw(this, b->outbuf->datas[0].data);
+	int height = this->current_format.info.raw.size.height;
+	uint32_t n_bands = spa_workers_get_threads(this->workers);
+
+	init_colors();
+
+	this->frame = b->outbuf->datas[0].data;
+	this->band_lines = (height + n_bands - 1) / n_bands;
+
+	if (n_bands == 1)
+		return draw_lines(this, this->frame, 0, height, this->frame_count);
+
+	spa_workers_run(this->workers, n_bands);
+
+	return SPA_RESULT_OK;
 }
 
 static void set_timer(struct impl *this, bool enabled)
@@ -915,6 +962,8 @@ static int impl_clear(struct spa_handle *handle)
 
 	this = (struct impl *) handle;
 
+	spa_workers_destroy(this->workers);
+
 	if (this->data_loop)
 		spa_loop_remove_source(this->data_loop, &this->timer_source);
 	close(this->timer_source.fd);
@@ -960,6 +1009,11 @@ impl_init(const struct spa_handle_factory *factory,
 
 	spa_list_init(&this->empty);
 
+	this->workers = spa_workers_new(this->log, MAX_THREADS, this->props.threads,
+					do_draw_band, this);
+	if (this->workers == NULL)
+		return SPA_RESULT_NO_MEMORY;
+
 	this->timer_source.func = on_output;
 	this->timer_source.data = this;
 	this->timer_source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
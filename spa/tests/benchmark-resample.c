@@ -0,0 +1,105 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <spa/defs.h>
+
+#include <plugins/audioconvert/fmt-ops.h>
+#include <plugins/audioconvert/resample.h>
+
+#define CHANNELS	2
+#define BLOCK		1024
+
+static float in[CHANNELS][BLOCK];
+static float out[CHANNELS][BLOCK * 4];
+
+static uint64_t get_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
+
+static void run(uint32_t i_rate, uint32_t o_rate, uint32_t quality, uint32_t features,
+		double rate, uint32_t seconds)
+{
+	struct resample r = { 0, };
+	const void *src[CHANNELS];
+	void *dst[CHANNELS];
+	uint32_t c, n_in = 0, n_out = 0;
+	uint64_t start, elapsed;
+
+	r.channels = CHANNELS;
+	r.i_rate = i_rate;
+	r.o_rate = o_rate;
+	r.quality = quality;
+	r.cpu_flags = features;
+	r.rate = rate;
+	if (resample_native_init(&r) < 0) {
+		printf("can't init resampler\n");
+		return;
+	}
+
+	start = get_time();
+	while (n_in < i_rate * seconds) {
+		uint32_t in_len = BLOCK, out_len = BLOCK * 4;
+
+		for (c = 0; c < CHANNELS; c++) {
+			src[c] = in[c];
+			dst[c] = out[c];
+		}
+		resample_process(&r, src, &in_len, dst, &out_len);
+		n_in += in_len;
+		n_out += out_len;
+	}
+	elapsed = get_time() - start;
+
+	printf("%6u -> %6u quality %u %-5s %-6s %8.1f ns/frame %8.1fx realtime\n",
+	       i_rate, o_rate, quality, features ? "sse" : "c", rate == 1.0 ? "fixed" : "adjust",
+	       (double) elapsed / n_out,
+	       seconds * (double) SPA_NSEC_PER_SEC / elapsed);
+
+	resample_free(&r);
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t q, c, i, seconds;
+
+	seconds = argc > 1 ? atoi(argv[1]) : 10;
+
+	for (c = 0; c < CHANNELS; c++)
+		for (i = 0; i < BLOCK; i++)
+			in[c][i] = (float) rand() / RAND_MAX - 0.5f;
+
+	for (q = RESAMPLE_QUALITY_MIN; q <= RESAMPLE_QUALITY_MAX; q++) {
+		run(44100, 48000, q, 0, 1.0, seconds);
+		run(44100, 48000, q, 0, 1.0001, seconds);
+#if defined(HAVE_SSE2)
+		run(44100, 48000, q, FEATURE_SSE2, 1.0, seconds);
+		run(44100, 48000, q, FEATURE_SSE2, 1.0001, seconds);
+#endif
+	}
+	return 0;
+}
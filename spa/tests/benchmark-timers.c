@@ -0,0 +1,199 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include <spa/log-impl.h>
+#include <spa/loop.h>
+#include <spa/type-map-impl.h>
+
+static SPA_TYPE_MAP_IMPL(default_map, 4096);
+static SPA_LOG_IMPL(default_log);
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_log *log;
+	struct spa_support support[2];
+	uint32_t n_support;
+
+	void *hnd;
+	struct spa_handle *handle;
+	struct spa_loop_control *control;
+	struct spa_loop_utils *utils;
+
+	struct spa_source **timers;
+	uint32_t n_timers;
+	uint32_t fired;
+};
+
+static int make_loop(struct data *data, const char *lib)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t i;
+	int res;
+
+	if ((data->hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return SPA_RESULT_ERROR;
+	}
+	if ((enum_func = dlsym(data->hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return SPA_RESULT_ERROR;
+	}
+
+	for (i = 0;; i++) {
+		const struct spa_handle_factory *factory;
+		void *iface;
+
+		if ((res = enum_func(&factory, i)) < 0) {
+			if (res != SPA_RESULT_ENUM_END)
+				printf("can't enumerate factories: %d\n", res);
+			break;
+		}
+		if (strcmp(factory->name, "loop"))
+			continue;
+
+		data->handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, data->handle, NULL,
+						   data->support, data->n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return res;
+		}
+		if ((res = spa_handle_get_interface(data->handle,
+				spa_type_map_get_id(data->map, SPA_TYPE__LoopControl),
+				&iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return res;
+		}
+		data->control = iface;
+		if ((res = spa_handle_get_interface(data->handle,
+				spa_type_map_get_id(data->map, SPA_TYPE__LoopUtils),
+				&iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return res;
+		}
+		data->utils = iface;
+		return SPA_RESULT_OK;
+	}
+	return SPA_RESULT_ERROR;
+}
+
+static uint64_t get_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
+
+static void report(const char *what, uint32_t count, uint64_t elapsed)
+{
+	printf("%-10s %10u ops %10.3f ms %10.1f ns/op %12.0f ops/s\n", what, count,
+	       elapsed / 1000000.0, (double) elapsed / count,
+	       count * (double) SPA_NSEC_PER_SEC / elapsed);
+}
+
+static void on_timeout(struct spa_loop_utils *utils, struct spa_source *source, void *data)
+{
+	struct data *d = data;
+	d->fired++;
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { NULL };
+	struct timespec value;
+	uint32_t i, j, rounds;
+	uint64_t start;
+	int res;
+	const char *str;
+
+	data.map = &default_map.map;
+	data.log = &default_log.log;
+
+	if ((str = getenv("SPA_DEBUG")))
+		data.log->level = atoi(str);
+
+	data.n_timers = argc > 1 ? atoi(argv[1]) : 10000;
+	rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+	data.support[0].type = SPA_TYPE__TypeMap;
+	data.support[0].data = data.map;
+	data.support[1].type = SPA_TYPE__Log;
+	data.support[1].data = data.log;
+	data.n_support = 2;
+
+	if ((res = make_loop(&data, "build/spa/plugins/support/libspa-support.so")) < 0) {
+		printf("can't create loop: %d\n", res);
+		return -1;
+	}
+
+	data.timers = calloc(data.n_timers, sizeof(struct spa_source *));
+
+	start = get_time();
+	for (i = 0; i < data.n_timers; i++)
+		data.timers[i] = spa_loop_utils_add_timer(data.utils, on_timeout, &data);
+	report("add", data.n_timers, get_time() - start);
+
+	/* arm with spread out timeouts far enough in the future that none fire */
+	start = get_time();
+	for (j = 0; j < rounds; j++) {
+		for (i = 0; i < data.n_timers; i++) {
+			value.tv_sec = 10 + (i * 7919 + j) % 1000;
+			value.tv_nsec = (i * 104729) % SPA_NSEC_PER_SEC;
+			spa_loop_utils_update_timer(data.utils, data.timers[i], &value, NULL, false);
+		}
+	}
+	report("arm", data.n_timers * rounds, get_time() - start);
+
+	start = get_time();
+	for (i = 0; i < data.n_timers; i++)
+		spa_loop_utils_update_timer(data.utils, data.timers[i], NULL, NULL, false);
+	report("cancel", data.n_timers, get_time() - start);
+
+	/* arm everything to expire soon and dispatch */
+	for (i = 0; i < data.n_timers; i++) {
+		value.tv_sec = 0;
+		value.tv_nsec = 1000000 + (i % 1000) * 1000;
+		spa_loop_utils_update_timer(data.utils, data.timers[i], &value, NULL, false);
+	}
+	start = get_time();
+	spa_loop_control_enter(data.control);
+	while (data.fired < data.n_timers)
+		spa_loop_control_iterate(data.control, -1);
+	spa_loop_control_leave(data.control);
+	report("dispatch", data.fired, get_time() - start);
+
+	start = get_time();
+	for (i = 0; i < data.n_timers; i++)
+		spa_loop_utils_destroy_source(data.utils, data.timers[i]);
+	report("destroy", data.n_timers, get_time() - start);
+
+	free(data.timers);
+	spa_handle_clear(data.handle);
+	free(data.handle);
+	dlclose(data.hnd);
+
+	return 0;
+}
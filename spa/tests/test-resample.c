@@ -0,0 +1,248 @@
+/* Spa
+ * Copyright (C) 2017 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <spa/defs.h>
+
+#include <plugins/audioconvert/fmt-ops.h>
+#include <plugins/audioconvert/resample.h>
+
+#define BLOCK		256
+#define FREQ		1000.0
+#define AMPLITUDE	0.5
+
+/* THD+N limits in dB for sines inside the passband, per quality. The
+ * higher qualities are limited by the float precision. */
+static const double thd_limit[RESAMPLE_QUALITY_MAX + 1] = {
+	-90.0, -100.0, -110.0, -120.0, -120.0, -120.0, -120.0,
+};
+
+static int init_resample(struct resample *r, uint32_t i_rate, uint32_t o_rate,
+			 uint32_t quality, uint32_t features)
+{
+	memset(r, 0, sizeof(struct resample));
+	r->channels = 1;
+	r->i_rate = i_rate;
+	r->o_rate = o_rate;
+	r->quality = quality;
+	r->cpu_flags = features;
+	return resample_native_init(r);
+}
+
+/* push n_in frames through the resampler in blocks, return the number of
+ * output frames */
+static uint32_t run(struct resample *r, const float *in, uint32_t n_in, float *out, uint32_t max_out)
+{
+	uint32_t in_done = 0, out_done = 0;
+
+	while (in_done < n_in && out_done < max_out) {
+		uint32_t in_len = SPA_MIN(n_in - in_done, BLOCK);
+		uint32_t out_len = max_out - out_done;
+		const void *src[1] = { &in[in_done] };
+		void *dst[1] = { &out[out_done] };
+
+		resample_process(r, src, &in_len, dst, &out_len);
+		in_done += in_len;
+		out_done += out_len;
+	}
+	return out_done;
+}
+
+/* least squares fit of a sine at freq, returns the power of the residual
+ * relative to the fitted sine in dB */
+static double thd_n(const float *s, uint32_t n, double freq, double rate)
+{
+	double ss = 0.0, cc = 0.0, sc = 0.0, ys = 0.0, yc = 0.0;
+	double a, b, det, sig = 0.0, err = 0.0;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		double w = 2.0 * M_PI * freq * i / rate;
+		ss += sin(w) * sin(w);
+		cc += cos(w) * cos(w);
+		sc += sin(w) * cos(w);
+		ys += s[i] * sin(w);
+		yc += s[i] * cos(w);
+	}
+	det = ss * cc - sc * sc;
+	a = (ys * cc - yc * sc) / det;
+	b = (yc * ss - ys * sc) / det;
+
+	for (i = 0; i < n; i++) {
+		double w = 2.0 * M_PI * freq * i / rate;
+		double fit = a * sin(w) + b * cos(w);
+		sig += fit * fit;
+		err += (s[i] - fit) * (s[i] - fit);
+	}
+	return 10.0 * log10(err / sig);
+}
+
+static int test_thd(uint32_t i_rate, uint32_t o_rate, double freq, uint32_t quality, uint32_t features)
+{
+	struct resample r;
+	uint32_t i, n_in = i_rate, max_out = o_rate * 2, n_out, skip;
+	float *in, *out;
+	double thd;
+	int res = 0;
+
+	in = malloc(n_in * sizeof(float));
+	out = malloc(max_out * sizeof(float));
+	for (i = 0; i < n_in; i++)
+		in[i] = AMPLITUDE * sin(2.0 * M_PI * freq * i / i_rate);
+
+	init_resample(&r, i_rate, o_rate, quality, features);
+	n_out = run(&r, in, n_in, out, max_out);
+
+	/* skip the filter startup */
+	skip = (uint64_t) resample_delay(&r) * 2 * o_rate / i_rate + 16;
+	thd = thd_n(out + skip, n_out - skip, freq, o_rate);
+	if (thd > thd_limit[quality])
+		res = -1;
+
+	printf("thd %6u -> %6u %5.0f Hz quality %u %-4s: %8.1f dB (limit %6.1f) %s\n",
+	       i_rate, o_rate, freq, quality, features ? "sse" : "c", thd, thd_limit[quality],
+	       res == 0 ? "ok" : "FAIL");
+
+	resample_free(&r);
+	free(in);
+	free(out);
+	return res;
+}
+
+/* feed an impulse one frame at a time and check that it comes out after
+ * the number of input frames reported by resample_delay() */
+static int test_latency(uint32_t i_rate, uint32_t o_rate, uint32_t quality)
+{
+	struct resample r;
+	uint32_t i, fed, n_out = 0, impulse = 1000, peak_pos = 0, expected, time, latency = 0;
+	float in = 0.0f, out[64], peak = 0.0f;
+	int res = 0;
+
+	init_resample(&r, i_rate, o_rate, quality, 0);
+	expected = (uint64_t) impulse * o_rate / i_rate;
+	/* the input frame that the expected output is aligned to */
+	time = (uint64_t) expected * i_rate / o_rate;
+
+	for (fed = 0; fed < impulse + 4096 && latency == 0; fed++) {
+		uint32_t in_len = 1, out_len = SPA_N_ELEMENTS(out);
+		const void *src[1] = { &in };
+		void *dst[1] = { out };
+
+		in = fed == impulse ? 1.0f : 0.0f;
+		resample_process(&r, src, &in_len, dst, &out_len);
+
+		for (i = 0; i < out_len; i++, n_out++) {
+			if (fabsf(out[i]) > peak) {
+				peak = fabsf(out[i]);
+				peak_pos = n_out;
+			}
+			if (n_out == expected)
+				latency = fed - time;
+		}
+	}
+
+	if (latency != resample_delay(&r) || peak_pos < expected - 1 || peak_pos > expected + 1)
+		res = -1;
+
+	printf("latency %6u -> %6u quality %u: %4u frames (reported %4u), peak at %u (expected %u) %s\n",
+	       i_rate, o_rate, quality, latency, resample_delay(&r), peak_pos, expected,
+	       res == 0 ? "ok" : "FAIL");
+
+	resample_free(&r);
+	return res;
+}
+
+/* changing the rate while running must change the ratio of produced
+ * samples and keep the signal clean */
+static int test_rate(uint32_t i_rate, uint32_t o_rate, double rate)
+{
+	struct resample r;
+	uint32_t i, n_in = i_rate, max_out = o_rate * 2, n_out, warm;
+	float *in, *out;
+	double expected, thd;
+	int res = 0;
+
+	in = malloc(n_in * sizeof(float));
+	out = malloc(max_out * sizeof(float));
+	for (i = 0; i < n_in; i++)
+		in[i] = AMPLITUDE * sin(2.0 * M_PI * FREQ * i / i_rate);
+
+	init_resample(&r, i_rate, o_rate, RESAMPLE_QUALITY_DEFAULT, 0);
+
+	warm = run(&r, in, i_rate / 10, out, max_out);
+	resample_update_rate(&r, rate);
+	n_out = run(&r, in + i_rate / 10, n_in - i_rate / 10, out + warm, max_out - warm);
+
+	expected = (n_in - i_rate / 10) * (double) o_rate / i_rate / rate;
+	if (fabs(n_out - expected) > resample_delay(&r) * 2)
+		res = -1;
+
+	/* the input is consumed faster with a higher rate, which raises the
+	 * frequency of the output */
+	thd = thd_n(out + warm + 64, n_out - 64, FREQ * rate, o_rate);
+	if (thd > thd_limit[RESAMPLE_QUALITY_DEFAULT])
+		res = -1;
+
+	printf("rate %6u -> %6u rate %.4f: %u frames (expected %.0f), %8.1f dB %s\n",
+	       i_rate, o_rate, rate, n_out, expected, thd, res == 0 ? "ok" : "FAIL");
+
+	resample_free(&r);
+	free(in);
+	free(out);
+	return res;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t rates[][2] = {
+		{ 44100, 48000 },
+		{ 48000, 44100 },
+		{ 48000, 96000 },
+		{ 96000, 48000 },
+		{ 44100, 44100 },
+	};
+	static const double freqs[] = { 1000.0, 10000.0 };
+	uint32_t i, j, q;
+	int res = 0;
+
+	for (i = 0; i < SPA_N_ELEMENTS(rates); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(freqs); j++) {
+			for (q = RESAMPLE_QUALITY_MIN; q <= RESAMPLE_QUALITY_MAX; q++) {
+				res |= test_thd(rates[i][0], rates[i][1], freqs[j], q, 0);
+#if defined(HAVE_SSE2)
+				res |= test_thd(rates[i][0], rates[i][1], freqs[j], q,
+						FEATURE_SSE2);
+#endif
+			}
+		}
+	}
+	for (i = 0; i < SPA_N_ELEMENTS(rates); i++)
+		res |= test_latency(rates[i][0], rates[i][1], RESAMPLE_QUALITY_DEFAULT);
+
+	res |= test_rate(44100, 48000, 1.001);
+	res |= test_rate(48000, 48000, 0.999);
+
+	printf("%s\n", res == 0 ? "all tests passed" : "some tests FAILED");
+
+	return res == 0 ? 0 : -1;
+}
@@ -40,12 +40,85 @@ struct pw_client_node_proxy;
 
 struct pw_client_node_message;
 
+/** Clock of the graph driver, shared between client and server
+ *
+ * The server updates the clock from the data thread every cycle. The
+ * fields are protected by a seqlock: \a seq is odd while an update is
+ * in progress and readers retry until they see the same even value
+ * before and after reading.
+ * \memberof pw_client_node
+ */
+struct pw_client_node_clock {
+	uint32_t seq;			/**< sequence number, odd while writing */
+	int32_t rate;			/**< rate of the ticks, 0 when no driver clock */
+	int64_t ticks;			/**< ticks of the driver at \a monotonic_time */
+	int64_t monotonic_time;		/**< monotonic time in nanoseconds */
+	uint32_t driver;		/**< id of the driver clock, changes when another
+					  *  node starts driving the graph */
+};
+
+/** Publish a new clock snapshot, only called from one thread */
+static inline void
+pw_client_node_clock_write(struct pw_client_node_clock *clock,
+			   uint32_t driver, int32_t rate, int64_t ticks, int64_t monotonic_time)
+{
+	uint32_t seq = clock->seq;
+
+	__atomic_store_n(&clock->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&clock->rate, rate, __ATOMIC_RELAXED);
+	__atomic_store_n(&clock->ticks, ticks, __ATOMIC_RELAXED);
+	__atomic_store_n(&clock->monotonic_time, monotonic_time, __ATOMIC_RELAXED);
+	__atomic_store_n(&clock->driver, driver, __ATOMIC_RELAXED);
+	__atomic_store_n(&clock->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/** Read a consistent clock snapshot, giving up after \a max_tries
+ * attempts. Readers that can't trust the writer use this so that they
+ * never spin on a seqlock that is left odd.
+ * \return false when no driver clock was published yet or no consistent
+ *  snapshot could be read */
+static inline bool
+pw_client_node_clock_try_read(struct pw_client_node_clock *clock, uint32_t max_tries,
+			      uint32_t *driver, int32_t *rate, int64_t *ticks,
+			      int64_t *monotonic_time)
+{
+	uint32_t seq1, seq2;
+
+	do {
+		if (max_tries-- == 0)
+			return false;
+		seq1 = __atomic_load_n(&clock->seq, __ATOMIC_ACQUIRE);
+		*rate = __atomic_load_n(&clock->rate, __ATOMIC_RELAXED);
+		*ticks = __atomic_load_n(&clock->ticks, __ATOMIC_RELAXED);
+		*monotonic_time = __atomic_load_n(&clock->monotonic_time, __ATOMIC_RELAXED);
+		*driver = __atomic_load_n(&clock->driver, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		seq2 = __atomic_load_n(&clock->seq, __ATOMIC_RELAXED);
+	} while ((seq1 & 1) || seq1 != seq2);
+
+	return *rate != 0;
+}
+
+/** Read a consistent clock snapshot, can be called from any thread
+ * \return false when no driver clock was published yet */
+static inline bool
+pw_client_node_clock_read(struct pw_client_node_clock *clock,
+			  uint32_t *driver, int32_t *rate, int64_t *ticks, int64_t *monotonic_time)
+{
+	return pw_client_node_clock_try_read(clock, UINT32_MAX, driver, rate, ticks,
+					     monotonic_time);
+}
+
 /** Shared structure between client and server \memberof pw_client_node */
 struct pw_client_node_area {
 	uint32_t max_input_ports;	/**< max input ports of the node */
 	uint32_t n_input_ports;		/**< number of input ports of the node */
 	uint32_t max_output_ports;	/**< max output ports of the node */
 	uint32_t n_output_ports;	/**< number of output ports of the node */
+	struct pw_client_node_clock clock;	/**< clock of the graph driver */
+	struct pw_client_node_clock node_clock;	/**< clock of the client, written by the
+						  *  client when it drives the graph */
 };
 
 /** \class pw_client_node_transport
@@ -60,6 +133,10 @@ struct pw_client_node_transport {
 	struct pw_client_node_area *area;	/**< the transport area */
 	struct spa_port_io *inputs;		/**< array of input port io */
 	struct spa_port_io *outputs;		/**< array of output port io */
+	uint64_t *input_reuse;			/**< per input port, bitmap of buffer ids
+						  *  recycled by the client */
+	uint64_t *output_reuse;			/**< per output port, bitmap of buffer ids
+						  *  released by the server */
 	void *input_data;			/**< input memory for ringbuffer */
 	struct spa_ringbuffer *input_buffer;	/**< ringbuffer for input memory */
 	void *output_data;			/**< output memory for ringbuffer */
@@ -115,6 +192,7 @@ enum pw_client_node_message_type {
 	PW_CLIENT_NODE_MESSAGE_REUSE_BUFFER,
 	PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT,
 	PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT,
+	PW_CLIENT_NODE_MESSAGE_REUSE_BUFFERS,
 };
 
 struct pw_client_node_message_body {
@@ -155,6 +233,29 @@ struct pw_client_node_message_reuse_buffer {
 		SPA_POD_INT_INIT(buffer_id))
 
 
+/** Buffer ids that can be passed in a reuse bitmap */
+#define PW_CLIENT_NODE_MAX_REUSE_IDS	64
+
+/** Mark \a buffer_id as reused in a reuse bitmap of the transport
+ *
+ * The buffer is handed over with a single PW_CLIENT_NODE_MESSAGE_REUSE_BUFFERS
+ * message for all buffers that were marked since the last one.
+ * \return false when \a buffer_id does not fit in the bitmap and a
+ *  PW_CLIENT_NODE_MESSAGE_REUSE_BUFFER message should be used instead */
+static inline bool pw_client_node_reuse_mark(uint64_t *reuse, uint32_t buffer_id)
+{
+	if (buffer_id >= PW_CLIENT_NODE_MAX_REUSE_IDS)
+		return false;
+	__atomic_fetch_or(reuse, (uint64_t) 1 << buffer_id, __ATOMIC_RELEASE);
+	return true;
+}
+
+/** Take all buffer ids marked in a reuse bitmap */
+static inline uint64_t pw_client_node_reuse_take(uint64_t *reuse)
+{
+	return __atomic_exchange_n(reuse, 0, __ATOMIC_ACQUIRE);
+}
+
 /** information about a buffer */
 struct pw_client_node_buffer {
 	uint32_t mem_id;		/**< the memory id for the metadata */
@@ -187,15 +288,18 @@ struct pw_client_node_proxy_methods {
 	 * \param max_input_ports new max input ports
 	 * \param max_output_ports new max output ports
 	 * \param props new properties
+	 * \param node_props node properties to update, like node.latency
 	 */
 	void (*update) (void *object,
 #define PW_CLIENT_NODE_UPDATE_MAX_INPUTS   (1 << 0)
 #define PW_CLIENT_NODE_UPDATE_MAX_OUTPUTS  (1 << 1)
 #define PW_CLIENT_NODE_UPDATE_PROPS        (1 << 2)
+#define PW_CLIENT_NODE_UPDATE_NODE_PROPS   (1 << 3)
 			uint32_t change_mask,
 			uint32_t max_input_ports,
 			uint32_t max_output_ports,
-			const struct spa_props *props);
+			const struct spa_props *props,
+			const struct spa_dict *node_props);
 
 	/**
 	 * Update a node port
@@ -247,12 +351,14 @@ pw_client_node_proxy_update(struct pw_client_node_proxy *p,
 			    uint32_t change_mask,
 			    uint32_t max_input_ports,
 			    uint32_t max_output_ports,
-			    const struct spa_props *props)
+			    const struct spa_props *props,
+			    const struct spa_dict *node_props)
 {
         pw_proxy_do((struct pw_proxy*)p, struct pw_client_node_proxy_methods, update, change_mask,
 							      max_input_ports,
 							      max_output_ports,
-							      props);
+							      props,
+							      node_props);
 }
 
 static inline void
@@ -328,6 +328,9 @@ struct node_data {
   uint32_t id;
   uint32_t parent_id;
   struct spa_hook node_listener;
+  struct spa_hook proxy_listener;
+  struct pw_node_info *info;
+  GstDevice *dev;
 };
 
 struct registry_data {
@@ -340,15 +343,33 @@ static void node_event_info(void *data, struct pw_node_info *info)
 {
   struct node_data *node_data = data;
   GstPipeWireDeviceProvider *self = node_data->self;
+  GstDeviceProvider *provider = GST_DEVICE_PROVIDER (self);
+  GstPipeWireDevice *old;
   GstDevice *dev;
 
-  dev = new_node (self, info, node_data->id);
-  if (dev) {
-    if(self->list_only)
+  /* the event only carries the changed fields, keep the complete info */
+  info = node_data->info = pw_node_info_update (node_data->info, info);
+
+  if (self->list_only) {
+    /* a probe lists the device of the latest info of each node */
+    if (node_data->dev) {
+      *self->devices = g_list_remove (*self->devices, node_data->dev);
+      gst_object_unref (node_data->dev);
+    }
+    node_data->dev = dev = new_node (self, info, node_data->id);
+    if (dev)
       *self->devices = g_list_prepend (*self->devices, gst_object_ref_sink (dev));
-    else
-      gst_device_provider_device_add (GST_DEVICE_PROVIDER (self), dev);
+    return;
+  }
+
+  old = find_device (provider, node_data->id);
+  if (old != NULL) {
+    gst_device_provider_device_remove (provider, GST_DEVICE (old));
+    gst_object_unref (old);
   }
+  dev = new_node (self, info, node_data->id);
+  if (dev)
+    gst_device_provider_device_add (provider, dev);
 }
 
 static const struct pw_node_proxy_events node_events = {
@@ -356,6 +377,22 @@ static const struct pw_node_proxy_events node_events = {
   .info = node_event_info
 };
 
+static void
+destroy_node (void *data)
+{
+  struct node_data *nd = data;
+
+  if (nd->info) {
+    pw_node_info_free (nd->info);
+    nd->info = NULL;
+  }
+}
+
+static const struct pw_proxy_events proxy_events = {
+  PW_VERSION_PROXY_EVENTS,
+  .destroy = destroy_node,
+};
+
 
 static void registry_event_global(void *data, uint32_t id, uint32_t parent_id, uint32_t permissions,
 				  uint32_t type, uint32_t version)
@@ -377,7 +414,10 @@ static void registry_event_global(void *data, uint32_t id, uint32_t parent_id, u
   nd->node = node;
   nd->id = id;
   nd->parent_id = parent_id;
+  nd->info = NULL;
+  nd->dev = NULL;
   pw_node_proxy_add_listener(node, &nd->node_listener, &node_events, nd);
+  pw_proxy_add_listener((struct pw_proxy*)node, &nd->proxy_listener, &proxy_events, nd);
 
   return;
 
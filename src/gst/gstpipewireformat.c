@@ -27,6 +27,7 @@
 #include <spa/format-builder.h>
 #include <spa/video/format-utils.h>
 #include <spa/audio/format-utils.h>
+#include <spa/lib/format.h>
 
 #include "gstpipewireformat.h"
 
@@ -528,20 +529,6 @@ handle_audio_fields (ConvertData *d)
   return TRUE;
 }
 
-static uint32_t
-write_pod (struct spa_pod_builder *b, uint32_t ref, const void *data, uint32_t size)
-{
-  if (ref == -1)
-    ref = b->offset;
-
-  if (b->size <= b->offset) {
-    b->size = SPA_ROUND_UP_N (b->offset + size, 512);
-    b->data = realloc (b->data, b->size);
-  }
-  memcpy (b->data + ref, data, size);
-  return ref;
-}
-
 static struct spa_format *
 convert_1 (GstCapsFeatures *cf, GstStructure *cs)
 {
@@ -555,7 +542,7 @@ convert_1 (GstCapsFeatures *cf, GstStructure *cs)
   if (!(d.type = find_media_types (gst_structure_get_name (cs))))
     return NULL;
 
-  d.b.write = write_pod;
+  spa_pod_builder_set_overflow (&d.b, spa_pod_builder_realloc);
 
   spa_pod_builder_push_format (&d.b, &f, type.format,
                                *d.type->media_type,
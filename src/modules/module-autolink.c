@@ -23,11 +23,17 @@
 
 #include "config.h"
 
+#include "pipewire/pipewire.h"
 #include "pipewire/core.h"
 #include "pipewire/interfaces.h"
 #include "pipewire/link.h"
 #include "pipewire/log.h"
 #include "pipewire/module.h"
+#include "pipewire/type.h"
+#include "modules/spa/spa-node.h"
+
+#define AUDIOCONVERT_LIB "audioconvert/libspa-audioconvert"
+#define VIDEOCONVERT_LIB "videoconvert/libspa-videoconvert"
 
 struct impl {
 	struct pw_core *core;
@@ -49,6 +55,10 @@ struct node_info {
 
 	struct pw_link *link;
 	struct spa_hook link_listener;
+
+	/* converter between the node and its target when their formats
+	 * don't match */
+	struct pw_node *convert;
 };
 
 static struct node_info *find_node_info(struct impl *impl, struct pw_node *node)
@@ -62,8 +72,24 @@ static struct node_info *find_node_info(struct impl *impl, struct pw_node *node)
 	return NULL;
 }
 
+static void destroy_converter(struct node_info *info)
+{
+	struct pw_node *convert = info->convert;
+
+	if (convert == NULL)
+		return;
+
+	/* the link to the converter goes away with it, don't relink */
+	spa_hook_remove(&info->link_listener);
+	spa_list_init(&info->link_listener.link);
+
+	info->convert = NULL;
+	pw_node_destroy(convert);
+}
+
 static void node_info_free(struct node_info *info)
 {
+	destroy_converter(info);
 	spa_list_remove(&info->l);
 	spa_hook_remove(&info->node_listener);
 	spa_hook_remove(&info->link_listener);
@@ -130,6 +156,113 @@ static const struct pw_link_events link_events = {
 	.state_changed = link_state_changed,
 };
 
+static bool can_link(struct impl *impl, struct pw_port *port, struct pw_port *target)
+{
+	char *error = NULL;
+	struct spa_format *format;
+
+	if (pw_port_get_direction(port) == PW_DIRECTION_OUTPUT)
+		format = pw_core_find_format(impl->core, port, target, NULL, 0, NULL, &error);
+	else
+		format = pw_core_find_format(impl->core, target, port, NULL, 0, NULL, &error);
+
+	free(error);
+	return format != NULL;
+}
+
+static struct pw_link *
+make_link(struct impl *impl, struct pw_port *port, struct pw_port *target, char **error)
+{
+	struct pw_link *link;
+
+	if (pw_port_get_direction(port) == PW_DIRECTION_INPUT) {
+	        struct pw_port *tmp = target;
+		target = port;
+		port = tmp;
+	}
+
+	link = pw_link_new(impl->core, pw_module_get_global(impl->module), port, target, NULL, NULL, error);
+	if (link != NULL)
+		pw_link_activate(link);
+
+	return link;
+}
+
+/* load a converter for the media type of the port */
+static struct pw_node *make_converter(struct impl *impl, struct pw_port *port)
+{
+	struct spa_format *format;
+	const char *lib, *factory_name;
+	uint32_t media_type;
+
+	if (pw_port_enum_formats(port, &format, NULL, 0) < 0)
+		return NULL;
+
+	media_type = SPA_FORMAT_MEDIA_TYPE(format);
+	if (media_type == impl->t->media_type.audio) {
+		lib = AUDIOCONVERT_LIB;
+		factory_name = "audioconvert";
+	} else if (media_type == impl->t->media_type.video) {
+		lib = VIDEOCONVERT_LIB;
+		factory_name = "videoconvert";
+	} else
+		return NULL;
+
+	return pw_spa_node_load(impl->core, NULL, pw_module_get_global(impl->module),
+				lib, factory_name, factory_name, NULL);
+}
+
+/* link the port to a target through a converter */
+static struct pw_link *
+link_converter(struct impl *impl, struct pw_port *port, uint32_t path_id,
+	       struct node_info *info, char **error)
+{
+	struct pw_node *convert;
+	struct pw_port *near, *far, *target;
+	struct pw_link *link;
+	enum pw_direction direction = pw_port_get_direction(port);
+
+	destroy_converter(info);
+
+	if ((convert = make_converter(impl, port)) == NULL) {
+		asprintf(error, "no converter for the format of the port");
+		return NULL;
+	}
+	info->convert = convert;
+
+	near = pw_node_get_free_port(convert, pw_direction_reverse(direction));
+	far = pw_node_get_free_port(convert, direction);
+	if (near == NULL || far == NULL || !can_link(impl, port, near)) {
+		asprintf(error, "converter can't be linked to the port");
+		goto failed;
+	}
+
+	if ((link = make_link(impl, port, near, error)) == NULL)
+		goto failed;
+
+	target = pw_core_find_port(impl->core, far, path_id, NULL, 0, NULL, error);
+	if (target == NULL)
+		goto failed;
+
+	if (pw_port_get_node(target) == convert ||
+	    pw_port_get_node(target) == pw_port_get_node(port)) {
+		asprintf(error, "no target for the converter");
+		goto failed;
+	}
+
+	if (make_link(impl, far, target, error) == NULL)
+		goto failed;
+
+	pw_log_debug("module %p: linked port %p to %p with converter %p", impl,
+		     port, target, convert);
+
+	return link;
+
+      failed:
+	destroy_converter(info);
+	return NULL;
+}
+
 static void try_link_port(struct pw_node *node, struct pw_port *port, struct node_info *info)
 {
 	struct impl *impl = info->impl;
@@ -161,23 +294,21 @@ static void try_link_port(struct pw_node *node, struct pw_port *port, struct nod
 	pw_log_debug("module %p: try to find and link to node '%d'", impl, path_id);
 
 	target = pw_core_find_port(impl->core, port, path_id, NULL, 0, NULL, &error);
-	if (target == NULL)
-		goto error;
-
-	if (pw_port_get_direction(port) == PW_DIRECTION_INPUT) {
-	        struct pw_port *tmp = target;
-		target = port;
-		port = tmp;
+	if (target != NULL && can_link(impl, port, target)) {
+		link = make_link(impl, port, target, &error);
+	} else {
+		/* no target with a matching format, go through a converter */
+		free(error);
+		error = NULL;
+		link = link_converter(impl, port, path_id, info, &error);
 	}
-
-	link = pw_link_new(impl->core, pw_module_get_global(impl->module), port, target, NULL, NULL, &error);
 	if (link == NULL)
 		goto error;
 
 	info->link = link;
 
+	spa_hook_remove(&info->link_listener);
 	pw_link_add_listener(link, &info->link_listener, &link_events, info);
-	pw_link_activate(link);
 
 	return;
 
@@ -29,6 +29,7 @@
 #include <sys/eventfd.h>
 
 #include "spa/node.h"
+#include "spa/clock.h"
 #include "spa/format-builder.h"
 #include "spa/lib/format.h"
 
@@ -36,6 +37,7 @@
 #include "pipewire/interfaces.h"
 
 #include "pipewire/core.h"
+#include "pipewire/private.h"
 #include "modules/spa/spa-node.h"
 #include "client-node.h"
 #include "transport.h"
@@ -47,6 +49,8 @@
 
 #define MAX_BUFFERS      64
 
+#define MAX_CLOCK_TRIES  16
+
 #define CHECK_IN_PORT_ID(this,d,p)       ((d) == SPA_DIRECTION_INPUT && (p) < MAX_INPUTS)
 #define CHECK_OUT_PORT_ID(this,d,p)      ((d) == SPA_DIRECTION_OUTPUT && (p) < MAX_OUTPUTS)
 #define CHECK_PORT_ID(this,d,p)          (CHECK_IN_PORT_ID(this,d,p) || CHECK_OUT_PORT_ID(this,d,p))
@@ -85,6 +89,7 @@ struct proxy_port {
 
 struct proxy {
 	struct spa_node node;
+	struct spa_clock clock;
 
 	struct impl *impl;
 
@@ -107,8 +112,10 @@ struct proxy {
 	struct proxy_port in_ports[MAX_INPUTS];
 	struct proxy_port out_ports[MAX_OUTPUTS];
 
-	uint8_t format_buffer[1024];
+	struct spa_pod_builder format_builder;
 	uint32_t seq;
+
+	bool reuse_pending;
 };
 
 struct impl {
@@ -399,7 +406,7 @@ spa_proxy_node_port_enum_formats(struct spa_node *node,
 	struct proxy *this;
 	struct proxy_port *port;
 	struct spa_format *fmt;
-	struct spa_pod_builder b = { NULL, };
+	struct spa_pod_builder *b;
 	int res;
 	uint32_t count, match = 0;
 
@@ -422,12 +429,16 @@ spa_proxy_node_port_enum_formats(struct spa_node *node,
 
 	fmt = port->formats[count++];
 
-	spa_pod_builder_init(&b, this->format_buffer, sizeof(this->format_buffer));
+	b = &this->format_builder;
+	spa_pod_builder_init(b, b->data, b->size);
 
-	if ((res = spa_format_filter(fmt, filter, &b)) != SPA_RESULT_OK || match++ != index)
+	if ((res = spa_format_filter(fmt, filter, b)) != SPA_RESULT_OK || match++ != index)
 		goto next;
 
-	*format = SPA_POD_BUILDER_DEREF(&b, 0, struct spa_format);
+	if (b->offset > b->size)
+		return SPA_RESULT_NO_MEMORY;
+
+	*format = SPA_POD_BUILDER_DEREF(b, 0, struct spa_format);
 
 	return SPA_RESULT_OK;
 }
@@ -717,7 +728,11 @@ spa_proxy_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32
 		return SPA_RESULT_INVALID_PORT;
 
 	spa_log_trace(this->log, "reuse buffer %d", buffer_id);
-	{
+	if (port_id < impl->transport->area->max_output_ports &&
+	    pw_client_node_reuse_mark(&impl->transport->output_reuse[port_id], buffer_id)) {
+		/* sent with the next process message */
+		this->reuse_pending = true;
+	} else {
 		struct pw_client_node_message_reuse_buffer rb = PW_CLIENT_NODE_MESSAGE_REUSE_BUFFER_INIT(port_id, buffer_id);
 		pw_client_node_transport_add_message(impl->transport, (struct pw_client_node_message *) &rb);
 	}
@@ -741,6 +756,36 @@ spa_proxy_node_port_send_command(struct spa_node *node,
 	return SPA_RESULT_NOT_IMPLEMENTED;
 }
 
+static void flush_reuse(struct proxy *this)
+{
+	struct impl *impl = this->impl;
+
+	if (!this->reuse_pending)
+		return;
+
+	this->reuse_pending = false;
+	pw_client_node_transport_add_message(impl->transport,
+			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_REUSE_BUFFERS));
+}
+
+static void update_clock(struct impl *impl)
+{
+	struct spa_clock *clock;
+	uint32_t id;
+	int32_t rate;
+	int64_t ticks, monotonic_time;
+
+	/* called from the data loop of the node, sample the driver of that loop */
+	clock = pw_data_loop_get_driver_clock(pw_node_get_data_loop(impl->this.node), &id);
+	if (clock == NULL)
+		return;
+
+	if (spa_clock_get_time(clock, &rate, &ticks, &monotonic_time) < 0)
+		return;
+
+	pw_client_node_clock_write(&impl->transport->area->clock, id, rate, ticks, monotonic_time);
+}
+
 static int spa_proxy_node_process_input(struct spa_node *node)
 {
 	struct impl *impl;
@@ -764,6 +809,8 @@ static int spa_proxy_node_process_input(struct spa_node *node)
 		impl->transport->inputs[i] = *io;
 		io->status = SPA_RESULT_NEED_BUFFER;
 	}
+	update_clock(impl);
+	flush_reuse(this);
 	pw_client_node_transport_add_message(impl->transport,
 			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT));
 	do_flush(this);
@@ -798,6 +845,8 @@ static int spa_proxy_node_process_output(struct spa_node *node)
 		*io = tmp;
 		pw_log_trace("%d %d  %d", io->status, io->buffer_id, io->status);
 	}
+	update_clock(impl);
+	flush_reuse(this);
 	pw_client_node_transport_add_message(impl->transport,
 			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT));
 	do_flush(this);
@@ -828,6 +877,20 @@ static int handle_node_message(struct proxy *this, struct pw_client_node_message
 		    (struct pw_client_node_message_reuse_buffer *) message;
 		this->callbacks->reuse_buffer(this->callbacks_data, p->body.port_id.value,
 					     p->body.buffer_id.value);
+	} else if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_REUSE_BUFFERS) {
+		for (i = 0; i < impl->transport->area->max_input_ports; i++) {
+			uint64_t ids;
+
+			if (!this->in_ports[i].valid)
+				continue;
+
+			ids = pw_client_node_reuse_take(&impl->transport->input_reuse[i]);
+			while (ids) {
+				this->callbacks->reuse_buffer(this->callbacks_data, i,
+							     __builtin_ctzll(ids));
+				ids &= ids - 1;
+			}
+		}
 	}
 	return SPA_RESULT_OK;
 }
@@ -846,7 +909,8 @@ static void
 client_node_update(void *data,
 		   uint32_t change_mask,
 		   uint32_t max_input_ports,
-		   uint32_t max_output_ports, const struct spa_props *props)
+		   uint32_t max_output_ports, const struct spa_props *props,
+		   const struct spa_dict *node_props)
 {
 	struct impl *impl = data;
 	struct proxy *this = &impl->proxy;
@@ -855,6 +919,8 @@ client_node_update(void *data,
 		this->max_inputs = max_input_ports;
 	if (change_mask & PW_CLIENT_NODE_UPDATE_MAX_OUTPUTS)
 		this->max_outputs = max_output_ports;
+	if ((change_mask & PW_CLIENT_NODE_UPDATE_NODE_PROPS) && node_props)
+		pw_node_update_properties(impl->this.node, node_props);
 
 	spa_log_info(this->log, "proxy %p: got node update max_in %u, max_out %u", this,
 		     this->max_inputs, this->max_outputs);
@@ -967,6 +1033,57 @@ static const struct spa_node proxy_node = {
 	spa_proxy_node_process_output,
 };
 
+static int proxy_clock_get_props(struct spa_clock *clock, struct spa_props **props)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int proxy_clock_set_props(struct spa_clock *clock, const struct spa_props *props)
+{
+	return SPA_RESULT_NOT_IMPLEMENTED;
+}
+
+static int proxy_clock_get_time(struct spa_clock *clock,
+				int32_t *rate,
+				int64_t *ticks,
+				int64_t *monotonic_time)
+{
+	struct proxy *this;
+	struct impl *impl;
+	uint32_t d;
+	int32_t r;
+	int64_t t, m;
+
+	spa_return_val_if_fail(clock != NULL, SPA_RESULT_INVALID_ARGUMENTS);
+
+	this = SPA_CONTAINER_OF(clock, struct proxy, clock);
+	impl = this->impl;
+
+	/* the client writes the clock, don't let it stall the data thread */
+	if (impl->transport == NULL ||
+	    !pw_client_node_clock_try_read(&impl->transport->area->node_clock,
+					   MAX_CLOCK_TRIES, &d, &r, &t, &m))
+		return SPA_RESULT_INACTIVE;
+
+	if (rate)
+		*rate = r;
+	if (ticks)
+		*ticks = t;
+	if (monotonic_time)
+		*monotonic_time = m;
+
+	return SPA_RESULT_OK;
+}
+
+static const struct spa_clock proxy_clock = {
+	SPA_VERSION_CLOCK,
+	NULL,
+	SPA_CLOCK_STATE_RUNNING,
+	proxy_clock_get_props,
+	proxy_clock_set_props,
+	proxy_clock_get_time,
+};
+
 static int
 proxy_init(struct proxy *this,
 	   struct spa_dict *info,
@@ -993,6 +1110,8 @@ proxy_init(struct proxy *this,
 	}
 
 	this->node = proxy_node;
+	this->clock = proxy_clock;
+	spa_pod_builder_set_overflow(&this->format_builder, spa_pod_builder_realloc);
 
 	this->data_source.func = proxy_on_data_fd_events;
 	this->data_source.data = this;
@@ -1068,6 +1187,8 @@ static int proxy_clear(struct proxy *this)
 		if (this->out_ports[i].valid)
 			clear_port(this, &this->out_ports[i], SPA_DIRECTION_OUTPUT, i);
 	}
+	free(this->format_builder.data);
+	spa_pod_builder_init(&this->format_builder, NULL, 0);
 
 	return SPA_RESULT_OK;
 }
@@ -1107,10 +1228,25 @@ static void node_free(void *data)
 	free(impl);
 }
 
+static void node_data_loop_changed(void *data, struct pw_data_loop *loop)
+{
+	struct impl *impl = data;
+	struct proxy *proxy = &impl->proxy;
+
+	if (proxy->data_source.fd != -1)
+		spa_loop_remove_source(proxy->data_loop, &proxy->data_source);
+
+	proxy->data_loop = pw_data_loop_get_loop(loop)->loop;
+
+	if (proxy->data_source.fd != -1)
+		spa_loop_add_source(proxy->data_loop, &proxy->data_source);
+}
+
 static const struct pw_node_events node_events = {
 	PW_VERSION_NODE_EVENTS,
 	.free = node_free,
 	.initialized = node_initialized,
+	.data_loop_changed = node_data_loop_changed,
 };
 
 static const struct pw_resource_events resource_events = {
@@ -1164,11 +1300,13 @@ struct pw_client_node *pw_client_node_new(struct pw_resource *resource,
 				     name,
 				     true,
 				     &impl->proxy.node,
-				     NULL,
+				     &impl->proxy.clock,
 				     properties);
 	if (this->node == NULL)
 		goto error_no_node;
 
+	this->node->rt.node.flags |= SPA_GRAPH_NODE_FLAG_ASYNC;
+
 	pw_resource_add_listener(this->resource,
 				 &impl->resource_listener,
 				 &resource_events,
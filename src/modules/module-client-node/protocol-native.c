@@ -52,18 +52,32 @@ static void
 client_node_marshal_update(void *object,
 			   uint32_t change_mask,
 			   uint32_t max_input_ports,
-			   uint32_t max_output_ports, const struct spa_props *props)
+			   uint32_t max_output_ports, const struct spa_props *props,
+			   const struct spa_dict *node_props)
 {
 	struct pw_proxy *proxy = object;
 	struct spa_pod_builder *b;
 	struct spa_pod_frame f;
+	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CLIENT_NODE_PROXY_METHOD_UPDATE);
 
-	spa_pod_builder_struct(b, &f,
-			       SPA_POD_TYPE_INT, change_mask,
-			       SPA_POD_TYPE_INT, max_input_ports,
-			       SPA_POD_TYPE_INT, max_output_ports, SPA_POD_TYPE_POD, props);
+	n_items = node_props ? node_props->n_items : 0;
+
+	spa_pod_builder_add(b,
+			    SPA_POD_TYPE_STRUCT, &f,
+			    SPA_POD_TYPE_INT, change_mask,
+			    SPA_POD_TYPE_INT, max_input_ports,
+			    SPA_POD_TYPE_INT, max_output_ports,
+			    SPA_POD_TYPE_POD, props,
+			    SPA_POD_TYPE_INT, n_items, 0);
+
+	for (i = 0; i < n_items; i++) {
+		spa_pod_builder_add(b,
+				    SPA_POD_TYPE_STRING, node_props->items[i].key,
+				    SPA_POD_TYPE_STRING, node_props->items[i].value, 0);
+	}
+	spa_pod_builder_add(b, -SPA_POD_TYPE_STRUCT, &f, 0);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -664,8 +678,9 @@ static bool client_node_demarshal_update(void *object, void *data, size_t size)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_iter it;
-	uint32_t change_mask, max_input_ports, max_output_ports;
+	uint32_t i, change_mask, max_input_ports, max_output_ports;
 	const struct spa_props *props;
+	struct spa_dict node_props = SPA_DICT_INIT(0, NULL);
 
 	if (!spa_pod_iter_struct(&it, data, size) ||
 	    !spa_pod_iter_get(&it,
@@ -674,10 +689,24 @@ static bool client_node_demarshal_update(void *object, void *data, size_t size)
 			      SPA_POD_TYPE_INT, &max_output_ports, -SPA_POD_TYPE_OBJECT, &props, 0))
 		return false;
 
+	/* older clients don't send node properties */
+	if (spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &node_props.n_items, 0)) {
+		node_props.items = alloca(node_props.n_items * sizeof(struct spa_dict_item));
+		for (i = 0; i < node_props.n_items; i++) {
+			if (!spa_pod_iter_get(&it,
+					      SPA_POD_TYPE_STRING, &node_props.items[i].key,
+					      SPA_POD_TYPE_STRING, &node_props.items[i].value, 0))
+				return false;
+		}
+	}
+	else
+		change_mask &= ~PW_CLIENT_NODE_UPDATE_NODE_PROPS;
+
 	pw_resource_do(resource, struct pw_client_node_proxy_methods, update, change_mask,
 									max_input_ports,
 									max_output_ports,
-									props);
+									props,
+									&node_props);
 	return true;
 }
 
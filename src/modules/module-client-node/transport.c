@@ -48,6 +48,8 @@ static size_t area_get_size(struct pw_client_node_area *area)
 	size = sizeof(struct pw_client_node_area);
 	size += area->max_input_ports * sizeof(struct spa_port_io);
 	size += area->max_output_ports * sizeof(struct spa_port_io);
+	size += area->max_input_ports * sizeof(uint64_t);
+	size += area->max_output_ports * sizeof(uint64_t);
 	size += sizeof(struct spa_ringbuffer);
 	size += INPUT_BUFFER_SIZE;
 	size += sizeof(struct spa_ringbuffer);
@@ -68,6 +70,12 @@ static void transport_setup_area(void *p, struct pw_client_node_transport *trans
 	trans->outputs = p;
 	p = SPA_MEMBER(p, a->max_output_ports * sizeof(struct spa_port_io), void);
 
+	trans->input_reuse = p;
+	p = SPA_MEMBER(p, a->max_input_ports * sizeof(uint64_t), void);
+
+	trans->output_reuse = p;
+	p = SPA_MEMBER(p, a->max_output_ports * sizeof(uint64_t), void);
+
 	trans->input_buffer = p;
 	p = SPA_MEMBER(p, sizeof(struct spa_ringbuffer), void);
 
@@ -89,13 +97,17 @@ static void transport_reset_area(struct pw_client_node_transport *trans)
 	for (i = 0; i < a->max_input_ports; i++) {
 		trans->inputs[i].status = SPA_RESULT_OK;
 		trans->inputs[i].buffer_id = SPA_ID_INVALID;
+		trans->input_reuse[i] = 0;
 	}
 	for (i = 0; i < a->max_output_ports; i++) {
 		trans->outputs[i].status = SPA_RESULT_OK;
 		trans->outputs[i].buffer_id = SPA_ID_INVALID;
+		trans->output_reuse[i] = 0;
 	}
 	spa_ringbuffer_init(trans->input_buffer, INPUT_BUFFER_SIZE);
 	spa_ringbuffer_init(trans->output_buffer, OUTPUT_BUFFER_SIZE);
+	memset(&a->clock, 0, sizeof(struct pw_client_node_clock));
+	memset(&a->node_clock, 0, sizeof(struct pw_client_node_clock));
 }
 
 static void destroy(struct pw_client_node_transport *trans)
@@ -20,10 +20,10 @@
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
-#include <dlfcn.h>
 
 #include "config.h"
 
+#include "pipewire/pipewire.h"
 #include "pipewire/core.h"
 #include "pipewire/link.h"
 #include "pipewire/log.h"
@@ -39,54 +39,9 @@ struct impl {
 	struct pw_module *module;
 	struct pw_properties *properties;
 
-	void *hnd;
 	const struct spa_handle_factory *factory;
 };
 
-static const struct spa_handle_factory *find_factory(struct impl *impl)
-{
-	spa_handle_factory_enum_func_t enum_func;
-	uint32_t index;
-	const struct spa_handle_factory *factory = NULL;
-	int res;
-	char *filename;
-	const char *dir;
-
-	if ((dir = getenv("SPA_PLUGIN_DIR")) == NULL)
-		dir = PLUGINDIR;
-
-	asprintf(&filename, "%s/%s.so", dir, AUDIOMIXER_LIB);
-
-	if ((impl->hnd = dlopen(filename, RTLD_NOW)) == NULL) {
-		pw_log_error("can't load %s: %s", AUDIOMIXER_LIB, dlerror());
-		goto open_failed;
-	}
-	if ((enum_func = dlsym(impl->hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
-		pw_log_error("can't find enum function");
-		goto no_symbol;
-	}
-
-	for (index = 0;; index++) {
-		if ((res = enum_func(&factory, index)) < 0) {
-			if (res != SPA_RESULT_ENUM_END)
-				pw_log_error("can't enumerate factories: %d", res);
-			goto enum_failed;
-		}
-		if (strcmp(factory->name, "audiomixer") == 0)
-			break;
-	}
-	free(filename);
-	return factory;
-
-      enum_failed:
-      no_symbol:
-	dlclose(impl->hnd);
-	impl->hnd = NULL;
-      open_failed:
-	free(filename);
-	return NULL;
-}
-
 static struct pw_node *make_node(struct impl *impl)
 {
 	struct spa_handle *handle;
@@ -179,7 +134,7 @@ static bool module_init(struct pw_module *module, struct pw_properties *properti
 	impl->module = module;
 	impl->properties = properties;
 
-	impl->factory = find_factory(impl);
+	impl->factory = pw_get_spa_handle_factory(AUDIOMIXER_LIB, "audiomixer");
 
 	pw_core_for_each_global(core, on_global, impl);
 
@@ -338,20 +338,13 @@ static inline void *begin_write(struct pw_protocol_native_connection *conn, uint
 	return p + 2;
 }
 
-static uint32_t write_pod(struct spa_pod_builder *b, uint32_t ref, const void *data, uint32_t size)
+static int grow_pod(struct spa_pod_builder *b, uint32_t size)
 {
 	struct impl *impl = SPA_CONTAINER_OF(b, struct impl, builder);
 
-        if (ref == -1)
-                ref = b->offset;
-
-        if (b->size <= b->offset) {
-                b->size = SPA_ROUND_UP_N(b->offset + size, 4096);
-                b->data = begin_write(&impl->this, b->size);
-        }
-        memcpy(b->data + ref, data, size);
-
-        return ref;
+	b->size = SPA_ROUND_UP_N(size, 4096);
+	b->data = begin_write(&impl->this, b->size);
+	return SPA_RESULT_OK;
 }
 
 struct spa_pod_builder *
@@ -378,7 +371,7 @@ pw_protocol_native_connection_begin_resource(struct pw_protocol_native_connectio
 
 	impl->dest_id = resource->id;
 	impl->opcode = opcode;
-	impl->builder = (struct spa_pod_builder) { NULL, 0, 0, NULL, write_pod };
+	impl->builder = (struct spa_pod_builder) { .overflow = grow_pod };
 
 	return &impl->builder;
 }
@@ -407,7 +400,7 @@ pw_protocol_native_connection_begin_proxy(struct pw_protocol_native_connection *
 
 	impl->dest_id = proxy->id;
 	impl->opcode = opcode;
-	impl->builder = (struct spa_pod_builder) { NULL, 0, 0, NULL, write_pod };
+	impl->builder = (struct spa_pod_builder) { .overflow = grow_pod };
 
 	return &impl->builder;
 }
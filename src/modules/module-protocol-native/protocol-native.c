@@ -182,27 +182,41 @@ static bool core_demarshal_info(void *object, void *data, size_t size)
 {
 	struct pw_proxy *proxy = object;
 	struct spa_dict props;
-	struct pw_core_info info;
+	struct pw_core_info info = { 0, };
 	struct spa_pod_iter it;
 	int i;
 
 	if (!spa_pod_iter_struct(&it, data, size) ||
-	    !spa_pod_iter_get(&it,
-			      SPA_POD_TYPE_LONG, &info.change_mask,
-			      SPA_POD_TYPE_STRING, &info.user_name,
-			      SPA_POD_TYPE_STRING, &info.host_name,
-			      SPA_POD_TYPE_STRING, &info.version,
-			      SPA_POD_TYPE_STRING, &info.name,
-			      SPA_POD_TYPE_INT, &info.cookie, SPA_POD_TYPE_INT, &props.n_items, 0))
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_LONG, &info.change_mask, 0))
 		return false;
 
-	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (!spa_pod_iter_get(&it,
-				      SPA_POD_TYPE_STRING, &props.items[i].key,
-				      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
+	if (info.change_mask & PW_CORE_CHANGE_MASK_USER_NAME &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &info.user_name, 0))
+		return false;
+	if (info.change_mask & PW_CORE_CHANGE_MASK_HOST_NAME &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &info.host_name, 0))
+		return false;
+	if (info.change_mask & PW_CORE_CHANGE_MASK_VERSION &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &info.version, 0))
+		return false;
+	if (info.change_mask & PW_CORE_CHANGE_MASK_NAME &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &info.name, 0))
+		return false;
+	if (info.change_mask & PW_CORE_CHANGE_MASK_COOKIE &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &info.cookie, 0))
+		return false;
+	if (info.change_mask & PW_CORE_CHANGE_MASK_PROPS) {
+		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &props.n_items, 0))
 			return false;
+
+		info.props = &props;
+		props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+		for (i = 0; i < props.n_items; i++) {
+			if (!spa_pod_iter_get(&it,
+					      SPA_POD_TYPE_STRING, &props.items[i].key,
+					      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
+				return false;
+		}
 	}
 	pw_proxy_notify(proxy, struct pw_core_proxy_events, info, &info);
 	return true;
@@ -283,21 +297,30 @@ static void core_marshal_info(void *object, struct pw_core_info *info)
 
 	b = pw_protocol_native_begin_resource(resource, PW_CORE_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
 	spa_pod_builder_add(b,
 			    SPA_POD_TYPE_STRUCT, &f,
-			    SPA_POD_TYPE_LONG, info->change_mask,
-			    SPA_POD_TYPE_STRING, info->user_name,
-			    SPA_POD_TYPE_STRING, info->host_name,
-			    SPA_POD_TYPE_STRING, info->version,
-			    SPA_POD_TYPE_STRING, info->name,
-			    SPA_POD_TYPE_INT, info->cookie, SPA_POD_TYPE_INT, n_items, 0);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    SPA_POD_TYPE_STRING, info->props->items[i].key,
-				    SPA_POD_TYPE_STRING, info->props->items[i].value, 0);
+			    SPA_POD_TYPE_LONG, info->change_mask, 0);
+
+	/* only the fields in the change_mask are sent */
+	if (info->change_mask & PW_CORE_CHANGE_MASK_USER_NAME)
+		spa_pod_builder_add(b, SPA_POD_TYPE_STRING, info->user_name, 0);
+	if (info->change_mask & PW_CORE_CHANGE_MASK_HOST_NAME)
+		spa_pod_builder_add(b, SPA_POD_TYPE_STRING, info->host_name, 0);
+	if (info->change_mask & PW_CORE_CHANGE_MASK_VERSION)
+		spa_pod_builder_add(b, SPA_POD_TYPE_STRING, info->version, 0);
+	if (info->change_mask & PW_CORE_CHANGE_MASK_NAME)
+		spa_pod_builder_add(b, SPA_POD_TYPE_STRING, info->name, 0);
+	if (info->change_mask & PW_CORE_CHANGE_MASK_COOKIE)
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, info->cookie, 0);
+	if (info->change_mask & PW_CORE_CHANGE_MASK_PROPS) {
+		n_items = info->props ? info->props->n_items : 0;
+
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, n_items, 0);
+		for (i = 0; i < n_items; i++) {
+			spa_pod_builder_add(b,
+					    SPA_POD_TYPE_STRING, info->props->items[i].key,
+					    SPA_POD_TYPE_STRING, info->props->items[i].value, 0);
+		}
 	}
 	spa_pod_builder_add(b, -SPA_POD_TYPE_STRUCT, &f, 0);
 
@@ -540,6 +563,33 @@ static void registry_marshal_global(void *object, uint32_t id, uint32_t parent_i
 	pw_protocol_native_end_resource(resource, b);
 }
 
+static void registry_marshal_global_list(void *object, uint32_t n_globals,
+					 const struct pw_registry_global *globals)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_builder *b;
+	struct spa_pod_frame f;
+	uint32_t i;
+
+	b = pw_protocol_native_begin_resource(resource, PW_REGISTRY_PROXY_EVENT_GLOBAL_LIST);
+
+	spa_pod_builder_add(b,
+			    SPA_POD_TYPE_STRUCT, &f,
+			    SPA_POD_TYPE_INT, n_globals, 0);
+
+	for (i = 0; i < n_globals; i++) {
+		spa_pod_builder_add(b,
+				    SPA_POD_TYPE_INT, globals[i].id,
+				    SPA_POD_TYPE_INT, globals[i].parent_id,
+				    SPA_POD_TYPE_INT, globals[i].permissions,
+				    SPA_POD_TYPE_ID, globals[i].type,
+				    SPA_POD_TYPE_INT, globals[i].version, 0);
+	}
+	spa_pod_builder_add(b, -SPA_POD_TYPE_STRUCT, &f, 0);
+
+	pw_protocol_native_end_resource(resource, b);
+}
+
 static void registry_marshal_global_remove(void *object, uint32_t id)
 {
 	struct pw_resource *resource = object;
@@ -580,19 +630,25 @@ static void module_marshal_info(void *object, struct pw_module_info *info)
 
 	b = pw_protocol_native_begin_resource(resource, PW_MODULE_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
 	spa_pod_builder_add(b,
 			    SPA_POD_TYPE_STRUCT, &f,
-			    SPA_POD_TYPE_LONG, info->change_mask,
-			    SPA_POD_TYPE_STRING, info->name,
-			    SPA_POD_TYPE_STRING, info->filename,
-			    SPA_POD_TYPE_STRING, info->args, SPA_POD_TYPE_INT, n_items, 0);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    SPA_POD_TYPE_STRING, info->props->items[i].key,
-				    SPA_POD_TYPE_STRING, info->props->items[i].value, 0);
+			    SPA_POD_TYPE_LONG, info->change_mask, 0);
+
+	if (info->change_mask & PW_MODULE_CHANGE_MASK_NAME)
+		spa_pod_builder_add(b, SPA_POD_TYPE_STRING, info->name, 0);
+	if (info->change_mask & PW_MODULE_CHANGE_MASK_FILENAME)
+		spa_pod_builder_add(b, SPA_POD_TYPE_STRING, info->filename, 0);
+	if (info->change_mask & PW_MODULE_CHANGE_MASK_ARGS)
+		spa_pod_builder_add(b, SPA_POD_TYPE_STRING, info->args, 0);
+	if (info->change_mask & PW_MODULE_CHANGE_MASK_PROPS) {
+		n_items = info->props ? info->props->n_items : 0;
+
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, n_items, 0);
+		for (i = 0; i < n_items; i++) {
+			spa_pod_builder_add(b,
+					    SPA_POD_TYPE_STRING, info->props->items[i].key,
+					    SPA_POD_TYPE_STRING, info->props->items[i].value, 0);
+		}
 	}
 	spa_pod_builder_add(b, -SPA_POD_TYPE_STRUCT, &f, 0);
 
@@ -604,24 +660,34 @@ static bool module_demarshal_info(void *object, void *data, size_t size)
 	struct pw_proxy *proxy = object;
 	struct spa_pod_iter it;
 	struct spa_dict props;
-	struct pw_module_info info;
+	struct pw_module_info info = { 0, };
 	int i;
 
 	if (!spa_pod_iter_struct(&it, data, size) ||
-	    !spa_pod_iter_get(&it,
-			      SPA_POD_TYPE_LONG, &info.change_mask,
-			      SPA_POD_TYPE_STRING, &info.name,
-			      SPA_POD_TYPE_STRING, &info.filename,
-			      SPA_POD_TYPE_STRING, &info.args, SPA_POD_TYPE_INT, &props.n_items, 0))
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_LONG, &info.change_mask, 0))
 		return false;
 
-	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (!spa_pod_iter_get(&it,
-				      SPA_POD_TYPE_STRING, &props.items[i].key,
-				      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
+	if (info.change_mask & PW_MODULE_CHANGE_MASK_NAME &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &info.name, 0))
+		return false;
+	if (info.change_mask & PW_MODULE_CHANGE_MASK_FILENAME &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &info.filename, 0))
+		return false;
+	if (info.change_mask & PW_MODULE_CHANGE_MASK_ARGS &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &info.args, 0))
+		return false;
+	if (info.change_mask & PW_MODULE_CHANGE_MASK_PROPS) {
+		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &props.n_items, 0))
 			return false;
+
+		info.props = &props;
+		props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+		for (i = 0; i < props.n_items; i++) {
+			if (!spa_pod_iter_get(&it,
+					      SPA_POD_TYPE_STRING, &props.items[i].key,
+					      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
+				return false;
+		}
 	}
 	pw_proxy_notify(proxy, struct pw_module_proxy_events, info, &info);
 	return true;
@@ -638,33 +704,43 @@ static void node_marshal_info(void *object, struct pw_node_info *info)
 
 	spa_pod_builder_add(b,
 			    SPA_POD_TYPE_STRUCT, &f,
-			    SPA_POD_TYPE_LONG, info->change_mask,
-			    SPA_POD_TYPE_STRING, info->name,
-			    SPA_POD_TYPE_INT, info->max_input_ports,
-			    SPA_POD_TYPE_INT, info->n_input_ports,
-			    SPA_POD_TYPE_INT, info->n_input_formats, 0);
-
-	for (i = 0; i < info->n_input_formats; i++)
-		spa_pod_builder_add(b, SPA_POD_TYPE_POD, info->input_formats[i], 0);
-
-	spa_pod_builder_add(b,
-			    SPA_POD_TYPE_INT, info->max_output_ports,
-			    SPA_POD_TYPE_INT, info->n_output_ports,
-			    SPA_POD_TYPE_INT, info->n_output_formats, 0);
-
-	for (i = 0; i < info->n_output_formats; i++)
-		spa_pod_builder_add(b, SPA_POD_TYPE_POD, info->output_formats[i], 0);
-
-	n_items = info->props ? info->props->n_items : 0;
+			    SPA_POD_TYPE_LONG, info->change_mask, 0);
 
-	spa_pod_builder_add(b,
-			    SPA_POD_TYPE_INT, info->state,
-			    SPA_POD_TYPE_STRING, info->error, SPA_POD_TYPE_INT, n_items, 0);
-
-	for (i = 0; i < n_items; i++) {
+	/* only the fields in the change_mask are sent, a state change does not
+	 * resend the formats and properties */
+	if (info->change_mask & PW_NODE_CHANGE_MASK_NAME)
+		spa_pod_builder_add(b, SPA_POD_TYPE_STRING, info->name, 0);
+	if (info->change_mask & PW_NODE_CHANGE_MASK_INPUT_PORTS)
+		spa_pod_builder_add(b,
+				    SPA_POD_TYPE_INT, info->max_input_ports,
+				    SPA_POD_TYPE_INT, info->n_input_ports, 0);
+	if (info->change_mask & PW_NODE_CHANGE_MASK_INPUT_FORMATS) {
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, info->n_input_formats, 0);
+		for (i = 0; i < info->n_input_formats; i++)
+			spa_pod_builder_add(b, SPA_POD_TYPE_POD, info->input_formats[i], 0);
+	}
+	if (info->change_mask & PW_NODE_CHANGE_MASK_OUTPUT_PORTS)
+		spa_pod_builder_add(b,
+				    SPA_POD_TYPE_INT, info->max_output_ports,
+				    SPA_POD_TYPE_INT, info->n_output_ports, 0);
+	if (info->change_mask & PW_NODE_CHANGE_MASK_OUTPUT_FORMATS) {
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, info->n_output_formats, 0);
+		for (i = 0; i < info->n_output_formats; i++)
+			spa_pod_builder_add(b, SPA_POD_TYPE_POD, info->output_formats[i], 0);
+	}
+	if (info->change_mask & PW_NODE_CHANGE_MASK_STATE)
 		spa_pod_builder_add(b,
-				    SPA_POD_TYPE_STRING, info->props->items[i].key,
-				    SPA_POD_TYPE_STRING, info->props->items[i].value, 0);
+				    SPA_POD_TYPE_INT, info->state,
+				    SPA_POD_TYPE_STRING, info->error, 0);
+	if (info->change_mask & PW_NODE_CHANGE_MASK_PROPS) {
+		n_items = info->props ? info->props->n_items : 0;
+
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, n_items, 0);
+		for (i = 0; i < n_items; i++) {
+			spa_pod_builder_add(b,
+					    SPA_POD_TYPE_STRING, info->props->items[i].key,
+					    SPA_POD_TYPE_STRING, info->props->items[i].value, 0);
+		}
 	}
 	spa_pod_builder_add(b, -SPA_POD_TYPE_STRUCT, &f, 0);
 
@@ -676,47 +752,61 @@ static bool node_demarshal_info(void *object, void *data, size_t size)
 	struct pw_proxy *proxy = object;
 	struct spa_pod_iter it;
 	struct spa_dict props;
-	struct pw_node_info info;
+	struct pw_node_info info = { 0, };
 	int i;
 
 	if (!spa_pod_iter_struct(&it, data, size) ||
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_LONG, &info.change_mask, 0))
+		return false;
+
+	if (info.change_mask & PW_NODE_CHANGE_MASK_NAME &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_STRING, &info.name, 0))
+		return false;
+	if (info.change_mask & PW_NODE_CHANGE_MASK_INPUT_PORTS &&
 	    !spa_pod_iter_get(&it,
-			      SPA_POD_TYPE_LONG, &info.change_mask,
-			      SPA_POD_TYPE_STRING, &info.name,
 			      SPA_POD_TYPE_INT, &info.max_input_ports,
-			      SPA_POD_TYPE_INT, &info.n_input_ports,
-			      SPA_POD_TYPE_INT, &info.n_input_formats, 0))
+			      SPA_POD_TYPE_INT, &info.n_input_ports, 0))
 		return false;
-
-	info.input_formats = alloca(info.n_input_formats * sizeof(struct spa_format *));
-	for (i = 0; i < info.n_input_formats; i++)
-		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_OBJECT, &info.input_formats[i], 0))
+	if (info.change_mask & PW_NODE_CHANGE_MASK_INPUT_FORMATS) {
+		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &info.n_input_formats, 0))
 			return false;
 
-	if (!spa_pod_iter_get(&it,
+		info.input_formats = alloca(info.n_input_formats * sizeof(struct spa_format *));
+		for (i = 0; i < info.n_input_formats; i++)
+			if (!spa_pod_iter_get(&it, SPA_POD_TYPE_OBJECT, &info.input_formats[i], 0))
+				return false;
+	}
+	if (info.change_mask & PW_NODE_CHANGE_MASK_OUTPUT_PORTS &&
+	    !spa_pod_iter_get(&it,
 			      SPA_POD_TYPE_INT, &info.max_output_ports,
-			      SPA_POD_TYPE_INT, &info.n_output_ports,
-			      SPA_POD_TYPE_INT, &info.n_output_formats, 0))
+			      SPA_POD_TYPE_INT, &info.n_output_ports, 0))
 		return false;
-
-	info.output_formats = alloca(info.n_output_formats * sizeof(struct spa_format *));
-	for (i = 0; i < info.n_output_formats; i++)
-		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_OBJECT, &info.output_formats[i], 0))
+	if (info.change_mask & PW_NODE_CHANGE_MASK_OUTPUT_FORMATS) {
+		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &info.n_output_formats, 0))
 			return false;
 
-	if (!spa_pod_iter_get(&it,
+		info.output_formats = alloca(info.n_output_formats * sizeof(struct spa_format *));
+		for (i = 0; i < info.n_output_formats; i++)
+			if (!spa_pod_iter_get(&it, SPA_POD_TYPE_OBJECT, &info.output_formats[i], 0))
+				return false;
+	}
+	if (info.change_mask & PW_NODE_CHANGE_MASK_STATE &&
+	    !spa_pod_iter_get(&it,
 			      SPA_POD_TYPE_INT, &info.state,
-			      SPA_POD_TYPE_STRING, &info.error,
-			      SPA_POD_TYPE_INT, &props.n_items, 0))
+			      SPA_POD_TYPE_STRING, &info.error, 0))
 		return false;
-
-	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (!spa_pod_iter_get(&it,
-				      SPA_POD_TYPE_STRING, &props.items[i].key,
-				      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
+	if (info.change_mask & PW_NODE_CHANGE_MASK_PROPS) {
+		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &props.n_items, 0))
 			return false;
+
+		info.props = &props;
+		props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+		for (i = 0; i < props.n_items; i++) {
+			if (!spa_pod_iter_get(&it,
+					      SPA_POD_TYPE_STRING, &props.items[i].key,
+					      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
+				return false;
+		}
 	}
 	pw_proxy_notify(proxy, struct pw_node_proxy_events, info, &info);
 	return true;
@@ -731,17 +821,19 @@ static void client_marshal_info(void *object, struct pw_client_info *info)
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
 	spa_pod_builder_add(b,
 			    SPA_POD_TYPE_STRUCT, &f,
-			    SPA_POD_TYPE_LONG, info->change_mask,
-			    SPA_POD_TYPE_INT, n_items, 0);
+			    SPA_POD_TYPE_LONG, info->change_mask, 0);
 
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    SPA_POD_TYPE_STRING, info->props->items[i].key,
-				    SPA_POD_TYPE_STRING, info->props->items[i].value, 0);
+	if (info->change_mask & PW_CLIENT_CHANGE_MASK_PROPS) {
+		n_items = info->props ? info->props->n_items : 0;
+
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, n_items, 0);
+		for (i = 0; i < n_items; i++) {
+			spa_pod_builder_add(b,
+					    SPA_POD_TYPE_STRING, info->props->items[i].key,
+					    SPA_POD_TYPE_STRING, info->props->items[i].value, 0);
+		}
 	}
 	spa_pod_builder_add(b, -SPA_POD_TYPE_STRUCT, &f, 0);
 
@@ -753,22 +845,25 @@ static bool client_demarshal_info(void *object, void *data, size_t size)
 	struct pw_proxy *proxy = object;
 	struct spa_pod_iter it;
 	struct spa_dict props;
-	struct pw_client_info info;
+	struct pw_client_info info = { 0, };
 	uint32_t i;
 
 	if (!spa_pod_iter_struct(&it, data, size) ||
-	    !spa_pod_iter_get(&it,
-			      SPA_POD_TYPE_LONG, &info.change_mask,
-			      SPA_POD_TYPE_INT, &props.n_items, 0))
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_LONG, &info.change_mask, 0))
 		return false;
 
-	info.props = &props;
-	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (!spa_pod_iter_get(&it,
-				      SPA_POD_TYPE_STRING, &props.items[i].key,
-				      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
+	if (info.change_mask & PW_CLIENT_CHANGE_MASK_PROPS) {
+		if (!spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &props.n_items, 0))
 			return false;
+
+		info.props = &props;
+		props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
+		for (i = 0; i < props.n_items; i++) {
+			if (!spa_pod_iter_get(&it,
+					      SPA_POD_TYPE_STRING, &props.items[i].key,
+					      SPA_POD_TYPE_STRING, &props.items[i].value, 0))
+				return false;
+		}
 	}
 	pw_proxy_notify(proxy, struct pw_client_proxy_events, info, &info);
 	return true;
@@ -782,13 +877,22 @@ static void link_marshal_info(void *object, struct pw_link_info *info)
 
 	b = pw_protocol_native_begin_resource(resource, PW_LINK_PROXY_EVENT_INFO);
 
-	spa_pod_builder_struct(b, &f,
-			       SPA_POD_TYPE_LONG, info->change_mask,
-			       SPA_POD_TYPE_INT, info->output_node_id,
-			       SPA_POD_TYPE_INT, info->output_port_id,
-			       SPA_POD_TYPE_INT, info->input_node_id,
-			       SPA_POD_TYPE_INT, info->input_port_id,
-			       SPA_POD_TYPE_POD, info->format);
+	spa_pod_builder_add(b,
+			    SPA_POD_TYPE_STRUCT, &f,
+			    SPA_POD_TYPE_LONG, info->change_mask, 0);
+
+	if (info->change_mask & PW_LINK_CHANGE_MASK_OUTPUT_NODE_ID)
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, info->output_node_id, 0);
+	if (info->change_mask & PW_LINK_CHANGE_MASK_OUTPUT_PORT_ID)
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, info->output_port_id, 0);
+	if (info->change_mask & PW_LINK_CHANGE_MASK_INPUT_NODE_ID)
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, info->input_node_id, 0);
+	if (info->change_mask & PW_LINK_CHANGE_MASK_INPUT_PORT_ID)
+		spa_pod_builder_add(b, SPA_POD_TYPE_INT, info->input_port_id, 0);
+	if (info->change_mask & PW_LINK_CHANGE_MASK_FORMAT)
+		spa_pod_builder_add(b, SPA_POD_TYPE_POD, info->format, 0);
+
+	spa_pod_builder_add(b, -SPA_POD_TYPE_STRUCT, &f, 0);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -800,13 +904,23 @@ static bool link_demarshal_info(void *object, void *data, size_t size)
 	struct pw_link_info info = { 0, };
 
 	if (!spa_pod_iter_struct(&it, data, size) ||
-	    !spa_pod_iter_get(&it,
-			      SPA_POD_TYPE_LONG, &info.change_mask,
-			      SPA_POD_TYPE_INT, &info.output_node_id,
-			      SPA_POD_TYPE_INT, &info.output_port_id,
-			      SPA_POD_TYPE_INT, &info.input_node_id,
-			      SPA_POD_TYPE_INT, &info.input_port_id,
-			      -SPA_POD_TYPE_OBJECT, &info.format, 0))
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_LONG, &info.change_mask, 0))
+		return false;
+
+	if (info.change_mask & PW_LINK_CHANGE_MASK_OUTPUT_NODE_ID &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &info.output_node_id, 0))
+		return false;
+	if (info.change_mask & PW_LINK_CHANGE_MASK_OUTPUT_PORT_ID &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &info.output_port_id, 0))
+		return false;
+	if (info.change_mask & PW_LINK_CHANGE_MASK_INPUT_NODE_ID &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &info.input_node_id, 0))
+		return false;
+	if (info.change_mask & PW_LINK_CHANGE_MASK_INPUT_PORT_ID &&
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &info.input_port_id, 0))
+		return false;
+	if (info.change_mask & PW_LINK_CHANGE_MASK_FORMAT &&
+	    !spa_pod_iter_get(&it, -SPA_POD_TYPE_OBJECT, &info.format, 0))
 		return false;
 
 	pw_proxy_notify(proxy, struct pw_link_proxy_events, info, &info);
@@ -846,6 +960,32 @@ static bool registry_demarshal_global_remove(void *object, void *data, size_t si
 	return true;
 }
 
+static bool registry_demarshal_global_list(void *object, void *data, size_t size)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_iter it;
+	struct pw_registry_global g;
+	uint32_t i, n_globals;
+
+	if (!spa_pod_iter_struct(&it, data, size) ||
+	    !spa_pod_iter_get(&it, SPA_POD_TYPE_INT, &n_globals, 0))
+		return false;
+
+	for (i = 0; i < n_globals; i++) {
+		if (!spa_pod_iter_get(&it,
+				      SPA_POD_TYPE_INT, &g.id,
+				      SPA_POD_TYPE_INT, &g.parent_id,
+				      SPA_POD_TYPE_INT, &g.permissions,
+				      SPA_POD_TYPE_ID, &g.type,
+				      SPA_POD_TYPE_INT, &g.version, 0))
+			return false;
+
+		pw_proxy_notify(proxy, struct pw_registry_proxy_events, global,
+				g.id, g.parent_id, g.permissions, g.type, g.version);
+	}
+	return true;
+}
+
 static void registry_marshal_bind(void *object, uint32_t id,
 				  uint32_t type, uint32_t version, uint32_t new_id)
 {
@@ -924,11 +1064,13 @@ static const struct pw_registry_proxy_events pw_protocol_native_registry_event_m
 	PW_VERSION_REGISTRY_PROXY_EVENTS,
 	&registry_marshal_global,
 	&registry_marshal_global_remove,
+	&registry_marshal_global_list,
 };
 
 static const struct pw_protocol_native_demarshal pw_protocol_native_registry_event_demarshal[] = {
 	{ &registry_demarshal_global, PW_PROTOCOL_NATIVE_REMAP, },
-	{ &registry_demarshal_global_remove, 0, }
+	{ &registry_demarshal_global_remove, 0, },
+	{ &registry_demarshal_global_list, PW_PROTOCOL_NATIVE_REMAP, }
 };
 
 const struct pw_protocol_marshal pw_protocol_native_registry_marshal = {
@@ -36,9 +36,9 @@
 
 bool pipewire__module_init(struct pw_module *module, const char *args)
 {
-	const char *dir;
+	struct pw_properties *props = NULL;
 	char **argv;
-	int n_tokens;
+	int i, n_tokens;
 
 	if (args == NULL)
 		goto wrong_arguments;
@@ -47,12 +47,22 @@ bool pipewire__module_init(struct pw_module *module, const char *args)
 	if (n_tokens < 3)
 		goto not_enough_arguments;
 
-	if ((dir = getenv("SPA_PLUGIN_DIR")) == NULL)
-		dir = PLUGINDIR;
+	props = pw_properties_new(NULL, NULL);
+
+	for (i = 3; i < n_tokens; i++) {
+		char **prop;
+		int n_props;
+
+		prop = pw_split_strv(argv[i], "=", INT_MAX, &n_props);
+		if (n_props >= 2)
+			pw_properties_set(props, prop[0], prop[1]);
+
+		pw_free_strv(prop);
+	}
 
 	pw_spa_monitor_load(pw_module_get_core(module),
 			    pw_module_get_global(module),
-			    dir, argv[0], argv[1], argv[2]);
+			    argv[0], argv[1], argv[2], props);
 
 	pw_free_strv(argv);
 
@@ -61,6 +71,6 @@ bool pipewire__module_init(struct pw_module *module, const char *args)
       not_enough_arguments:
 	pw_free_strv(argv);
       wrong_arguments:
-	pw_log_error("usage: module-spa-monitor <plugin> <factory> <name>");
+	pw_log_error("usage: module-spa-monitor <plugin> <factory> <name> [key=value ...]");
 	return false;
 }
@@ -49,10 +49,11 @@ static struct pw_node *create_node(void *_data,
 	if (properties == NULL)
 		goto no_properties;
 
+	/* without a library, the factory is looked up in the plugin index */
 	lib = pw_properties_get(properties, "spa.library.name");
 	factory_name = pw_properties_get(properties, "spa.factory.name");
 
-	if(lib == NULL || factory_name == NULL)
+	if (factory_name == NULL)
 		goto no_properties;
 
 	node = pw_spa_node_load(data->core,
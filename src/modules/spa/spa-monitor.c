@@ -18,7 +18,6 @@
  */
 
 #include <stdio.h>
-#include <dlfcn.h>
 #include <errno.h>
 #include <poll.h>
 #include <string.h>
@@ -31,6 +30,7 @@
 #include <spa/monitor.h>
 #include <spa/pod-iter.h>
 
+#include <pipewire/pipewire.h>
 #include <pipewire/log.h>
 #include <pipewire/type.h>
 #include <pipewire/node.h>
@@ -51,7 +51,7 @@ struct impl {
 	struct pw_type *t;
 	struct pw_global *parent;
 
-	void *hnd;
+	struct pw_properties *properties;
 
 	struct spa_list item_list;
 };
@@ -97,7 +97,14 @@ static void add_item(struct pw_spa_monitor *this, struct spa_monitor_item *item)
 	}
 	pw_properties_set(props, "media.class", klass);
 
-	support = pw_core_get_support(impl->core, &n_support);
+	/* devices drive their own graph, give them a data loop of their own
+	 * when there are extra loops */
+	if (pw_properties_get(props, "node.driver") == NULL)
+		pw_properties_set(props, "node.driver", "1");
+
+	support = pw_core_get_data_loop_support(impl->core,
+						pw_core_find_data_loop(impl->core, props),
+						&n_support);
 
 	handle = calloc(1, factory->size);
 	if ((res = spa_handle_factory_init(factory,
@@ -219,48 +226,30 @@ static const struct spa_monitor_callbacks callbacks = {
 
 struct pw_spa_monitor *pw_spa_monitor_load(struct pw_core *core,
 					   struct pw_global *parent,
-					   const char *dir,
 					   const char *lib,
-					   const char *factory_name, const char *system_name)
+					   const char *factory_name, const char *system_name,
+					   struct pw_properties *properties)
 {
 	struct impl *impl;
 	struct pw_spa_monitor *this;
 	struct spa_handle *handle;
 	int res;
 	void *iface;
-	void *hnd;
 	uint32_t index;
-	spa_handle_factory_enum_func_t enum_func;
 	const struct spa_handle_factory *factory;
-	char *filename;
 	const struct spa_support *support;
 	uint32_t n_support;
 	struct pw_type *t = pw_core_get_type(core);
 
-	asprintf(&filename, "%s/%s.so", dir, lib);
-
-	if ((hnd = dlopen(filename, RTLD_NOW)) == NULL) {
-		pw_log_error("can't load %s: %s", filename, dlerror());
-		goto open_failed;
-	}
-	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
-		pw_log_error("can't find enum function");
-		goto no_symbol;
-	}
-
-	for (index = 0;; index++) {
-		if ((res = enum_func(&factory, index)) < 0) {
-			if (res != SPA_RESULT_ENUM_END)
-				pw_log_error("can't enumerate factories: %d", res);
-			goto enum_failed;
-		}
-		if (strcmp(factory->name, factory_name) == 0)
-			break;
+	if ((factory = pw_get_spa_handle_factory(lib, factory_name)) == NULL) {
+		pw_log_error("can't find factory %s", factory_name);
+		goto no_factory;
 	}
 	support = pw_core_get_support(core, &n_support);
 	handle = calloc(1, factory->size);
 	if ((res = spa_handle_factory_init(factory,
-					   handle, NULL, support, n_support)) < 0) {
+					   handle, properties ? &properties->dict : NULL,
+					   support, n_support)) < 0) {
 		pw_log_error("can't make factory instance: %d", res);
 		goto init_failed;
 	}
@@ -274,11 +263,11 @@ struct pw_spa_monitor *pw_spa_monitor_load(struct pw_core *core,
 	impl->core = core;
 	impl->t = t;
 	impl->parent = parent;
-	impl->hnd = hnd;
+	impl->properties = properties;
 
 	this = &impl->this;
 	this->monitor = iface;
-	this->lib = filename;
+	this->lib = strdup(lib);
 	this->factory_name = strdup(factory_name);
 	this->system_name = strdup(system_name);
 	this->handle = handle;
@@ -306,11 +295,9 @@ struct pw_spa_monitor *pw_spa_monitor_load(struct pw_core *core,
 	spa_handle_clear(handle);
       init_failed:
 	free(handle);
-      enum_failed:
-      no_symbol:
-	dlclose(hnd);
-      open_failed:
-	free(filename);
+      no_factory:
+	if (properties)
+		pw_properties_free(properties);
 	return NULL;
 
 }
@@ -331,6 +318,7 @@ void pw_spa_monitor_destroy(struct pw_spa_monitor *monitor)
 	free(monitor->factory_name);
 	free(monitor->system_name);
 
-	dlclose(impl->hnd);
+	if (impl->properties)
+		pw_properties_free(impl->properties);
 	free(impl);
 }
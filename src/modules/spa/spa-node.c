@@ -25,7 +25,6 @@
 
 #include <string.h>
 #include <stdio.h>
-#include <dlfcn.h>
 
 #include <spa/node.h>
 
@@ -37,7 +36,6 @@ struct impl {
 
 	bool async_init;
 
-	void *hnd;
         struct spa_handle *handle;
         struct spa_node *node;          /**< handle to SPA node */
 	char *lib;
@@ -315,8 +313,6 @@ static void pw_spa_node_destroy(void *data)
 	}
 	free(impl->lib);
 	free(impl->factory_name);
-	if (impl->hnd)
-		dlclose(impl->hnd);
 }
 
 static void complete_init(struct impl *impl)
@@ -524,42 +520,30 @@ struct pw_node *pw_spa_node_load(struct pw_core *core,
 	struct spa_clock *spa_clock;
 	int res;
 	struct spa_handle *handle;
-	void *hnd;
-	uint32_t index;
-	spa_handle_factory_enum_func_t enum_func;
 	const struct spa_handle_factory *factory;
+	const struct spa_support *support;
+	uint32_t n_support;
 	void *iface;
-	char *filename;
-	const char *dir;
-	bool async;
+	const char *str;
+	bool async, pinned, driver;
 
-	if ((dir = getenv("SPA_PLUGIN_DIR")) == NULL)
-		dir = PLUGINDIR;
-
-	asprintf(&filename, "%s/%s.so", dir, lib);
-
-	if ((hnd = dlopen(filename, RTLD_NOW)) == NULL) {
-		pw_log_error("can't load %s: %s", filename, dlerror());
-		goto open_failed;
-	}
-	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
-		pw_log_error("can't find enum function");
-		goto no_symbol;
+	if ((factory = pw_get_spa_handle_factory(lib, factory_name)) == NULL) {
+		pw_log_error("can't find factory %s", factory_name);
+		goto no_factory;
 	}
 
-	for (index = 0;; index++) {
-		if ((res = enum_func(&factory, index)) < 0) {
-			if (res != SPA_RESULT_ENUM_END)
-				pw_log_error("can't enumerate factories: %d", res);
-			goto enum_failed;
-		}
-		if (strcmp(factory->name, factory_name) == 0)
-			break;
-	}
+	/* the plugin is bound to the data loop it is created with */
+	if (properties == NULL)
+		properties = pw_properties_new(NULL, NULL);
+	pinned = pw_properties_get(properties, "node.data-loop") != NULL;
+	driver = (str = pw_properties_get(properties, "node.driver")) && atoi(str);
+	support = pw_core_get_data_loop_support(core,
+						pw_core_find_data_loop(core, properties),
+						&n_support);
 
 	handle = calloc(1, factory->size);
 	if ((res = spa_handle_factory_init(factory,
-					   handle, NULL, core->support, core->n_support)) < 0) {
+					   handle, NULL, support, n_support)) < 0) {
 		pw_log_error("can't make factory instance: %d", res);
 		goto init_failed;
 	}
@@ -576,6 +560,12 @@ struct pw_node *pw_spa_node_load(struct pw_core *core,
 	}
 	spa_clock = iface;
 
+	/* devices and nodes with a clock keep their sources on the data loop
+	 * and stay pinned to it. Filters don't use the data loop, they follow
+	 * the nodes they get linked to. */
+	if (!pinned && !driver && spa_clock == NULL)
+		pw_properties_set(properties, "node.data-loop", NULL);
+
 	if (properties != NULL) {
 		if (setup_props(core, spa_node, properties) != SPA_RESULT_OK) {
 			pw_log_debug("Unrecognized properties");
@@ -583,9 +573,12 @@ struct pw_node *pw_spa_node_load(struct pw_core *core,
 	}
 
 	this = pw_spa_node_new(core, owner, parent, name, async, spa_node, spa_clock, properties);
-	impl->hnd = hnd;
+	if (this == NULL)
+		goto interface_failed;
+
+	impl = this->user_data;
 	impl->handle = handle;
-	impl->lib = filename;
+	impl->lib = lib ? strdup(lib) : NULL;
 	impl->factory_name = strdup(factory_name);
 
 	return this;
@@ -594,10 +587,6 @@ struct pw_node *pw_spa_node_load(struct pw_core *core,
 	spa_handle_clear(handle);
       init_failed:
 	free(handle);
-      enum_failed:
-      no_symbol:
-	dlclose(hnd);
-      open_failed:
-	free(filename);
+      no_factory:
 	return NULL;
 }
@@ -68,7 +68,7 @@ client_bind_func(struct pw_global *global,
 
 	spa_list_insert(this->resource_list.prev, &resource->link);
 
-	this->info.change_mask = ~0;
+	this->info.change_mask = PW_CLIENT_CHANGE_MASK_ALL;
 	pw_client_resource_info(resource, &this->info);
 	this->info.change_mask = 0;
 
@@ -245,7 +245,12 @@ void pw_client_update_properties(struct pw_client *client, const struct spa_dict
 					  dict->items[i].key, dict->items[i].value);
 	}
 
-	client->info.change_mask |= 1 << 0;
+	if (client->properties == NULL ||
+	    client->props_generation == pw_properties_get_generation(client->properties))
+		return;
+	client->props_generation = pw_properties_get_generation(client->properties);
+
+	client->info.change_mask |= PW_CLIENT_CHANGE_MASK_PROPS;
 	client->info.props = client->properties ? &client->properties->dict : NULL;
 
 	spa_hook_list_call(&client->listener_list, struct pw_client_events, info_changed, &client->info);
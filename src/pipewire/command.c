@@ -20,10 +20,12 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 
 #include <pipewire/pipewire.h>
 #include <pipewire/utils.h>
 #include <pipewire/module.h>
+#include <pipewire/data-loop.h>
 
 #include "command.h"
 #include "private.h"
@@ -38,6 +40,16 @@ typedef struct pw_command *(*pw_command_parse_func_t) (const char *line, char **
 
 static struct pw_command *parse_command_module_load(const char *line, char **err);
 
+static bool execute_command_add_data_loop(struct pw_command *command,
+					  struct pw_core *core, char **err);
+
+static struct pw_command *parse_command_add_data_loop(const char *line, char **err);
+
+static bool execute_command_set_data_loop(struct pw_command *command,
+					  struct pw_core *core, char **err);
+
+static struct pw_command *parse_command_set_data_loop(const char *line, char **err);
+
 struct impl {
 	struct pw_command this;
 
@@ -53,6 +65,8 @@ struct command_parse {
 
 static const struct command_parse parsers[] = {
 	{"load-module", parse_command_module_load},
+	{"add-data-loop", parse_command_add_data_loop},
+	{"set-data-loop", parse_command_set_data_loop},
 	{NULL, NULL}
 };
 
@@ -98,6 +112,105 @@ execute_command_module_load(struct pw_command *command, struct pw_core *core, ch
 	return true;
 }
 
+static struct pw_command *parse_command_add_data_loop(const char *line, char **err)
+{
+	struct impl *impl;
+
+	impl = calloc(1, sizeof(struct impl));
+	if (impl == NULL)
+		goto no_mem;
+
+	impl->func = execute_command_add_data_loop;
+	impl->args = pw_split_strv(line, whitespace, INT_MAX, &impl->n_args);
+
+	impl->this.name = impl->args[0];
+
+	return &impl->this;
+
+      no_mem:
+	asprintf(err, "no memory");
+	return NULL;
+}
+
+static struct pw_properties *parse_properties(char **args, int n_args)
+{
+	struct pw_properties *props;
+	int i;
+
+	props = pw_properties_new(NULL, NULL);
+
+	for (i = 0; i < n_args; i++) {
+		char **prop;
+		int n_props;
+
+		prop = pw_split_strv(args[i], "=", 2, &n_props);
+		if (n_props >= 2)
+			pw_properties_set(props, prop[0], prop[1]);
+
+		pw_free_strv(prop);
+	}
+	return props;
+}
+
+static bool
+execute_command_add_data_loop(struct pw_command *command, struct pw_core *core, char **err)
+{
+	struct impl *impl = SPA_CONTAINER_OF(command, struct impl, this);
+
+	if (pw_core_add_data_loop(core, parse_properties(&impl->args[1], impl->n_args - 1)) == NULL) {
+		asprintf(err, "could not add data loop");
+		return false;
+	}
+	return true;
+}
+
+static struct pw_command *parse_command_set_data_loop(const char *line, char **err)
+{
+	struct impl *impl;
+
+	impl = calloc(1, sizeof(struct impl));
+	if (impl == NULL)
+		goto no_mem;
+
+	impl->func = execute_command_set_data_loop;
+	impl->args = pw_split_strv(line, whitespace, INT_MAX, &impl->n_args);
+
+	if (impl->args[1] == NULL)
+		goto no_id;
+
+	impl->this.name = impl->args[0];
+
+	return &impl->this;
+
+      no_id:
+	asprintf(err, "%s requires a data loop id", impl->args[0]);
+	pw_free_strv(impl->args);
+	free(impl);
+	return NULL;
+      no_mem:
+	asprintf(err, "no memory");
+	return NULL;
+}
+
+static bool
+execute_command_set_data_loop(struct pw_command *command, struct pw_core *core, char **err)
+{
+	struct impl *impl = SPA_CONTAINER_OF(command, struct impl, this);
+	struct pw_data_loop *loop;
+	struct pw_properties *props;
+
+	if ((loop = pw_core_get_data_loop(core, atoi(impl->args[1]))) == NULL) {
+		asprintf(err, "unknown data loop \"%s\"", impl->args[1]);
+		return false;
+	}
+
+	props = parse_properties(&impl->args[2], impl->n_args - 2);
+	pw_data_loop_update_properties(loop, &props->dict);
+	pw_properties_free(props);
+
+	return true;
+}
+
 /** Free command
  *
  * \param command a command to free
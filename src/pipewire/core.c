@@ -116,6 +116,12 @@ static void core_get_registry(void *object, uint32_t version, uint32_t new_id)
 	struct pw_global *global;
 	struct pw_resource *registry_resource;
 	struct resource_data *data;
+	struct pw_registry_global *g;
+	struct pw_array globals;
+
+	/* the global_list event and the info encoding need version 1 */
+	if (version < PW_VERSION_REGISTRY)
+		goto wrong_version;
 
 	registry_resource = pw_resource_new(client,
 					    new_id,
@@ -138,20 +144,36 @@ static void core_get_registry(void *object, uint32_t version, uint32_t new_id)
 
 	spa_list_insert(this->registry_resource_list.prev, &registry_resource->link);
 
+	/* send a snapshot of all globals in one go */
+	pw_array_init(&globals, 64 * sizeof(struct pw_registry_global));
 	spa_list_for_each(global, &this->global_list, link) {
 		uint32_t permissions = pw_global_get_permissions(global, client);
-		if (PW_PERM_IS_R(permissions)) {
-			pw_registry_resource_global(registry_resource,
-						    global->id,
-						    global->parent->id,
-						    permissions,
-						    global->type,
-						    global->version);
+		if (!PW_PERM_IS_R(permissions))
+			continue;
+		if ((g = pw_array_add(&globals, sizeof(struct pw_registry_global))) == NULL) {
+			pw_array_clear(&globals);
+			goto no_mem;
 		}
+		*g = (struct pw_registry_global) {
+			global->id,
+			global->parent->id,
+			permissions,
+			global->type,
+			global->version };
 	}
+	pw_registry_resource_global_list(registry_resource,
+					 pw_array_get_len(&globals, struct pw_registry_global),
+					 globals.data);
+	pw_array_clear(&globals);
 
 	return;
 
+      wrong_version:
+	pw_log_error("registry version %d < %d", version, PW_VERSION_REGISTRY);
+	pw_core_resource_error(client->core_resource,
+			       resource->id, SPA_RESULT_INCOMPATIBLE_VERSION,
+			       "registry version %d < %d", version, PW_VERSION_REGISTRY);
+	return;
       no_mem:
 	pw_log_error("can't create registry resource");
 	pw_core_resource_error(client->core_resource,
@@ -303,6 +325,19 @@ core_bind_func(struct pw_global *global,
 	return SPA_RESULT_NO_MEMORY;
 }
 
+static void setup_data_loop(struct pw_core *core, struct pw_data_loop *loop)
+{
+	loop->id = core->n_data_loops++;
+	loop->support[0] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, core->type.map);
+	loop->support[1] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__DataLoop, loop->loop->loop);
+	loop->support[2] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__MainLoop, core->main_loop->loop);
+	loop->support[3] = SPA_SUPPORT_INIT(SPA_TYPE__Log, pw_log_get());
+	loop->n_support = 4;
+	loop->rt.quantum = core->quantum;
+
+	spa_list_insert(core->data_loop_list.prev, &loop->link);
+}
+
 /** Create a new core object
  *
  * \param main_loop the main loop to use
@@ -330,16 +365,13 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	pw_type_init(&this->type);
 	pw_map_init(&this->globals, 128, 32);
 
-	spa_graph_init(&this->rt.graph);
-	spa_graph_scheduler_init(&this->rt.sched, &this->rt.graph);
-
 	spa_debug_set_type_map(this->type.map);
 
-	this->support[0] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, this->type.map);
-	this->support[1] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__DataLoop, this->data_loop->loop);
-	this->support[2] = SPA_SUPPORT_INIT(SPA_TYPE_LOOP__MainLoop, this->main_loop->loop);
-	this->support[3] = SPA_SUPPORT_INIT(SPA_TYPE__Log, pw_log_get());
-	this->n_support = 4;
+	spa_list_init(&this->data_loop_list);
+	setup_data_loop(this, this->data_loop_impl);
+
+	memcpy(this->support, this->data_loop_impl->support, sizeof(this->support));
+	this->n_support = this->data_loop_impl->n_support;
 
 	pw_data_loop_start(this->data_loop_impl);
 
@@ -373,6 +405,16 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	this->info.name = pw_properties_get(properties, "pipewire.core.name");
 	this->properties = properties;
 
+	this->quantum_default = this->data_loop_impl->config.quantum;
+	this->quantum_min = 32;
+	this->quantum_max = 8192;
+	if ((name = pw_properties_get(properties, "core.quantum.min")) && atoi(name) > 0)
+		this->quantum_min = atoi(name);
+	if ((name = pw_properties_get(properties, "core.quantum.max")) && atoi(name) > 0)
+		this->quantum_max = atoi(name);
+	this->quantum_default = SPA_CLAMP(this->quantum_default, this->quantum_min, this->quantum_max);
+	this->quantum = this->quantum_default;
+
 	this->global = pw_core_add_global(this,
 					  NULL,
 					  NULL,
@@ -396,6 +438,7 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 void pw_core_destroy(struct pw_core *core)
 {
 	struct pw_global *global, *t;
+	struct pw_data_loop *loop, *tl;
 
 	pw_log_debug("core %p: destroy", core);
 	spa_hook_list_call(&core->listener_list, struct pw_core_events, destroy, core);
@@ -403,7 +446,8 @@ void pw_core_destroy(struct pw_core *core)
 	spa_list_for_each_safe(global, t, &core->global_list, link)
 		pw_global_destroy(global);
 
-	pw_data_loop_destroy(core->data_loop_impl);
+	spa_list_for_each_safe(loop, tl, &core->data_loop_list, link)
+		pw_data_loop_destroy(loop);
 
 	pw_properties_free(core->properties);
 
@@ -455,6 +499,112 @@ struct pw_loop *pw_core_get_main_loop(struct pw_core *core)
 	return core->main_loop;
 }
 
+/** Add an extra data loop to the core
+ *
+ * \param core a core
+ * \param properties properties of the data loop, ownership is taken
+ * \return the new data loop or NULL on error
+ *
+ * The loop is started right away. Nodes that drive a graph are spread
+ * over the extra data loops, see \ref pw_core_find_data_loop.
+ *
+ * \memberof pw_core
+ */
+struct pw_data_loop *pw_core_add_data_loop(struct pw_core *core, struct pw_properties *properties)
+{
+	struct pw_data_loop *loop;
+
+	loop = pw_data_loop_new(properties);
+	if (properties)
+		pw_properties_free(properties);
+	if (loop == NULL)
+		return NULL;
+
+	setup_data_loop(core, loop);
+
+	pw_log_debug("core %p: added data loop %p id %d", core, loop, loop->id);
+
+	if (pw_data_loop_start(loop) < 0) {
+		spa_list_remove(&loop->link);
+		pw_data_loop_destroy(loop);
+		return NULL;
+	}
+	return loop;
+}
+
+/** Get a data loop by id
+ * \param core a core
+ * \param id the id of the data loop, 0 is the default data loop
+ * \return the data loop or NULL when not found
+ *
+ * \memberof pw_core
+ */
+struct pw_data_loop *pw_core_get_data_loop(struct pw_core *core, uint32_t id)
+{
+	struct pw_data_loop *loop;
+
+	spa_list_for_each(loop, &core->data_loop_list, link) {
+		if (loop->id == id)
+			return loop;
+	}
+	return NULL;
+}
+
+/** Find the data loop for a new node
+ *
+ * \param core a core
+ * \param properties properties of the new node
+ * \return the data loop to schedule the node on
+ *
+ * The "node.data-loop" property selects a loop by id. Otherwise nodes with
+ * "node.driver" set to 1 go to the extra data loop with the fewest nodes so that
+ * independent devices don't share a thread. All other nodes go to the
+ * default data loop and follow the nodes they get linked to.
+ *
+ * The selected loop id is stored in "node.data-loop", nodes created with
+ * that property are never moved to another loop.
+ *
+ * \memberof pw_core
+ */
+struct pw_data_loop *pw_core_find_data_loop(struct pw_core *core, struct pw_properties *properties)
+{
+	struct pw_data_loop *loop, *best = NULL;
+	const char *str;
+
+	if (properties == NULL)
+		return core->data_loop_impl;
+
+	if ((str = pw_properties_get(properties, "node.data-loop"))) {
+		if ((best = pw_core_get_data_loop(core, atoi(str))) == NULL)
+			pw_log_warn("core %p: unknown data loop %s", core, str);
+	}
+	else if ((str = pw_properties_get(properties, "node.driver")) && atoi(str)) {
+		spa_list_for_each(loop, &core->data_loop_list, link) {
+			if (loop == core->data_loop_impl)
+				continue;
+			if (best == NULL || loop->n_nodes < best->n_nodes)
+				best = loop;
+		}
+	}
+	if (best == NULL)
+		best = core->data_loop_impl;
+
+	pw_properties_setf(properties, "node.data-loop", "%d", best->id);
+
+	return best;
+}
+
+/** Get the support items for plugins scheduled on \a loop
+ * \memberof pw_core
+ */
+const struct spa_support *pw_core_get_data_loop_support(struct pw_core *core,
+							struct pw_data_loop *loop,
+							uint32_t *n_support)
+{
+	*n_support = loop->n_support;
+	return loop->support;
+}
+
 const struct pw_properties *pw_core_get_properties(struct pw_core *core)
 {
 	return core->properties;
@@ -465,7 +615,8 @@ const struct pw_properties *pw_core_get_properties(struct pw_core *core)
  * \param core a core
  * \param dict properties to update
  *
- * Update the core object with the given properties
+ * Update the core object with the given properties, clients are only
+ * notified when the properties changed
  *
  * \memberof pw_core
  */
@@ -484,6 +635,11 @@ void pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict
 					  dict->items[i].key, dict->items[i].value);
 	}
 
+	if (core->properties == NULL ||
+	    core->props_generation == pw_properties_get_generation(core->properties))
+		return;
+	core->props_generation = pw_properties_get_generation(core->properties);
+
 	core->info.change_mask = PW_CORE_CHANGE_MASK_PROPS;
 	core->info.props = core->properties ? &core->properties->dict : NULL;
 
@@ -495,6 +651,113 @@ void pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict
 	core->info.change_mask = 0;
 }
 
+/** Get the graph quantum
+ *
+ * \param core a core
+ * \return the current graph quantum in samples
+ *
+ * \memberof pw_core
+ */
+uint32_t pw_core_get_quantum(struct pw_core *core)
+{
+	return core->quantum;
+}
+
+/** Recalculate the graph quantum
+ *
+ * \param core a core
+ *
+ * The quantum is the smallest node.latency of the active nodes, clamped
+ * to core.quantum.min and core.quantum.max. Without active nodes that
+ * request a latency, the data-loop.quantum of the core is used.
+ *
+ * When the quantum changes, it is configured on all driver nodes and the
+ * data loops and published in the core.quantum property. Links are kept and the new
+ * size reaches the other nodes through the port io ranges.
+ *
+ * \memberof pw_core
+ */
+void pw_core_update_quantum(struct pw_core *core)
+{
+	struct pw_data_loop *loop;
+	struct pw_node *node;
+	uint32_t quantum = 0;
+
+	spa_list_for_each(node, &core->node_list, link) {
+		if (node->active && node->latency > 0 &&
+		    (quantum == 0 || node->latency < quantum))
+			quantum = node->latency;
+	}
+	if (quantum == 0)
+		quantum = core->quantum_default;
+	quantum = SPA_CLAMP(quantum, core->quantum_min, core->quantum_max);
+
+	if (quantum == core->quantum)
+		return;
+
+	pw_log_debug("core %p: quantum %u -> %u", core, core->quantum, quantum);
+	core->quantum = quantum;
+
+	spa_list_for_each(node, &core->node_list, link)
+		pw_node_set_quantum(node, quantum);
+	spa_list_for_each(loop, &core->data_loop_list, link)
+		pw_data_loop_set_quantum(loop, quantum);
+
+	pw_properties_setf(core->properties, "core.quantum", "%u", quantum);
+	pw_core_update_properties(core, &core->properties->dict);
+}
+
+static int
+do_set_driver_clock(struct spa_loop *loop,
+		    bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct pw_data_loop *l = user_data;
+	l->rt.clock = l->driver ? l->driver->clock : NULL;
+	l->rt.clock_id = l->driver_id;
+	return SPA_RESULT_OK;
+}
+
+/** Select the nodes that drive the graph clocks
+ *
+ * \param core a core
+ *
+ * Each data loop schedules its own graph and gets its own driver. The
+ * active live node on the loop with a clock and the highest
+ * "node.driver-priority" becomes the driver, the first one wins on a tie.
+ * Devices have priority 2, streams connected with PW_STREAM_FLAG_DRIVER
+ * have priority 1 and drive only when no device is running on the loop.
+ *
+ * The clock of the driver is made available to its data loop, where it is
+ * sampled every cycle and published to the clients on that loop.
+ *
+ * \memberof pw_core
+ */
+void pw_core_update_driver(struct pw_core *core)
+{
+	struct pw_data_loop *loop;
+	struct pw_node *node, *driver;
+
+	spa_list_for_each(loop, &core->data_loop_list, link) {
+		driver = NULL;
+		spa_list_for_each(node, &core->node_list, link) {
+			if (node->data_loop_impl != loop ||
+			    !node->active || !node->live || node->clock == NULL)
+				continue;
+			if (driver == NULL || node->driver_priority > driver->driver_priority)
+				driver = node;
+		}
+		if (driver == loop->driver)
+			continue;
+
+		pw_log_debug("core %p: data loop %d driver %p -> %p", core, loop->id,
+			     loop->driver, driver);
+		loop->driver = driver;
+		loop->driver_id = ++core->driver_serial;
+
+		pw_loop_invoke(loop->loop, do_set_driver_clock, 1, 0, NULL, true, loop);
+	}
+}
+
 bool pw_core_for_each_global(struct pw_core *core,
 			     bool (*callback) (void *data, struct pw_global *global),
 			     void *data)
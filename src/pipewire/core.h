@@ -26,6 +26,7 @@ extern "C" {
 
 #include <spa/hook.h>
 #include <spa/format.h>
+#include <spa/clock.h>
 
 /** \class pw_core
  *
@@ -39,6 +40,7 @@ extern "C" {
 struct pw_core;
 
 #include <pipewire/client.h>
+#include <pipewire/data-loop.h>
 #include <pipewire/global.h>
 #include <pipewire/introspect.h>
 #include <pipewire/loop.h>
@@ -152,6 +154,29 @@ const struct spa_support *pw_core_get_support(struct pw_core *core, uint32_t *n_
 
 struct pw_loop *pw_core_get_main_loop(struct pw_core *core);
 
+/** Get the current graph quantum in samples */
+uint32_t pw_core_get_quantum(struct pw_core *core);
+
+/** Recalculate the graph quantum from the latency of the active nodes */
+void pw_core_update_quantum(struct pw_core *core);
+
+/** Select the nodes that provide the graph clock of each data loop */
+void pw_core_update_driver(struct pw_core *core);
+
+/** Add an extra data loop */
+struct pw_data_loop *pw_core_add_data_loop(struct pw_core *core, struct pw_properties *properties);
+
+/** Get a data loop by id */
+struct pw_data_loop *pw_core_get_data_loop(struct pw_core *core, uint32_t id);
+
+/** Find the data loop for a node with the given properties */
+struct pw_data_loop *pw_core_find_data_loop(struct pw_core *core, struct pw_properties *properties);
+
+/** Get the support items for plugins running on \a loop */
+const struct spa_support *pw_core_get_data_loop_support(struct pw_core *core,
+							struct pw_data_loop *loop,
+							uint32_t *n_support);
+
 void pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict);
 
 /** iterate the globals */
@@ -18,15 +18,53 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
 #include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
 #include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 #include "pipewire/log.h"
 #include "pipewire/rtkit.h"
 #include "pipewire/data-loop.h"
 #include "pipewire/private.h"
 
-static void make_realtime(struct pw_data_loop *this)
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE	6
+#endif
+#ifndef SCHED_FLAG_RESET_ON_FORK
+#define SCHED_FLAG_RESET_ON_FORK	0x01
+#endif
+
+/* not in the libc headers yet */
+struct sched_attr {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+};
+
+static const struct {
+	const char *name;
+	int policy;
+} policies[] = {
+	{ "rtkit", -1 },
+	{ "other", SCHED_OTHER },
+	{ "fifo", SCHED_FIFO },
+	{ "rr", SCHED_RR },
+	{ "deadline", SCHED_DEADLINE },
+};
+
+static void make_realtime_rtkit(struct pw_data_loop *this)
 {
 	struct sched_param sp;
 	struct pw_rtkit_bus *system_bus;
@@ -34,8 +72,8 @@ static void make_realtime(struct pw_data_loop *this)
 	int r, rtprio;
 	long long rttime;
 
-	rtprio = 20;
-	rttime = 20000;
+	rtprio = this->config.priority;
+	rttime = this->config.rttime;
 
 	spa_zero(sp);
 	sp.sched_priority = rtprio;
@@ -69,12 +107,216 @@ static void make_realtime(struct pw_data_loop *this)
 	pw_rtkit_bus_free(system_bus);
 }
 
+/* the period follows the graph quantum unless it was configured */
+static uint64_t get_period(struct pw_data_loop *this)
+{
+	uint32_t quantum;
+
+	if (this->config.period)
+		return this->config.period;
+	quantum = this->rt.quantum ? this->rt.quantum : this->config.quantum;
+	return (uint64_t) quantum * SPA_USEC_PER_SEC / this->config.rate;
+}
+
+static int make_deadline(struct pw_data_loop *this)
+{
+	struct sched_attr attr;
+	uint64_t period, runtime;
+
+	period = get_period(this);
+	runtime = this->config.runtime;
+	if (runtime == 0 || runtime > period)
+		runtime = period / 2;
+
+	spa_zero(attr);
+	attr.size = sizeof(attr);
+	attr.sched_policy = SCHED_DEADLINE;
+	attr.sched_flags = SCHED_FLAG_RESET_ON_FORK;
+	attr.sched_runtime = runtime * 1000;
+	attr.sched_deadline = period * 1000;
+	attr.sched_period = period * 1000;
+
+	if (syscall(SYS_sched_setattr, 0, &attr, 0) < 0)
+		return -errno;
+
+	pw_log_debug("data-loop %p: SCHED_DEADLINE runtime %" PRIu64 " period %" PRIu64,
+		     this, runtime, period);
+	return 0;
+}
+
+static void make_realtime(struct pw_data_loop *this)
+{
+	struct sched_param sp;
+	int err;
+
+	switch (this->config.policy) {
+	case SCHED_OTHER:
+		spa_zero(sp);
+		pthread_setschedparam(pthread_self(), SCHED_OTHER, &sp);
+		return;
+
+	case SCHED_FIFO:
+	case SCHED_RR:
+		spa_zero(sp);
+		sp.sched_priority = this->config.priority;
+		if ((err = pthread_setschedparam(pthread_self(),
+						 this->config.policy | SCHED_RESET_ON_FORK,
+						 &sp)) == 0) {
+			pw_log_debug("data-loop %p: policy %d priority %d", this,
+				     this->config.policy, this->config.priority);
+			return;
+		}
+		pw_log_warn("data-loop %p: can't set policy %d: %s, trying rtkit", this,
+			    this->config.policy, strerror(err));
+		break;
+
+	case SCHED_DEADLINE:
+		if ((err = make_deadline(this)) == 0)
+			return;
+		pw_log_warn("data-loop %p: can't set SCHED_DEADLINE: %s, trying rtkit", this,
+			    strerror(-err));
+		break;
+	}
+	make_realtime_rtkit(this);
+}
+
+static void pin_thread(struct pw_data_loop *this)
+{
+	int err;
+
+	if (!this->config.pinned)
+		return;
+
+	/* the kernel refuses SCHED_DEADLINE for threads that can't run on
+	 * all cpus of their root domain */
+	if (this->config.policy == SCHED_DEADLINE) {
+		pw_log_warn("data-loop %p: not pinning the thread, the deadline policy "
+			    "needs all cpus", this);
+		return;
+	}
+
+	if ((err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &this->config.cpus)) != 0) {
+		pw_log_warn("data-loop %p: can't set cpu affinity: %s", this, strerror(err));
+	} else {
+		pw_log_debug("data-loop %p: pinned to %d cpus", this, CPU_COUNT(&this->config.cpus));
+	}
+}
+
+/* lock the complete stack of the current thread so that it never faults */
+static void lock_stack(struct pw_data_loop *this)
+{
+	pthread_attr_t attr;
+	void *addr;
+	size_t size;
+
+	if (!this->config.lock_memory)
+		return;
+
+	if (pthread_getattr_np(pthread_self(), &attr) != 0)
+		return;
+
+	if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+		if (mlock(addr, size) < 0) {
+			pw_log_warn("data-loop %p: can't lock stack: %s", this, strerror(errno));
+		} else {
+			pw_log_debug("data-loop %p: locked %zd bytes of stack", this, size);
+		}
+	}
+	pthread_attr_destroy(&attr);
+}
+
+static void apply_config(struct pw_data_loop *this)
+{
+	pin_thread(this);
+	lock_stack(this);
+	make_realtime(this);
+}
+
+static int
+do_apply_config(struct spa_loop *loop,
+		bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	apply_config(user_data);
+	return SPA_RESULT_OK;
+}
+
+/* parse a cpu list like "0,2-3" */
+static bool parse_cpus(const char *str, cpu_set_t *cpus)
+{
+	const char *p = str;
+
+	CPU_ZERO(cpus);
+	while (*p) {
+		char *end;
+		long first, last;
+
+		first = last = strtol(p, &end, 10);
+		if (end == p || first < 0)
+			return false;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first)
+				return false;
+		}
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, cpus);
+
+		p = end;
+		if (*p == ',')
+			p++;
+		else if (*p != '\0')
+			return false;
+	}
+	return CPU_COUNT(cpus) > 0;
+}
+
+static void parse_config(struct pw_data_loop *this, const struct spa_dict *dict)
+{
+	const char *str;
+	int i;
+
+	if (dict == NULL)
+		return;
+
+	if ((str = spa_dict_lookup(dict, "data-loop.cpus"))) {
+		if (!(this->config.pinned = parse_cpus(str, &this->config.cpus)))
+			pw_log_warn("data-loop %p: invalid cpu list \"%s\"", this, str);
+	}
+	if ((str = spa_dict_lookup(dict, "data-loop.rt.policy"))) {
+		for (i = 0; i < SPA_N_ELEMENTS(policies); i++) {
+			if (strcmp(str, policies[i].name) == 0)
+				break;
+		}
+		if (i < SPA_N_ELEMENTS(policies))
+			this->config.policy = policies[i].policy;
+		else
+			pw_log_warn("data-loop %p: unknown policy \"%s\"", this, str);
+	}
+	if ((str = spa_dict_lookup(dict, "data-loop.rt.priority")))
+		this->config.priority = atoi(str);
+	if ((str = spa_dict_lookup(dict, "data-loop.rt.time")))
+		this->config.rttime = atoll(str);
+	if ((str = spa_dict_lookup(dict, "data-loop.rt.period")))
+		this->config.period = strtoull(str, NULL, 10);
+	if ((str = spa_dict_lookup(dict, "data-loop.rt.runtime")))
+		this->config.runtime = strtoull(str, NULL, 10);
+	if ((str = spa_dict_lookup(dict, "data-loop.quantum")) && atoi(str) > 0)
+		this->config.quantum = atoi(str);
+	if ((str = spa_dict_lookup(dict, "data-loop.rate")) && atoi(str) > 0)
+		this->config.rate = atoi(str);
+	if ((str = spa_dict_lookup(dict, "data-loop.stack-size")))
+		this->config.stack_size = strtoul(str, NULL, 10);
+	if ((str = spa_dict_lookup(dict, "data-loop.lock-memory")))
+		this->config.lock_memory = atoi(str) != 0;
+}
+
 static void *do_loop(void *user_data)
 {
 	struct pw_data_loop *this = user_data;
 	int res;
 
-	make_realtime(this);
+	apply_config(this);
 
 	pw_log_debug("data-loop %p: enter thread", this);
 	pw_loop_enter(this->loop);
@@ -96,9 +338,89 @@ static void do_stop(struct spa_loop_utils *utils, struct spa_source *source, uin
 	this->running = false;
 }
 
+static void on_deadline(struct spa_loop_utils *utils, struct spa_source *source, void *data)
+{
+	struct pw_data_loop *this = data;
+	uint32_t late;
+
+	if ((late = spa_graph_scheduler_deadline(&this->rt.sched)) > 0)
+		pw_log_debug("data-loop %p: %u nodes missed the deadline", this, late);
+}
+
+/** Arm the deadline of the current cycle
+ * \param loop the data loop
+ *
+ * Called from the data thread after async nodes were issued work. Nodes
+ * that did not complete one graph quantum later are skipped and get an
+ * xrun.
+ *
+ * \memberof pw_data_loop
+ */
+void pw_data_loop_schedule_deadline(struct pw_data_loop *loop)
+{
+	struct timespec value;
+	uint64_t timeout = get_period(loop) * SPA_NSEC_PER_USEC;
+
+	value.tv_sec = timeout / SPA_NSEC_PER_SEC;
+	value.tv_nsec = timeout % SPA_NSEC_PER_SEC;
+	pw_loop_update_timer(loop->loop, loop->rt.deadline, &value, NULL, false);
+}
+
+static int
+do_set_quantum(struct spa_loop *loop,
+	       bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct pw_data_loop *this = user_data;
+	int res;
+
+	this->rt.quantum = *(uint32_t *) data;
+
+	if (this->config.policy == SCHED_DEADLINE && this->config.period == 0 &&
+	    (res = make_deadline(this)) < 0)
+		pw_log_warn("data-loop %p: can't update SCHED_DEADLINE: %s", this,
+			    strerror(-res));
+	return SPA_RESULT_OK;
+}
+
+/** Set the graph quantum
+ * \param loop the data loop
+ * \param quantum the graph quantum in samples
+ *
+ * The deadline of async nodes and the SCHED_DEADLINE period, when not
+ * configured with data-loop.rt.period, are derived from the quantum.
+ *
+ * \memberof pw_data_loop
+ */
+void pw_data_loop_set_quantum(struct pw_data_loop *loop, uint32_t quantum)
+{
+	if (loop->running)
+		pw_loop_invoke(loop->loop, do_set_quantum, 1, sizeof(uint32_t), &quantum,
+			       true, loop);
+	else
+		loop->rt.quantum = quantum;
+}
+
 /** Create a new \ref pw_data_loop.
+ * \param properties extra properties, or NULL
  * \return a newly allocated data loop
  *
+ * The scheduling of the thread is configured with these properties:
+ *
+ *  - data-loop.cpus: cpu list like "0,2-3" to pin the thread to, ignored
+ *    with the deadline policy
+ *  - data-loop.rt.policy: rtkit (default), other, fifo, rr or deadline
+ *  - data-loop.rt.priority: priority for rtkit, fifo and rr, default 20
+ *  - data-loop.rt.time: RLIMIT_RTTIME in usec for rtkit, default 20000
+ *  - data-loop.rt.period: deadline period in usec, default the duration of
+ *    the graph quantum at data-loop.rate (48000). Until the core sets the
+ *    quantum, data-loop.quantum (1024) is used
+ *  - data-loop.rt.runtime: deadline runtime in usec, default half the period
+ *  - data-loop.stack-size: stack size of the thread in bytes
+ *  - data-loop.lock-memory: 1 to lock the stack of the thread in memory
+ *
+ * The fifo, rr and deadline policies fall back to rtkit when they can't be
+ * set directly.
+ *
  * \memberof pw_data_loop
  */
 struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
@@ -117,7 +439,18 @@ struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 
 	spa_hook_list_init(&this->listener_list);
 
+	this->config.policy = -1;
+	this->config.priority = 20;
+	this->config.rttime = 20000;
+	this->config.quantum = 1024;
+	this->config.rate = 48000;
+	parse_config(this, properties ? &properties->dict : NULL);
+
+	spa_graph_init(&this->rt.graph);
+	spa_graph_scheduler_init(&this->rt.sched, &this->rt.graph);
+
 	this->event = pw_loop_add_event(this->loop, do_stop, this);
+	this->rt.deadline = pw_loop_add_timer(this->loop, on_deadline, this);
 
 	return this;
 
@@ -138,6 +471,7 @@ void pw_data_loop_destroy(struct pw_data_loop *loop)
 
 	pw_data_loop_stop(loop);
 
+	pw_loop_destroy_source(loop->loop, loop->rt.deadline);
 	pw_loop_destroy_source(loop->loop, loop->event);
 	pw_loop_destroy(loop->loop);
 	free(loop);
@@ -170,8 +504,17 @@ int pw_data_loop_start(struct pw_data_loop *loop)
 	if (!loop->running) {
 		int err;
 
+		pthread_attr_t attr;
+
+		pthread_attr_init(&attr);
+		if (loop->config.stack_size > 0 &&
+		    (err = pthread_attr_setstacksize(&attr, loop->config.stack_size)) != 0)
+			pw_log_warn("data-loop %p: can't set stack size: %s", loop, strerror(err));
+
 		loop->running = true;
-		if ((err = pthread_create(&loop->thread, NULL, do_loop, loop)) != 0) {
+		err = pthread_create(&loop->thread, &attr, do_loop, loop);
+		pthread_attr_destroy(&attr);
+		if (err != 0) {
 			pw_log_warn("data-loop %p: can't create thread: %s", loop, strerror(err));
 			loop->running = false;
 			return SPA_RESULT_ERROR;
@@ -198,6 +541,24 @@ int pw_data_loop_stop(struct pw_data_loop *loop)
 	return SPA_RESULT_OK;
 }
 
+/** Update the properties of a data loop
+ * \param loop the data loop to update
+ * \param dict new properties
+ *
+ * Update the scheduling configuration of the loop, see \ref pw_data_loop_new.
+ * A running thread is reconfigured right away except for the stack size,
+ * which only applies when the thread is started.
+ *
+ * \memberof pw_data_loop
+ */
+void pw_data_loop_update_properties(struct pw_data_loop *loop, const struct spa_dict *dict)
+{
+	parse_config(loop, dict);
+
+	if (loop->running)
+		pw_loop_invoke(loop->loop, do_apply_config, 1, 0, NULL, true, loop);
+}
+
 /** Check if we are inside the data loop
  * \param loop the data loop to check
  * \return true is the current thread is the data loop thread
@@ -208,3 +569,19 @@ bool pw_data_loop_in_thread(struct pw_data_loop * loop)
 {
 	return pthread_equal(loop->thread, pthread_self());
 }
+
+/** Get the clock of the driver of the graph of the loop
+ * \param loop the data loop
+ * \param[out] id the id of the clock, changes when the driver changes
+ * \return the clock of the driver node or NULL when there is none
+ *
+ * This is only safe to call from the thread of \a loop.
+ *
+ * \memberof pw_data_loop
+ */
+struct spa_clock *pw_data_loop_get_driver_clock(struct pw_data_loop *loop, uint32_t *id)
+{
+	if (id)
+		*id = loop->rt.clock_id;
+	return loop->rt.clock;
+}
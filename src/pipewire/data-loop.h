@@ -56,6 +56,9 @@ pw_data_loop_get_loop(struct pw_data_loop *loop);
 void
 pw_data_loop_destroy(struct pw_data_loop *loop);
 
+void
+pw_data_loop_update_properties(struct pw_data_loop *loop, const struct spa_dict *dict);
+
 int
 pw_data_loop_start(struct pw_data_loop *loop);
 
@@ -65,6 +68,9 @@ pw_data_loop_stop(struct pw_data_loop *loop);
 bool
 pw_data_loop_in_thread(struct pw_data_loop *loop);
 
+struct spa_clock *
+pw_data_loop_get_driver_clock(struct pw_data_loop *loop, uint32_t *id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -65,7 +65,7 @@ struct pw_link_proxy;
 #define PW_TYPE_INTERFACE__Client	PW_TYPE_INTERFACE_BASE "Client"
 #define PW_TYPE_INTERFACE__Link		PW_TYPE_INTERFACE_BASE "Link"
 
-#define PW_VERSION_CORE				0
+#define PW_VERSION_CORE				1
 
 #define PW_CORE_PROXY_METHOD_UPDATE_TYPES	0
 #define PW_CORE_PROXY_METHOD_SYNC		1
@@ -234,7 +234,7 @@ pw_core_proxy_create_link(struct pw_core_proxy *core,
  *  \ingroup pw_core_interface The pw_core interface
  */
 struct pw_core_proxy_events {
-#define PW_VERSION_CORE_PROXY_EVENTS	0
+#define PW_VERSION_CORE_PROXY_EVENTS	1
 	uint32_t version;
 	/**
 	 * Update the type map
@@ -284,6 +284,8 @@ struct pw_core_proxy_events {
 	/**
 	 * Notify new core info
 	 *
+	 * Only the fields marked in the change_mask of \a info are set.
+	 *
 	 * \param info new core info
 	 */
 	void (*info) (void *object, struct pw_core_info *info);
@@ -306,7 +308,7 @@ pw_core_proxy_add_listener(struct pw_core_proxy *core,
 #define pw_core_resource_info(r,...)         pw_resource_notify(r,struct pw_core_proxy_events,info,__VA_ARGS__)
 
 
-#define PW_VERSION_REGISTRY			0
+#define PW_VERSION_REGISTRY			1
 
 #define PW_REGISTRY_PROXY_METHOD_BIND		0
 #define PW_REGISTRY_PROXY_METHOD_NUM		1
@@ -344,11 +346,21 @@ pw_registry_proxy_bind(struct pw_registry_proxy *registry,
 
 #define PW_REGISTRY_PROXY_EVENT_GLOBAL             0
 #define PW_REGISTRY_PROXY_EVENT_GLOBAL_REMOVE      1
-#define PW_REGISTRY_PROXY_EVENT_NUM                2
+#define PW_REGISTRY_PROXY_EVENT_GLOBAL_LIST        2
+#define PW_REGISTRY_PROXY_EVENT_NUM                3
+
+/** A global object, as announced in a registry snapshot */
+struct pw_registry_global {
+	uint32_t id;		/**< the global object id */
+	uint32_t parent_id;	/**< the parent global id */
+	uint32_t permissions;	/**< the permissions of the object */
+	uint32_t type;		/**< the type of the interface */
+	uint32_t version;	/**< the version of the interface */
+};
 
 /** Registry events */
 struct pw_registry_proxy_events {
-#define PW_VERSION_REGISTRY_PROXY_EVENTS	0
+#define PW_VERSION_REGISTRY_PROXY_EVENTS	1
 	uint32_t version;
 	/**
 	 * Notify of a new global object
@@ -374,6 +386,22 @@ struct pw_registry_proxy_events {
 	 * \param id the id of the global that was removed
 	 */
 	void (*global_remove) (void *object, uint32_t id);
+	/**
+	 * Notify of a list of global objects
+	 *
+	 * The registry emits this event once after it was created, with a
+	 * snapshot of all the global objects that are visible to the
+	 * client. Globals added later are notified with the global event.
+	 *
+	 * The native protocol sends the snapshot as one message and
+	 * delivers the entries to the proxy listeners as individual global
+	 * events.
+	 *
+	 * \param n_globals the number of globals
+	 * \param globals the globals
+	 */
+	void (*global_list) (void *object, uint32_t n_globals,
+			     const struct pw_registry_global *globals);
 };
 
 static inline void
@@ -387,20 +415,23 @@ pw_registry_proxy_add_listener(struct pw_registry_proxy *registry,
 
 #define pw_registry_resource_global(r,...)        pw_resource_notify(r,struct pw_registry_proxy_events,global,__VA_ARGS__)
 #define pw_registry_resource_global_remove(r,...) pw_resource_notify(r,struct pw_registry_proxy_events,global_remove,__VA_ARGS__)
+#define pw_registry_resource_global_list(r,...)   pw_resource_notify(r,struct pw_registry_proxy_events,global_list,__VA_ARGS__)
 
 
-#define PW_VERSION_MODULE			0
+#define PW_VERSION_MODULE			1
 
 #define PW_MODULE_PROXY_EVENT_INFO		0
 #define PW_MODULE_PROXY_EVENT_NUM		1
 
 /** Module events */
 struct pw_module_proxy_events {
-#define PW_VERSION_MODULE_PROXY_EVENTS	0
+#define PW_VERSION_MODULE_PROXY_EVENTS	1
 	uint32_t version;
 	/**
 	 * Notify module info
 	 *
+	 * Only the fields marked in the change_mask of \a info are set.
+	 *
 	 * \param info info about the module
 	 */
 	void (*info) (void *object, struct pw_module_info *info);
@@ -417,18 +448,20 @@ pw_module_proxy_add_listener(struct pw_module_proxy *module,
 
 #define pw_module_resource_info(r,...)	pw_resource_notify(r,struct pw_module_proxy_events,info,__VA_ARGS__)
 
-#define PW_VERSION_NODE			0
+#define PW_VERSION_NODE			1
 
 #define PW_NODE_PROXY_EVENT_INFO	0
 #define PW_NODE_PROXY_EVENT_NUM	1
 
 /** Node events */
 struct pw_node_proxy_events {
-#define PW_VERSION_NODE_PROXY_EVENTS	0
+#define PW_VERSION_NODE_PROXY_EVENTS	1
 	uint32_t version;
 	/**
 	 * Notify node info
 	 *
+	 * Only the fields marked in the change_mask of \a info are set.
+	 *
 	 * \param info info about the node
 	 */
 	void (*info) (void *object, struct pw_node_info *info);
@@ -445,18 +478,20 @@ pw_node_proxy_add_listener(struct pw_node_proxy *node,
 
 #define pw_node_resource_info(r,...) pw_resource_notify(r,struct pw_node_proxy_events,info,__VA_ARGS__)
 
-#define PW_VERSION_CLIENT			0
+#define PW_VERSION_CLIENT			1
 
 #define PW_CLIENT_PROXY_EVENT_INFO		0
 #define PW_CLIENT_PROXY_EVENT_NUM		1
 
 /** Client events */
 struct pw_client_proxy_events {
-#define PW_VERSION_CLIENT_PROXY_EVENTS	0
+#define PW_VERSION_CLIENT_PROXY_EVENTS	1
 	uint32_t version;
 	/**
 	 * Notify client info
 	 *
+	 * Only the fields marked in the change_mask of \a info are set.
+	 *
 	 * \param info info about the client
 	 */
 	void (*info) (void *object, struct pw_client_info *info);
@@ -475,18 +510,20 @@ pw_client_proxy_add_listener(struct pw_client_proxy *client,
 #define pw_client_resource_info(r,...) pw_resource_notify(r,struct pw_client_proxy_events,info,__VA_ARGS__)
 
 
-#define PW_VERSION_LINK			0
+#define PW_VERSION_LINK			1
 
 #define PW_LINK_PROXY_EVENT_INFO	0
 #define PW_LINK_PROXY_EVENT_NUM	1
 
 /** Link events */
 struct pw_link_proxy_events {
-#define PW_VERSION_LINK_PROXY_EVENTS	0
+#define PW_VERSION_LINK_PROXY_EVENTS	1
 	uint32_t version;
 	/**
 	 * Notify link info
 	 *
+	 * Only the fields marked in the change_mask of \a info are set.
+	 *
 	 * \param info info about the link
 	 */
 	void (*info) (void *object, struct pw_link_info *info);
@@ -74,44 +74,101 @@ const char *pw_link_state_as_string(enum pw_link_state state)
 	return "invalid-state";
 }
 
-static void pw_spa_dict_destroy(struct spa_dict *dict)
+/** \cond */
+struct dict_snapshot {
+	int ref;
+	struct spa_dict dict;
+	struct spa_dict_item items[];
+};
+/** \endcond */
+
+/** Keep the properties of an info alive
+ * \param props properties of an info from one of the pw_*_info_update() functions
+ * \return \a props
+ *
+ * The properties of an info are immutable and shared. They are only replaced
+ * when they change and a reference stays valid after the info is updated
+ * or freed.
+ *
+ * \memberof pw_introspect
+ */
+struct spa_dict *pw_info_props_ref(struct spa_dict *props)
 {
-	struct spa_dict_item *item;
+	struct dict_snapshot *snap = SPA_CONTAINER_OF(props, struct dict_snapshot, dict);
 
-	spa_dict_for_each(item, dict) {
-		free((void *) item->key);
-		free((void *) item->value);
-	}
-	free(dict->items);
-	free(dict);
+	snap->ref++;
+	return props;
 }
 
-static struct spa_dict *pw_spa_dict_copy(struct spa_dict *dict)
+/** Release a reference on info properties
+ * \param props properties from \ref pw_info_props_ref()
+ * \memberof pw_introspect
+ */
+void pw_info_props_unref(struct spa_dict *props)
 {
-	struct spa_dict *copy;
+	struct dict_snapshot *snap = SPA_CONTAINER_OF(props, struct dict_snapshot, dict);
+
+	if (--snap->ref == 0)
+		free(snap);
+}
+
+static struct spa_dict *pw_spa_dict_copy(const struct spa_dict *dict)
+{
+	struct dict_snapshot *snap;
+	size_t size = 0;
 	uint32_t i;
+	char *p;
 
 	if (dict == NULL)
 		return NULL;
 
-	copy = calloc(1, sizeof(struct spa_dict));
-	if (copy == NULL)
-		goto no_mem;
-	copy->items = calloc(dict->n_items, sizeof(struct spa_dict_item));
-	if (copy->items == NULL)
-		goto no_items;
-	copy->n_items = dict->n_items;
+	for (i = 0; i < dict->n_items; i++)
+		size += strlen(dict->items[i].key) + strlen(dict->items[i].value) + 2;
+
+	snap = malloc(sizeof(struct dict_snapshot) +
+		      dict->n_items * sizeof(struct spa_dict_item) + size);
+	if (snap == NULL)
+		return NULL;
 
+	snap->ref = 1;
+	snap->dict.items = snap->items;
+	snap->dict.n_items = dict->n_items;
+
+	/* keys and values are stored after the items in the same allocation */
+	p = (char *) &snap->items[dict->n_items];
 	for (i = 0; i < dict->n_items; i++) {
-		copy->items[i].key = strdup(dict->items[i].key);
-		copy->items[i].value = strdup(dict->items[i].value);
+		snap->items[i].key = p;
+		p = stpcpy(p, dict->items[i].key) + 1;
+		snap->items[i].value = p;
+		p = stpcpy(p, dict->items[i].value) + 1;
+	}
+	return &snap->dict;
+}
+
+static bool pw_spa_dict_equal(const struct spa_dict *a, const struct spa_dict *b)
+{
+	uint32_t i;
+
+	if (a == b)
+		return true;
+	if (a == NULL || b == NULL || a->n_items != b->n_items)
+		return false;
+
+	for (i = 0; i < a->n_items; i++) {
+		if (strcmp(a->items[i].key, b->items[i].key) != 0 ||
+		    strcmp(a->items[i].value, b->items[i].value) != 0)
+			return false;
 	}
-	return copy;
+	return true;
+}
 
-      no_items:
-	free(copy);
-      no_mem:
-	return NULL;
+static struct spa_dict *update_props(struct spa_dict *props, const struct spa_dict *update)
+{
+	if (pw_spa_dict_equal(props, update))
+		return props;
+	if (props)
+		pw_info_props_unref(props);
+	return pw_spa_dict_copy(update);
 }
 
 struct pw_core_info *pw_core_info_update(struct pw_core_info *info,
@@ -127,32 +184,30 @@ struct pw_core_info *pw_core_info_update(struct pw_core_info *info,
 	}
 	info->change_mask = update->change_mask;
 
-	if (update->change_mask & (1 << 0)) {
+	if (update->change_mask & PW_CORE_CHANGE_MASK_USER_NAME) {
 		if (info->user_name)
 			free((void *) info->user_name);
 		info->user_name = update->user_name ? strdup(update->user_name) : NULL;
 	}
-	if (update->change_mask & (1 << 1)) {
+	if (update->change_mask & PW_CORE_CHANGE_MASK_HOST_NAME) {
 		if (info->host_name)
 			free((void *) info->host_name);
 		info->host_name = update->host_name ? strdup(update->host_name) : NULL;
 	}
-	if (update->change_mask & (1 << 2)) {
+	if (update->change_mask & PW_CORE_CHANGE_MASK_VERSION) {
 		if (info->version)
 			free((void *) info->version);
 		info->version = update->version ? strdup(update->version) : NULL;
 	}
-	if (update->change_mask & (1 << 3)) {
+	if (update->change_mask & PW_CORE_CHANGE_MASK_NAME) {
 		if (info->name)
 			free((void *) info->name);
 		info->name = update->name ? strdup(update->name) : NULL;
 	}
-	if (update->change_mask & (1 << 4))
+	if (update->change_mask & PW_CORE_CHANGE_MASK_COOKIE)
 		info->cookie = update->cookie;
-	if (update->change_mask & (1 << 5)) {
-		if (info->props)
-			pw_spa_dict_destroy(info->props);
-		info->props = pw_spa_dict_copy(update->props);
+	if (update->change_mask & PW_CORE_CHANGE_MASK_PROPS) {
+		info->props = update_props(info->props, update->props);
 	}
 	return info;
 }
@@ -168,7 +223,7 @@ void pw_core_info_free(struct pw_core_info *info)
 	if (info->name)
 		free((void *) info->name);
 	if (info->props)
-		pw_spa_dict_destroy(info->props);
+		pw_info_props_unref(info->props);
 	free(info);
 }
 
@@ -187,16 +242,16 @@ struct pw_node_info *pw_node_info_update(struct pw_node_info *info,
 	}
 	info->change_mask = update->change_mask;
 
-	if (update->change_mask & (1 << 0)) {
+	if (update->change_mask & PW_NODE_CHANGE_MASK_NAME) {
 		if (info->name)
 			free((void *) info->name);
 		info->name = update->name ? strdup(update->name) : NULL;
 	}
-	if (update->change_mask & (1 << 1)) {
+	if (update->change_mask & PW_NODE_CHANGE_MASK_INPUT_PORTS) {
 		info->max_input_ports = update->max_input_ports;
 		info->n_input_ports = update->n_input_ports;
 	}
-	if (update->change_mask & (1 << 2)) {
+	if (update->change_mask & PW_NODE_CHANGE_MASK_INPUT_FORMATS) {
 		for (i = 0; i < info->n_input_formats; i++)
 			free(info->input_formats[i]);
 		info->n_input_formats = update->n_input_formats;
@@ -212,11 +267,11 @@ struct pw_node_info *pw_node_info_update(struct pw_node_info *info,
 			info->input_formats[i] = spa_format_copy(update->input_formats[i]);
 		}
 	}
-	if (update->change_mask & (1 << 3)) {
+	if (update->change_mask & PW_NODE_CHANGE_MASK_OUTPUT_PORTS) {
 		info->max_output_ports = update->max_output_ports;
 		info->n_output_ports = update->n_output_ports;
 	}
-	if (update->change_mask & (1 << 4)) {
+	if (update->change_mask & PW_NODE_CHANGE_MASK_OUTPUT_FORMATS) {
 		for (i = 0; i < info->n_output_formats; i++)
 			free(info->output_formats[i]);
 		info->n_output_formats = update->n_output_formats;
@@ -233,16 +288,14 @@ struct pw_node_info *pw_node_info_update(struct pw_node_info *info,
 		}
 	}
 
-	if (update->change_mask & (1 << 5)) {
+	if (update->change_mask & PW_NODE_CHANGE_MASK_STATE) {
 		info->state = update->state;
 		if (info->error)
 			free((void *) info->error);
 		info->error = update->error ? strdup(update->error) : NULL;
 	}
-	if (update->change_mask & (1 << 6)) {
-		if (info->props)
-			pw_spa_dict_destroy(info->props);
-		info->props = pw_spa_dict_copy(update->props);
+	if (update->change_mask & PW_NODE_CHANGE_MASK_PROPS) {
+		info->props = update_props(info->props, update->props);
 	}
 	return info;
 }
@@ -266,7 +319,7 @@ void pw_node_info_free(struct pw_node_info *info)
 	if (info->error)
 		free((void *) info->error);
 	if (info->props)
-		pw_spa_dict_destroy(info->props);
+		pw_info_props_unref(info->props);
 	free(info);
 }
 
@@ -283,25 +336,23 @@ struct pw_module_info *pw_module_info_update(struct pw_module_info *info,
 	}
 	info->change_mask = update->change_mask;
 
-	if (update->change_mask & (1 << 0)) {
+	if (update->change_mask & PW_MODULE_CHANGE_MASK_NAME) {
 		if (info->name)
 			free((void *) info->name);
 		info->name = update->name ? strdup(update->name) : NULL;
 	}
-	if (update->change_mask & (1 << 1)) {
+	if (update->change_mask & PW_MODULE_CHANGE_MASK_FILENAME) {
 		if (info->filename)
 			free((void *) info->filename);
 		info->filename = update->filename ? strdup(update->filename) : NULL;
 	}
-	if (update->change_mask & (1 << 2)) {
+	if (update->change_mask & PW_MODULE_CHANGE_MASK_ARGS) {
 		if (info->args)
 			free((void *) info->args);
 		info->args = update->args ? strdup(update->args) : NULL;
 	}
-	if (update->change_mask & (1 << 3)) {
-		if (info->props)
-			pw_spa_dict_destroy(info->props);
-		info->props = pw_spa_dict_copy(update->props);
+	if (update->change_mask & PW_MODULE_CHANGE_MASK_PROPS) {
+		info->props = update_props(info->props, update->props);
 	}
 	return info;
 }
@@ -315,7 +366,7 @@ void pw_module_info_free(struct pw_module_info *info)
 	if (info->args)
 		free((void *) info->args);
 	if (info->props)
-		pw_spa_dict_destroy(info->props);
+		pw_info_props_unref(info->props);
 	free(info);
 }
 
@@ -333,10 +384,8 @@ struct pw_client_info *pw_client_info_update(struct pw_client_info *info,
 	}
 	info->change_mask = update->change_mask;
 
-	if (update->change_mask & (1 << 0)) {
-		if (info->props)
-			pw_spa_dict_destroy(info->props);
-		info->props = pw_spa_dict_copy(update->props);
+	if (update->change_mask & PW_CLIENT_CHANGE_MASK_PROPS) {
+		info->props = update_props(info->props, update->props);
 	}
 	return info;
 }
@@ -344,7 +393,7 @@ struct pw_client_info *pw_client_info_update(struct pw_client_info *info,
 void pw_client_info_free(struct pw_client_info *info)
 {
 	if (info->props)
-		pw_spa_dict_destroy(info->props);
+		pw_info_props_unref(info->props);
 	free(info);
 }
 
@@ -361,15 +410,15 @@ struct pw_link_info *pw_link_info_update(struct pw_link_info *info,
 	}
 	info->change_mask = update->change_mask;
 
-	if (update->change_mask & (1 << 0))
+	if (update->change_mask & PW_LINK_CHANGE_MASK_OUTPUT_NODE_ID)
 		info->output_node_id = update->output_node_id;
-	if (update->change_mask & (1 << 1))
+	if (update->change_mask & PW_LINK_CHANGE_MASK_OUTPUT_PORT_ID)
 		info->output_port_id = update->output_port_id;
-	if (update->change_mask & (1 << 2))
+	if (update->change_mask & PW_LINK_CHANGE_MASK_INPUT_NODE_ID)
 		info->input_node_id = update->input_node_id;
-	if (update->change_mask & (1 << 3))
+	if (update->change_mask & PW_LINK_CHANGE_MASK_INPUT_PORT_ID)
 		info->input_port_id = update->input_port_id;
-	if (update->change_mask & (1 << 4)) {
+	if (update->change_mask & PW_LINK_CHANGE_MASK_FORMAT) {
 		if (info->format)
 			free(info->format);
 		info->format = spa_format_copy(update->format);
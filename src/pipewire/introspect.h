@@ -72,6 +72,13 @@ const char * pw_link_state_as_string(enum pw_link_state state);
  * about the object in the PipeWire server
  */
 
+/** Take a reference on the properties of an info, they stay valid after the
+ * info is updated or freed \memberof pw_introspect */
+struct spa_dict *pw_info_props_ref(struct spa_dict *props);
+
+/** Release properties from \ref pw_info_props_ref() \memberof pw_introspect */
+void pw_info_props_unref(struct spa_dict *props);
+
 /**  The core information. Extra information can be added in later versions \memberof pw_introspect */
 struct pw_core_info {
 #define PW_CORE_CHANGE_MASK_USER_NAME  (1 << 0)
@@ -100,6 +107,11 @@ void pw_core_info_free(struct pw_core_info *info);
 
 /** The module information. Extra information can be added in later versions \memberof pw_introspect */
 struct pw_module_info {
+#define PW_MODULE_CHANGE_MASK_NAME	(1 << 0)
+#define PW_MODULE_CHANGE_MASK_FILENAME	(1 << 1)
+#define PW_MODULE_CHANGE_MASK_ARGS	(1 << 2)
+#define PW_MODULE_CHANGE_MASK_PROPS	(1 << 3)
+#define PW_MODULE_CHANGE_MASK_ALL	(~0)
 	uint64_t change_mask;	/**< bitfield of changed fields since last call */
 	const char *name;	/**< name of the module */
 	const char *filename;	/**< filename of the module */
@@ -117,6 +129,8 @@ void pw_module_info_free(struct pw_module_info *info);
 
 /** The client information. Extra information can be added in later versions \memberof pw_introspect */
 struct pw_client_info {
+#define PW_CLIENT_CHANGE_MASK_PROPS	(1 << 0)
+#define PW_CLIENT_CHANGE_MASK_ALL	(~0)
 	uint64_t change_mask;	/**< bitfield of changed fields since last call */
 	struct spa_dict *props;	/**< extra properties */
 };
@@ -132,6 +146,14 @@ void pw_client_info_free(struct pw_client_info *info);
 
 /** The node information. Extra information can be added in later versions \memberof pw_introspect */
 struct pw_node_info {
+#define PW_NODE_CHANGE_MASK_NAME		(1 << 0)
+#define PW_NODE_CHANGE_MASK_INPUT_PORTS		(1 << 1)
+#define PW_NODE_CHANGE_MASK_INPUT_FORMATS	(1 << 2)
+#define PW_NODE_CHANGE_MASK_OUTPUT_PORTS	(1 << 3)
+#define PW_NODE_CHANGE_MASK_OUTPUT_FORMATS	(1 << 4)
+#define PW_NODE_CHANGE_MASK_STATE		(1 << 5)
+#define PW_NODE_CHANGE_MASK_PROPS		(1 << 6)
+#define PW_NODE_CHANGE_MASK_ALL			(~0)
 	uint64_t change_mask;			/**< bitfield of changed fields since last call */
 	const char *name;			/**< name the node, suitable for display */
 	uint32_t max_input_ports;		/**< maximum number of inputs */
@@ -157,6 +179,12 @@ pw_node_info_free(struct pw_node_info *info);
 
 /** The link information. Extra information can be added in later versions \memberof pw_introspect */
 struct pw_link_info {
+#define PW_LINK_CHANGE_MASK_OUTPUT_NODE_ID	(1 << 0)
+#define PW_LINK_CHANGE_MASK_OUTPUT_PORT_ID	(1 << 1)
+#define PW_LINK_CHANGE_MASK_INPUT_NODE_ID	(1 << 2)
+#define PW_LINK_CHANGE_MASK_INPUT_PORT_ID	(1 << 3)
+#define PW_LINK_CHANGE_MASK_FORMAT		(1 << 4)
+#define PW_LINK_CHANGE_MASK_ALL			(~0)
 	uint64_t change_mask;		/**< bitfield of changed fields since last call */
 	uint32_t output_node_id;	/**< server side output node id */
 	uint32_t output_port_id;	/**< output port id */
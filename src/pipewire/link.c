@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <spa/lib/debug.h>
 #include <spa/video/format.h>
@@ -34,6 +35,7 @@
 #include "work-queue.h"
 
 #define MAX_BUFFERS     16
+#define MAX_MIX_SPARES  2
 
 /** \cond */
 struct impl {
@@ -53,8 +55,16 @@ struct impl {
 
 	void *buffer_owner;
 	struct pw_memblock buffer_mem;
+	struct pw_memblock ring_mem;
 	struct spa_buffer **buffers;
 	uint32_t n_buffers;
+
+	/* buffers that only a mixing input port and its node know */
+	struct pw_memblock spare_mem;
+	struct spa_buffer **spares;
+	uint32_t n_spares;
+
+	struct spa_pod_builder params;	/**< arena for the filtered params */
 };
 
 struct resource_data {
@@ -234,7 +244,8 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 					 uint32_t n_datas,
 					 size_t *data_sizes,
 					 ssize_t *data_strides,
-					 struct pw_memblock *mem)
+					 struct pw_memblock *mem,
+					 struct pw_memblock *ring_mem)
 {
 	struct spa_buffer **buffers, *bp;
 	uint32_t i;
@@ -243,6 +254,7 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 	void *ddp;
 	uint32_t n_metas;
 	struct spa_meta *metas;
+	bool ring = false;
 
 	n_metas = data_size = meta_size = 0;
 
@@ -278,14 +290,33 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 			meta_size += metas[n_metas].size;
 			n_metas++;
 			skel_size += sizeof(struct spa_meta);
+
+			if (type == this->core->type.meta.Ringbuffer)
+				ring = true;
 		}
 	}
 	data_size += meta_size;
 
+	/* the data of a single ringbuffer goes in its own memory that is mapped
+	 * twice so that readers and writers never have to wrap around */
+	if (ring && n_buffers == 1 && n_datas > 0 && data_sizes[0] > 0) {
+		ring = pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
+					 PW_MEMBLOCK_FLAG_MAP_READWRITE |
+					 PW_MEMBLOCK_FLAG_MAP_TWICE |
+					 PW_MEMBLOCK_FLAG_SEAL, data_sizes[0], ring_mem) >= 0;
+		if (!ring) {
+			pw_log_warn("link %p: can't map ringbuffer twice", this);
+			ring_mem->flags = 0;
+			ring_mem->ptr = NULL;
+		}
+	} else
+		ring = false;
+
 	/* data */
 	for (i = 0; i < n_datas; i++) {
 		data_size += sizeof(struct spa_chunk);
-		data_size += data_sizes[i];
+		if (!ring || i > 0)
+			data_size += data_sizes[i];
 		skel_size += sizeof(struct spa_data);
 	}
 
@@ -340,7 +371,17 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 			struct spa_data *d = &b->datas[j];
 
 			d->chunk = &cdp[j];
-			if (data_sizes[j] > 0) {
+			if (ring && j == 0) {
+				d->type = this->core->type.data.MemFd;
+				d->flags = SPA_DATA_FLAG_MAP_TWICE;
+				d->fd = ring_mem->fd;
+				d->mapoffset = 0;
+				d->maxsize = data_sizes[j];
+				d->data = ring_mem->ptr;
+				d->chunk->offset = 0;
+				d->chunk->size = data_sizes[j];
+				d->chunk->stride = data_strides[j];
+			} else if (data_sizes[j] > 0) {
 				d->type = this->core->type.data.MemFd;
 				d->flags = 0;
 				d->fd = mem->fd;
@@ -360,6 +401,53 @@ static struct spa_buffer **alloc_buffers(struct pw_link *this,
 	return buffers;
 }
 
+/* a mixing input port gets spare buffers to mix into when the buffer of
+ * the link it shares its pool with is missing or still read elsewhere.
+ * The spares come after the shared buffers and the output port doesn't
+ * know them. */
+static void alloc_spares(struct pw_link *this, uint32_t n_params, struct spa_param **params)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct spa_buffer **spares;
+	struct pw_memblock ring_mem = { 0, };
+	size_t data_sizes[1];
+	ssize_t data_strides[1];
+	uint32_t i, n_spares;
+
+	/* a ringbuffer is a single buffer that is never mixed */
+	if (impl->n_buffers < 2 || impl->buffers[0]->n_datas == 0)
+		return;
+
+	n_spares = SPA_MIN(impl->n_buffers, MAX_MIX_SPARES);
+	data_sizes[0] = impl->buffers[0]->datas[0].maxsize;
+	data_strides[0] = impl->buffers[0]->datas[0].chunk->stride;
+
+	spares = alloc_buffers(this, n_spares, n_params, params, 1,
+			       data_sizes, data_strides, &impl->spare_mem, &ring_mem);
+	if (spares == NULL)
+		return;
+
+	for (i = 0; i < n_spares; i++)
+		spares[i]->id = impl->n_buffers + i;
+
+	impl->spares = spares;
+	impl->n_spares = n_spares;
+	pw_log_debug("link %p: allocated %d spare buffers for mixing", this, n_spares);
+}
+
+static void free_spares(struct pw_link *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+
+	if (impl->spares == NULL)
+		return;
+
+	free(impl->spares);
+	pw_memblock_free(&impl->spare_mem);
+	impl->spares = NULL;
+	impl->n_spares = 0;
+}
+
 static int
 param_filter(struct pw_link *this,
 	     struct pw_port *in_port,
@@ -468,6 +556,15 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 	} else if (in_state == PW_PORT_STATE_READY && out_state > PW_PORT_STATE_READY) {
 		out_flags &= ~SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
 		in_flags &= ~SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS;
+	} else if (out_state == PW_PORT_STATE_READY && in_state > PW_PORT_STATE_READY &&
+		   pw_port_can_mix(this->input)) {
+		/* the input port has buffers from another link, this link gets
+		 * buffers of its own that the input port mixes from */
+		in_flags = 0;
+		if (out_flags & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS)
+			out_flags = SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS;
+		else
+			out_flags &= SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
 	} else if (out_state == PW_PORT_STATE_READY && in_state > PW_PORT_STATE_READY) {
 		in_flags &= ~SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
 		out_flags &= ~SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS;
@@ -483,17 +580,22 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 
 	if (impl->buffers == NULL) {
 		struct spa_param **params, *param;
-		uint8_t buffer[4096];
-		struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+		struct spa_pod_builder *b = &impl->params;
 		int i, offset, n_params;
 		uint32_t max_buffers;
 		size_t minsize = 1024, stride = 0;
 
-		n_params = param_filter(this, this->input, this->output, &b);
+		spa_pod_builder_init(b, b->data, b->size);
+		n_params = param_filter(this, this->input, this->output, b);
+		if (b->offset > b->size) {
+			asprintf(&error, "no memory for params");
+			res = SPA_RESULT_NO_MEMORY;
+			goto error;
+		}
 
 		params = alloca(n_params * sizeof(struct spa_param *));
 		for (i = 0, offset = 0; i < n_params; i++) {
-			params[i] = SPA_MEMBER(buffer, offset, struct spa_param);
+			params[i] = SPA_MEMBER(b->data, offset, struct spa_param);
 			spa_param_fixate(params[i]);
 			if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
 				spa_debug_param(params[i]);
@@ -511,7 +613,11 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 					    SPA_POD_TYPE_INT, &ms,
 					    this->core->type.param_alloc_meta_enable.
 					    ringbufferStride, SPA_POD_TYPE_INT, &s, 0) == 2) {
-				minsize = ms;
+				/* the ringbuffer is indexed with a mask and mapped twice,
+				 * so it needs a power of two size of whole pages */
+				minsize = SPA_MAX(ms, (uint32_t) sysconf(_SC_PAGESIZE));
+				while (minsize & (minsize - 1))
+					minsize = (minsize | (minsize - 1)) + 1;
 				stride = s;
 			}
 		} else {
@@ -553,7 +659,9 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 			impl->buffer_owner = this->output;
 			pw_log_debug("reusing %d output buffers %p", impl->n_buffers,
 				     impl->buffers);
-		} else if (this->input->n_buffers) {
+		} else if (this->input->n_buffers && !pw_port_can_mix(this->input)) {
+			/* the links of the input port can't be mixed, they
+			 * share the buffers of the input port */
 			out_flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
 			in_flags = 0;
 			impl->n_buffers = this->input->n_buffers;
@@ -574,7 +682,8 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 						      n_params,
 						      params,
 						      1,
-						      data_sizes, data_strides, &impl->buffer_mem);
+						      data_sizes, data_strides,
+						      &impl->buffer_mem, &impl->ring_mem);
 
 			pw_log_debug("allocating %d input buffers %p %zd %zd", impl->n_buffers,
 				     impl->buffers, minsize, stride);
@@ -609,12 +718,35 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 			pw_log_debug("allocated %d buffers %p from input port", impl->n_buffers,
 				     impl->buffers);
 		}
+
+		if ((in_flags & SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS) &&
+		    pw_port_can_mix(this->input))
+			alloc_spares(this, n_params, params);
 	}
 
 	if (in_flags & SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS) {
-		pw_log_debug("using %d buffers %p on input port", impl->n_buffers, impl->buffers);
-		if ((res = pw_port_use_buffers(this->input,
-					       impl->buffers, impl->n_buffers)) < 0) {
+		res = SPA_RESULT_ERROR;
+		if (impl->n_spares > 0) {
+			uint32_t n = impl->n_buffers + impl->n_spares;
+			struct spa_buffer **buffers = alloca(n * sizeof(struct spa_buffer *));
+
+			memcpy(buffers, impl->buffers, impl->n_buffers * sizeof(struct spa_buffer *));
+			memcpy(buffers + impl->n_buffers, impl->spares,
+			       impl->n_spares * sizeof(struct spa_buffer *));
+
+			pw_log_debug("using %d+%d buffers %p on input port", impl->n_buffers,
+				     impl->n_spares, impl->buffers);
+			if ((res = pw_port_use_buffers(this->input, buffers, n)) < 0) {
+				pw_log_debug("input port can't use spare buffers: %d", res);
+				free_spares(this);
+			}
+		}
+		if (res < 0) {
+			pw_log_debug("using %d buffers %p on input port", impl->n_buffers,
+				     impl->buffers);
+			res = pw_port_use_buffers(this->input, impl->buffers, impl->n_buffers);
+		}
+		if (res < 0) {
 			asprintf(&error, "error use input buffers: %d", res);
 			goto error;
 		}
@@ -629,6 +761,8 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		}
 		if (SPA_RESULT_IS_ASYNC(res))
 			pw_work_queue_add(impl->work, this->output->node, res, complete_paused, this->output);
+	} else if (in_state > PW_PORT_STATE_READY && (out_flags & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS)) {
+		pw_log_debug("output port allocated its own buffers for a mixing input");
 	} else {
 		asprintf(&error, "no common buffer alloc found");
 		goto error;
@@ -791,6 +925,7 @@ do_remove_output(struct spa_loop *loop,
 {
 	struct pw_link *this = user_data;
 	spa_graph_port_remove(&this->rt.out_port);
+	pw_port_tee_unlink(this->output, this);
 	return SPA_RESULT_OK;
 }
 
@@ -966,7 +1101,7 @@ link_bind_func(struct pw_global *global,
 
 	spa_list_insert(this->resource_list.prev, &resource->link);
 
-	this->info.change_mask = ~0;
+	this->info.change_mask = PW_LINK_CHANGE_MASK_ALL;
 	pw_link_resource_info(resource, &this->info);
 	this->info.change_mask = 0;
 
@@ -995,6 +1130,17 @@ do_add_link(struct spa_loop *loop,
         return SPA_RESULT_OK;
 }
 
+static int out_port_reuse_buffer(void *data, uint32_t buffer_id)
+{
+	struct pw_link *this = data;
+	return pw_port_tee_reuse_buffer(this->output, this, buffer_id);
+}
+
+static const struct spa_graph_port_callbacks out_port_callbacks = {
+	SPA_VERSION_GRAPH_PORT_CALLBACKS,
+	out_port_reuse_buffer,
+};
+
 static const struct pw_port_events input_port_events = {
 	PW_VERSION_PORT_EVENTS,
 	.destroy = input_port_destroy,
@@ -1015,6 +1161,73 @@ static const struct pw_node_events output_node_events = {
 	.async_complete = output_node_async_complete,
 };
 
+static void add_node(struct pw_array *nodes, struct pw_node *node)
+{
+	struct pw_node **n;
+
+	pw_array_for_each(n, nodes) {
+		if (*n == node)
+			return;
+	}
+	pw_array_add_ptr(nodes, node);
+}
+
+/* move node and everything linked to it to loop, fails when one of
+ * the nodes can't be moved */
+static int move_nodes(struct pw_node *node, struct pw_data_loop *loop)
+{
+	struct pw_array nodes;
+	struct pw_node **n;
+	struct pw_port *port;
+	struct pw_link *l;
+	size_t i;
+	int res = SPA_RESULT_OK;
+
+	pw_array_init(&nodes, 16 * sizeof(struct pw_node *));
+
+	add_node(&nodes, node);
+	for (i = 0; i < pw_array_get_len(&nodes, struct pw_node *); i++) {
+		node = *pw_array_get_unchecked(&nodes, i, struct pw_node *);
+
+		if (node->data_loop_pinned || node->info.state == PW_NODE_STATE_RUNNING) {
+			res = SPA_RESULT_ERROR;
+			goto done;
+		}
+		spa_list_for_each(port, &node->input_ports, link)
+			spa_list_for_each(l, &port->links, input_link)
+				add_node(&nodes, l->output->node);
+		spa_list_for_each(port, &node->output_ports, link)
+			spa_list_for_each(l, &port->links, output_link)
+				add_node(&nodes, l->input->node);
+	}
+
+	pw_array_for_each(n, &nodes) {
+		if ((res = pw_node_set_data_loop(*n, loop)) < 0)
+			break;
+	}
+      done:
+	pw_array_clear(&nodes);
+	return res;
+}
+
+/* make sure both nodes are scheduled by the same data loop. The nodes that
+ * are not pinned to a loop join the loop of the other side. */
+static int join_data_loops(struct pw_node *output, struct pw_node *input)
+{
+	if (output->data_loop_impl == input->data_loop_impl)
+		return SPA_RESULT_OK;
+
+	if (!input->data_loop_pinned &&
+	    move_nodes(input, output->data_loop_impl) >= 0)
+		return SPA_RESULT_OK;
+
+	if (!output->data_loop_pinned &&
+	    move_nodes(output, input->data_loop_impl) >= 0)
+		return SPA_RESULT_OK;
+
+	return SPA_RESULT_ERROR;
+}
+
 struct pw_link *pw_link_new(struct pw_core *core,
 			    struct pw_global *parent,
 			    struct pw_port *output,
@@ -1033,6 +1246,9 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	if (pw_link_find(output, input))
 		goto link_exists;
 
+	if (join_data_loops(output->node, input->node) < 0)
+		goto different_loops;
+
 	impl = calloc(1, sizeof(struct impl));
 	if (impl == NULL)
 		goto no_mem;
@@ -1041,6 +1257,7 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	pw_log_debug("link %p: new", this);
 
 	impl->work = pw_work_queue_new(core->main_loop);
+	spa_pod_builder_set_overflow(&impl->params, spa_pod_builder_realloc);
 
 	this->core = core;
 	this->properties = properties;
@@ -1088,6 +1305,7 @@ struct pw_link *pw_link_new(struct pw_core *core,
 			    this->rt.out_port.port_id,
 			    0,
 			    &this->io);
+	spa_graph_port_set_callbacks(&this->rt.out_port, &out_port_callbacks, this);
 	spa_graph_port_init(&this->rt.in_port,
 			    PW_DIRECTION_INPUT,
 			    this->rt.in_port.port_id,
@@ -1112,6 +1330,9 @@ struct pw_link *pw_link_new(struct pw_core *core,
       link_exists:
 	asprintf(error, "link already exists");
 	return NULL;
+      different_loops:
+	asprintf(error, "nodes are scheduled on different data loops");
+	return NULL;
       no_mem:
 	asprintf(error, "no memory");
 	return NULL;
@@ -1146,8 +1367,12 @@ void pw_link_destroy(struct pw_link *link)
 	if (link->info.format)
 		free(link->info.format);
 
-	if (impl->buffer_owner == link)
+	if (impl->buffer_owner == link) {
 		pw_memblock_free(&impl->buffer_mem);
+		pw_memblock_free(&impl->ring_mem);
+	}
+	free_spares(link);
+	free(impl->params.data);
 
 	free(impl);
 }
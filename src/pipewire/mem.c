@@ -30,9 +30,13 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/syscall.h>
+#include <sys/stat.h>
 
 #include <pipewire/log.h>
 #include <pipewire/mem.h>
+#include <pipewire/private.h>
+
+#define MAX_CACHED_MAPS 4
 
 /*
  * No glibc wrappers exist for memfd_create(2), so provide our own.
@@ -210,7 +214,8 @@ void pw_memblock_free(struct pw_memblock *mem)
 
 	if (mem->flags & PW_MEMBLOCK_FLAG_WITH_FD) {
 		if (mem->ptr)
-			munmap(mem->ptr, mem->size);
+			munmap(mem->ptr, mem->flags & PW_MEMBLOCK_FLAG_MAP_TWICE ?
+				mem->size << 1 : mem->size);
 		if (mem->fd != -1)
 			close(mem->fd);
 	} else {
@@ -219,3 +224,121 @@ void pw_memblock_free(struct pw_memblock *mem)
 	mem->ptr = NULL;
 	mem->fd = -1;
 }
+
+void pw_mem_cache_init(struct pw_mem_cache *cache)
+{
+	spa_list_init(&cache->maps);
+	cache->n_cached = 0;
+}
+
+static void free_map(struct pw_mem_map *map)
+{
+	spa_list_remove(&map->link);
+	munmap(map->ptr, map->size);
+	free(map);
+}
+
+static struct pw_mem_map *ref_map(struct pw_mem_cache *cache, int fd, size_t size)
+{
+	struct pw_mem_map *map;
+	struct stat st;
+
+	if (fstat(fd, &st) < 0)
+		return NULL;
+
+	spa_list_for_each(map, &cache->maps, link) {
+		if (map->dev == st.st_dev && map->ino == st.st_ino && map->size >= size) {
+			if (map->ref++ == 0)
+				cache->n_cached--;
+			return map;
+		}
+	}
+
+	map = calloc(1, sizeof(struct pw_mem_map));
+	if (map == NULL)
+		return NULL;
+
+	map->dev = st.st_dev;
+	map->ino = st.st_ino;
+	map->size = SPA_MAX((size_t) st.st_size, size);
+	map->ptr = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map->ptr == MAP_FAILED) {
+		free(map);
+		return NULL;
+	}
+	map->ref = 1;
+	spa_list_insert(cache->maps.prev, &map->link);
+
+	return map;
+}
+
+/** Map memory through the cache
+ * \param cache a memory cache
+ * \param map a mapping to update, points to NULL when not mapped yet
+ * \param fd the memfd to map
+ * \param size the minimum size to map
+ * \return \ref SPA_RESULT_OK on success
+ *
+ * A mapping of the same file is shared. When \a map is too small for
+ * \a size, a larger mapping replaces it.
+ *
+ * \memberof pw_mem_cache
+ */
+int pw_mem_cache_map(struct pw_mem_cache *cache, struct pw_mem_map **map, int fd, size_t size)
+{
+	struct pw_mem_map *m;
+
+	if (*map != NULL && (*map)->size >= size)
+		return SPA_RESULT_OK;
+
+	if ((m = ref_map(cache, fd, size)) == NULL)
+		return SPA_RESULT_ERROR;
+
+	if (*map != NULL)
+		pw_mem_cache_unref(cache, *map);
+	*map = m;
+
+	return SPA_RESULT_OK;
+}
+
+/** Release a mapping
+ * \param cache a memory cache
+ * \param map a mapping from \a cache
+ *
+ * The mapping is kept around for when the same memory is used again
+ * after renegotiation, the oldest unused mappings are evicted.
+ *
+ * \memberof pw_mem_cache
+ */
+void pw_mem_cache_unref(struct pw_mem_cache *cache, struct pw_mem_map *map)
+{
+	struct pw_mem_map *m, *t;
+
+	if (--map->ref > 0)
+		return;
+
+	spa_list_remove(&map->link);
+	spa_list_insert(cache->maps.prev, &map->link);
+	cache->n_cached++;
+
+	spa_list_for_each_safe(m, t, &cache->maps, link) {
+		if (cache->n_cached <= MAX_CACHED_MAPS)
+			break;
+		if (m->ref == 0) {
+			free_map(m);
+			cache->n_cached--;
+		}
+	}
+}
+
+/** Unmap all memory of the cache
+ * \memberof pw_mem_cache
+ */
+void pw_mem_cache_clear(struct pw_mem_cache *cache)
+{
+	struct pw_mem_map *m, *t;
+
+	spa_list_for_each_safe(m, t, &cache->maps, link)
+		free_map(m);
+	cache->n_cached = 0;
+}
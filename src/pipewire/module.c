@@ -125,7 +125,7 @@ module_bind_func(struct pw_global *global,
 
 	spa_list_insert(this->resource_list.prev, &resource->link);
 
-	this->info.change_mask = ~0;
+	this->info.change_mask = PW_MODULE_CHANGE_MASK_ALL;
 	pw_module_resource_info(resource, &this->info);
 	this->info.change_mask = 0;
 
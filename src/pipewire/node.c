@@ -164,22 +164,38 @@ static void node_event(void *data, const struct spa_event *event)
         }
 }
 
+static void check_deadline(struct pw_node *this, bool idle)
+{
+	if (idle && !spa_list_is_empty(&this->rt.sched->pending))
+		pw_data_loop_schedule_deadline(this->data_loop_impl);
+}
+
 static void node_need_input(void *data)
 {
         struct impl *impl = data;
 	struct pw_node *this = &impl->this;
+	bool idle = spa_list_is_empty(&this->rt.sched->pending);
 
 	spa_graph_scheduler_pull(this->rt.sched, &this->rt.node);
 	while (spa_graph_scheduler_iterate(this->rt.sched));
+	check_deadline(this, idle);
 }
 
 static void node_have_output(void *data)
 {
         struct impl *impl = data;
 	struct pw_node *this = &impl->this;
+	bool idle;
 
+	if (!spa_graph_scheduler_complete(this->rt.sched, &this->rt.node)) {
+		pw_log_trace("node %p: completed after the deadline, xruns %u",
+			     this, this->rt.node.xruns);
+		return;
+	}
+	idle = spa_list_is_empty(&this->rt.sched->pending);
 	spa_graph_scheduler_push(this->rt.sched, &this->rt.node);
 	while (spa_graph_scheduler_iterate(this->rt.sched));
+	check_deadline(this, idle);
 }
 
 static void node_unbind_func(void *data)
@@ -274,7 +290,7 @@ node_bind_func(struct pw_global *global,
 
 	spa_list_insert(this->resource_list.prev, &resource->link);
 
-	this->info.change_mask = ~0;
+	this->info.change_mask = PW_NODE_CHANGE_MASK_ALL;
 	pw_node_resource_info(resource, &this->info);
 	this->info.change_mask = 0;
 
@@ -360,6 +376,57 @@ static const struct pw_node_events node_events = {
 	.have_output = node_have_output,
 };
 
+/* node.driver-priority ranks the nodes that can drive the graph, nodes
+ * with node.driver (devices) default to 2, other nodes to 0 */
+static int32_t parse_driver_priority(struct pw_node *node)
+{
+	const char *str;
+
+	if ((str = pw_properties_get(node->properties, "node.driver-priority")))
+		return atoi(str);
+	if ((str = pw_properties_get(node->properties, "node.driver")))
+		return atoi(str) != 0 ? 2 : 0;
+	return 0;
+}
+
+static bool has_live_port(struct pw_node *node)
+{
+	struct pw_port *port;
+	const struct spa_port_info *info;
+
+	spa_list_for_each(port, &node->input_ports, link) {
+		if (pw_port_get_info(port, &info) >= 0 && (info->flags & SPA_PORT_INFO_FLAG_LIVE))
+			return true;
+	}
+	spa_list_for_each(port, &node->output_ports, link) {
+		if (pw_port_get_info(port, &info) >= 0 && (info->flags & SPA_PORT_INFO_FLAG_LIVE))
+			return true;
+	}
+	return false;
+}
+
+/* node.latency is in samples, or num/denom seconds like "256/48000" */
+static uint32_t parse_latency(struct pw_node *node)
+{
+	const char *str;
+	uint32_t num, denom;
+
+	if ((str = pw_properties_get(node->properties, "node.latency")) == NULL)
+		return 0;
+
+	switch (sscanf(str, "%u/%u", &num, &denom)) {
+	case 1:
+		return num;
+	case 2:
+		if (denom == 0)
+			return 0;
+		return (uint64_t) num * node->data_loop_impl->config.rate / denom;
+	default:
+		pw_log_warn("node %p: invalid node.latency \"%s\"", node, str);
+		return 0;
+	}
+}
+
 struct pw_node *pw_node_new(struct pw_core *core,
 			    struct pw_resource *owner,
 			    struct pw_global *parent,
@@ -393,9 +460,15 @@ struct pw_node *pw_node_new(struct pw_core *core,
 	impl->work = pw_work_queue_new(this->core->main_loop);
 	this->info.name = strdup(name);
 
-	this->data_loop = core->data_loop;
+	this->data_loop_pinned = pw_properties_get(properties, "node.data-loop") != NULL;
+	this->data_loop_impl = pw_core_find_data_loop(core, properties);
+	this->data_loop_impl->n_nodes++;
+	this->data_loop = this->data_loop_impl->loop;
+
+	this->rt.sched = &this->data_loop_impl->rt.sched;
 
-	this->rt.sched = &core->rt.sched;
+	this->latency = parse_latency(this);
+	this->driver_priority = parse_driver_priority(this);
 
 	spa_list_init(&this->resource_list);
 
@@ -452,6 +525,92 @@ struct pw_properties *pw_node_get_properties(struct pw_node *node)
 	return node->properties;
 }
 
+/** Update node properties
+ *
+ * \param node a node
+ * \param dict properties to update
+ *
+ * Update the node with the given properties. A change of node.latency
+ * is applied to the graph quantum while the node is running. Nothing is
+ * sent to the clients when the properties did not change.
+ *
+ * \memberof pw_node
+ */
+void pw_node_update_properties(struct pw_node *node, const struct spa_dict *dict)
+{
+	struct pw_resource *resource;
+	uint32_t i, latency, generation;
+
+	for (i = 0; i < dict->n_items; i++)
+		pw_properties_set(node->properties, dict->items[i].key, dict->items[i].value);
+
+	generation = pw_properties_get_generation(node->properties);
+	if (generation == node->props_generation)
+		return;
+	node->props_generation = generation;
+
+	node->info.change_mask |= PW_NODE_CHANGE_MASK_PROPS;
+	node->info.props = &node->properties->dict;
+
+	spa_hook_list_call(&node->listener_list, struct pw_node_events, info_changed, &node->info);
+
+	spa_list_for_each(resource, &node->resource_list, link)
+		pw_node_resource_info(resource, &node->info);
+
+	node->info.change_mask = 0;
+
+	latency = parse_latency(node);
+	if (latency != node->latency) {
+		node->latency = latency;
+		if (node->active)
+			pw_core_update_quantum(node->core);
+	}
+}
+
+/** Configure the graph quantum on a node
+ *
+ * \param node a node
+ * \param quantum the quantum in samples
+ * \return 0 on success < 0 on error
+ *
+ * Drivers expose the minLatency property, which is set to \a quantum.
+ * Other nodes follow the size requested in their port io ranges.
+ *
+ * \memberof pw_node
+ */
+int pw_node_set_quantum(struct pw_node *node, uint32_t quantum)
+{
+	struct spa_props *props;
+	struct spa_pod_prop *prop;
+	uint32_t id;
+	int res;
+
+	if (node->quantum == quantum)
+		return SPA_RESULT_OK;
+
+	if (node->implementation == NULL ||
+	    node->implementation->get_props == NULL ||
+	    node->implementation->set_props == NULL)
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	if ((res = node->implementation->get_props(node->implementation_data, &props)) < 0)
+		return res;
+
+	id = spa_type_map_get_id(node->core->type.map, SPA_TYPE_PROPS__minLatency);
+	if ((prop = spa_pod_object_find_prop(&props->object, id)) == NULL ||
+	    prop->body.value.type != SPA_POD_TYPE_INT)
+		return SPA_RESULT_NOT_IMPLEMENTED;
+
+	pw_log_debug("node %p: set quantum %u", node, quantum);
+	SPA_POD_VALUE(struct spa_pod_int, &prop->body.value) = quantum;
+
+	if ((res = node->implementation->set_props(node->implementation_data, props)) < 0)
+		return res;
+
+	node->quantum = quantum;
+	return SPA_RESULT_OK;
+}
+
 void pw_node_set_implementation(struct pw_node *node,
 				const struct pw_node_implementation *implementation,
 				void *data)
@@ -499,11 +658,16 @@ void pw_node_destroy(struct pw_node *node)
 	spa_hook_list_call(&node->listener_list, struct pw_node_events, destroy);
 
 	pw_loop_invoke(node->data_loop, do_node_remove, 1, 0, NULL, true, node);
+	node->data_loop_impl->n_nodes--;
 
 	if (impl->registered) {
 		spa_list_remove(&node->link);
 		pw_global_destroy(node->global);
 		node->global = NULL;
+		if (node->active) {
+			pw_core_update_quantum(node->core);
+			pw_core_update_driver(node->core);
+		}
 	}
 
 	spa_list_for_each_safe(resource, tmp, &node->resource_list, link)
@@ -536,6 +700,99 @@ void pw_node_destroy(struct pw_node *node)
 	free(impl);
 }
 
+static int
+do_node_leave(struct spa_loop *loop,
+	      bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct pw_node *this = user_data;
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct pw_port *port;
+
+	if (impl->registered)
+		spa_graph_node_remove(&this->rt.node);
+	spa_list_for_each(port, &this->input_ports, link)
+		spa_graph_node_remove(&port->rt.mix_node);
+	spa_list_for_each(port, &this->output_ports, link)
+		spa_graph_node_remove(&port->rt.mix_node);
+
+	return SPA_RESULT_OK;
+}
+
+static int
+do_node_join(struct spa_loop *loop,
+	     bool async, uint32_t seq, size_t size, const void *data, void *user_data)
+{
+	struct pw_node *this = user_data;
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct pw_port *port;
+
+	if (impl->registered)
+		spa_graph_node_add(this->rt.sched->graph, &this->rt.node);
+	spa_list_for_each(port, &this->input_ports, link)
+		spa_graph_node_add(port->rt.graph, &port->rt.mix_node);
+	spa_list_for_each(port, &this->output_ports, link)
+		spa_graph_node_add(port->rt.graph, &port->rt.mix_node);
+
+	return SPA_RESULT_OK;
+}
+
+/** Get the data loop of the node
+ * \param node a node
+ * \return the data loop that schedules \a node
+ *
+ * \memberof pw_node
+ */
+struct pw_data_loop *pw_node_get_data_loop(struct pw_node *node)
+{
+	return node->data_loop_impl;
+}
+
+/** Move a node to another data loop
+ * \param node a node
+ * \param loop the new data loop
+ * \return \ref SPA_RESULT_OK on success
+ *
+ * Move the node and its ports to the graph of \a loop. This is only
+ * possible when the node is not running and was not created for a
+ * specific data loop. Implementations that have sources on the data
+ * loop should move them in the data_loop_changed event.
+ *
+ * \memberof pw_node
+ */
+int pw_node_set_data_loop(struct pw_node *node, struct pw_data_loop *loop)
+{
+	struct pw_port *port;
+
+	if (node->data_loop_impl == loop)
+		return SPA_RESULT_OK;
+
+	if (node->data_loop_pinned || node->info.state == PW_NODE_STATE_RUNNING)
+		return SPA_RESULT_ERROR;
+
+	pw_log_debug("node %p: move from data loop %d to %d", node,
+		     node->data_loop_impl->id, loop->id);
+
+	pw_loop_invoke(node->data_loop, do_node_leave, 1, 0, NULL, true, node);
+	node->data_loop_impl->n_nodes--;
+
+	node->data_loop_impl = loop;
+	node->data_loop = loop->loop;
+	node->rt.sched = &loop->rt.sched;
+	spa_list_for_each(port, &node->input_ports, link)
+		port->rt.graph = &loop->rt.graph;
+	spa_list_for_each(port, &node->output_ports, link)
+		port->rt.graph = &loop->rt.graph;
+	loop->n_nodes++;
+
+	pw_properties_setf(node->properties, "node.data-loop", "%d", loop->id);
+
+	spa_hook_list_call(&node->listener_list, struct pw_node_events, data_loop_changed, loop);
+
+	pw_loop_invoke(node->data_loop, do_node_join, 1, 0, NULL, true, node);
+
+	return SPA_RESULT_OK;
+}
+
 bool pw_node_for_each_port(struct pw_node *node,
 			   enum pw_direction direction,
 			   bool (*callback) (void *data, struct pw_port *port),
@@ -710,6 +967,16 @@ int pw_node_set_state(struct pw_node *node, enum pw_node_state state)
 		break;
 
 	case PW_NODE_STATE_RUNNING:
+		if (!node->active) {
+			node->active = true;
+			/* a driver stream is live through its own port even when
+			 * it is not linked to a live output */
+			if (has_live_port(node))
+				node->live = true;
+			pw_core_update_quantum(node->core);
+			pw_core_update_driver(node->core);
+		}
+		pw_node_set_quantum(node, node->core->quantum);
 		node_activate(node);
 		send_clock_update(node);
 		res = start_node(node);
@@ -756,10 +1023,18 @@ void pw_node_update_state(struct pw_node *node, enum pw_node_state state, char *
 		if (state == PW_NODE_STATE_IDLE)
 			node_deactivate(node);
 
+		if (state != PW_NODE_STATE_RUNNING && node->active) {
+			node->active = false;
+			if (node->latency > 0)
+				pw_core_update_quantum(node->core);
+			if (node == node->data_loop_impl->driver)
+				pw_core_update_driver(node->core);
+		}
+
 		spa_hook_list_call(&node->listener_list, struct pw_node_events, state_changed,
 				 old, state, error);
 
-		node->info.change_mask |= 1 << 5;
+		node->info.change_mask |= PW_NODE_CHANGE_MASK_STATE;
 		spa_hook_list_call(&node->listener_list, struct pw_node_events, info_changed, &node->info);
 
 		spa_list_for_each(resource, &node->resource_list, link)
@@ -42,6 +42,7 @@ extern "C" {
 struct pw_node;
 
 #include <pipewire/core.h>
+#include <pipewire/data-loop.h>
 #include <pipewire/global.h>
 #include <pipewire/introspect.h>
 #include <pipewire/port.h>
@@ -102,6 +103,9 @@ struct pw_node_events {
 	void (*need_input) (void *data);
         /** the node has output */
 	void (*have_output) (void *data);
+
+	/** the node was moved to another data loop */
+	void (*data_loop_changed) (void *data, struct pw_data_loop *loop);
 };
 
 /** Create a new node \memberof pw_node */
@@ -131,6 +135,9 @@ struct pw_global *pw_node_get_global(struct pw_node *node);
 
 struct pw_properties *pw_node_get_properties(struct pw_node *node);
 
+/** Update the node properties */
+void pw_node_update_properties(struct pw_node *node, const struct spa_dict *dict);
+
 void pw_node_set_implementation(struct pw_node *node,
 				const struct pw_node_implementation *implementation,
 				void *data);
@@ -155,6 +162,12 @@ pw_node_find_port(struct pw_node *node, enum pw_direction direction, uint32_t po
 struct pw_port *
 pw_node_get_free_port(struct pw_node *node, enum pw_direction direction);
 
+/** Get the data loop that schedules the node */
+struct pw_data_loop *pw_node_get_data_loop(struct pw_node *node);
+
+/** Move the node to another data loop */
+int pw_node_set_data_loop(struct pw_node *node, struct pw_data_loop *loop);
+
 /** Change the state of the node */
 int pw_node_set_state(struct pw_node *node, enum pw_node_state state);
 
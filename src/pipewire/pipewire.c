@@ -28,6 +28,9 @@
 #include <pwd.h>
 #include <errno.h>
 #include <dlfcn.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <sys/stat.h>
 
 #include "pipewire/pipewire.h"
 #include "pipewire/private.h"
@@ -35,46 +38,408 @@
 static char **categories = NULL;
 
 static struct support_info {
-	void *hnd;
-	spa_handle_factory_enum_func_t enum_func;
 	struct spa_support support[4];
 	uint32_t n_support;
 } support_info;
 
-static bool
-open_support(const char *path,
-	     const char *lib,
-	     struct support_info *info)
+/** \cond */
+struct plugin {
+	struct spa_list link;
+	char *lib;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+};
+
+/* an index entry is a line of the index file:
+ * <lib> <mtime> <size> <factory> ... */
+struct plugin_entry {
+	char **tokens;
+	int n_tokens;
+	bool seen;
+};
+
+#define ENTRY_LIB(e)		((e)->tokens[0])
+#define ENTRY_MTIME(e)		((e)->tokens[1])
+#define ENTRY_SIZE(e)		((e)->tokens[2])
+#define ENTRY_FIRST_FACTORY	3
+
+static struct registry {
+	const char *dir;
+	struct spa_list plugins;
+	struct pw_array entries;
+	bool scanned;
+	bool changed;
+} registry;
+/** \endcond */
+
+static struct plugin *open_plugin(const char *lib)
 {
+	struct plugin *plugin;
 	char *filename;
+	void *hnd;
+	spa_handle_factory_enum_func_t enum_func;
+
+	spa_list_for_each(plugin, &registry.plugins, link) {
+		if (strcmp(plugin->lib, lib) == 0)
+			return plugin;
+	}
 
-        if (asprintf(&filename, "%s/%s.so", path, lib) < 0)
+	if (asprintf(&filename, "%s/%s.so", registry.dir, lib) < 0)
 		goto no_filename;
 
-        if ((info->hnd = dlopen(filename, RTLD_NOW)) == NULL) {
-                fprintf(stderr, "can't load %s: %s\n", filename, dlerror());
-                goto open_failed;
-        }
-        if ((info->enum_func = dlsym(info->hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
-                fprintf(stderr, "can't find enum function\n");
-                goto no_symbol;
-        }
+	if ((hnd = dlopen(filename, RTLD_NOW)) == NULL) {
+		pw_log_error("can't load %s: %s", filename, dlerror());
+		goto open_failed;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		pw_log_error("can't find enum function in %s", filename);
+		goto no_symbol;
+	}
+	if ((plugin = calloc(1, sizeof(struct plugin))) == NULL)
+		goto no_mem;
+
+	plugin->lib = strdup(lib);
+	plugin->hnd = hnd;
+	plugin->enum_func = enum_func;
+	spa_list_insert(registry.plugins.prev, &plugin->link);
+
+	pw_log_debug("registry: loaded %s", filename);
 	free(filename);
-	return true;
 
-      no_filename:
-	return false;
+	return plugin;
+
+      no_mem:
       no_symbol:
-	dlclose(info->hnd);
+	dlclose(hnd);
       open_failed:
-        free(filename);
+	free(filename);
+      no_filename:
+	return NULL;
+}
+
+static const struct spa_handle_factory *
+find_factory(spa_handle_factory_enum_func_t enum_func, const char *factory_name)
+{
+	int res;
+	uint32_t index;
+	const struct spa_handle_factory *factory;
+
+	for (index = 0;; index++) {
+		if ((res = enum_func(&factory, index)) < 0) {
+			if (res != SPA_RESULT_ENUM_END)
+				pw_log_error("can't enumerate factories: %d", res);
+			break;
+		}
+		if (strcmp(factory->name, factory_name) == 0)
+			return factory;
+	}
+	return NULL;
+}
+
+static char *get_index_filename(void)
+{
+	const char *dir;
+	char *filename;
+	int res;
+
+	if ((dir = getenv("XDG_CACHE_HOME")) != NULL)
+		res = asprintf(&filename, "%s/pipewire/plugin-index", dir);
+	else if ((dir = getenv("HOME")) != NULL)
+		res = asprintf(&filename, "%s/.cache/pipewire/plugin-index", dir);
+	else
+		return NULL;
+
+	return res < 0 ? NULL : filename;
+}
+
+static struct plugin_entry *find_entry(const char *lib)
+{
+	struct plugin_entry *e;
+
+	pw_array_for_each(e, &registry.entries) {
+		if (strcmp(ENTRY_LIB(e), lib) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+static bool add_entry(const char *line)
+{
+	struct plugin_entry *e;
+	char **tokens;
+	int n_tokens;
+
+	tokens = pw_split_strv(line, " \n", INT_MAX, &n_tokens);
+	if (n_tokens < ENTRY_FIRST_FACTORY || find_entry(tokens[0]) != NULL)
+		goto invalid;
+
+	if ((e = pw_array_add(&registry.entries, sizeof(struct plugin_entry))) == NULL)
+		goto invalid;
+
+	e->tokens = tokens;
+	e->n_tokens = n_tokens;
+	e->seen = false;
+
+	return true;
+
+      invalid:
+	pw_free_strv(tokens);
 	return false;
 }
 
+static void remove_entry(struct plugin_entry *e)
+{
+	struct plugin_entry *last;
+
+	pw_free_strv(e->tokens);
+
+	last = pw_array_get_unchecked(&registry.entries,
+			pw_array_get_len(&registry.entries, struct plugin_entry) - 1,
+			struct plugin_entry);
+	*e = *last;
+	registry.entries.size -= sizeof(struct plugin_entry);
+}
+
+static void read_index(const char *filename)
+{
+	FILE *f;
+	char line[4096];
+	bool valid = false;
+
+	if ((f = fopen(filename, "re")) == NULL)
+		return;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#')
+			continue;
+
+		/* the index is only valid for the same plugin directory */
+		if (strncmp(line, "dir ", 4) == 0) {
+			valid = strcmp(pw_strip(line + 4, "\n"), registry.dir) == 0;
+			continue;
+		}
+		if (valid)
+			add_entry(line);
+	}
+	fclose(f);
+}
+
+static int make_dirs(char *filename)
+{
+	char *p;
+
+	for (p = strchr(filename + 1, '/'); p; p = strchr(p + 1, '/')) {
+		*p = '\0';
+		if (mkdir(filename, 0700) < 0 && errno != EEXIST) {
+			*p = '/';
+			return -errno;
+		}
+		*p = '/';
+	}
+	return 0;
+}
+
+static void write_index(char *filename)
+{
+	struct plugin_entry *e;
+	char *tmp;
+	FILE *f;
+	int i;
+
+	if (make_dirs(filename) < 0 || asprintf(&tmp, "%s.tmp", filename) < 0)
+		return;
+
+	if ((f = fopen(tmp, "we")) == NULL)
+		goto open_failed;
+
+	fprintf(f, "# PipeWire plugin index, generated\n");
+	fprintf(f, "dir %s\n", registry.dir);
+	pw_array_for_each(e, &registry.entries) {
+		for (i = 0; i < e->n_tokens; i++)
+			fprintf(f, "%s%s", i == 0 ? "" : " ", e->tokens[i]);
+		fprintf(f, "\n");
+	}
+	if (fclose(f) != 0 || rename(tmp, filename) < 0) {
+		pw_log_warn("registry: can't write %s: %m", filename);
+		unlink(tmp);
+	}
+
+      open_failed:
+	free(tmp);
+}
+
+/* load the plugin to list its factories, only done for plugins that are
+ * not in the index or that changed since the index was written */
+static void probe_plugin(const char *lib, const char *filename, struct stat *st)
+{
+	struct plugin_entry *e;
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	uint32_t index;
+	char line[4096];
+	void *hnd;
+	int len;
+
+	if ((e = find_entry(lib)) != NULL) {
+		if (strtoull(ENTRY_MTIME(e), NULL, 10) == st->st_mtime &&
+		    strtoull(ENTRY_SIZE(e), NULL, 10) == st->st_size) {
+			e->seen = true;
+			return;
+		}
+		remove_entry(e);
+		registry.changed = true;
+	}
+
+	if ((hnd = dlopen(filename, RTLD_NOW | RTLD_LOCAL)) == NULL) {
+		pw_log_warn("registry: can't load %s: %s", filename, dlerror());
+		return;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL)
+		goto done;
+
+	len = snprintf(line, sizeof(line), "%s %" PRIu64 " %" PRIu64, lib,
+		       (uint64_t) st->st_mtime, (uint64_t) st->st_size);
+
+	for (index = 0; len < sizeof(line) && enum_func(&factory, index) >= 0; index++)
+		len += snprintf(line + len, sizeof(line) - len, " %s", factory->name);
+
+	if (len < sizeof(line) && add_entry(line)) {
+		e = find_entry(lib);
+		e->seen = true;
+		registry.changed = true;
+	}
+
+      done:
+	/* the plugin stays loaded when it was opened with open_plugin() */
+	dlclose(hnd);
+}
+
+static void scan_dir(const char *path, const char *prefix)
+{
+	DIR *dir;
+	struct dirent *d;
+
+	if ((dir = opendir(path)) == NULL)
+		return;
+
+	while ((d = readdir(dir)) != NULL) {
+		struct stat st;
+		char *filename, *lib;
+		int len;
+
+		if (d->d_name[0] == '.')
+			continue;
+
+		if (asprintf(&filename, "%s/%s", path, d->d_name) < 0)
+			continue;
+		if (asprintf(&lib, "%s%s%s", prefix, prefix[0] ? "/" : "", d->d_name) < 0) {
+			free(filename);
+			continue;
+		}
+
+		if (stat(filename, &st) == 0) {
+			len = strlen(lib);
+			if (S_ISDIR(st.st_mode)) {
+				scan_dir(filename, lib);
+			} else if (S_ISREG(st.st_mode) && len > 3 &&
+				   strcmp(lib + len - 3, ".so") == 0) {
+				lib[len - 3] = '\0';
+				probe_plugin(lib, filename, &st);
+			}
+		}
+		free(lib);
+		free(filename);
+	}
+	closedir(dir);
+}
+
+/* scan the plugin directory once, the factories of the plugins are taken
+ * from the index file when the plugin did not change */
+static void scan_plugins(void)
+{
+	struct plugin_entry *e;
+	char *filename;
+
+	if (registry.scanned)
+		return;
+
+	registry.scanned = true;
+
+	filename = get_index_filename();
+	if (filename)
+		read_index(filename);
+
+	scan_dir(registry.dir, "");
+
+	for (e = registry.entries.data;
+	     (uint8_t *) e < (uint8_t *) registry.entries.data + registry.entries.size;) {
+		if (!e->seen) {
+			remove_entry(e);
+			registry.changed = true;
+		}
+		else
+			e++;
+	}
+
+	pw_log_debug("registry: %zd plugins in %s",
+		     pw_array_get_len(&registry.entries, struct plugin_entry), registry.dir);
+
+	if (filename && registry.changed)
+		write_index(filename);
+
+	free(filename);
+}
+
+static const char *find_lib(const char *factory_name)
+{
+	struct plugin_entry *e;
+	int i;
+
+	scan_plugins();
+
+	pw_array_for_each(e, &registry.entries) {
+		for (i = ENTRY_FIRST_FACTORY; i < e->n_tokens; i++) {
+			if (strcmp(e->tokens[i], factory_name) == 0)
+				return ENTRY_LIB(e);
+		}
+	}
+	return NULL;
+}
+
+/** Get a handle factory
+ * \param lib the plugin relative to the plugin directory and without the .so
+ *	extension or NULL
+ * \param factory_name the name of the factory
+ * \return the factory or NULL when not found
+ *
+ * Plugins are loaded only once and are shared by all users.
+ *
+ * When \a lib is NULL, the plugin is looked up in an index of the
+ * factories in the plugin directory. The index is kept in a file and
+ * only the plugins that changed are loaded to update it.
+ *
+ * \memberof pw_pipewire
+ */
+const struct spa_handle_factory *
+pw_get_spa_handle_factory(const char *lib, const char *factory_name)
+{
+	struct plugin *plugin;
+
+	if (lib == NULL && (lib = find_lib(factory_name)) == NULL) {
+		pw_log_error("can't find factory %s", factory_name);
+		return NULL;
+	}
+	if ((plugin = open_plugin(lib)) == NULL)
+		return NULL;
+
+	return find_factory(plugin->enum_func, factory_name);
+}
+
 static void *
 load_interface(struct support_info *info,
 	       const char *factory_name,
-	       const char *type)
+	       const char *type,
+	       const struct spa_dict *dict)
 {
         int res;
         struct spa_handle *handle;
@@ -89,7 +454,7 @@ load_interface(struct support_info *info,
 
         handle = calloc(1, factory->size);
         if ((res = spa_handle_factory_init(factory,
-                                           handle, NULL, info->support, info->n_support)) < 0) {
+                                           handle, dict, info->support, info->n_support)) < 0) {
                 fprintf(stderr, "can't make factory instance: %d\n", res);
                 goto init_failed;
         }
@@ -127,13 +492,21 @@ static void configure_debug(const char *str)
 static void configure_support(struct support_info *info)
 {
 	void *iface;
+	struct spa_dict_item items[1];
+	struct spa_dict dict = SPA_DICT_INIT(0, items);
+	const char *str;
 
-	iface = load_interface(info, "mapper", SPA_TYPE__TypeMap);
+	iface = load_interface(info, "mapper", SPA_TYPE__TypeMap, NULL);
 	if (iface != NULL) {
 		info->support[info->n_support++] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, iface);
 	}
 
-	iface = load_interface(info, "logger", SPA_TYPE__Log);
+	if ((str = getenv("PIPEWIRE_LOG_BINARY"))) {
+		items[dict.n_items].key = "log.binary";
+		items[dict.n_items++].value = str;
+	}
+
+	iface = load_interface(info, "logger", SPA_TYPE__Log, &dict);
 	if (iface != NULL) {
 		info->support[info->n_support++] = SPA_SUPPORT_INIT(SPA_TYPE__Log, iface);
 		pw_log_set(iface);
@@ -157,20 +530,7 @@ void *pw_get_support_interface(const char *type)
 
 const struct spa_handle_factory *pw_get_support_factory(const char *factory_name)
 {
-	int res;
-	uint32_t index;
-        const struct spa_handle_factory *factory;
-
-        for (index = 0;; index++) {
-                if ((res = support_info.enum_func(&factory, index)) < 0) {
-                        if (res != SPA_RESULT_ENUM_END)
-                                fprintf(stderr, "can't enumerate factories: %d\n", res);
-                        break;
-                }
-                if (strcmp(factory->name, factory_name) == 0)
-                        return factory;
-	}
-	return NULL;
+	return pw_get_spa_handle_factory("support/libspa-support", factory_name);
 }
 
 const struct spa_support *pw_get_support(uint32_t *n_support)
@@ -187,7 +547,11 @@ const struct spa_support *pw_get_support(uint32_t *n_support)
  * Initialize the PipeWire system, parse and modify any parameters given
  * by \a argc and \a argv and set up debugging.
  *
- * The environment variable \a PIPEWIRE_DEBUG
+ * The environment variable \a PIPEWIRE_DEBUG configures the log level
+ * and debug categories. With \a PIPEWIRE_LOG_BINARY set to 1, trace
+ * messages are copied unformatted into a ringbuffer per thread and
+ * formatted later on a thread of the logger, so that tracing doesn't
+ * block the realtime threads.
  *
  * \memberof pw_pipewire
  */
@@ -201,8 +565,11 @@ void pw_init(int *argc, char **argv[])
 	if ((str = getenv("SPA_PLUGIN_DIR")) == NULL)
 		str = PLUGINDIR;
 
-	if (open_support(str, "support/libspa-support", &support_info))
-		configure_support(&support_info);
+	registry.dir = str;
+	spa_list_init(&registry.plugins);
+	pw_array_init(&registry.entries, 64 * sizeof(struct plugin_entry));
+
+	configure_support(&support_info);
 }
 
 /** Check if a debug category is enabled
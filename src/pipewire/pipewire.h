@@ -135,6 +135,9 @@ pw_get_support_interface(const char *type);
 const struct spa_handle_factory *
 pw_get_support_factory(const char *factory_name);
 
+const struct spa_handle_factory *
+pw_get_spa_handle_factory(const char *lib, const char *factory_name);
+
 const struct spa_support *
 pw_get_support(uint32_t *n_support);
 
@@ -21,13 +21,32 @@
 #include <stdlib.h>
 #include <errno.h>
 
+#include <spa/audio/format-utils.h>
+#include <spa/plugins/audiomixer/conv.h>
+
 #include "pipewire/pipewire.h"
 #include "pipewire/private.h"
 #include "pipewire/port.h"
 
+#define MAX_BUFFERS	64
+
 /** \cond */
 struct impl {
 	struct pw_port this;
+
+	/* number of links still holding each output buffer, only used
+	 * from the data thread */
+	uint32_t refcount[MAX_BUFFERS];
+
+	/* input ports mix the buffers of their links with these kernels,
+	 * mix_conv is -1 when the format can't be mixed */
+	struct spa_audiomixer_ops ops;
+	int mix_conv;
+	/* the link that provided the buffer of the last mix, NULL when
+	 * a spare buffer of the port was used */
+	struct spa_graph_port *mix_target;
+	/* spare buffers that the node still holds */
+	uint64_t mix_spare_busy;
 };
 /** \endcond */
 
@@ -41,12 +60,61 @@ static void port_update_state(struct pw_port *port, enum pw_port_state state)
 	}
 }
 
+/* Output ports hand the same buffer to all links. Each link takes a
+ * reference, the buffer goes back to the node when the last link releases
+ * it. Buffers with an id too large to track are returned on first release. */
+static bool tee_unref(struct pw_port *this, struct pw_link *link, uint32_t buffer_id)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	uint64_t mask;
+
+	if (buffer_id >= MAX_BUFFERS)
+		return true;
+
+	mask = 1ULL << buffer_id;
+	if (!(link->rt.held_buffers & mask))
+		return false;
+
+	link->rt.held_buffers &= ~mask;
+	return --impl->refcount[buffer_id] == 0;
+}
+
+static void tee_recycle(struct pw_port *this, uint32_t buffer_id, bool in_cycle)
+{
+	/* in a cycle the node picks the buffer up from the io area in
+	 * process_output, otherwise it is given back right away */
+	if (in_cycle && this->io.buffer_id == SPA_ID_INVALID)
+		this->io.buffer_id = buffer_id;
+	else if (this->implementation->reuse_buffer)
+		this->implementation->reuse_buffer(this->implementation_data, buffer_id);
+}
+
+static void tee_reset(struct pw_port *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct pw_link *link;
+
+	memset(impl->refcount, 0, sizeof(impl->refcount));
+	spa_list_for_each(link, &this->links, output_link)
+		link->rt.held_buffers = 0;
+}
+
+static void mix_reset(struct pw_port *this)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+
+	impl->mix_target = NULL;
+	impl->mix_spare_busy = 0;
+}
+
 static int schedule_tee_input(void *data)
 {
         struct pw_port *this = data;
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
 	struct spa_graph_node *node = &this->rt.mix_node;
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
+	uint32_t buffer_id = io->buffer_id, n_links = 0;
         int res;
 
 	if (spa_list_is_empty(&node->ports[SPA_DIRECTION_OUTPUT])) {
@@ -55,8 +123,23 @@ static int schedule_tee_input(void *data)
 	}
 	else {
 		pw_log_trace("tee input %d %d", io->status, io->buffer_id);
-		spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link)
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+			struct pw_link *link = SPA_CONTAINER_OF(p, struct pw_link, rt.out_port);
+
+			/* the link did not take the previous buffer, drop it */
+			if (p->io->status == SPA_RESULT_HAVE_BUFFER &&
+			    p->io->buffer_id != SPA_ID_INVALID &&
+			    tee_unref(this, link, p->io->buffer_id))
+				tee_recycle(this, p->io->buffer_id, false);
+
 			*p->io = *io;
+			if (buffer_id < MAX_BUFFERS)
+				link->rt.held_buffers |= 1ULL << buffer_id;
+			n_links++;
+		}
+		if (buffer_id < MAX_BUFFERS)
+			impl->refcount[buffer_id] = n_links;
+
 		io->status = SPA_RESULT_OK;
 		io->buffer_id = SPA_ID_INVALID;
 		res = SPA_RESULT_HAVE_BUFFER;
@@ -70,8 +153,19 @@ static int schedule_tee_output(void *data)
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
 
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link)
-		*io = *p->io;
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+		struct pw_link *link = SPA_CONTAINER_OF(p, struct pw_link, rt.out_port);
+		uint32_t buffer_id = p->io->buffer_id;
+
+		io->range = p->io->range;
+
+		if (p->io->status == SPA_RESULT_HAVE_BUFFER || buffer_id == SPA_ID_INVALID)
+			continue;
+
+		p->io->buffer_id = SPA_ID_INVALID;
+		if (tee_unref(this, link, buffer_id))
+			tee_recycle(this, buffer_id, true);
+	}
 	io->status = SPA_RESULT_NEED_BUFFER;
 
 	return SPA_RESULT_NEED_BUFFER;
@@ -93,32 +187,248 @@ static const struct spa_graph_port_callbacks schedule_tee_port = {
 	schedule_tee_reuse_buffer,
 };
 
+int pw_port_tee_reuse_buffer(struct pw_port *port, struct pw_link *link, uint32_t buffer_id)
+{
+	if (tee_unref(port, link, buffer_id))
+		tee_recycle(port, buffer_id, false);
+	return SPA_RESULT_OK;
+}
+
+void pw_port_tee_unlink(struct pw_port *port, struct pw_link *link)
+{
+	uint32_t i;
+
+	for (i = 0; i < MAX_BUFFERS && link->rt.held_buffers; i++) {
+		if ((link->rt.held_buffers & (1ULL << i)) && tee_unref(port, link, i))
+			tee_recycle(port, i, false);
+	}
+}
+
+/* the link that shares its buffers with the input port, its buffer ids
+ * are the ones known by the node */
+static bool mix_owns_buffers(struct pw_port *this, struct spa_graph_port *p)
+{
+	struct pw_link *link = SPA_CONTAINER_OF(p, struct pw_link, rt.in_port);
+	struct pw_port *output = link->output;
+
+	return output->n_buffers > 0 && this->n_buffers > 0 &&
+		output->buffers[0] == this->buffers[0];
+}
+
+static bool mix_single_link(struct spa_graph_node *node)
+{
+	struct spa_list *ports = &node->ports[SPA_DIRECTION_INPUT];
+	return ports->next != ports && ports->next->next == ports;
+}
+
+/* the port can have spare buffers after the ones it shares with a link,
+ * they are only known by the port and its node */
+static uint32_t mix_n_shared(struct pw_port *this)
+{
+	struct spa_graph_node *node = &this->rt.mix_node;
+	struct spa_graph_port *p;
+
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		struct pw_link *link = SPA_CONTAINER_OF(p, struct pw_link, rt.in_port);
+		if (mix_owns_buffers(this, p))
+			return SPA_MIN(link->output->n_buffers, this->n_buffers);
+	}
+	return this->n_buffers;
+}
+
+static bool mix_is_spare(struct pw_port *this, uint32_t buffer_id)
+{
+	return buffer_id >= mix_n_shared(this) && buffer_id < this->n_buffers &&
+		buffer_id < MAX_BUFFERS;
+}
+
+static struct spa_buffer *mix_get_spare(struct pw_port *this, uint32_t *buffer_id)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	uint32_t i, n_buffers = SPA_MIN(this->n_buffers, MAX_BUFFERS);
+	struct spa_buffer *b;
+
+	for (i = mix_n_shared(this); i < n_buffers; i++) {
+		if (impl->mix_spare_busy & (1ULL << i))
+			continue;
+
+		b = this->buffers[i];
+		if (b->n_datas == 0)
+			return NULL;
+
+		impl->mix_spare_busy |= 1ULL << i;
+		b->datas[0].chunk->offset = 0;
+		b->datas[0].chunk->size = 0;
+		*buffer_id = i;
+		return b;
+	}
+	return NULL;
+}
+
+/* a buffer can be mixed into when no other link of its output port
+ * still reads it */
+static bool mix_writable(struct spa_graph_port *p, uint32_t buffer_id)
+{
+	struct pw_link *link = SPA_CONTAINER_OF(p, struct pw_link, rt.in_port);
+	struct impl *out = SPA_CONTAINER_OF(link->output, struct impl, this);
+
+	return buffer_id < MAX_BUFFERS && out->refcount[buffer_id] == 1;
+}
+
+static void mix_buffer(struct impl *impl, struct spa_buffer *dst, struct spa_buffer *src)
+{
+	struct spa_data *dd = &dst->datas[0], *sd = &src->datas[0];
+	uint32_t doffs, dsize, soffs, ssize, n_bytes;
+
+	doffs = SPA_MIN(dd->chunk->offset, dd->maxsize);
+	dsize = SPA_MIN(dd->chunk->size, dd->maxsize - doffs);
+	soffs = SPA_MIN(sd->chunk->offset, sd->maxsize);
+	ssize = SPA_MIN(sd->chunk->size, sd->maxsize - soffs);
+
+	n_bytes = SPA_MIN(ssize, dd->maxsize - doffs);
+	if (n_bytes > dsize) {
+		impl->ops.copy[impl->mix_conv](SPA_MEMBER(dd->data, doffs + dsize, void),
+					       SPA_MEMBER(sd->data, soffs + dsize, void),
+					       n_bytes - dsize);
+		dd->chunk->size = n_bytes;
+		n_bytes = dsize;
+	}
+	impl->ops.add[impl->mix_conv](SPA_MEMBER(dd->data, doffs, void),
+				      SPA_MEMBER(sd->data, soffs, void),
+				      n_bytes);
+}
+
+static void mix_release(struct spa_graph_port *p)
+{
+	struct spa_graph_port *pp = p->peer;
+	uint32_t buffer_id = p->io->buffer_id;
+
+	p->io->status = SPA_RESULT_OK;
+	p->io->buffer_id = SPA_ID_INVALID;
+	if (pp && pp->callbacks && pp->callbacks->reuse_buffer)
+		pp->callbacks->reuse_buffer(pp->callbacks_data, buffer_id);
+}
+
+/* Input ports add the buffers of all ready links into a buffer of the
+ * port: the buffer of the link that shares its pool with the port when no
+ * other link reads it, or else one of the spare buffers of the port. The
+ * mixed buffers are given back right away. With only the link that shares
+ * its pool ready, or when the format can't be mixed, its buffer is passed
+ * on without copying. When there is nothing to mix into, the buffers stay
+ * with their links until the node gives a spare buffer back. */
 static int schedule_mix_input(void *data)
 {
         struct pw_port *this = data;
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
 	struct spa_graph_node *node = &this->rt.mix_node;
-	struct spa_graph_port *p;
+	struct spa_graph_port *p, *owner = NULL, *target = NULL;
 	struct spa_port_io *io = this->rt.mix_port.io;
+	struct spa_buffer *dst;
+	uint32_t dst_id;
+	int n_ready = 0;
 
 	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
-		pw_log_trace("mix input %p %p->%p %d %d", p, p->io, io, p->io->status, p->io->buffer_id);
-		*io = *p->io;
-		p->io->status = SPA_RESULT_OK;
-		p->io->buffer_id = SPA_ID_INVALID;
+		if (p->io->status != SPA_RESULT_HAVE_BUFFER || p->io->buffer_id == SPA_ID_INVALID)
+			continue;
+		n_ready++;
+		if (owner == NULL && (mix_owns_buffers(this, p) || mix_single_link(node)))
+			owner = p;
 	}
+
+	if (n_ready == 0)
+		goto need_buffer;
+
+	if ((n_ready == 1 && owner != NULL) || impl->mix_conv < 0) {
+		/* pass on one buffer without copying. The node only knows the
+		 * buffers of the link that shares its pool with the port. */
+		if (owner == NULL)
+			goto need_buffer;
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+			if (p != owner && p->io->status == SPA_RESULT_HAVE_BUFFER &&
+			    p->io->buffer_id != SPA_ID_INVALID)
+				mix_release(p);
+		}
+		target = owner;
+		pw_log_trace("mix input %p %p->%p %d", target, target->io, io,
+			     target->io->buffer_id);
+		goto done;
+	}
+
+	if (owner != NULL && owner->io->buffer_id < this->n_buffers &&
+	    mix_writable(owner, owner->io->buffer_id)) {
+		target = owner;
+		dst_id = owner->io->buffer_id;
+		dst = this->buffers[dst_id];
+	}
+	else if ((dst = mix_get_spare(this, &dst_id)) == NULL) {
+		pw_log_trace("mix input %p: no buffer to mix %d links into", this, n_ready);
+		goto need_buffer;
+	}
+
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		struct pw_link *link = SPA_CONTAINER_OF(p, struct pw_link, rt.in_port);
+		uint32_t buffer_id = p->io->buffer_id;
+
+		if (p == target || p->io->status != SPA_RESULT_HAVE_BUFFER ||
+		    buffer_id == SPA_ID_INVALID)
+			continue;
+
+		pw_log_trace("mix input %p: add buffer %d to %d", p, buffer_id, dst_id);
+		if (buffer_id < link->output->n_buffers)
+			mix_buffer(impl, dst, link->output->buffers[buffer_id]);
+
+		mix_release(p);
+	}
+
+	if (target == NULL) {
+		io->status = SPA_RESULT_HAVE_BUFFER;
+		io->buffer_id = dst_id;
+		impl->mix_target = NULL;
+		return SPA_RESULT_HAVE_BUFFER;
+	}
+
+      done:
+	*io = *target->io;
+	target->io->status = SPA_RESULT_OK;
+	target->io->buffer_id = SPA_ID_INVALID;
+	impl->mix_target = target;
+
 	return SPA_RESULT_HAVE_BUFFER;
+
+      need_buffer:
+	io->status = SPA_RESULT_NEED_BUFFER;
+	io->buffer_id = SPA_ID_INVALID;
+	return SPA_RESULT_NEED_BUFFER;
 }
 
 static int schedule_mix_output(void *data)
 {
         struct pw_port *this = data;
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
 	struct spa_graph_node *node = &this->rt.mix_node;
 	struct spa_graph_port *p;
 	struct spa_port_io *io = this->rt.mix_port.io;
+	bool spare = io->buffer_id != SPA_ID_INVALID && mix_is_spare(this, io->buffer_id);
+
+	if (spare)
+		impl->mix_spare_busy &= ~(1ULL << io->buffer_id);
 
 	io->status = SPA_RESULT_NEED_BUFFER;
-	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
-		*p->io = *io;
+	if (impl->mix_target == NULL && !spare) {
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
+			*p->io = *io;
+	} else {
+		/* only the mix target gets the buffer back, the other links
+		 * already got theirs when mixing and spare buffers stay with
+		 * the port */
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+			p->io->status = SPA_RESULT_NEED_BUFFER;
+			p->io->range = io->range;
+			p->io->buffer_id = !spare && p == impl->mix_target ?
+				io->buffer_id : SPA_ID_INVALID;
+		}
+	}
+	impl->mix_target = NULL;
 	io->buffer_id = SPA_ID_INVALID;
 
 	return SPA_RESULT_NEED_BUFFER;
@@ -132,6 +442,27 @@ static const struct spa_graph_node_callbacks schedule_mix_node = {
 
 static int schedule_mix_reuse_buffer(void *data, uint32_t buffer_id)
 {
+        struct pw_port *this = data;
+	struct spa_graph_node *node = &this->rt.mix_node;
+	struct spa_list *ports = &node->ports[SPA_DIRECTION_INPUT];
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct spa_graph_port *p, *pp;
+
+	if (mix_is_spare(this, buffer_id)) {
+		impl->mix_spare_busy &= ~(1ULL << buffer_id);
+		return SPA_RESULT_OK;
+	}
+
+	/* the buffer belongs to the link that shares its buffers with the
+	 * port, or to the only link */
+	spa_list_for_each(p, ports, link) {
+		if (!mix_owns_buffers(this, p) && !mix_single_link(node))
+			continue;
+
+		if ((pp = p->peer) && pp->callbacks && pp->callbacks->reuse_buffer)
+			return pp->callbacks->reuse_buffer(pp->callbacks_data, buffer_id);
+		break;
+	}
 	return SPA_RESULT_OK;
 }
 static const struct spa_graph_port_callbacks schedule_mix_port = {
@@ -159,6 +490,9 @@ struct pw_port *pw_port_new(enum pw_direction direction,
 	this->io.status = SPA_RESULT_OK;
 	this->io.buffer_id = SPA_ID_INVALID;
 
+	spa_audiomixer_get_ops(&impl->ops);
+	impl->mix_conv = -1;
+
         if (user_data_size > 0)
 		this->user_data = SPA_MEMBER(impl, sizeof(struct impl), void);
 
@@ -339,8 +673,41 @@ int pw_port_enum_formats(struct pw_port *port,
 	return res;
 }
 
+/* pick the kernels to mix the links of an input port with, only raw
+ * S16 and F32 audio is mixed */
+static int mix_conv_for_format(struct pw_port *port, const struct spa_format *format)
+{
+	struct pw_type *t = &port->node->core->type;
+	struct spa_audio_info_raw info;
+
+	if (format == NULL || port->direction != PW_DIRECTION_INPUT)
+		return -1;
+
+	if (SPA_FORMAT_MEDIA_TYPE(format) != t->media_type.audio ||
+	    SPA_FORMAT_MEDIA_SUBTYPE(format) != t->media_subtype.raw)
+		return -1;
+
+	if (!spa_format_audio_raw_parse(format, &info, &t->format_audio) ||
+	    info.layout != SPA_AUDIO_LAYOUT_INTERLEAVED)
+		return -1;
+
+	if (info.format == t->audio_format.S16)
+		return CONV_S16_S16;
+	else if (info.format == t->audio_format.F32)
+		return CONV_F32_F32;
+
+	return -1;
+}
+
+bool pw_port_can_mix(struct pw_port *port)
+{
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
+	return impl->mix_conv >= 0;
+}
+
 int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_format *format)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	int res;
 
 	if (port->implementation->set_format)
@@ -351,6 +718,8 @@ int pw_port_set_format(struct pw_port *port, uint32_t flags, const struct spa_fo
 	pw_log_debug("port %p: set format %d", port, res);
 
 	if (!SPA_RESULT_IS_ASYNC(res)) {
+		impl->mix_conv = mix_conv_for_format(port, format);
+
 		if (format == NULL) {
 			if (port->buffers)
 				free(port->buffers);
@@ -434,6 +803,11 @@ int pw_port_use_buffers(struct pw_port *port, struct spa_buffer **buffers, uint3
 
 	size = sizeof(struct spa_buffer *) * n_buffers;
 
+	if (port->direction == PW_DIRECTION_OUTPUT)
+		tee_reset(port);
+	else
+		mix_reset(port);
+
 	if (port->buffers)
 		free(port->buffers);
 	port->buffers = size ? memcpy(malloc(size), buffers, size) : NULL;
@@ -477,6 +851,11 @@ int pw_port_alloc_buffers(struct pw_port *port,
 
 	size = sizeof(struct spa_buffer *) * *n_buffers;
 
+	if (port->direction == PW_DIRECTION_OUTPUT)
+		tee_reset(port);
+	else
+		mix_reset(port);
+
 	if (port->buffers)
 		free(port->buffers);
 	port->buffers = size ? memcpy(malloc(size), buffers, size) : NULL;
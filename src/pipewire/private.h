@@ -25,12 +25,42 @@ extern "C" {
 #endif
 
 #include <sys/socket.h>
+#include <sched.h>
+#include <pthread.h>
+
 #include <spa/graph-scheduler3.h>
 
 #include "pipewire/mem.h"
 #include "pipewire/pipewire.h"
 #include "pipewire/introspect.h"
 
+/** One mapping of a memfd, shared by all memory ids that refer to the
+ * same file */
+struct pw_mem_map {
+	struct spa_list link;	/**< link in the cache */
+	dev_t dev;		/**< device of the file */
+	ino_t ino;		/**< inode of the file */
+	void *ptr;		/**< mapped memory */
+	size_t size;		/**< mapped size */
+	int ref;		/**< users of the mapping, 0 when cached */
+};
+
+/** Mappings of the memory of a client node. Unused mappings are kept for
+ * when the same memory is used again after renegotiation */
+struct pw_mem_cache {
+	struct spa_list maps;	/**< mappings, the least recently used first */
+	uint32_t n_cached;	/**< number of unused mappings */
+};
+
+void pw_mem_cache_init(struct pw_mem_cache *cache);
+
+/** Make \a map point to a mapping of at least \a size bytes of \a fd */
+int pw_mem_cache_map(struct pw_mem_cache *cache, struct pw_mem_map **map, int fd, size_t size);
+
+void pw_mem_cache_unref(struct pw_mem_cache *cache, struct pw_mem_map *map);
+
+void pw_mem_cache_clear(struct pw_mem_cache *cache);
+
 struct pw_command {
 	struct spa_list link;	/**< link in list of commands */
 	const char *name;	/**< command name */
@@ -42,6 +72,7 @@ struct pw_client {
 	struct pw_global *global;	/**< global object created for this client */
 
 	struct pw_properties *properties;	/**< Client properties */
+	uint32_t props_generation;	/**< generation of the properties in \a info */
 
 	struct pw_client_info info;	/**< client info */
 	bool ucred_valid;		/**< if the ucred member is valid */
@@ -87,6 +118,7 @@ struct pw_core {
 	struct pw_core_info info;	/**< info about the core */
 
 	struct pw_properties *properties;	/**< properties of the core */
+	uint32_t props_generation;		/**< generation of the properties in \a info */
 
 	struct pw_type type;			/**< type map and common types */
 
@@ -109,16 +141,20 @@ struct pw_core {
 	struct spa_hook_list listener_list;
 
 	struct pw_loop *main_loop;	/**< main loop for control */
-	struct pw_loop *data_loop;	/**< data loop for data passing */
+	struct pw_loop *data_loop;	/**< default data loop for data passing */
         struct pw_data_loop *data_loop_impl;
+	struct spa_list data_loop_list;	/**< list of data loops, default first */
+	uint32_t n_data_loops;		/**< number of data loops ever added */
 
 	struct spa_support support[4];	/**< support for spa plugins */
 	uint32_t n_support;		/**< number of support items */
 
-	struct {
-		struct spa_graph_scheduler sched;
-		struct spa_graph graph;
-	} rt;
+	uint32_t quantum;		/**< current graph quantum in samples */
+	uint32_t quantum_default;	/**< quantum when no active node requests a latency */
+	uint32_t quantum_min;		/**< lower bound of the quantum */
+	uint32_t quantum_max;		/**< upper bound of the quantum */
+
+	uint32_t driver_serial;		/**< last id given to a driver clock */
 };
 
 struct pw_data_loop {
@@ -130,6 +166,40 @@ struct pw_data_loop {
 
         bool running;
         pthread_t thread;
+
+	struct {
+		int policy;		/**< scheduling policy, -1 to use rtkit */
+		int priority;		/**< realtime priority */
+		long long rttime;	/**< RLIMIT_RTTIME in usec */
+		uint32_t quantum;	/**< graph quantum in samples */
+		uint32_t rate;		/**< graph rate in Hz */
+		uint64_t period;	/**< deadline period in usec, 0 from quantum */
+		uint64_t runtime;	/**< deadline runtime in usec, 0 for half the period */
+		size_t stack_size;	/**< stack size of the thread, 0 for default */
+		bool lock_memory;	/**< lock the thread stack in memory */
+		bool pinned;		/**< if the thread is pinned to cpus */
+		cpu_set_t cpus;		/**< cpus to run the thread on */
+	} config;			/**< scheduling configuration */
+
+	uint32_t id;			/**< id of the loop in the core */
+	struct spa_list link;		/**< link in core data_loop_list */
+	uint32_t n_nodes;		/**< number of nodes scheduled on the loop */
+
+	struct pw_node *driver;		/**< active live node that provides the clock
+					  *  of the graph of this loop */
+	uint32_t driver_id;		/**< id of the clock of \a driver */
+
+	struct spa_support support[4];	/**< support for spa plugins on this loop */
+	uint32_t n_support;		/**< number of support items */
+
+	struct {
+		struct spa_graph_scheduler sched;
+		struct spa_graph graph;
+		struct spa_source *deadline;	/**< timer for async node completion */
+		uint32_t quantum;		/**< graph quantum, 0 to use config.quantum */
+		struct spa_clock *clock;	/**< clock of the driver */
+		uint32_t clock_id;		/**< id of \a clock */
+	} rt;
 };
 
 struct pw_main_loop {
@@ -165,6 +235,7 @@ struct pw_link {
 	struct {
 		struct spa_graph_port out_port;
 		struct spa_graph_port in_port;
+		uint64_t held_buffers;	/**< output buffers not yet released by the input */
 	} rt;
 };
 
@@ -189,10 +260,12 @@ struct pw_node {
 
 	struct pw_resource *owner;		/**< owner resource if any */
 	struct pw_properties *properties;	/**< properties of the node */
+	uint32_t props_generation;		/**< generation of the properties in \a info */
 
 	struct pw_node_info info;		/**< introspectable node info */
 
 	bool live;			/**< if the node is live */
+	int32_t driver_priority;	/**< rank of the node when selecting the driver */
 	struct spa_clock *clock;	/**< handle to SPA clock if any */
 
 	struct spa_list resource_list;	/**< list of resources for this node */
@@ -214,6 +287,12 @@ struct pw_node {
 	struct spa_hook_list listener_list;
 
 	struct pw_loop *data_loop;		/**< the data loop for this node */
+	struct pw_data_loop *data_loop_impl;	/**< the data loop implementation */
+	bool data_loop_pinned;			/**< if the node can't change data loop */
+
+	bool active;			/**< if the node is started or being started */
+	uint32_t latency;		/**< requested latency in samples, 0 for none */
+	uint32_t quantum;		/**< quantum last configured on the node */
 
 	struct {
 		struct spa_graph_scheduler *sched;
@@ -259,6 +338,27 @@ struct pw_port {
         void *user_data;                /**< extra user data */
 };
 
+/** Arm the deadline of the current cycle on \a loop, called from the
+ * data thread */
+void pw_data_loop_schedule_deadline(struct pw_data_loop *loop);
+
+/** Set the graph \a quantum that the cycle deadlines of \a loop follow */
+void pw_data_loop_set_quantum(struct pw_data_loop *loop, uint32_t quantum);
+
+/** Configure the graph \a quantum on the driver \a node */
+int pw_node_set_quantum(struct pw_node *node, uint32_t quantum);
+
+/** Release a buffer that \a link got from the output \a port, called
+ * from the data thread */
+int pw_port_tee_reuse_buffer(struct pw_port *port, struct pw_link *link, uint32_t buffer_id);
+
+/** Release all buffers still held by \a link, called from the data thread */
+void pw_port_tee_unlink(struct pw_port *port, struct pw_link *link);
+
+/** Check if the links of the input \a port can be mixed with the
+ * negotiated format */
+bool pw_port_can_mix(struct pw_port *port);
+
 
 struct pw_resource {
 	struct pw_core *core;		/**< the core object */
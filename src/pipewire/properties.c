@@ -27,6 +27,7 @@ struct properties {
 	struct pw_properties this;
 
 	struct pw_array items;
+	uint32_t generation;
 };
 /** \endcond */
 
@@ -41,6 +42,7 @@ static void add_func(struct pw_properties *this, char *key, char *value)
 
 	this->dict.items = impl->items.data;
 	this->dict.n_items = pw_array_get_len(&impl->items, struct spa_dict_item);
+	impl->generation++;
 }
 
 static void clear_item(struct spa_dict_item *item)
@@ -203,11 +205,20 @@ static void do_replace(struct pw_properties *properties, char *key, char *value)
 	int index = find_index(properties, key);
 
 	if (index == -1) {
-		add_func(properties, key, value);
+		if (value == NULL)
+			free(key);
+		else
+			add_func(properties, key, value);
 	} else {
 		struct spa_dict_item *item =
 		    pw_array_get_unchecked(&impl->items, index, struct spa_dict_item);
 
+		if (value && strcmp(item->value, value) == 0) {
+			free(key);
+			free(value);
+			return;
+		}
+		impl->generation++;
 		clear_item(item);
 		if (value == NULL) {
 			struct spa_dict_item *other = pw_array_get_unchecked(&impl->items,
@@ -219,6 +230,8 @@ static void do_replace(struct pw_properties *properties, char *key, char *value)
 			item->key = other->key;
 			item->value = other->value;
 			impl->items.size -= sizeof(struct spa_dict_item);
+			properties->dict.n_items--;
+			free(key);
 		} else {
 			item->key = key;
 			item->value = value;
@@ -288,6 +301,23 @@ const char *pw_properties_get(const struct pw_properties *properties, const char
 	return pw_array_get_unchecked(&impl->items, index, struct spa_dict_item)->value;
 }
 
+/** Get the change generation
+ *
+ * \param properties a \ref pw_properties
+ * \return the generation of \a properties
+ *
+ * The generation changes whenever a key is added or removed or when a
+ * key gets a different value. Setting a key to its current value does
+ * not change the generation.
+ *
+ * \memberof pw_properties
+ */
+uint32_t pw_properties_get_generation(const struct pw_properties *properties)
+{
+	struct properties *impl = SPA_CONTAINER_OF(properties, struct properties, this);
+	return impl->generation;
+}
+
 /** Iterate property values
  *
  * \param properties a \ref pw_properties
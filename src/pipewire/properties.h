@@ -64,6 +64,9 @@ pw_properties_setf(struct pw_properties *properties,
 const char *
 pw_properties_get(const struct pw_properties *properties, const char *key);
 
+uint32_t
+pw_properties_get_generation(const struct pw_properties *properties);
+
 const char *
 pw_properties_iterate(const struct pw_properties *properties, void **state);
 
@@ -23,6 +23,7 @@
 #include <sys/un.h>
 #include <errno.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <spa/lib/debug.h>
 
@@ -45,6 +46,7 @@ struct remote {
 	struct spa_hook core_listener;
 };
 
+
 struct mem_id {
 	uint32_t id;
 	int fd;
@@ -52,6 +54,7 @@ struct mem_id {
 	void *ptr;
 	uint32_t offset;
 	uint32_t size;
+	struct pw_mem_map *map;
 };
 
 struct buffer_id {
@@ -59,6 +62,7 @@ struct buffer_id {
 	uint32_t id;
 	void *buf_ptr;
 	struct spa_buffer *buf;
+	struct pw_memblock ring;
 };
 
 struct node_data {
@@ -79,9 +83,12 @@ struct node_data {
 
         struct pw_client_node_proxy *node_proxy;
 	struct spa_hook proxy_listener;
+	struct spa_hook proxy_destroy_listener;
 
         struct pw_array mem_ids;
+	struct pw_mem_cache maps;
 	struct pw_array buffer_ids;
+	void *buffer_skel;
 	bool in_order;
 
 };
@@ -140,7 +147,7 @@ static void core_event_info(void *data, struct pw_core_info *info)
 
 	pw_log_debug("got core info");
 	this->info = pw_core_info_update(this->info, info);
-	spa_hook_list_call(&this->listener_list, struct pw_remote_events, info_changed, info);
+	spa_hook_list_call(&this->listener_list, struct pw_remote_events, info_changed, this->info);
 }
 
 static void core_event_done(void *data, uint32_t seq)
@@ -439,6 +446,12 @@ static void handle_rtnode_message(struct pw_proxy *proxy, struct pw_client_node_
 	}
 	else if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_REUSE_BUFFER) {
 	}
+	else if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_REUSE_BUFFERS) {
+		int i;
+
+		for (i = 0; i < data->trans->area->max_output_ports; i++)
+			pw_client_node_reuse_take(&data->trans->output_reuse[i]);
+	}
 	else {
 		pw_log_warn("unexpected node message %d", PW_CLIENT_NODE_MESSAGE_TYPE(message));
 	}
@@ -653,10 +666,35 @@ static struct mem_id *find_mem(struct pw_proxy *proxy, uint32_t id)
 	return NULL;
 }
 
-static void clear_memid(struct mem_id *mid)
+static int map_memid(struct node_data *data, struct mem_id *mid, size_t size)
+{
+	if (pw_mem_cache_map(&data->maps, &mid->map, mid->fd, size) < 0)
+		return SPA_RESULT_ERROR;
+	mid->ptr = mid->map->ptr;
+	return SPA_RESULT_OK;
+}
+
+static int map_ringbuffer(struct buffer_id *bid, struct spa_data *d)
+{
+	bid->ring.flags = PW_MEMBLOCK_FLAG_MAP_READWRITE | PW_MEMBLOCK_FLAG_MAP_TWICE;
+	bid->ring.fd = d->fd;
+	bid->ring.offset = d->mapoffset;
+	bid->ring.size = d->maxsize;
+	bid->ring.ptr = NULL;
+
+	if (pw_memblock_map(&bid->ring) < 0) {
+		bid->ring.ptr = NULL;
+		return SPA_RESULT_ERROR;
+	}
+	d->data = bid->ring.ptr;
+	return SPA_RESULT_OK;
+}
+
+static void clear_memid(struct node_data *data, struct mem_id *mid)
 {
-	if (mid->ptr != NULL)
-		munmap(mid->ptr, mid->size + mid->offset);
+	if (mid->map != NULL)
+		pw_mem_cache_unref(&data->maps, mid->map);
+	mid->map = NULL;
 	mid->ptr = NULL;
 	close(mid->fd);
 }
@@ -667,7 +705,7 @@ static void clear_mems(struct pw_proxy *proxy)
 	struct mem_id *mid;
 
 	pw_array_for_each(mid, &data->mem_ids)
-	    clear_memid(mid);
+	    clear_memid(data, mid);
 	data->mem_ids.size = 0;
 }
 
@@ -679,10 +717,14 @@ static void clear_buffers(struct pw_proxy *proxy)
         pw_log_debug("node %p: clear buffers", proxy);
 
         pw_array_for_each(bid, &data->buffer_ids) {
-                free(bid->buf);
+                if (bid->ring.ptr)
+                        munmap(bid->ring.ptr, bid->ring.size << 1);
+                bid->ring.ptr = NULL;
                 bid->buf = NULL;
         }
         data->buffer_ids.size = 0;
+	free(data->buffer_skel);
+	data->buffer_skel = NULL;
 }
 
 static void
@@ -700,7 +742,7 @@ client_node_add_mem(void *object,
 	if (m) {
 		pw_log_debug("update mem %u, fd %d, flags %d, off %d, size %d",
 			     mem_id, memfd, flags, offset, size);
-		clear_memid(m);
+		clear_memid(data, m);
 	} else {
 		m = pw_array_add(&data->mem_ids, sizeof(struct mem_id));
 		pw_log_debug("add mem %u, fd %d, flags %d, off %d, size %d",
@@ -712,6 +754,7 @@ client_node_add_mem(void *object,
 	m->ptr = NULL;
 	m->offset = offset;
 	m->size = size;
+	m->map = NULL;
 }
 
 static void
@@ -726,6 +769,8 @@ client_node_use_buffers(void *object,
 	uint32_t i, j, len;
 	struct spa_buffer *b, **bufs;
 	struct pw_port *port;
+	size_t skel_size;
+	void *skel;
 	int res;
 
 	port = pw_node_find_port(data->node, direction, port_id);
@@ -739,6 +784,19 @@ client_node_use_buffers(void *object,
 
 	bufs = alloca(n_buffers * sizeof(struct spa_buffer *));
 
+	/* allocate the skeletons of all buffers in one block */
+	skel_size = 0;
+	for (i = 0; i < n_buffers; i++) {
+		skel_size += sizeof(struct spa_buffer) +
+		    sizeof(struct spa_meta) * buffers[i].buffer->n_metas +
+		    sizeof(struct spa_data) * buffers[i].buffer->n_datas;
+	}
+	skel = data->buffer_skel = n_buffers ? malloc(skel_size) : NULL;
+	if (n_buffers && skel == NULL) {
+		res = SPA_RESULT_NO_MEMORY;
+		goto done;
+	}
+
 	for (i = 0; i < n_buffers; i++) {
 		off_t offset;
 
@@ -748,40 +806,23 @@ client_node_use_buffers(void *object,
 			continue;
 		}
 
-		if (mid->ptr == NULL) {
-			mid->ptr =
-			    mmap(NULL, mid->size + mid->offset, PROT_READ | PROT_WRITE, MAP_SHARED,
-				 mid->fd, 0);
-			if (mid->ptr == MAP_FAILED) {
-				mid->ptr = NULL;
-				pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
-					    strerror(errno));
-				continue;
-			}
+		if (map_memid(data, mid, mid->size + mid->offset) < 0) {
+			pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
+				    strerror(errno));
+			continue;
 		}
 		len = pw_array_get_len(&data->buffer_ids, struct buffer_id);
 		bid = pw_array_add(&data->buffer_ids, sizeof(struct buffer_id));
+		bid->ring.ptr = NULL;
 
-		b = buffers[i].buffer;
+		b = bid->buf = skel;
+		memcpy(b, buffers[i].buffer, sizeof(struct spa_buffer));
+		b->metas = SPA_MEMBER(b, sizeof(struct spa_buffer), struct spa_meta);
+		b->datas = SPA_MEMBER(b->metas, sizeof(struct spa_meta) * b->n_metas,
+				      struct spa_data);
+		skel = SPA_MEMBER(b->datas, sizeof(struct spa_data) * b->n_datas, void);
 
 		bid->buf_ptr = SPA_MEMBER(mid->ptr, mid->offset + buffers[i].offset, void);
-		{
-			size_t size;
-
-			size = sizeof(struct spa_buffer);
-			for (j = 0; j < buffers[i].buffer->n_metas; j++)
-				size += sizeof(struct spa_meta);
-			for (j = 0; j < buffers[i].buffer->n_datas; j++)
-				size += sizeof(struct spa_data);
-
-			b = bid->buf = malloc(size);
-			memcpy(b, buffers[i].buffer, sizeof(struct spa_buffer));
-
-			b->metas = SPA_MEMBER(b, sizeof(struct spa_buffer), struct spa_meta);
-			b->datas =
-			    SPA_MEMBER(b->metas, sizeof(struct spa_meta) * b->n_metas,
-				       struct spa_data);
-		}
 		bid->id = b->id;
 
 		if (bid->id != len) {
@@ -807,13 +848,25 @@ client_node_use_buffers(void *object,
 
 			if (d->type == proxy->remote->core->type.data.Id) {
 				struct mem_id *bmid = find_mem(proxy, SPA_PTR_TO_UINT32(d->data));
-				void *map;
 
 				d->type = proxy->remote->core->type.data.MemFd;
 				d->fd = bmid->fd;
-				map = mmap(NULL, d->maxsize + d->mapoffset, PROT_READ|PROT_WRITE,
-					   MAP_SHARED, d->fd, 0);
-				d->data = SPA_MEMBER(map, d->mapoffset, uint8_t);
+				if (d->flags & SPA_DATA_FLAG_MAP_TWICE) {
+					if (map_ringbuffer(bid, d) == SPA_RESULT_OK) {
+						pw_log_debug(" data %d %u -> fd %d, mapped twice",
+							     j, bmid->id, bmid->fd);
+						continue;
+					}
+					pw_log_warn("Failed to map ringbuffer twice: %s", strerror(errno));
+					d->flags &= ~SPA_DATA_FLAG_MAP_TWICE;
+				}
+				if (map_memid(data, bmid, d->maxsize + d->mapoffset) < 0) {
+					pw_log_warn("Failed to mmap memory %d %p: %s", d->maxsize, bmid,
+						    strerror(errno));
+					d->data = NULL;
+					continue;
+				}
+				d->data = SPA_MEMBER(bmid->ptr, d->mapoffset, uint8_t);
 				pw_log_debug(" data %d %u -> fd %d", j, bmid->id, bmid->fd);
 			} else if (d->type == proxy->remote->core->type.data.MemPtr) {
 				d->data = SPA_MEMBER(bid->buf_ptr, SPA_PTR_TO_INT(d->data), void);
@@ -950,10 +1003,12 @@ static void do_node_init(struct pw_proxy *proxy)
         pw_client_node_proxy_update(data->node_proxy,
                                     PW_CLIENT_NODE_UPDATE_MAX_INPUTS |
 				    PW_CLIENT_NODE_UPDATE_MAX_OUTPUTS |
-				    PW_CLIENT_NODE_UPDATE_PROPS,
+				    PW_CLIENT_NODE_UPDATE_PROPS |
+				    PW_CLIENT_NODE_UPDATE_NODE_PROPS,
 				    data->node->info.max_input_ports,
 				    data->node->info.max_output_ports,
-				    NULL);
+				    NULL,
+				    &data->node->properties->dict);
 
 	spa_list_for_each(port, &data->node->input_ports, link) {
 		add_port_update(proxy, port,
@@ -968,12 +1023,44 @@ static void do_node_init(struct pw_proxy *proxy)
         pw_client_node_proxy_done(data->node_proxy, 0, SPA_RESULT_OK);
 }
 
+/* property changes of the exported node, like node.latency, are
+ * forwarded to the client node in the server */
+static void node_info_changed(void *data, struct pw_node_info *info)
+{
+	struct node_data *d = data;
+
+	if (!(info->change_mask & PW_NODE_CHANGE_MASK_PROPS) || info->props == NULL)
+		return;
+
+	pw_client_node_proxy_update(d->node_proxy,
+				    PW_CLIENT_NODE_UPDATE_NODE_PROPS,
+				    0, 0, NULL, info->props);
+}
+
 static const struct pw_node_events node_events = {
 	PW_VERSION_NODE_EVENTS,
+	.info_changed = node_info_changed,
 	.need_input = node_need_input,
 	.have_output = node_have_output,
 };
 
+static void node_proxy_destroy(void *_data)
+{
+	struct node_data *data = _data;
+	struct pw_proxy *proxy = (struct pw_proxy *) data->node_proxy;
+
+	clear_buffers(proxy);
+	pw_array_clear(&data->buffer_ids);
+	clear_mems(proxy);
+	pw_array_clear(&data->mem_ids);
+	pw_mem_cache_clear(&data->maps);
+}
+
+static const struct pw_proxy_events proxy_events = {
+	PW_VERSION_PROXY_EVENTS,
+	.destroy = node_proxy_destroy,
+};
+
 struct pw_proxy *pw_remote_export(struct pw_remote *remote,
 				  struct pw_node *node)
 {
@@ -1000,10 +1087,12 @@ struct pw_proxy *pw_remote_export(struct pw_remote *remote,
 
         pw_array_init(&data->mem_ids, 64);
         pw_array_ensure_size(&data->mem_ids, sizeof(struct mem_id) * 64);
+	pw_mem_cache_init(&data->maps);
         pw_array_init(&data->buffer_ids, 32);
         pw_array_ensure_size(&data->buffer_ids, sizeof(struct buffer_id) * 64);
 
 	pw_node_add_listener(node, &data->node_listener, &node_events, data);
+	pw_proxy_add_listener(proxy, &data->proxy_destroy_listener, &proxy_events, data);
 
         pw_client_node_proxy_add_listener(data->node_proxy,
 					  &data->proxy_listener,
@@ -21,6 +21,7 @@
 #include <sys/socket.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <errno.h>
 #include <time.h>
 
@@ -49,6 +50,7 @@ struct mem_id {
 	void *ptr;
 	uint32_t offset;
 	uint32_t size;
+	struct pw_mem_map *map;
 };
 
 struct buffer_id {
@@ -57,6 +59,7 @@ struct buffer_id {
 	bool used;
 	void *buf_ptr;
 	struct spa_buffer *buf;
+	struct pw_memblock ring;
 };
 
 struct stream {
@@ -77,6 +80,7 @@ struct stream {
 	uint32_t pending_seq;
 
 	enum pw_stream_mode mode;
+	enum pw_stream_flags flags;
 
 	int rtreadfd;
 	int rtwritefd;
@@ -92,22 +96,61 @@ struct stream {
 	struct spa_source *timeout_source;
 
 	struct pw_array mem_ids;
+	struct pw_mem_cache maps;
 	struct pw_array buffer_ids;
+	void *buffer_skel;
 	bool in_order;
 
+	struct {
+		uint32_t id;
+		struct spa_ringbuffer *rb;
+		void *data;
+		bool twice;
+		uint32_t index;
+	} ring;
+
 	struct spa_list free;
 	bool in_need_buffer;
+	bool in_new_buffer;
+	bool reuse_pending;
 
 	int64_t last_ticks;
 	int32_t last_rate;
 	int64_t last_monotonic;
+	int64_t time_ticks;
+	uint32_t time_driver;
 };
 /** \endcond */
 
-static void clear_memid(struct mem_id *mid)
+static int map_ringbuffer(struct buffer_id *bid, struct spa_data *d)
+{
+	bid->ring.flags = PW_MEMBLOCK_FLAG_MAP_READWRITE | PW_MEMBLOCK_FLAG_MAP_TWICE;
+	bid->ring.fd = d->fd;
+	bid->ring.offset = d->mapoffset;
+	bid->ring.size = d->maxsize;
+	bid->ring.ptr = NULL;
+
+	if (pw_memblock_map(&bid->ring) < 0) {
+		bid->ring.ptr = NULL;
+		return SPA_RESULT_ERROR;
+	}
+	d->data = bid->ring.ptr;
+	return SPA_RESULT_OK;
+}
+
+static int map_memid(struct stream *impl, struct mem_id *mid, size_t size)
 {
-	if (mid->ptr != NULL)
-		munmap(mid->ptr, mid->size + mid->offset);
+	if (pw_mem_cache_map(&impl->maps, &mid->map, mid->fd, size) < 0)
+		return SPA_RESULT_ERROR;
+	mid->ptr = mid->map->ptr;
+	return SPA_RESULT_OK;
+}
+
+static void clear_memid(struct stream *impl, struct mem_id *mid)
+{
+	if (mid->map != NULL)
+		pw_mem_cache_unref(&impl->maps, mid->map);
+	mid->map = NULL;
 	mid->ptr = NULL;
 	close(mid->fd);
 }
@@ -118,7 +161,7 @@ static void clear_mems(struct pw_stream *stream)
 	struct mem_id *mid;
 
 	pw_array_for_each(mid, &impl->mem_ids)
-	    clear_memid(mid);
+	    clear_memid(impl, mid);
 	impl->mem_ids.size = 0;
 }
 
@@ -131,11 +174,16 @@ static void clear_buffers(struct pw_stream *stream)
 
 	pw_array_for_each(bid, &impl->buffer_ids) {
 		spa_hook_list_call(&stream->listener_list, struct pw_stream_events, remove_buffer, bid->id);
-		free(bid->buf);
+		if (bid->ring.ptr)
+			munmap(bid->ring.ptr, bid->ring.size << 1);
+		bid->ring.ptr = NULL;
 		bid->buf = NULL;
 		bid->used = false;
 	}
 	impl->buffer_ids.size = 0;
+	free(impl->buffer_skel);
+	impl->buffer_skel = NULL;
+	impl->ring.rb = NULL;
 	impl->in_order = true;
 	spa_list_init(&impl->free);
 }
@@ -214,6 +262,8 @@ struct pw_stream *pw_stream_new(struct pw_remote *remote,
 
 	pw_array_init(&impl->mem_ids, 64);
 	pw_array_ensure_size(&impl->mem_ids, sizeof(struct mem_id) * 64);
+	pw_mem_cache_init(&impl->maps);
+	impl->time_ticks = INT64_MIN;
 	pw_array_init(&impl->buffer_ids, 32);
 	pw_array_ensure_size(&impl->buffer_ids, sizeof(struct buffer_id) * 64);
 	impl->pending_seq = SPA_ID_INVALID;
@@ -348,6 +398,7 @@ void pw_stream_destroy(struct pw_stream *stream)
 
 	clear_mems(stream);
 	pw_array_clear(&impl->mem_ids);
+	pw_mem_cache_clear(&impl->maps);
 
 	if (stream->properties)
 		pw_properties_free(stream->properties);
@@ -371,7 +422,7 @@ static void add_node_update(struct pw_stream *stream, uint32_t change_mask)
 		max_output_ports = impl->direction == SPA_DIRECTION_OUTPUT ? 1 : 0;
 
 	pw_client_node_proxy_update(impl->node_proxy,
-				    change_mask, max_input_ports, max_output_ports, NULL);
+				    change_mask, max_input_ports, max_output_ports, NULL, NULL);
 }
 
 static void add_port_update(struct pw_stream *stream, uint32_t change_mask)
@@ -402,6 +453,17 @@ static inline void send_need_input(struct pw_stream *stream)
 #endif
 }
 
+static inline void send_reuse_buffers(struct pw_stream *stream)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	uint64_t cmd = 1;
+
+	impl->reuse_pending = false;
+	pw_client_node_transport_add_message(impl->trans,
+			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_REUSE_BUFFERS));
+	write(impl->rtwritefd, &cmd, 8);
+}
+
 static inline void send_have_output(struct pw_stream *stream)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
@@ -439,6 +501,8 @@ static void do_node_init(struct pw_stream *stream)
 			PW_CLIENT_NODE_UPDATE_MAX_OUTPUTS);
 
 	impl->port_info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	if (impl->flags & PW_STREAM_FLAG_DRIVER)
+		impl->port_info.flags |= SPA_PORT_INFO_FLAG_LIVE;
 	add_port_update(stream, PW_CLIENT_NODE_PORT_UPDATE_POSSIBLE_FORMATS |
 			PW_CLIENT_NODE_PORT_UPDATE_INFO);
 	add_async_complete(stream, 0, SPA_RESULT_OK);
@@ -499,6 +563,7 @@ static void handle_rtnode_message(struct pw_stream *stream, struct pw_client_nod
 	if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT) {
 		int i;
 
+		impl->in_new_buffer = true;
 		for (i = 0; i < impl->trans->area->n_input_ports; i++) {
 			struct spa_port_io *input = &impl->trans->inputs[i];
 
@@ -511,6 +576,11 @@ static void handle_rtnode_message(struct pw_stream *stream, struct pw_client_nod
 					 new_buffer, input->buffer_id);
 			input->buffer_id = SPA_ID_INVALID;
 		}
+		impl->in_new_buffer = false;
+
+		/* buffers recycled from the new_buffer event go out together */
+		if (impl->reuse_pending)
+			send_reuse_buffers(stream);
 		send_need_input(stream);
 	} else if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT) {
 		int i;
@@ -538,6 +608,17 @@ static void handle_rtnode_message(struct pw_stream *stream, struct pw_client_nod
 			return;
 
 		reuse_buffer(stream, p->body.buffer_id.value);
+	} else if (PW_CLIENT_NODE_MESSAGE_TYPE(message) == PW_CLIENT_NODE_MESSAGE_REUSE_BUFFERS) {
+		uint64_t ids;
+
+		if (impl->direction != SPA_DIRECTION_OUTPUT)
+			return;
+
+		ids = pw_client_node_reuse_take(&impl->trans->output_reuse[impl->port_id]);
+		while (ids) {
+			reuse_buffer(stream, __builtin_ctzll(ids));
+			ids &= ids - 1;
+		}
 	} else {
 		pw_log_warn("unexpected node message %d", PW_CLIENT_NODE_MESSAGE_TYPE(message));
 	}
@@ -638,6 +719,7 @@ handle_node_command(struct pw_stream *stream, uint32_t seq, const struct spa_com
 		impl->last_ticks = cu->body.ticks.value;
 		impl->last_rate = cu->body.rate.value;
 		impl->last_monotonic = cu->body.monotonic_time.value;
+		__atomic_store_n(&impl->time_ticks, INT64_MIN, __ATOMIC_RELAXED);
 	} else {
 		pw_log_warn("unhandled node command %d", SPA_COMMAND_TYPE(command));
 		add_async_complete(stream, seq, SPA_RESULT_NOT_IMPLEMENTED);
@@ -717,7 +799,7 @@ client_node_add_mem(void *data,
 	if (m) {
 		pw_log_debug("update mem %u, fd %d, flags %d, off %d, size %d",
 			     mem_id, memfd, flags, offset, size);
-		clear_memid(m);
+		clear_memid(impl, m);
 	} else {
 		m = pw_array_add(&impl->mem_ids, sizeof(struct mem_id));
 		pw_log_debug("add mem %u, fd %d, flags %d, off %d, size %d",
@@ -729,6 +811,7 @@ client_node_add_mem(void *data,
 	m->ptr = NULL;
 	m->offset = offset;
 	m->size = size;
+	m->map = NULL;
 }
 
 static void
@@ -742,10 +825,26 @@ client_node_use_buffers(void *data,
 	struct buffer_id *bid;
 	uint32_t i, j, len;
 	struct spa_buffer *b;
+	size_t skel_size;
+	void *skel;
 
 	/* clear previous buffers */
 	clear_buffers(stream);
 
+	/* allocate the skeletons of all buffers in one block */
+	skel_size = 0;
+	for (i = 0; i < n_buffers; i++) {
+		skel_size += sizeof(struct spa_buffer) +
+		    sizeof(struct spa_meta) * buffers[i].buffer->n_metas +
+		    sizeof(struct spa_data) * buffers[i].buffer->n_datas;
+	}
+	skel = impl->buffer_skel = n_buffers ? malloc(skel_size) : NULL;
+	if (n_buffers && skel == NULL) {
+		pw_log_error("stream %p: can't allocate buffers", stream);
+		add_async_complete(stream, seq, SPA_RESULT_NO_MEMORY);
+		return;
+	}
+
 	for (i = 0; i < n_buffers; i++) {
 		off_t offset;
 
@@ -755,16 +854,10 @@ client_node_use_buffers(void *data,
 			continue;
 		}
 
-		if (mid->ptr == NULL) {
-			mid->ptr =
-			    mmap(NULL, mid->size + mid->offset, PROT_READ | PROT_WRITE, MAP_SHARED,
-				 mid->fd, 0);
-			if (mid->ptr == MAP_FAILED) {
-				mid->ptr = NULL;
-				pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
-					    strerror(errno));
-				continue;
-			}
+		if (map_memid(impl, mid, mid->size + mid->offset) < 0) {
+			pw_log_warn("Failed to mmap memory %d %p: %s", mid->size, mid,
+				    strerror(errno));
+			continue;
 		}
 		len = pw_array_get_len(&impl->buffer_ids, struct buffer_id);
 		bid = pw_array_add(&impl->buffer_ids, sizeof(struct buffer_id));
@@ -774,27 +867,16 @@ client_node_use_buffers(void *data,
 		} else {
 			bid->used = true;
 		}
+		bid->ring.ptr = NULL;
 
-		b = buffers[i].buffer;
+		b = bid->buf = skel;
+		memcpy(b, buffers[i].buffer, sizeof(struct spa_buffer));
+		b->metas = SPA_MEMBER(b, sizeof(struct spa_buffer), struct spa_meta);
+		b->datas = SPA_MEMBER(b->metas, sizeof(struct spa_meta) * b->n_metas,
+				      struct spa_data);
+		skel = SPA_MEMBER(b->datas, sizeof(struct spa_data) * b->n_datas, void);
 
 		bid->buf_ptr = SPA_MEMBER(mid->ptr, mid->offset + buffers[i].offset, void);
-		{
-			size_t size;
-
-			size = sizeof(struct spa_buffer);
-			for (j = 0; j < buffers[i].buffer->n_metas; j++)
-				size += sizeof(struct spa_meta);
-			for (j = 0; j < buffers[i].buffer->n_datas; j++)
-				size += sizeof(struct spa_data);
-
-			b = bid->buf = malloc(size);
-			memcpy(b, buffers[i].buffer, sizeof(struct spa_buffer));
-
-			b->metas = SPA_MEMBER(b, sizeof(struct spa_buffer), struct spa_meta);
-			b->datas =
-			    SPA_MEMBER(b->metas, sizeof(struct spa_meta) * b->n_metas,
-				       struct spa_data);
-		}
 		bid->id = b->id;
 
 		if (bid->id != len) {
@@ -825,6 +907,15 @@ client_node_use_buffers(void *data,
 				d->data = NULL;
 				d->fd = bmid->fd;
 				pw_log_debug(" data %d %u -> fd %d", j, bmid->id, bmid->fd);
+
+				if ((d->flags & SPA_DATA_FLAG_MAP_TWICE) &&
+				    map_ringbuffer(bid, d) < 0) {
+					pw_log_warn("stream %p: can't map ringbuffer twice: %s",
+						    stream, strerror(errno));
+					d->flags &= ~SPA_DATA_FLAG_MAP_TWICE;
+					if (map_memid(impl, bmid, d->mapoffset + d->maxsize) == SPA_RESULT_OK)
+						d->data = SPA_MEMBER(bmid->ptr, d->mapoffset, void);
+				}
 			} else if (d->type == stream->remote->core->type.data.MemPtr) {
 				d->data = SPA_MEMBER(bid->buf_ptr, SPA_PTR_TO_INT(d->data), void);
 				d->fd = -1;
@@ -833,6 +924,15 @@ client_node_use_buffers(void *data,
 				pw_log_warn("unknown buffer data type %d", d->type);
 			}
 		}
+		if (impl->mode == PW_STREAM_MODE_RINGBUFFER && b->n_datas > 0 &&
+		    b->datas[0].data != NULL &&
+		    (impl->ring.rb = spa_buffer_find_meta(b, stream->remote->core->type.meta.Ringbuffer))) {
+			impl->ring.id = bid->id;
+			impl->ring.data = b->datas[0].data;
+			impl->ring.twice = b->datas[0].flags & SPA_DATA_FLAG_MAP_TWICE;
+			pw_log_debug("stream %p: ringbuffer %u size %u%s", stream, bid->id,
+				     impl->ring.rb->size, impl->ring.twice ? ", mapped twice" : "");
+		}
 		spa_hook_list_call(&stream->listener_list, struct pw_stream_events, add_buffer, bid->id);
 	}
 
@@ -929,6 +1029,7 @@ pw_stream_connect(struct pw_stream *stream,
 	    direction == PW_DIRECTION_INPUT ? SPA_DIRECTION_INPUT : SPA_DIRECTION_OUTPUT;
 	impl->port_id = 0;
 	impl->mode = mode;
+	impl->flags = flags;
 
 	set_possible_formats(stream, n_possible_formats, possible_formats);
 
@@ -940,6 +1041,12 @@ pw_stream_connect(struct pw_stream *stream,
 		pw_properties_set(stream->properties, "pipewire.target.node", port_path);
 	if (flags & PW_STREAM_FLAG_AUTOCONNECT)
 		pw_properties_set(stream->properties, "pipewire.autoconnect", "1");
+	if (flags & PW_STREAM_FLAG_DRIVER) {
+		pw_properties_set(stream->properties, "node.driver", "1");
+		/* devices have priority 2 and keep pacing the hardware, the
+		 * stream drives when no device is running on its loop */
+		pw_properties_set(stream->properties, "node.driver-priority", "1");
+	}
 
 	impl->node_proxy = pw_core_proxy_create_node(stream->remote->core_proxy,
 			       "client-node",
@@ -1009,15 +1116,37 @@ void pw_stream_disconnect(struct pw_stream *stream)
 bool pw_stream_get_time(struct pw_stream *stream, struct pw_time *time)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	int64_t elapsed;
+	int64_t elapsed, ticks, monotonic, last;
+	uint32_t driver;
+	int32_t rate;
 	struct timespec ts;
 
+	if (impl->trans == NULL ||
+	    !pw_client_node_clock_read(&impl->trans->area->clock, &driver, &rate, &ticks, &monotonic)) {
+		ticks = impl->last_ticks;
+		rate = impl->last_rate;
+		monotonic = impl->last_monotonic;
+	}
+	/* the ticks of a new driver are unrelated to the old ones */
+	else if (__atomic_exchange_n(&impl->time_driver, driver, __ATOMIC_RELAXED) != driver)
+		__atomic_store_n(&impl->time_ticks, INT64_MIN, __ATOMIC_RELAXED);
+
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	time->now = SPA_TIMESPEC_TO_TIME(&ts);
-	elapsed = (time->now - impl->last_monotonic) / 1000;
+	elapsed = (time->now - monotonic) / 1000;
+
+	time->ticks = ticks + (elapsed * rate) / SPA_USEC_PER_SEC;
+	time->rate = rate;
 
-	time->ticks = impl->last_ticks + (elapsed * impl->last_rate) / SPA_USEC_PER_SEC;
-	time->rate = impl->last_rate;
+	/* the extrapolation can overshoot the next driver update, never go back */
+	last = __atomic_load_n(&impl->time_ticks, __ATOMIC_RELAXED);
+	do {
+		if (time->ticks < last) {
+			time->ticks = last;
+			break;
+		}
+	} while (!__atomic_compare_exchange_n(&impl->time_ticks, &last, time->ticks,
+					      true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 
 	return true;
 }
@@ -1049,6 +1178,13 @@ bool pw_stream_recycle_buffer(struct pw_stream *stream, uint32_t id)
 	bid->used = false;
 	spa_list_insert(impl->free.prev, &bid->link);
 
+	if (pw_client_node_reuse_mark(&impl->trans->input_reuse[impl->port_id], id)) {
+		impl->reuse_pending = true;
+		if (!impl->in_new_buffer)
+			send_reuse_buffers(stream);
+		return true;
+	}
+
 	pw_client_node_transport_add_message(impl->trans, (struct pw_client_node_message *) &rb);
 	write(impl->rtwritefd, &cmd, 8);
 
@@ -1082,7 +1218,7 @@ bool pw_stream_send_buffer(struct pw_stream *stream, uint32_t id)
 		impl->trans->outputs[0].buffer_id = id;
 		impl->trans->outputs[0].status = SPA_RESULT_HAVE_BUFFER;
 		pw_log_trace("stream %p: send buffer %d", stream, id);
-		if (!impl->in_need_buffer)
+		if (!impl->in_need_buffer && !(impl->flags & PW_STREAM_FLAG_DRIVER))
 			send_have_output(stream);
 	} else {
 		pw_log_debug("stream %p: output %u was used", stream, id);
@@ -1090,3 +1226,76 @@ bool pw_stream_send_buffer(struct pw_stream *stream, uint32_t id)
 
 	return true;
 }
+
+bool pw_stream_drive(struct pw_stream *stream, const struct pw_time *time)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	uint64_t cmd = 1;
+	uint32_t type;
+
+	if (!(impl->flags & PW_STREAM_FLAG_DRIVER) || impl->trans == NULL)
+		return false;
+
+	pw_client_node_clock_write(&impl->trans->area->node_clock, 0,
+				   time->rate, time->ticks, time->now);
+
+	if (impl->direction == SPA_DIRECTION_OUTPUT)
+		type = PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT;
+	else
+		type = PW_CLIENT_NODE_MESSAGE_NEED_INPUT;
+
+	pw_client_node_transport_add_message(impl->trans, &PW_CLIENT_NODE_MESSAGE_INIT(type));
+	write(impl->rtwritefd, &cmd, 8);
+
+	return true;
+}
+
+void *pw_stream_ringbuffer_acquire(struct pw_stream *stream, uint32_t *size)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct spa_ringbuffer *rb = impl->ring.rb;
+	int32_t avail;
+	uint32_t offset;
+
+	if (rb == NULL)
+		return NULL;
+
+	if (impl->direction == SPA_DIRECTION_OUTPUT)
+		avail = rb->size - spa_ringbuffer_get_write_index(rb, &impl->ring.index);
+	else
+		avail = spa_ringbuffer_get_read_index(rb, &impl->ring.index);
+
+	avail = SPA_CLAMP(avail, 0, (int32_t) rb->size);
+	offset = impl->ring.index & rb->mask;
+
+	/* without the second mapping, stop at the end of the memory */
+	if (!impl->ring.twice)
+		avail = SPA_MIN(avail, rb->size - offset);
+
+	*size = avail;
+	return SPA_MEMBER(impl->ring.data, offset, void);
+}
+
+bool pw_stream_ringbuffer_commit(struct pw_stream *stream, uint32_t size)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct spa_ringbuffer *rb = impl->ring.rb;
+	struct buffer_id *bid;
+	uint32_t index;
+
+	if (rb == NULL)
+		return false;
+
+	if (impl->direction == SPA_DIRECTION_OUTPUT) {
+		spa_ringbuffer_write_update(rb, impl->ring.index + size);
+		/* queue the ringbuffer again when the consumer has drained it */
+		if ((bid = find_buffer(stream, impl->ring.id)) && !bid->used)
+			pw_stream_send_buffer(stream, impl->ring.id);
+	} else {
+		spa_ringbuffer_read_update(rb, impl->ring.index + size);
+		/* give the ringbuffer back to the producer when it is empty */
+		if (spa_ringbuffer_get_read_index(rb, &index) <= 0)
+			pw_stream_recycle_buffer(stream, impl->ring.id);
+	}
+	return true;
+}
@@ -69,7 +69,11 @@ extern "C" {
  *	frames.
  * \li \ref PW_STREAM_MODE_RINGBUFFER: data is exhanged with a fixed
  *	size ringbuffer. This is ideal for variable sized audio packets
- *	or compressed media.
+ *	or compressed media. Pass a MetaEnable param for the ringbuffer
+ *	metadata to pw_stream_finish_format() and use
+ *	pw_stream_ringbuffer_acquire() and pw_stream_ringbuffer_commit()
+ *	to access the data. The ringbuffer memory is mapped twice, back to
+ *	back, so the returned region is always contiguous.
  *
  * \subsection ssec_stream_target Stream target
  *
@@ -147,6 +151,13 @@ extern "C" {
  * The new_buffer signal is emited when PipeWire no longer uses the buffer
  * and it can be safely reused.
  *
+ * \subsection ssec_drive Drive the graph
+ *
+ * A stream connected with \ref PW_STREAM_FLAG_DRIVER provides the clock of
+ * the graph when no device is running on its data loop. Sent buffers
+ * are not processed until \ref pw_stream_drive() starts the next cycle with
+ * the time of the stream.
+ *
  * \section sec_stream_disconnect Disconnect
  *
  * Use \ref pw_stream_disconnect() to disconnect a stream after use.
@@ -213,6 +224,8 @@ enum pw_stream_flags {
 						  *  this stream */
 	PW_STREAM_FLAG_CLOCK_UPDATE = (1 << 1),	/**< request periodic clock updates for
 						  *  this stream */
+	PW_STREAM_FLAG_DRIVER = (1 << 2),	/**< the stream drives the graph with
+						  *  pw_stream_drive() */
 };
 
 /** \enum pw_stream_mode The method for transfering data for a stream \memberof pw_stream */
@@ -285,7 +298,12 @@ pw_stream_finish_format(struct pw_stream *stream,	/**< a \ref pw_stream */
 			struct spa_param **params,	/**< an array of pointers to \ref spa_param */
 			uint32_t n_params		/**< number of elements in \a params */);
 
-/** Query the time on the stream \memberof pw_stream */
+/** Query the time on the stream \memberof pw_stream
+ *
+ * The time is extrapolated from the clock of the graph driver, which is
+ * published in shared memory every cycle. This does not block and can be
+ * called from any thread while the stream is connected. The returned ticks
+ * never decrease. */
 bool pw_stream_get_time(struct pw_stream *stream, struct pw_time *time);
 
 /** Get the id of an empty buffer that can be filled \memberof pw_stream
@@ -305,6 +323,23 @@ bool pw_stream_recycle_buffer(struct pw_stream *stream, uint32_t id);
 struct spa_buffer *
 pw_stream_peek_buffer(struct pw_stream *stream, uint32_t id);
 
+/** Get the next region of the ringbuffer \memberof pw_stream
+ *
+ * For an output stream this is the free space that can be written, for an
+ * input stream the data that can be read. The region is contiguous and
+ * can be used up to the returned \a size.
+ *
+ * \return a pointer to the region or NULL when the stream has no ringbuffer */
+void *pw_stream_ringbuffer_acquire(struct pw_stream *stream, uint32_t *size);
+
+/** Complete the access to the region of pw_stream_ringbuffer_acquire() \memberof pw_stream
+ *
+ * \a size bytes are made available to the consumer for an output stream or
+ * released for an input stream.
+ *
+ * \return true on success, false when the stream has no ringbuffer */
+bool pw_stream_ringbuffer_commit(struct pw_stream *stream, uint32_t size);
+
 /** Send a buffer with \a id to \a stream \memberof pw_stream
  * \return true when \a id was handled, false on error
  *
@@ -312,6 +347,14 @@ pw_stream_peek_buffer(struct pw_stream *stream, uint32_t id);
  * there is a new buffer available. */
 bool pw_stream_send_buffer(struct pw_stream *stream, uint32_t id);
 
+/** Start a graph cycle on a driver stream \memberof pw_stream
+ * \return true on success, false when the stream is not a driver
+ *
+ * \a time is published as the clock of the graph and the cycle is
+ * started: the sent buffer is pushed for an output stream, input is
+ * pulled for an input stream. */
+bool pw_stream_drive(struct pw_stream *stream, const struct pw_time *time);
+
 #ifdef __cplusplus
 }
 #endif
@@ -56,6 +56,10 @@ void pw_type_init(struct pw_type *type)
 
 	spa_type_meta_map(type->map, &type->meta);
 	spa_type_data_map(type->map, &type->data);
+	spa_type_media_type_map(type->map, &type->media_type);
+	spa_type_media_subtype_map(type->map, &type->media_subtype);
+	spa_type_format_audio_map(type->map, &type->format_audio);
+	spa_type_audio_format_map(type->map, &type->audio_format);
 	spa_type_event_node_map(type->map, &type->event_node);
 	spa_type_command_node_map(type->map, &type->command_node);
 	spa_type_monitor_map(type->map, &type->monitor);
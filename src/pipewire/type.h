@@ -29,6 +29,7 @@ extern "C" {
 #include <spa/command-node.h>
 #include <spa/monitor.h>
 #include <spa/param-alloc.h>
+#include <spa/audio/format-utils.h>
 
 #include <pipewire/map.h>
 
@@ -65,6 +66,10 @@ struct pw_type {
 
 	struct spa_type_meta meta;
 	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
 	struct spa_type_event_node event_node;
 	struct spa_type_command_node command_node;
 	struct spa_type_monitor monitor;